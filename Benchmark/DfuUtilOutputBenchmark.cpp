@@ -0,0 +1,119 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Benchmark of the dfu-util output parsing over recorded outputs (Benchmark/Samples).
+ * The streaming parser is compared with the former std::regex based parsing, which
+ * compiled its expression for every "dfu-util -l" poll.
+ *
+ * Build and run with : make benchmark
+ */
+
+#include "DfuUtilOutputParser.h"
+#include <regex>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include <algorithm>
+
+static const char* samples[] = {
+    "Benchmark/Samples/dfu-util-list.txt",
+    "Benchmark/Samples/dfu-util-download.txt",
+    "Benchmark/Samples/dfu-util-upload.txt",
+    "Benchmark/Samples/dfu-util-error.txt"
+};
+
+static const int ITERATIONS = 20000 ;
+static const size_t CHUNK_SIZE = 512 ; // The process output is read in small chunks
+
+static int parseWithRegex(const std::string &output)
+{
+    int events = 0 ;
+    std::regex lineRegex(R"(Found DFU: \[0483:df11\][^\n]*devnum=([0-9]+),[^\n]*path=\"([^\"]*)\", alt=([0-9]+), name=\"([^\"]*)\", serial=\"([^\"]*)\")");
+    auto begin = std::sregex_iterator(output.begin(), output.end(), lineRegex);
+    for (std::sregex_iterator i = begin; i != std::sregex_iterator(); ++i)
+        events++ ;
+
+    if(output.find("Download done.") != std::string::npos)
+        events++ ;
+    if(output.find("Upload done.") != std::string::npos)
+        events++ ;
+
+    return events ;
+}
+
+static int parseWithScanner(DfuUtilOutputParser &parser, const std::string &output)
+{
+    int events = 0 ;
+    parser.reset();
+    parser.setEventCallback([&events](const DfuOutputEvent &event) {
+        if((event.type == DFU_OUTPUT_ALT_SETTING) || (event.type == DFU_OUTPUT_DOWNLOAD_DONE) || (event.type == DFU_OUTPUT_UPLOAD_DONE))
+            events++ ;
+    });
+
+    for(size_t offset = 0; offset < output.size(); offset += CHUNK_SIZE)
+        parser.feed(output.data() + offset, std::min(CHUNK_SIZE, output.size() - offset)) ;
+    parser.finish();
+
+    return events ;
+}
+
+int main()
+{
+    int status = 0 ;
+    DfuUtilOutputParser parser ;
+
+    printf("%-42s %8s %12s %12s %10s\n", "Sample", "Events", "regex ns", "scanner ns", "Speedup") ;
+    for(const char *sample : samples)
+    {
+        std::ifstream file(sample, std::ios::binary) ;
+        if(file.is_open() == false)
+        {
+            printf("Cannot open %s, run the benchmark from the project directory\n", sample) ;
+            return 1 ;
+        }
+        std::string output((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>()) ;
+
+        int regexEvents = 0 ;
+        auto start = std::chrono::steady_clock::now() ;
+        for(int i = 0; i < ITERATIONS; i++)
+            regexEvents = parseWithRegex(output) ;
+        double regexNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ITERATIONS ;
+
+        int scannerEvents = 0 ;
+        start = std::chrono::steady_clock::now() ;
+        for(int i = 0; i < ITERATIONS; i++)
+            scannerEvents = parseWithScanner(parser, output) ;
+        double scannerNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ITERATIONS ;
+
+        if(regexEvents != scannerEvents)
+        {
+            printf("%s : %d events with regex, %d with the scanner\n", sample, regexEvents, scannerEvents) ;
+            status = 1 ;
+        }
+
+        printf("%-42s %8d %12.0f %12.0f %9.1fx\n", sample, scannerEvents, regexNs, scannerNs, regexNs / scannerNs) ;
+    }
+
+    return status ;
+}
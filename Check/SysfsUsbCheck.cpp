@@ -0,0 +1,181 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Check of the sysfs USB enumeration over a fake sysfs tree, built in a temporary directory
+ * the same way the kernel lays it out: the device directories under /devices and their links
+ * in /bus/usb/devices. Covers the device attributes, the port path of a bus and device number
+ * and the interface strings, then the USB topology derived from the port paths.
+ *
+ * Build and run with : make check
+ */
+
+#include "SysfsUsb.h"
+#include "TransferScheduler.h"
+#include <fstream>
+#include <cstdio>
+#include <experimental/filesystem>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace fs = std::experimental::filesystem ;
+
+struct FakeDevice
+{
+    const char *portPath;
+    const char *parentPath;     // Device directory of the parent, relative to the fake root
+    const char *vendorID;
+    const char *productID;
+    int busNumber;
+    int deviceNumber;
+    const char *serialNumber;
+    const char *product;
+    const char *interfaceString;
+};
+
+static const char* CONTROLLER_PATH = "devices/pci0000:00/0000:00:14.0" ;
+
+static const FakeDevice fakeDevices[] = {
+    {"usb1",  "",                   "1d6b", "0002", 1, 1,  "0000:00:14.0",             "xHCI Host Controller", nullptr},
+    {"1-2",   "usb1",               "05e3", "0610", 1, 4,  "",                         "USB2.1 Hub",           nullptr},
+    {"1-2.3", "usb1/1-2",           "0483", "df11", 1, 7,  "0021003A3135510B37363934", "DFU in HS Mode",       "@FSBL /0x01/1*1Me"},
+    {"1-4",   "usb1",               "0483", "0afb", 1, 9,  "003A00213135510B37363934", "USB download gadget",  "Android Fastboot"},
+    {"usb2",  "",                   "1d6b", "0003", 2, 1,  "0000:00:14.0",             "xHCI Host Controller", nullptr},
+    {"2-1",   "usb2",               "0483", "df11", 2, 3,  "004800343138510E36333937", "DFU in HS Mode",       "@virtual /0xF1/1*512Ba"},
+};
+
+static int failures = 0 ;
+
+static void check(bool condition, const char *description)
+{
+    printf("%-64s %s\n", description, condition ? "OK" : "FAILED") ;
+    if(condition == false)
+        failures++ ;
+}
+
+static void writeAttribute(const fs::path &path, const std::string &value)
+{
+    std::ofstream file(path.string());
+    file << value << "\n" ;
+}
+
+static std::string getDevicePath(const FakeDevice &device)
+{
+    std::string path = std::string(CONTROLLER_PATH) + "/" ;
+    if(device.parentPath[0] != '\0')
+        path += std::string(device.parentPath) + "/" ;
+    return path + device.portPath ;
+}
+
+static bool createTree(const fs::path &root)
+{
+    std::error_code errorCode ;
+    fs::create_directories(root / "bus/usb/devices", errorCode) ;
+    if(errorCode)
+        return false ;
+
+    for(const auto &device : fakeDevices)
+    {
+        fs::path directory = root / getDevicePath(device) ;
+        fs::create_directories(directory, errorCode) ;
+        if(errorCode)
+            return false ;
+
+        writeAttribute(directory / "idVendor", device.vendorID) ;
+        writeAttribute(directory / "idProduct", device.productID) ;
+        writeAttribute(directory / "busnum", std::to_string(device.busNumber)) ;
+        writeAttribute(directory / "devnum", std::to_string(device.deviceNumber)) ;
+        writeAttribute(directory / "product", device.product) ;
+        if(device.serialNumber[0] != '\0')
+            writeAttribute(directory / "serial", device.serialNumber) ;
+
+        /* Interface <port path>:<configuration>.<interface>, linked like its device */
+        if(device.interfaceString != nullptr)
+        {
+            std::string interfaceName = std::string(device.portPath) + ":1.0" ;
+            fs::create_directories(directory / interfaceName, errorCode) ;
+            writeAttribute(directory / interfaceName / "interface", device.interfaceString) ;
+            fs::create_directory_symlink("../../../" + getDevicePath(device) + "/" + interfaceName, root / "bus/usb/devices" / interfaceName, errorCode) ;
+        }
+
+        fs::create_directory_symlink("../../../" + getDevicePath(device), root / "bus/usb/devices" / device.portPath, errorCode) ;
+        if(errorCode)
+            return false ;
+    }
+
+    return true ;
+}
+
+int main()
+{
+#ifdef __linux__
+    std::error_code errorCode ;
+    fs::path root = fs::temp_directory_path(errorCode) / ("PRG-TOOLBOX-DFU-sysfs-" + std::to_string(getpid())) ;
+    if(createTree(root) == false)
+    {
+        printf("Cannot create the fake sysfs tree in %s\n", root.string().c_str()) ;
+        fs::remove_all(root, errorCode) ;
+        return 1 ;
+    }
+    SysfsUsb::setRoot(root.string()) ;
+
+    check(SysfsUsb::isAvailable(), "The fake tree is available") ;
+
+    std::vector<SysfsUsbDevice> devices ;
+    check((SysfsUsb::enumerate(0x0483, 0xdf11, devices) == 0) && (devices.size() == 2), "Two DFU devices are enumerated") ;
+    if(devices.size() == 2)
+    {
+        check((devices[0].portPath == "1-2.3") && (devices[1].portPath == "2-1"), "The devices are sorted by port path") ;
+        check((devices[0].busNumber == 1) && (devices[0].deviceNumber == 7), "Bus and device numbers are read") ;
+        check(devices[0].serialNumber == "0021003A3135510B37363934", "Serial number is read") ;
+        check(devices[0].product == "DFU in HS Mode", "Product string is read") ;
+        check((devices[0].interfaceStrings.size() == 1) && (devices[0].interfaceStrings[0] == "@FSBL /0x01/1*1Me"), "Interface string is read") ;
+        check((devices[1].interfaceStrings.size() == 1) && (devices[1].interfaceStrings[0] == "@virtual /0xF1/1*512Ba"), "Interface string of the second bus is read") ;
+    }
+
+    SysfsUsbDevice device ;
+    check(SysfsUsb::findDevice(0x0483, 0xdf11, "004800343138510E36333937", device) && (device.portPath == "2-1"), "Device is found by serial number") ;
+    check(SysfsUsb::findDevice(0x0483, 0xdf11, "UNPLUGGED", device) == false, "Unknown serial number is not found") ;
+    check(SysfsUsb::findDevice(0x0483, 0x0afb, "", device) && (device.portPath == "1-4"), "Fastboot device is found") ;
+
+    check(SysfsUsb::findPortPath(1, 7) == "1-2.3", "Port path of bus 1 device 7 is 1-2.3") ;
+    check(SysfsUsb::findPortPath(2, 3) == "2-1", "Port path of bus 2 device 3 is 2-1") ;
+    check(SysfsUsb::findPortPath(2, 7).empty(), "Device number of another bus is not matched") ;
+    check(SysfsUsb::readSerialNumber("/" + getDevicePath(fakeDevices[2])) == "0021003A3135510B37363934", "Serial number is read from the uevent device path") ;
+
+    UsbTopology topology = TransferScheduler::getTopology("1-2.3") ;
+    check((topology.busNumber == 1) && (topology.rootPort == "1-2") && (topology.hub == "1-2"), "Topology of 1-2.3") ;
+    topology = TransferScheduler::getTopology("2-1") ;
+    check((topology.busNumber == 2) && (topology.rootPort == "2-1") && topology.hub.empty(), "Topology of 2-1") ;
+    topology = TransferScheduler::getTopology("1-2.3.4") ;
+    check((topology.rootPort == "1-2") && (topology.hub == "1-2.3"), "Topology of 1-2.3.4") ;
+    check(TransferScheduler::getTopology("").rootPort.empty(), "Unknown port has no topology") ;
+
+    fs::remove_all(root, errorCode) ;
+    printf("%s\n", (failures == 0) ? "All checks passed" : "Some checks failed") ;
+    return (failures == 0) ? 0 : 1 ;
+#else
+    printf("The sysfs enumeration is only available on Linux\n") ;
+    return 0 ;
+#endif
+}
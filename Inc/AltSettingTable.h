@@ -0,0 +1,52 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ALTSETTINGTABLE_H
+#define ALTSETTINGTABLE_H
+
+#include <iostream>
+#include <vector>
+#include <tuple>
+#include <unordered_map>
+#include <cstdint>
+#include "DfuDevice.h"
+
+/**
+ * Alternate settings of one device enumeration, parsed once from the "@name /0xID..." strings
+ * and indexed by partition name and by partition (phase) ID.
+ */
+class AltSettingTable
+{
+public:
+    void build(const std::vector<DfuAltSetting> &altSettings) ;
+    void clear() ;
+    bool findByName(const std::string &name, uint8_t *altIndex) const ;
+    bool findByPartitionId(int partitionId, uint8_t *altIndex) const ;
+    const std::vector<std::tuple<int, std::string, int>>& getEntries() const ;
+
+private:
+    std::vector<std::tuple<int, std::string, int>> entries ;    // alternate index, name, partition ID
+    std::unordered_map<std::string, uint8_t> nameIndex ;
+    std::unordered_map<int, uint8_t> partitionIdIndex ;
+};
+
+#endif // ALTSETTINGTABLE_H
@@ -26,6 +26,10 @@
 #include <iostream>
 #include "DisplayManager.h"
 #include "Error.h"
+#include "DfuTransport.h"
+#include "DeviceSession.h"
+#include "DeviceIndex.h"
+#include "HotplugMonitor.h"
 #include <thread>
 #include <chrono>
 #include <vector>
@@ -37,11 +41,23 @@ enum STM32MP_DEVICE {
     STM32MP21 = 0x503
 };
 
+struct GetPhaseStruct
+{
+    uint8_t Phase;          // Phase P expected by device
+    uint32_t Address;       // 0xFFFFFFFF or load address in embedded RAM
+    uint32_t Offset;        // 0x0
+    uint8_t NeedDFUDetach;  // Present only if P = 0, 1 : DFU detach is requested for a new USB enumeration
+};
+
+#define GET_PHASE_MIN_SIZE  9   // Phase (1 byte), Address (4 bytes LE), Offset (4 bytes LE), then the optional NeedDFUDetach byte
+
 class DFU
 {
 public:
     DFU();
+    ~DFU();
     int flashPartition(uint8_t partitionIndex, const std::string inputFirmwarePath) ;
+    int flashPartition(uint8_t partitionIndex, const unsigned char *data, size_t size) ;
     int dfuDetach() ;
     bool isUbootDfuRunning(uint32_t msTimeout = 1000) ;
     bool isUbootFastbootRunning(uint32_t msTimeout = 1000) ;
@@ -50,23 +66,42 @@ public:
     int readOtpPartition(const std::string filePath) ;
     int writeOtpPartition(const std::string filePath) ;
     bool isDfuUtilInstalled() ;
+    bool isFileDownloadPreferred() ;
     int getAlternateSettingIndex(const std::string altName, uint8_t *altIndex);
     int displayDevicesList() ;
     int readPartition(const std::string filePath, uint8_t altIndex);
+    int readPartition(uint8_t altIndex, std::vector<unsigned char> &data);
+    int getPhase(GetPhaseStruct *phaseInfo) ;
     int getAlternateSettingIndex(const uint8_t phaseId, uint8_t *altIndex);
+    const DeviceSession& getSession() const ;
+    int scanDevices() ;
+    const DeviceIndex& getDeviceIndex() const ;
 
     uint16_t deviceID ;
     std::string otpPartitionName ;
     bool isSTM32PRGFW_UTIL ;
     std::string toolboxFolder = "" ;
     std::string dfuSerialNumber = "" ;
-    std::vector<std::tuple<int, std::string, int>> altSettingList ;
 
 private:
+    DfuTransport* getTransport() ;
+    int flashCompressedPartition(uint8_t partitionIndex, const std::string &inputFirmwarePath) ;
+    int getAlternateSettingTable(const AltSettingTable **table);
+    bool isSessionValid() ;
+    bool isFastbootDevicePresent() ;
+    bool updateSession(const DfuDeviceInfo &device) ;
+    bool findOtpAlternateSetting(const DfuDeviceInfo &device) ;
+    bool startHotplugMonitor() ;
+    void waitDeviceChange(bool isEventDriven, uint16_t productID, const std::chrono::steady_clock::time_point &deadline, uint32_t pollMs) ;
+
     DisplayManager displayManager = DisplayManager::getInstance() ;
-    std::string getDfuUtilProgramPath() ;
-    std::string getLsUsbProgramPath() ;
-    int getAlternateSettingList();
+    std::unique_ptr<DfuTransport> transport ;
+    DeviceSession session ;
+    DeviceIndex deviceIndex ;
+    HotplugMonitor hotplugMonitor ;
+    uint8_t otpAltIndex ;
+    std::vector<unsigned char> phaseBuffer ;
+    std::string usbPortPath ;   // Port of the device, kept across its re-enumerations for the transfer scheduling
 };
 
 #endif // DFU_H
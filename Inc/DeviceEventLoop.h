@@ -0,0 +1,86 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DEVICEEVENTLOOP_H
+#define DEVICEEVENTLOOP_H
+
+#include <iostream>
+#include <deque>
+#include <list>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+#include "DFU.h"
+#include "DeviceIndex.h"
+#include "Error.h"
+
+constexpr uint32_t EVENT_LOOP_POLL_MS = 50 ;    // Period of the device scans while devices are awaited
+
+enum DEVICE_WAIT {
+    DEVICE_WAIT_NONE,           // Nothing to wait for
+    DEVICE_WAIT_DFU,            // New enumeration in a DFU mode (next boot stage: FSBL, FIP-DDR)
+    DEVICE_WAIT_UBOOT_DFU,      // New enumeration of U-Boot running the DFU command
+    DEVICE_WAIT_FASTBOOT        // U-Boot running the fastboot command
+};
+
+struct DeviceWaiter
+{
+    std::string serialNumber;
+    DEVICE_WAIT mode;
+    int lastDeviceNumber;       // Device number before the detach, the device is back once it changed
+    std::chrono::steady_clock::time_point deadline;
+    std::function<void(int)> callback;
+};
+
+/**
+ * Single thread event loop driving many devices without a thread per device. The work of each
+ * device is split into tasks chained by continuations: a task runs the next DFU operations of its
+ * device, then posts the following task, or registers a wait for the next boot stage of the device
+ * (waitForMode) whose callback continues the sequence. The waits of all the devices are served by
+ * a single device scan per poll, so the reboots of the devices overlap while the loop only works
+ * for the devices which are ready. The DFU operations themselves run on the loop thread.
+ */
+class DeviceEventLoop
+{
+public:
+    DeviceEventLoop(const std::string &toolboxFolder);
+    void post(std::function<void(void)> task) ;
+    void waitForMode(const std::string &serialNumber, DEVICE_WAIT mode, int lastDeviceNumber, uint32_t msTimeout, std::function<void(int)> callback) ;
+    void run() ;
+    int scanDevices() ;
+    const DeviceIndex& getDeviceIndex() const ;
+    uint64_t getBusyMs() const ;
+    uint32_t getScanCount() const ;
+
+private:
+    void runReadyTasks() ;
+    void pollWaiters() ;
+    static bool isDeviceBack(const DeviceWaiter &waiter, const DiscoveredDevice *device) ;
+
+    DFU scanInterface ;         // Lists every attached device in one pass
+    std::deque<std::function<void(void)>> readyTasks ;
+    std::list<DeviceWaiter> waiters ;
+    uint64_t busyMs ;           // Time spent running the tasks and the wait callbacks
+    uint32_t scanCount ;
+};
+
+#endif // DEVICEEVENTLOOP_H
@@ -0,0 +1,75 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DEVICEINDEX_H
+#define DEVICEINDEX_H
+
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "DfuTransport.h"
+#include "AltSettingTable.h"
+#include "DeviceLock.h"
+
+enum DEVICE_MODE {
+    DEVICE_MODE_ROM_DFU,        // ROM code waiting for the boot partitions
+    DEVICE_MODE_UBOOT_DFU,      // U-Boot running the stm32prog DFU command
+    DEVICE_MODE_PRGFW_UTIL,     // STM32PRGFW-UTIL programming firmware
+    DEVICE_MODE_FASTBOOT        // U-Boot running the fastboot command
+};
+
+struct DiscoveredDevice
+{
+    std::string serialNumber;
+    DEVICE_MODE mode;
+    uint16_t deviceID;          // STM32MP_DEVICE value, 0 when it is not exposed
+    AltSettingTable altSettings;
+    std::string otpAltName;     // Empty when the OTP partition is not exposed
+    uint8_t otpAltIndex;
+    std::string portPath;       // USB port path, e.g. 1-2.3, empty when it is not known
+    int busNumber;
+    int deviceNumber;
+    long lockOwnerPid;          // Process holding the device lock, 0 when the device is free
+};
+
+/**
+ * Snapshot of every attached ST device (DFU and Fastboot), built by a single discovery pass:
+ * one device listing from the transport joined with one sysfs scan. The device locks of the
+ * other instances are sampled at the same time.
+ */
+class DeviceIndex
+{
+public:
+    int scan(DfuTransport *transport) ;
+    const std::vector<DiscoveredDevice>& getDevices() const ;
+    const DiscoveredDevice* findBySerialNumber(const std::string &serialNumber) const ;
+    static const char* getModeName(DEVICE_MODE mode) ;
+
+private:
+    static DiscoveredDevice classifyDfuDevice(const DfuDeviceInfo &device, const SysfsUsbDevice *sysfsDevice) ;
+
+    std::vector<DiscoveredDevice> devices ;
+    std::unordered_map<std::string, size_t> serialNumberIndex ;
+};
+
+#endif // DEVICEINDEX_H
@@ -0,0 +1,64 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DEVICELOCK_H
+#define DEVICELOCK_H
+
+#include <iostream>
+#include <cstdint>
+
+/**
+ * Advisory lock of a device shared by all the toolbox processes, keyed by the serial number and by
+ * the USB port path. Each key is a file of the lock directory holding an fcntl open file description
+ * lock, so the lock also excludes the other threads of the same process and is released by the kernel
+ * if the holder dies. The lock directory is PRG_TOOLBOX_DFU_LOCK_DIR if set, otherwise the system wide
+ * /run/lock/PRG-TOOLBOX-DFU, otherwise /tmp/PRG-TOOLBOX-DFU-locks (PRG-TOOLBOX-DFU-locks in the temporary
+ * directory on Windows).
+ */
+class DeviceLock
+{
+public:
+    DeviceLock();
+    ~DeviceLock();
+    int acquire(const std::string &serialNumber, const std::string &portPath, uint32_t msTimeout = 0) ;
+    void release() ;
+    bool isHeld() const ;
+    const std::string& getSerialNumber() const ;
+    const std::string& getPortPath() const ;
+
+    static bool isLocked(const std::string &serialNumber, const std::string &portPath, long *ownerPid = nullptr) ;
+    static std::string getLockDirectory() ;
+
+private:
+    static std::string getLockFilePath(const std::string &kind, const std::string &key) ;
+    static int lockFile(const std::string &path, intptr_t *handle) ;
+    static void unlockFile(intptr_t handle) ;
+    static bool isFileLocked(const std::string &path, long *ownerPid) ;
+    void writeOwner(intptr_t handle) ;
+
+    std::string serialNumber ;
+    std::string portPath ;
+    intptr_t serialHandle ;     // Open lock files, -1 if not held
+    intptr_t portHandle ;
+};
+
+#endif // DEVICELOCK_H
@@ -0,0 +1,67 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DEVICESESSION_H
+#define DEVICESESSION_H
+
+#include <iostream>
+#include <cstdint>
+#include "DfuDevice.h"
+#include "AltSettingTable.h"
+
+/**
+ * Identity of the selected DFU device (serial number, device ID, descriptors) as probed
+ * for one USB enumeration. The information stays valid until the device re-enumerates:
+ * a detach, a hotplug event or a failed transfer invalidates it and opens a new generation.
+ */
+class DeviceSession
+{
+public:
+    DeviceSession();
+    bool isValid() const ;
+    bool isDeviceIdKnown() const ;
+    void update(const DfuDeviceInfo &deviceInfo) ;
+    void setDeviceID(uint16_t deviceID) ;
+    void invalidate() ;
+    void countLookup(bool isCached) ;
+
+    uint32_t getGeneration() const ;
+    uint32_t getProbeCount() const ;
+    uint16_t getDeviceID() const ;
+    uint32_t getLookupHits() const ;
+    uint32_t getLookupMisses() const ;
+    const DfuDeviceInfo& getDeviceInfo() const ;
+    const AltSettingTable& getAltSettingTable() const ;
+
+private:
+    DfuDeviceInfo deviceInfo ;
+    AltSettingTable altSettingTable ;
+    uint16_t deviceID ;
+    bool isProbed ;
+    bool isDeviceIdProbed ;
+    uint32_t generation ;       // Incremented each time the device re-enumerates
+    uint32_t probeCount ;       // Number of descriptor probes over the session lifetime
+    uint32_t lookupHits ;       // Alternate setting lookups answered from the cached table
+    uint32_t lookupMisses ;     // Alternate setting lookups which needed to query the descriptors
+};
+
+#endif // DEVICESESSION_H
@@ -0,0 +1,177 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DFUDEVICE_H
+#define DFUDEVICE_H
+
+#include <iostream>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include "DisplayManager.h"
+#include "Error.h"
+
+constexpr uint16_t ST_USB_VENDOR_ID = 0x0483;
+constexpr uint16_t ST_DFU_PRODUCT_ID = 0xDF11;
+constexpr uint16_t ST_FASTBOOT_PRODUCT_ID = 0x0AFB;
+
+constexpr uint32_t DFU_CONTROL_TIMEOUT_MS = 5000;
+constexpr uint16_t DFU_DETACH_TIMEOUT_MS = 1000;
+constexpr uint32_t DFU_BUSY_TIMEOUT_MS = 60000;     // Longest time a block may keep the device busy, e.g. a large erase
+constexpr uint32_t DFU_BUSY_MIN_POLL_MS = 1;
+constexpr uint16_t DFU_DEFAULT_TRANSFER_SIZE = 1024;
+
+/* Producer of the bytes of a download whose size is not known in advance: it fills up to capacity bytes
+   of the buffer and sets the number of bytes written, 0 at the end of the data. It returns 0 or an error. */
+typedef std::function<int(unsigned char *buffer, size_t capacity, size_t *size)> DownloadReader ;
+
+/* DFU 1.1 class-specific requests */
+enum DFU_REQUEST {
+    DFU_REQUEST_DETACH = 0,
+    DFU_REQUEST_DNLOAD = 1,
+    DFU_REQUEST_UPLOAD = 2,
+    DFU_REQUEST_GETSTATUS = 3,
+    DFU_REQUEST_CLRSTATUS = 4,
+    DFU_REQUEST_GETSTATE = 5,
+    DFU_REQUEST_ABORT = 6
+};
+
+/* DFU 1.1 device states (bState) */
+enum DFU_STATE {
+    DFU_STATE_APP_IDLE = 0,
+    DFU_STATE_APP_DETACH = 1,
+    DFU_STATE_DFU_IDLE = 2,
+    DFU_STATE_DNLOAD_SYNC = 3,
+    DFU_STATE_DNBUSY = 4,
+    DFU_STATE_DNLOAD_IDLE = 5,
+    DFU_STATE_MANIFEST_SYNC = 6,
+    DFU_STATE_MANIFEST = 7,
+    DFU_STATE_MANIFEST_WAIT_RESET = 8,
+    DFU_STATE_UPLOAD_IDLE = 9,
+    DFU_STATE_ERROR = 10
+};
+
+/* DFU 1.1 status codes (bStatus) */
+enum DFU_STATUS {
+    DFU_STATUS_OK = 0x00,
+    DFU_STATUS_ERR_TARGET = 0x01,
+    DFU_STATUS_ERR_FILE = 0x02,
+    DFU_STATUS_ERR_WRITE = 0x03,
+    DFU_STATUS_ERR_ERASE = 0x04,
+    DFU_STATUS_ERR_CHECK_ERASED = 0x05,
+    DFU_STATUS_ERR_PROG = 0x06,
+    DFU_STATUS_ERR_VERIFY = 0x07,
+    DFU_STATUS_ERR_ADDRESS = 0x08,
+    DFU_STATUS_ERR_NOTDONE = 0x09,
+    DFU_STATUS_ERR_FIRMWARE = 0x0A,
+    DFU_STATUS_ERR_VENDOR = 0x0B,
+    DFU_STATUS_ERR_USBR = 0x0C,
+    DFU_STATUS_ERR_POR = 0x0D,
+    DFU_STATUS_ERR_UNKNOWN = 0x0E,
+    DFU_STATUS_ERR_STALLEDPKT = 0x0F
+};
+
+/* Answer of the DFU_GETSTATUS request */
+struct DfuStatus
+{
+    uint8_t bStatus;        // DFU_STATUS code of the last request
+    uint32_t bwPollTimeout; // Minimum time in ms before the next DFU_GETSTATUS
+    uint8_t bState;         // DFU_STATE the device is going to enter
+    uint8_t iString;        // Index of a status description string
+};
+
+struct DfuAltSetting
+{
+    uint8_t alt;            // bAlternateSetting of the DFU interface
+    std::string name;       // iInterface string, e.g. "@virtual /0xF1/1*512Ba"
+};
+
+struct DfuDeviceInfo
+{
+    std::string serialNumber;
+    int busNumber;
+    int deviceNumber;
+    std::string portPath;                         // USB port path, e.g. 1-2.3, empty when it is not known
+    std::vector<DfuAltSetting> altSettings;
+    std::vector<std::string> descriptorStrings;   // Alternate setting names, manufacturer and product strings
+};
+
+/**
+ * Native DFU 1.1 host implementation talking to the device through the Linux usbfs
+ * (/dev/bus/usb). The device handle stays open between operations until a detach or
+ * a re-enumeration makes it stale.
+ */
+class DfuDevice
+{
+public:
+    DfuDevice();
+    ~DfuDevice();
+    int open(uint16_t vendorId, uint16_t productId, const std::string serialNumber = "");
+    void close();
+    bool isOpen() const;
+    bool isAlive();
+    int download(uint8_t alt, const unsigned char *data, size_t size);
+    int download(uint8_t alt, const DownloadReader &reader);
+    int upload(uint8_t alt, std::vector<unsigned char> &data);
+    int detach();
+    int getStatus(DfuStatus *status);
+    int clearStatus();
+    int abort();
+    bool isDownloadStarted() const;
+    DfuDeviceInfo getDeviceInfo() const;
+    static int enumerate(uint16_t vendorId, uint16_t productId, std::vector<DfuDeviceInfo> &devices);
+    static bool isDevicePresent(uint16_t vendorId, uint16_t productId);
+    static bool findDeviceIdString(const std::string &descriptorString, std::string &deviceIdString);
+    static bool parseAlternateName(const std::string &rawName, std::string &name, int &partID);
+
+    std::string serialNumber ;
+    std::vector<DfuAltSetting> altSettings ;
+    std::vector<std::string> descriptorStrings ;
+    DfuStatus lastStatus ;
+
+private:
+    static int getDevicePaths(std::vector<std::string> &devicePaths);
+    int openPath(const std::string &devPath, uint16_t vendorId, uint16_t productId);
+    int controlTransfer(uint8_t requestType, uint8_t request, uint16_t value, uint16_t index, unsigned char *data, uint16_t length);
+    int getStringDescriptor(uint8_t index, std::string &outString);
+    int parseDescriptors(const unsigned char *data, size_t size);
+    int setAlternateSetting(uint8_t alt);
+    int prepareIdleState();
+    int waitWhileBusy();
+    int finishDownload(uint16_t blockNumber);
+    int mapTransferError() ;
+    static const char* getStateName(uint8_t state);
+
+    DisplayManager displayManager = DisplayManager::getInstance() ;
+    int fileDescriptor ;
+    uint8_t interfaceNumber ;
+    int currentAlt ;
+    uint16_t transferSize ;
+    uint8_t dfuAttributes ;
+    int busNumber ;
+    int deviceNumber ;
+    std::string portPath ;
+    bool isBlockSent ;      // A data block of the last download was sent, the device may have started writing
+    std::vector<uint8_t> interfaceStringIndexes ;
+};
+
+#endif // DFUDEVICE_H
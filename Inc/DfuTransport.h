@@ -0,0 +1,84 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DFUTRANSPORT_H
+#define DFUTRANSPORT_H
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "DfuDevice.h"
+#include "SysfsUsb.h"
+#include "Error.h"
+
+constexpr size_t DOWNLOAD_READ_SIZE = 64 * 1024 ;   // Bytes asked to a download producer at once
+
+enum DFU_BACKEND {
+    DFU_BACKEND_AUTO,       // In-process USB when the device is accessible, dfu-util otherwise
+    DFU_BACKEND_DFU_UTIL,   // dfu-util and lsusb subprocesses
+    DFU_BACKEND_USB,        // In-process USB only
+    DFU_BACKEND_MOCK        // In-memory simulated boards, no hardware needed
+};
+
+/**
+ * Low level access to the STM32 DFU devices. The DFU class keeps the sequencing
+ * (timeouts, alternate setting lookup, messages) and relies on a transport for the
+ * USB operations themselves.
+ */
+class DfuTransport
+{
+public:
+    virtual ~DfuTransport() {}
+    virtual const char* getName() const = 0;
+    virtual bool isAvailable() = 0;
+    virtual int listDevices(const std::string &serialNumber, std::vector<DfuDeviceInfo> &devices) = 0;
+    virtual bool isFastbootDevicePresent() = 0;
+    virtual int listFastbootDevices(std::vector<DfuDeviceInfo> &devices);
+    virtual int readDeviceIdString(std::string &deviceIdString) = 0;
+    virtual int download(uint8_t alternateIndex, const std::string &filePath) = 0;
+    virtual int downloadFromMemory(uint8_t alternateIndex, const unsigned char *data, size_t size) = 0;
+    virtual int downloadFromReader(uint8_t alternateIndex, const DownloadReader &reader);
+    virtual int upload(uint8_t alternateIndex, const std::string &filePath) = 0;
+    virtual int uploadToMemory(uint8_t alternateIndex, std::vector<unsigned char> &data) = 0;
+    virtual int detach() = 0;
+
+    /* True while the selected device has not re-enumerated since it was last listed, transports
+       which cannot tell keep the answer to true and rely on the transfer errors */
+    virtual bool isSameEnumeration() { return true; }
+
+    /* True if the devices of this transport raise the USB hotplug events, otherwise they are polled */
+    virtual bool isHotplugObservable() { return true; }
+
+    /* True if the transport reads the binaries itself, a whole file is then given by path rather than from memory */
+    virtual bool isFileDownloadPreferred() { return false; }
+
+    static std::unique_ptr<DfuTransport> create(DFU_BACKEND backend, const std::string &toolboxFolder, const std::string &serialNumber);
+    static int parseBackendName(const std::string &name, DFU_BACKEND *backend);
+    static void setDefaultBackend(DFU_BACKEND backend);
+    static DFU_BACKEND getDefaultBackend();
+
+protected:
+    static int writeFile(const std::string &filePath, const std::vector<unsigned char> &data);
+};
+
+#endif // DFUTRANSPORT_H
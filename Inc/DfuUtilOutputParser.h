@@ -0,0 +1,106 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DFUUTILOUTPUTPARSER_H
+#define DFUUTILOUTPUTPARSER_H
+
+#include <string>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+enum DFU_OUTPUT_EVENT {
+    DFU_OUTPUT_ALT_SETTING,     // "Found DFU: [vid:pid] ... devnum=, path=, alt=, name=, serial="
+    DFU_OUTPUT_TRANSFER_SIZE,   // "Device returned transfer size 1024"
+    DFU_OUTPUT_PROGRESS,        // "Download [=====   ]  40%   16384 bytes"
+    DFU_OUTPUT_STATE,           // "DFU state(2) = dfuIDLE, status(0) = No error condition is present"
+    DFU_OUTPUT_ERROR,           // "dfu-util: ..." messages and error states
+    DFU_OUTPUT_DOWNLOAD_DONE,   // "Download done."
+    DFU_OUTPUT_UPLOAD_DONE      // "Upload done."
+};
+
+struct DfuOutputEvent
+{
+    DFU_OUTPUT_EVENT type;
+    uint16_t vendorID;          // DFU_OUTPUT_ALT_SETTING
+    uint16_t productID;         // DFU_OUTPUT_ALT_SETTING
+    int deviceNumber;           // DFU_OUTPUT_ALT_SETTING
+    int alternateIndex;         // DFU_OUTPUT_ALT_SETTING
+    std::string path;           // DFU_OUTPUT_ALT_SETTING
+    std::string name;           // DFU_OUTPUT_ALT_SETTING
+    std::string serialNumber;   // DFU_OUTPUT_ALT_SETTING
+    bool isUpload;              // DFU_OUTPUT_PROGRESS
+    int percent;                // DFU_OUTPUT_PROGRESS
+    uint64_t value;             // Transfer size, transferred bytes or DFU state
+    int status;                 // DFU_OUTPUT_STATE
+    std::string text;           // State description or error message
+};
+
+/**
+ * Incremental parser of the dfu-util output: the bytes are fed as they are read from the process
+ * and each recognized line is reported as a typed event. Lines are split on '\n' and '\r' since
+ * dfu-util redraws its progress bar with carriage returns. The lines are matched with plain
+ * prefix and key scanners, no regular expression is built.
+ */
+class DfuUtilOutputParser
+{
+public:
+    DfuUtilOutputParser();
+    void setEventCallback(std::function<void(const DfuOutputEvent&)> callback) ;
+    void feed(const char *data, size_t size) ;
+    void feedLine(const char *line, size_t length) ;
+    void feedLine(const std::string &line) ;
+    void finish() ;
+    void reset() ;
+
+    bool isDownloadDone() const ;
+    bool isUploadDone() const ;
+    bool isErrorReported() const ;
+    uint32_t getTransferSize() const ;
+    uint64_t getTransferredBytes() const ;
+    const std::string& getLastError() const ;
+
+    static bool isErrorState(int state) ;
+
+private:
+    void parseFoundLine(const char *line, size_t length) ;
+    void parseProgressLine(const char *line, size_t length, bool isUpload) ;
+    void parseStateLine(const char *line, size_t length) ;
+    void emit(const DfuOutputEvent &event) ;
+
+    static bool startsWith(const char *line, size_t length, const char *prefix) ;
+    static const char* findKey(const char *line, size_t length, const char *key) ;
+    static bool readNumber(const char *&cursor, const char *end, uint64_t &value) ;
+    static bool readQuoted(const char *line, size_t length, const char *key, std::string &value) ;
+    static bool readKeyNumber(const char *line, size_t length, const char *key, uint64_t &value) ;
+
+    std::function<void(const DfuOutputEvent&)> eventCallback ;
+    std::string pendingLine ;
+    bool isDownloadCompleted ;
+    bool isUploadCompleted ;
+    bool isErrorFound ;
+    uint32_t transferSize ;
+    uint64_t transferredBytes ;
+    std::string lastError ;
+};
+
+#endif // DFUUTILOUTPUTPARSER_H
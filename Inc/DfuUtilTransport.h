@@ -0,0 +1,75 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DFUUTILTRANSPORT_H
+#define DFUUTILTRANSPORT_H
+
+#include "DfuTransport.h"
+#include "DisplayManager.h"
+#include "SysfsUsb.h"
+#include "ProcessRunner.h"
+#include "DfuUtilOutputParser.h"
+#include "ScratchSpace.h"
+#include <atomic>
+
+constexpr size_t DFU_UTIL_INPUT_MAX_SIZE = 64 * 1024 * 1024 ;   // Streamed bytes held in memory for dfu-util, a larger stream is spilled to a file
+
+/**
+ * Transport running the dfu-util and lsusb programs for each operation.
+ */
+class DfuUtilTransport : public DfuTransport
+{
+public:
+    DfuUtilTransport(const std::string &toolboxFolder, const std::string &serialNumber);
+    const char* getName() const override;
+    bool isAvailable() override;
+    int listDevices(const std::string &serialNumber, std::vector<DfuDeviceInfo> &devices) override;
+    bool isFastbootDevicePresent() override;
+    int readDeviceIdString(std::string &deviceIdString) override;
+    int download(uint8_t alternateIndex, const std::string &filePath) override;
+    int downloadFromMemory(uint8_t alternateIndex, const unsigned char *data, size_t size) override;
+    int downloadFromReader(uint8_t alternateIndex, const DownloadReader &reader) override;
+    int upload(uint8_t alternateIndex, const std::string &filePath) override;
+    int uploadToMemory(uint8_t alternateIndex, std::vector<unsigned char> &data) override;
+    int detach() override;
+    bool isSameEnumeration() override;
+    bool isFileDownloadPreferred() override;
+
+private:
+    std::string getDfuUtilProgramPath() ;
+    std::string getLsUsbProgramPath() ;
+    int executeCommand(const std::string &command, std::string &output, uint32_t msTimeout = PROCESS_QUERY_TIMEOUT_MS, bool isOutputDisplayed = false) ;
+    int runTransfer(const std::string &command, uint8_t alternateIndex, bool isUpload, uint64_t totalSize = 0, const unsigned char *input = nullptr, size_t inputSize = 0) ;
+    int downloadFromScratchFile(uint8_t alternateIndex, const unsigned char *data, size_t size, const DownloadReader *reader = nullptr) ;
+    int parseDeviceList(const std::string &output, std::vector<DfuDeviceInfo> &devices) ;
+
+    static std::atomic<bool> isProgramFound ;  // dfu-util answered once, it is not probed again by this process
+    DisplayManager displayManager = DisplayManager::getInstance() ;
+    std::string toolboxFolder ;
+    std::string dfuSerialNumber ;
+    int lastExitCode ;
+    DfuUtilOutputParser outputParser ;
+    ScratchSpace scratchSpace ;     // Files exchanged with dfu-util, private to this transport
+    SysfsUsbDevice listedDevice ;   // sysfs entry of the selected device when it was last listed
+};
+
+#endif // DFUUTILTRANSPORT_H
@@ -25,6 +25,10 @@
 
 #include <stdarg.h>
 #include <iostream>
+#include <string>
+#include <mutex>
+#include <functional>
+#include <cstdint>
 
 /* Colors macros for console*/
 #define BLACK 0
@@ -53,15 +57,50 @@ enum messageType
     MSG_ERROR,
 };
 
+enum CONSOLE_FILTER
+{
+    CONSOLE_ALL,            // Every message reaches the console
+    CONSOLE_MILESTONES,     // Only MSG_GREEN and MSG_ERROR messages reach the console
+    CONSOLE_NONE            // The messages only go to the log stream and the message handler
+};
+
+/**
+ * Destination of the messages printed by one thread. The default one writes everything to the
+ * console; a fleet worker sends its messages to the device log and only echoes the milestones
+ * and the errors to the console, tagged with the device serial number. A daemon job also
+ * forwards them to its client through the message handler, and a library call hands them to
+ * the caller only, along with the transfer progress.
+ */
+struct ThreadOutput
+{
+    std::ostream *logStream;    // Receives every message when it is set
+    std::string consolePrefix;  // Inserted before each message echoed to the console
+    CONSOLE_FILTER consoleFilter;
+    std::function<void(messageType, const std::string&)> messageHandler;   // Receives every message in UTF-8 when it is set
+    std::function<void(int, uint64_t, uint64_t)> progressHandler;          // Receives the transfer progress (alternate setting, bytes done, total bytes or 0 if unknown) when it is set
+};
+
+/**
+ * Console output shared by all the threads: each message is written as a whole, under a
+ * single lock, so the messages of concurrent services are never interleaved. The log stream
+ * and the message handler of a thread are served without the lock.
+ */
 class DisplayManager
 {
 public:
     static DisplayManager& getInstance() ;
     void print(messageType messageType, const wchar_t* message, ...);
+    static void setThreadOutput(const ThreadOutput &output) ;
+    static void resetThreadOutput() ;
+    static void reportProgress(int alt, uint64_t done, uint64_t total) ;
 
 private:
     DisplayManager();
     void displayMessage(messageType type, const wchar_t* str) ;
+    static std::string encodeUtf8(const wchar_t* str) ;
+
+    static std::mutex outputMutex ;
+    static thread_local ThreadOutput threadOutput ;
 };
 
 #endif // DISPLAYMANAGER_H
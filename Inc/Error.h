@@ -60,6 +60,12 @@ enum ToolboxError {
     /** File format not supported for this kind of device */
     TOOLBOX_DFU_ERROR_UNSUPPORTED_FILE_FORMAT = -11,
 
+    /** Operation did not complete before its deadline */
+    TOOLBOX_DFU_ERROR_TIMEOUT = -12,
+
+    /** Device held by another instance */
+    TOOLBOX_DFU_ERROR_DEVICE_BUSY = -13,
+
     /** Other error */
     TOOLBOX_DFU_ERROR_OTHER = -99,
 };
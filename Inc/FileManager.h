@@ -30,6 +30,7 @@
 #include <fstream>
 #include <cstdint>
 #include"DisplayManager.h"
+#include "FirmwareImage.h"
 #include "Error.h"
 
 constexpr uint8_t TSV_NB_COLUMNS = 7;
@@ -78,19 +79,21 @@ struct scriptDataInfoHeader {
     uint32_t	iReserved ; /* reserved, set it to 0 */
 } ;
 
+/**
+ * TSV file parser. It keeps no state between the calls: each call only works on the fileTSV
+ * of its caller, so the services running in parallel share the instance safely.
+ */
 class FileManager
 {
 public:
     static FileManager& getInstance() ;
     int openTsvFile(const std::string &fileName, fileTSV **parsedFile, bool isStartFastboot = true);
     bool isValidTsvFile(fileTSV *myTsvFile, bool isBoot_PRGFW_UTIL) ;
-    int saveTemproryScriptFile(const fileTSV parsedTsvFile, std::string &outTempFile) ;
-    int removeTemproryFile(const std::string tempFile) ;
-    int getTemproryFile(std::string &outTempFile) ;
 
 private:
     FileManager();
     int parseTsvFile(const std::string tsvFolderPath, std::ifstream *inFile, fileTSV* parsedTSV, bool isStartFastboot = true);
+    std::string getUniqueBinary(const partitionInfo &partition, FirmwareIdentity &identity, std::vector<std::pair<FirmwareIdentity, std::string>> &uniqueBinaries) ;
     int splitStdString(std::string str, std::regex, std::vector<std::string>& substrings) ;
     uint32_t getChecksumCrc32(unsigned char* data, uint32_t size) ;
     int prepareUbootScriptFile(fileTSV & parsedTsvFile) ;
@@ -0,0 +1,71 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FIRMWAREIMAGE_H
+#define FIRMWAREIMAGE_H
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+
+constexpr uint64_t IMAGE_COMPARE_MAX_SIZE = 256 * 1024 * 1024 ;   // Larger binaries are only identified by their file
+constexpr size_t IMAGE_SAMPLE_SIZE = 64 * 1024 ;                    // Bytes read at the start, middle and end of a binary
+
+struct FirmwareIdentity
+{
+    std::string fileKey;        // Device and inode of the file, its canonical path on Windows
+    uint64_t size;
+    bool isSampled;             // sampleDigest is computed, only for the binaries compared by content
+    uint32_t sampleDigest;      // CRC-32 of the samples of the content
+};
+
+/**
+ * Read-only view of a partition binary, handed to the transfer loop as a span (data, size).
+ * The file is mapped, not read: the pages are loaded from the page cache on demand, so huge
+ * images keep a bounded resident size and the boards flashing the same file share one copy.
+ * The kernel is told that the file is read once, sequentially, so it reads ahead and drops
+ * the pages behind the transfer. On Windows the file is read into memory.
+ */
+class FirmwareImage
+{
+public:
+    FirmwareImage();
+    ~FirmwareImage();
+    FirmwareImage(const FirmwareImage&) = delete;
+    FirmwareImage& operator=(const FirmwareImage&) = delete;
+    int open(const std::string &filePath) ;
+    void close() ;
+    const unsigned char* getData() const ;
+    size_t getSize() const ;
+    static bool isFileExist(const std::string &filePath) ;
+    static bool getIdentity(const std::string &filePath, FirmwareIdentity &identity) ;
+    static bool getSampleDigest(const std::string &filePath, FirmwareIdentity &identity) ;
+    static bool isSameContent(const std::string &filePath, const std::string &otherFilePath) ;
+
+private:
+    const unsigned char *data ;
+    size_t size ;
+    void *mappedAddress ;               // nullptr when the file is not mapped
+    std::vector<unsigned char> buffer ; // Content of the file when it is not mapped
+};
+
+#endif // FIRMWAREIMAGE_H
@@ -0,0 +1,100 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLEETMANAGER_H
+#define FLEETMANAGER_H
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstdint>
+#include "DisplayManager.h"
+#include "Error.h"
+
+struct fileTSV ;
+
+constexpr uint32_t FLEET_DEFAULT_JOBS = 4 ;
+constexpr uint32_t FLEET_MAX_JOBS = 64 ;
+constexpr uint32_t FLEET_DEFAULT_ROOT_PORT_TRANSFERS = 4 ;  // Bulk phases at the same time behind a root port
+constexpr uint32_t FLEET_DEFAULT_HUB_TRANSFERS = 2 ;        // Bulk phases at the same time in a hub
+
+enum FLEET_SERVICE {
+    FLEET_SERVICE_INSTALL,  // startInstallService, as the -d/--download command
+    FLEET_SERVICE_FLASH     // startFlashingService, as the -f/--flash command
+};
+
+struct FleetJob
+{
+    std::string serialNumber;
+    std::string tsvFilePath;
+    std::string logFilePath;
+    std::string portPath;       // USB port path, empty when the device was not found before the run
+    int status;                 // Result of the service, TOOLBOX_DFU_NO_ERROR on success
+    bool isStarted;
+    bool isDone;
+    uint64_t durationMs;
+};
+
+/**
+ * Runs one service on several devices at once. The jobs come either from a map file giving the
+ * TSV file of each serial number, or from the discovery of all the attached boards which are not
+ * in use. A bounded pool of worker threads runs one ProgramManager per device; the messages of
+ * each device go to its own log file and only its milestones and errors reach the console.
+ * The workers start the devices of the least loaded root ports first, and the bulk phases go
+ * through the TransferScheduler so that a root port or a hub is never oversubscribed.
+ */
+class FleetManager
+{
+public:
+    FleetManager(const std::string &toolboxFolder);
+    int loadMapFile(const std::string &mapFilePath) ;
+    int discoverDevices(const std::string &tsvFilePath) ;
+    void setTransferLimits(uint32_t maxPerRootPort, uint32_t maxPerHub) ;
+    int run(FLEET_SERVICE service, uint32_t jobsNumber, bool isStartFastboot = true) ;
+    int runWave(bool isStartFastboot = true) ;
+    void displayResults() ;
+    void displayUsbUtilization() ;
+    const std::vector<FleetJob>& getJobs() const ;
+    int createLogDirectory() ;
+    std::string getLogFilePath(const std::string &serialNumber) const ;
+    void runJob(FleetJob &job, FLEET_SERVICE service, bool isStartFastboot, fileTSV *parsedTsvFile = nullptr) ;
+
+private:
+    int addJob(const std::string &serialNumber, const std::string &tsvFilePath) ;
+    void locateDevices() ;
+    FleetJob* takeNextJob() ;
+    void finishJob(FleetJob &job) ;
+    void runWorker(FLEET_SERVICE service, bool isStartFastboot) ;
+
+    DisplayManager displayManager = DisplayManager::getInstance() ;
+    std::string toolboxFolder ;
+    std::string logDirectory ;
+    std::vector<FleetJob> jobs ;
+    std::mutex jobsMutex ;
+    std::map<std::string, uint32_t> rootPortJobs ;     // Jobs running behind each root port
+    uint32_t maxRootPortTransfers ;
+    uint32_t maxHubTransfers ;
+    uint64_t durationMs ;
+};
+
+#endif // FLEETMANAGER_H
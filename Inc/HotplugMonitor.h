@@ -0,0 +1,70 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef HOTPLUGMONITOR_H
+#define HOTPLUGMONITOR_H
+
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+
+constexpr uint32_t HOTPLUG_RECHECK_MS = 1000;  // Safety re-check period while waiting for events
+
+enum HOTPLUG_WAIT_STATUS {
+    HOTPLUG_EVENT_RECEIVED,
+    HOTPLUG_EVENTS_LOST,        // The socket buffer overflowed, the caller has to check the devices again
+    HOTPLUG_DEADLINE_REACHED,
+    HOTPLUG_NOT_SUPPORTED
+};
+
+struct HotplugEvent
+{
+    std::string action;         // add, remove, bind...
+    std::string devPath;        // Kernel device path, e.g. /devices/pci0000:00/0000:00:14.0/usb1/1-2
+    uint16_t vendorID;
+    uint16_t productID;
+    std::string serialNumber;   // Empty when it is not known (removed device)
+};
+
+/**
+ * Listener of the USB device hotplug events (udev uevents over netlink, the kernel ones without udevd),
+ * used to wake the waiters as soon as a device appears or disappears instead of polling the bus.
+ */
+class HotplugMonitor
+{
+public:
+    HotplugMonitor();
+    ~HotplugMonitor();
+    bool open() ;
+    void close() ;
+    bool isOpen() const ;
+    void flush() ;
+    HOTPLUG_WAIT_STATUS waitEvent(const std::chrono::steady_clock::time_point &deadline, HotplugEvent &event) ;
+    HOTPLUG_WAIT_STATUS wait(uint16_t vendorID, uint16_t productID, const std::string &serialNumber, const std::chrono::steady_clock::time_point &deadline) ;
+
+private:
+    static bool parseEvent(const char *buffer, size_t size, HotplugEvent &event) ;
+
+    int socketDescriptor ;
+};
+
+#endif // HOTPLUGMONITOR_H
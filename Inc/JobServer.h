@@ -0,0 +1,103 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef JOBSERVER_H
+#define JOBSERVER_H
+
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include "DisplayManager.h"
+#include "FileManager.h"
+#include "JsonMessage.h"
+#include "Error.h"
+
+constexpr size_t JOB_MAX_REQUEST_SIZE = 64 * 1024 ;     // Longest request line accepted from a client
+constexpr uint32_t JOB_POLL_MS = 500 ;                  // Period of the stop request checks while waiting for the clients
+
+struct CachedTsvFile
+{
+    std::shared_ptr<fileTSV> parsedTsvFile;
+    long long modificationTime;     // TSV file state when it was parsed, it is parsed again once changed
+    unsigned long long fileSize;
+};
+
+struct JobClient
+{
+    int socketDescriptor;
+    std::thread worker;
+    std::atomic<bool> isFinished;
+};
+
+/**
+ * Daemon serving the toolbox operations over a local Unix domain socket, so a production
+ * orchestrator runs its jobs without starting a process, probing dfu-util and parsing the TSV
+ * files each time. Each line sent by a client is a flat JSON request, for instance
+ *   {"id":"12","type":"install","serial":"0025003C3338510A","tsv":"/data/FlashLayout.tsv","fastboot":true}
+ * with the types install, flash, otp-read, otp-write, phase and list. The jobs of a client run one
+ * after the other, the clients run in parallel. The daemon answers with JSON lines carrying the
+ * request id: an "accepted" event, one "message" event per message of the job (level, text), one
+ * "device" event per device for a list, then a "done" event with the job status (ToolboxError).
+ * The parsed TSV files, with their flashlayout and U-Boot script buffers, are kept in memory.
+ */
+class JobServer
+{
+public:
+    JobServer(const std::string &toolboxFolder);
+    ~JobServer();
+    int run(const std::string &socketPath) ;
+
+private:
+    static void handleStopSignal(int signalNumber) ;
+    int openSocket() ;
+    void closeSocket() ;
+    void startClient(int socketDescriptor) ;
+    void joinClients(bool isAllJoined) ;
+    void serveClient(JobClient *client) ;
+    void runJob(int socketDescriptor, const JsonMessage &request) ;
+    int runServiceJob(const JsonMessage &request, bool isFlashService) ;
+    int runOtpJob(const JsonMessage &request, bool isWrite) ;
+    int runPhaseJob(const JsonMessage &request, JsonMessage &result) ;
+    int runListJob(int socketDescriptor, const std::string &jobId, JsonMessage &result) ;
+    int getParsedTsvFile(const std::string &tsvFilePath, bool isStartFastboot, std::shared_ptr<fileTSV> &parsedTsvFile) ;
+    static const char* getLevelName(messageType type) ;
+    static bool sendMessage(int socketDescriptor, const JsonMessage &message) ;
+
+    static volatile std::sig_atomic_t isStopRequested ;
+    DisplayManager displayManager = DisplayManager::getInstance() ;
+    FileManager fileManager  = FileManager::getInstance() ;
+    std::string toolboxFolder ;
+    std::string socketPath ;
+    int listenDescriptor ;
+    std::list<JobClient> clients ;
+    std::mutex tsvCacheMutex ;
+    std::map<std::string, CachedTsvFile> tsvCache ;     // Indexed by the fastboot option and the TSV path
+    std::atomic<uint32_t> jobCount ;
+};
+
+#endif // JOBSERVER_H
@@ -0,0 +1,65 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef JSONMESSAGE_H
+#define JSONMESSAGE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+struct JsonField
+{
+    std::string key;
+    std::string value;      // Decoded string, or the JSON text of a number, true, false or null
+    bool isString;
+};
+
+/**
+ * Flat JSON object (string, number, boolean and null values, no nesting) exchanged on one
+ * line with the clients of the daemon. The fields are written in their insertion order.
+ */
+class JsonMessage
+{
+public:
+    bool parse(const std::string &text) ;
+    std::string toString() const ;
+    bool hasField(const std::string &key) const ;
+    std::string getString(const std::string &key, const std::string &defaultValue = "") const ;
+    bool getBool(const std::string &key, bool defaultValue) const ;
+    void setString(const std::string &key, const std::string &value) ;
+    void setNumber(const std::string &key, long long value) ;
+    void setBool(const std::string &key, bool value) ;
+
+private:
+    const JsonField* findField(const std::string &key) const ;
+    void setField(const std::string &key, const std::string &value, bool isString) ;
+    static bool parseString(const std::string &text, size_t &position, std::string &value) ;
+    static void appendUtf8(std::string &text, uint32_t code) ;
+    static void appendQuoted(std::string &text, const std::string &value) ;
+    static void skipSpaces(const std::string &text, size_t &position) ;
+
+    std::vector<JsonField> fields ;
+};
+
+#endif // JSONMESSAGE_H
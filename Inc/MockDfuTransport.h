@@ -0,0 +1,104 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MOCKDFUTRANSPORT_H
+#define MOCKDFUTRANSPORT_H
+
+#include "DfuTransport.h"
+#include "DisplayManager.h"
+#include <map>
+#include <mutex>
+#include <chrono>
+
+enum MOCK_BOARD_MODE {
+    MOCK_MODE_ROM,          // ROM code / FSBL waiting for the boot partitions
+    MOCK_MODE_UBOOT_DFU,    // U-Boot running the DFU command
+    MOCK_MODE_FASTBOOT      // U-Boot running the fastboot command
+};
+
+struct MockPartition
+{
+    std::string name;
+    uint8_t phaseID;
+};
+
+struct MockBoard
+{
+    std::string serialNumber;
+    uint16_t deviceID;
+    std::string portPath;                   // Simulated USB port, e.g. 1-2.3
+    int deviceNumber;                       // Changes on each simulated re-enumeration
+    MOCK_BOARD_MODE mode;
+    uint8_t bootDownloads;                  // Boot partitions received in ROM mode
+    bool isFastbootScriptLoaded;            // U-Boot script starting fastboot received
+    uint32_t enumerationCount;              // Incremented on each simulated re-enumeration
+    std::chrono::steady_clock::time_point rebootEnd;    // The board is detached until then
+    std::vector<uint8_t> phases;            // Next GetPhase answers, the last one is kept
+    std::vector<MockPartition> layout;      // Partitions of the received flashlayout
+    std::vector<unsigned char> otpData;
+};
+
+/**
+ * In-memory transport simulating STM32MP boards, so the install and flashing services
+ * run without hardware. The boards are declared with PRG_TOOLBOX_DFU_MOCK_BOARDS as a
+ * comma separated list of "serial[:deviceID][@portPath]", e.g. "MOCK0001:0x505@1-2.1,MOCK0002:0x500".
+ * The downloads take the time of a real transfer when PRG_TOOLBOX_DFU_MOCK_KBPS is set, and the
+ * boards stay detached for PRG_TOOLBOX_DFU_MOCK_REBOOT_MS after each detach request.
+ */
+class MockDfuTransport : public DfuTransport
+{
+public:
+    MockDfuTransport(const std::string &serialNumber);
+    const char* getName() const override;
+    bool isAvailable() override;
+    int listDevices(const std::string &serialNumber, std::vector<DfuDeviceInfo> &devices) override;
+    bool isFastbootDevicePresent() override;
+    int listFastbootDevices(std::vector<DfuDeviceInfo> &devices) override;
+    int readDeviceIdString(std::string &deviceIdString) override;
+    int download(uint8_t alternateIndex, const std::string &filePath) override;
+    int downloadFromMemory(uint8_t alternateIndex, const unsigned char *data, size_t size) override;
+    int downloadFromReader(uint8_t alternateIndex, const DownloadReader &reader) override;
+    int upload(uint8_t alternateIndex, const std::string &filePath) override;
+    int uploadToMemory(uint8_t alternateIndex, std::vector<unsigned char> &data) override;
+    int detach() override;
+    bool isSameEnumeration() override;
+    bool isHotplugObservable() override;
+
+private:
+    static std::map<std::string, MockBoard>& getBoards() ;
+    MockBoard* getSelectedBoard() ;
+    static std::vector<DfuAltSetting> getAltSettings(const MockBoard &board) ;
+    static int getPartitionId(const MockBoard &board, uint8_t alternateIndex) ;
+    static void loadFlashlayout(MockBoard &board, const std::vector<unsigned char> &data) ;
+    static bool isBootCompleted(const MockBoard &board) ;
+    static void simulateTransfer(size_t size) ;
+    static bool isRebooting(const MockBoard &board) ;
+    int receiveData(uint8_t alternateIndex, const std::vector<unsigned char> &data, size_t size) ;
+
+    static std::mutex boardsMutex ;
+    static int nextDeviceNumber ;   // Next device number given by the simulated bus
+    DisplayManager displayManager = DisplayManager::getInstance() ;
+    std::string dfuSerialNumber ;
+    uint32_t listedEnumeration ;    // Enumeration of the selected board when it was last listed
+};
+
+#endif // MOCKDFUTRANSPORT_H
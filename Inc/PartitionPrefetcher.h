@@ -0,0 +1,61 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PARTITIONPREFETCHER_H
+#define PARTITIONPREFETCHER_H
+
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <cstdint>
+#include "FirmwareImage.h"
+
+constexpr size_t PREFETCH_MAX_SIZE = 256 * 1024 * 1024 ;    // Where the images are read into memory (Windows), larger binaries are given by path to the transport
+
+/**
+ * Second stage of the flashing pipeline: while a partition is downloaded, the binary of the next
+ * partition is mapped by a background thread, and the kernel is asked to read it ahead into the
+ * page cache (MADV_WILLNEED). No copy is made: the image handed to the caller is the mapping, and
+ * a transport reading the file itself finds its pages cached. A prediction which proves wrong is
+ * dropped, and the awaited binary is then mapped on demand.
+ */
+class PartitionPrefetcher
+{
+public:
+    PartitionPrefetcher();
+    ~PartitionPrefetcher();
+    void prefetch(const std::string &filePath) ;
+    int take(const std::string &filePath, std::shared_ptr<FirmwareImage> &image, uint64_t &stallMs, bool &isPrefetched) ;
+    uint64_t getStallMs() const ;
+
+private:
+    void cancel() ;
+    static int load(const std::string &filePath, FirmwareImage &image) ;
+
+    std::thread loader ;
+    std::string pendingPath ;           // Binary mapped by the thread, empty when there is none
+    std::shared_ptr<FirmwareImage> pendingImage ;
+    int pendingStatus ;
+    uint64_t totalStallMs ;             // Time the downloads waited for their binary
+};
+
+#endif // PARTITIONPREFETCHER_H
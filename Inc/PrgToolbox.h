@@ -0,0 +1,101 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PRGTOOLBOX_H
+#define PRGTOOLBOX_H
+
+/*
+ * C interface of libprgtoolbox, the PRG-TOOLBOX-DFU services callable in-process.
+ *
+ * A session selects a device by serial number (any device if empty). The calls on a session
+ * are serialized, the sessions can be used from different threads at the same time. Each call
+ * returns a ToolboxError value, TOOLBOX_DFU_NO_ERROR (0) on success. The messages of a call,
+ * including the transfer progress, are given to the message callback of its session when it is
+ * set, and printed on the console otherwise. The progress callback of a session receives the
+ * byte counts of the transfers, without parsing the messages.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Error.h"
+
+#define PRGTOOLBOX_VERSION "2.1.0"
+
+/* PRGTOOLBOX_BUILD is defined by the toolbox build, a Windows program linking libprgtoolbox.a defines PRGTOOLBOX_STATIC */
+#if defined(_WIN32) && defined(PRGTOOLBOX_BUILD)
+#define PRGTOOLBOX_API __declspec(dllexport)
+#elif defined(_WIN32) && defined(PRGTOOLBOX_STATIC)
+#define PRGTOOLBOX_API
+#elif defined(_WIN32)
+#define PRGTOOLBOX_API __declspec(dllimport)
+#else
+#define PRGTOOLBOX_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum PRGTOOLBOX_LEVEL {
+    PRGTOOLBOX_LEVEL_INFO = 0,
+    PRGTOOLBOX_LEVEL_SUCCESS = 1,   /* Milestones of the services */
+    PRGTOOLBOX_LEVEL_WARNING = 2,
+    PRGTOOLBOX_LEVEL_ERROR = 3
+};
+
+typedef struct prgtoolbox_session prgtoolbox_session;
+
+/* Called from the thread of the call, the text is only valid during the callback */
+typedef void (*prgtoolbox_message_callback)(void *context, int level, const char *text);
+
+/* Called from the thread of the call during each partition transfer, total is 0 when the size is not known in advance */
+typedef void (*prgtoolbox_progress_callback)(void *context, int alt, uint64_t done, uint64_t total);
+
+typedef struct prgtoolbox_device
+{
+    char serial_number[64];
+    char mode[32];              /* ROM DFU, U-Boot DFU, STM32PRGFW-UTIL or Fastboot */
+    uint16_t device_id;         /* STM32MP device ID, 0 when it is not exposed */
+    char port_path[32];         /* USB port path, e.g. 1-2.3, empty when it is not known */
+    long lock_owner_pid;        /* Process holding the device, 0 when the device is free */
+} prgtoolbox_device;
+
+PRGTOOLBOX_API const char* prgtoolbox_get_version(void);
+PRGTOOLBOX_API int prgtoolbox_set_backend(const char *backend_name);
+
+PRGTOOLBOX_API int prgtoolbox_open_session(const char *toolbox_folder, const char *serial_number, prgtoolbox_session **session);
+PRGTOOLBOX_API void prgtoolbox_close_session(prgtoolbox_session *session);
+PRGTOOLBOX_API void prgtoolbox_set_message_callback(prgtoolbox_session *session, prgtoolbox_message_callback callback, void *context);
+PRGTOOLBOX_API void prgtoolbox_set_progress_callback(prgtoolbox_session *session, prgtoolbox_progress_callback callback, void *context);
+
+PRGTOOLBOX_API int prgtoolbox_install(prgtoolbox_session *session, const char *tsv_file_path, int is_start_fastboot);
+PRGTOOLBOX_API int prgtoolbox_flash(prgtoolbox_session *session, const char *tsv_file_path);
+PRGTOOLBOX_API int prgtoolbox_read_otp(prgtoolbox_session *session, const char *file_path);
+PRGTOOLBOX_API int prgtoolbox_write_otp(prgtoolbox_session *session, const char *file_path);
+PRGTOOLBOX_API int prgtoolbox_get_phase(prgtoolbox_session *session, uint8_t *phase, int *is_need_detach);
+PRGTOOLBOX_API int prgtoolbox_list_devices(prgtoolbox_session *session, prgtoolbox_device *devices, size_t capacity, size_t *count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PRGTOOLBOX_H
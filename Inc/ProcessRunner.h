@@ -0,0 +1,97 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PROCESSRUNNER_H
+#define PROCESSRUNNER_H
+
+#include <iostream>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+constexpr uint32_t PROCESS_QUERY_TIMEOUT_MS = 15000;        // Listing and detach commands
+constexpr uint32_t PROCESS_TRANSFER_IDLE_TIMEOUT_MS = 600000;  // Download and upload commands, longest time without output
+constexpr uint32_t PROCESS_KILL_GRACE_MS = 2000;            // Delay between SIGTERM and SIGKILL
+
+struct ProcessResult
+{
+    int exitCode;               // -1 when the process did not exit normally
+    bool isTimedOut;
+    bool isCanceled;
+    int signalNumber;           // Signal which terminated the process, 0 if none
+    uint64_t wallTimeMs;
+    std::string output;         // stdout and stderr, when captured
+};
+
+struct ProcessStatistics
+{
+    uint32_t processCount;
+    uint32_t failedCount;       // Non zero exit code, signal or spawn failure
+    uint32_t timedOutCount;
+    uint64_t totalWallTimeMs;
+};
+
+/**
+ * Runs the external tools (dfu-util, lsusb) without blocking on their output: the process is spawned with
+ * its stdout/stderr on a non-blocking pipe, every line is handed to a callback as soon as it is read, and a
+ * deadline, from the start or from the last output, is enforced with SIGTERM then SIGKILL. A run can be canceled from another thread.
+ */
+class ProcessRunner
+{
+public:
+    ProcessRunner();
+    void setTimeout(uint32_t msTimeout) ;
+    void setIdleTimeout(uint32_t msIdleTimeout) ;
+    void setLineCallback(std::function<void(const std::string&)> callback) ;
+    void setDataCallback(std::function<void(const char*, size_t)> callback) ;
+    void setOutputCaptured(bool isCaptured) ;
+    void setInputData(const unsigned char *data, size_t size) ;
+    void setInputReader(std::function<int(unsigned char*, size_t, size_t*)> reader) ;
+    int run(const std::vector<std::string> &arguments, ProcessResult &result) ;
+    int runShellCommand(const std::string &command, ProcessResult &result) ;
+    void cancel() ;
+
+    static ProcessStatistics getStatistics() ;
+
+private:
+    void processOutput(const char *data, size_t size, std::string &pendingLine, ProcessResult &result) ;
+    bool writeInput(int descriptor, size_t &offset) ;
+    static void account(const ProcessResult &result, bool isSpawned) ;
+
+    uint32_t msTimeout ;
+    uint32_t msIdleTimeout ;
+    bool isOutputCaptured ;
+    const unsigned char *inputData ;    // Written to the standard input of the process, not copied
+    size_t inputSize ;
+    std::function<int(unsigned char*, size_t, size_t*)> inputReader ;  // Refills inputChunk once it is written
+    std::vector<unsigned char> inputChunk ;
+    std::function<void(const std::string&)> lineCallback ;
+    std::function<void(const char*, size_t)> dataCallback ;
+    std::atomic<bool> isCancelRequested ;
+
+    static std::mutex statisticsMutex ;
+    static ProcessStatistics statistics ;
+};
+
+#endif // PROCESSRUNNER_H
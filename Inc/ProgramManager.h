@@ -24,19 +24,19 @@
 #define PROGRAMMANAGER_H
 
 #include <iostream>
+#include <map>
+#include <memory>
 #include "FileManager.h"
 #include "DisplayManager.h"
 #include "DFU.h"
+#include "ProcessRunner.h"
+#include "DeviceLock.h"
+#include "PartitionPrefetcher.h"
+#include "SparseScanner.h"
+#include "FirmwareImage.h"
+#include "StreamDecompressor.h"
 #include "Error.h"
 
-struct GetPhaseStruct
-{
-    uint8_t Phase;          // Phase P expected by device
-    uint32_t Address;       // 0xFFFFFFFF or load address in embedded RAM
-    uint32_t Offset;        // 0x0
-    uint8_t NeedDFUDetach;  // Present only if P = 0, 1 : DFU detach is requested for a new USB enumeration
-};
-
 class ProgramManager
 {
 public:
@@ -47,15 +47,24 @@ public:
     int writeOtpPartition(const std::string filePath) ;
     int startFlashingService(const std::string inputTsvPath) ;
     int getPhase(uint8_t* phase, bool* isNeedDetach) ;
+    void useParsedTsvFile(fileTSV *tsvFile) ;
 
 private:
     void sleep(uint32_t ms) ;
+    int lockDevice() ;
+    static bool isPartitionBinary(const partitionInfo &part) ;
+    bool isServedPartition(size_t partitionIndex) ;
+    bool isBinaryUsedAgain(size_t partitionIndex) ;
+    std::string getNextBinary(int partitionIndex) ;
+    int flashPartitionBinary(uint8_t alternateIndex, size_t partitionIndex, PartitionPrefetcher &prefetcher, std::map<std::string, std::shared_ptr<FirmwareImage>> &sharedImages) ;
 
     DisplayManager displayManager = DisplayManager::getInstance() ;
     FileManager fileManager  = FileManager::getInstance() ;
     DFU *dfuInterface ;
+    DeviceLock deviceLock ;     // Held from the first access to the device until the end of the service
     bool isDfuUbootRunning = false ;
     fileTSV *parsedTsvFile ;
+    bool isTsvFileShared = false ;  // The parsed TSV file is owned by the caller of useParsedTsvFile
 
 };
 
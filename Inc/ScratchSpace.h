@@ -0,0 +1,62 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SCRATCHSPACE_H
+#define SCRATCHSPACE_H
+
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <cstdint>
+
+/**
+ * Private scratch directory of a session, for the files exchanged with the external tools.
+ * The directory is unique to the instance (mkdtemp, mode 0700) and is created on first use in
+ * $XDG_RUNTIME_DIR, $TMPDIR or /tmp. It is removed with its content when the instance is destroyed,
+ * or when the process exits. Directories left by processes which no longer exist are removed too,
+ * once the flock of their lock file shows that no session holds them anymore.
+ */
+class ScratchSpace
+{
+public:
+    ScratchSpace();
+    ~ScratchSpace();
+    int getFilePath(const std::string &name, std::string &filePath) ;
+    const std::string& getDirectory() const ;
+    void remove() ;
+
+private:
+    int create() ;
+    static std::string getBaseDirectory() ;
+    static void removeStaleDirectories(const std::string &baseDirectory) ;
+    static bool removeUnlockedDirectory(const std::string &path) ;
+    static void removeAll() ;
+
+    std::string directory ;
+    uint32_t fileCount ;
+    int lockDescriptor ;        // Lock file of the directory, held while the directory is used, -1 if none
+
+    static std::mutex registryMutex ;
+    static std::set<std::string> registry ;     // Directories still to be removed at exit
+};
+
+#endif // SCRATCHSPACE_H
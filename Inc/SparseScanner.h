@@ -0,0 +1,71 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SPARSESCANNER_H
+#define SPARSESCANNER_H
+
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+constexpr size_t SPARSE_BLOCK_SIZE = 4096 ;    // Scan granularity, a multiple of the memory blocks written by U-Boot
+constexpr size_t SPARSE_CACHE_MAX_ENTRIES = 1024 ;    // Layouts kept in the cache file, the least recently stored are dropped
+
+struct SparseLayout
+{
+    uint64_t fileSize;
+    uint64_t trimmedSize;       // Bytes to download, the trailing fill blocks are dropped
+    uint64_t dataSize;          // Bytes of the blocks which are not only made of 0x00 or 0xFF
+};
+
+/**
+ * Opt-in sparse download of the partition binaries. An image is scanned by blocks for the fill
+ * patterns left by the image builders (0x00 and erased 0xFF), with SSE2 when available, and the
+ * trailing fill blocks are not downloaded: the end of the partition keeps its previous content.
+ * The layouts are cached by file identity (device, inode, size and modification time), in memory
+ * and in sparse-cache.txt of PRG_TOOLBOX_DFU_CACHE_DIR if set, otherwise of
+ * $XDG_CACHE_HOME/PRG-TOOLBOX-DFU or ~/.cache/PRG-TOOLBOX-DFU, so the next runs skip the scan.
+ * The file is rewritten compacted on each store: one entry per key, the latest ones only.
+ */
+class SparseScanner
+{
+public:
+    static void setEnabled(bool isEnabled) ;
+    static bool isEnabled() ;
+    static bool getLayout(const std::string &filePath, const unsigned char *data, size_t size, SparseLayout &layout) ;
+    static void scan(const unsigned char *data, size_t size, SparseLayout &layout) ;
+
+private:
+    static bool isFillBlock(const unsigned char *block, size_t size) ;
+    static std::string getFileKey(const std::string &filePath) ;
+    static std::string getCacheFilePath() ;
+    static void loadCache() ;
+    static void storeCache(const std::string &key, const SparseLayout &layout) ;
+
+    static bool isSparseEnabled ;
+    static std::mutex cacheMutex ;
+    static bool isCacheLoaded ;
+    static std::map<std::string, SparseLayout> cache ;
+};
+
+#endif // SPARSESCANNER_H
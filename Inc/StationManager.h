@@ -0,0 +1,92 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef STATIONMANAGER_H
+#define STATIONMANAGER_H
+
+#include <iostream>
+#include <list>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include "DisplayManager.h"
+#include "FileManager.h"
+#include "FleetManager.h"
+#include "DFU.h"
+#include "HotplugMonitor.h"
+#include "Error.h"
+
+constexpr uint32_t STATION_POLL_MS = 500 ;      // Period of the device scans when the hotplug events are not available
+constexpr uint32_t STATION_UNPLUG_MS = 5000 ;   // Absence after which a served board is considered unplugged
+
+struct StationBoard
+{
+    FleetJob job;
+    std::thread worker;
+    std::atomic<bool> isFinished;
+    bool isReported;            // The result was displayed and the worker joined
+    std::chrono::steady_clock::time_point lastSeen;
+};
+
+/**
+ * Unattended production station: waits for the boards to be plugged, runs the service on each new
+ * board from its own worker (at most jobsNumber at a time), displays the result of each port and
+ * waits for the next board, until Ctrl+C. The TSV file, with its flashlayout and U-Boot script
+ * buffers, is parsed once and shared by all the boards. A served board is served again only
+ * after it was unplugged for STATION_UNPLUG_MS.
+ */
+class StationManager
+{
+public:
+    StationManager(const std::string &toolboxFolder);
+    ~StationManager();
+    int run(FLEET_SERVICE service, const std::string &tsvFilePath, uint32_t jobsNumber, bool isStartFastboot = true) ;
+
+private:
+    static void handleStopSignal(int signalNumber) ;
+    int loadTsvFile(const std::string &tsvFilePath) ;
+    void updateBoards() ;
+    void startBoard(const DiscoveredDevice &device) ;
+    void runBoard(StationBoard *board) ;
+    void reportFinishedBoards() ;
+    uint32_t getRunningCount() const ;
+    void waitDevicesChange() ;
+
+    static volatile std::sig_atomic_t isStopRequested ;
+    DisplayManager displayManager = DisplayManager::getInstance() ;
+    FileManager fileManager  = FileManager::getInstance() ;
+    FleetManager fleetManager ;
+    DFU scanInterface ;             // Kept across the scans, so the transport is probed once
+    HotplugMonitor hotplugMonitor ;
+    fileTSV *parsedTsvFile ;
+    std::string tsvFilePath ;
+    std::list<StationBoard> boards ;
+    FLEET_SERVICE service ;
+    bool isStartFastboot ;
+    uint32_t jobsNumber ;
+    uint32_t passedCount ;
+    uint32_t failedCount ;
+};
+
+#endif // STATIONMANAGER_H
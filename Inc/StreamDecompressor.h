@@ -0,0 +1,87 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef STREAMDECOMPRESSOR_H
+#define STREAMDECOMPRESSOR_H
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+constexpr size_t DECOMPRESS_RING_SIZE = 8 * 1024 * 1024 ;   // Decompressed bytes waiting for the transfer
+constexpr size_t DECOMPRESS_READ_SIZE = 256 * 1024 ;        // Compressed bytes read at once
+
+enum COMPRESSION_FORMAT {
+    COMPRESSION_NONE,
+    COMPRESSION_GZIP,       // .gz, zlib
+    COMPRESSION_XZ,         // .xz, liblzma
+    COMPRESSION_ZSTD        // .zst, zstd program found in PATH
+};
+
+/**
+ * Decompresses a partition binary on a background thread into a bounded ring buffer, read by the
+ * transfer as a DownloadReader: the decompressed image is never written to disk nor held in memory
+ * as a whole. The decompression runs ahead of the transfer until the ring buffer is full, the time the
+ * transfer waited for the decompression is reported to check that it keeps pace with the USB link.
+ */
+class StreamDecompressor
+{
+public:
+    StreamDecompressor();
+    ~StreamDecompressor();
+    static COMPRESSION_FORMAT getFormat(const std::string &filePath) ;
+    int open(const std::string &filePath) ;
+    int read(unsigned char *buffer, size_t capacity, size_t *size) ;
+    void close() ;
+    int getStatus() ;
+    uint64_t getOutputSize() const ;
+    uint64_t getReadWaitMs() const ;
+    uint64_t getWriteWaitMs() const ;
+
+private:
+    void decompress() ;
+    int decompressGzip() ;
+    int decompressXz() ;
+    int decompressZstd() ;
+    bool write(const unsigned char *data, size_t size) ;
+
+    std::string filePath ;
+    COMPRESSION_FORMAT format ;
+    std::thread decompressor ;
+    std::mutex ringMutex ;
+    std::condition_variable dataReady ;
+    std::condition_variable spaceReady ;
+    std::vector<unsigned char> ring ;
+    size_t readOffset ;             // Next byte of the ring buffer to be read
+    size_t fillSize ;               // Bytes of the ring buffer not read yet
+    bool isEnd ;                    // The decompression ended, status holds its result
+    bool isClosed ;                 // The transfer stopped reading
+    int status ;
+    uint64_t outputSize ;
+    uint64_t readWaitMs ;           // Time the transfer waited for decompressed bytes
+    uint64_t writeWaitMs ;          // Time the decompression waited for the transfer
+};
+
+#endif // STREAMDECOMPRESSOR_H
@@ -0,0 +1,66 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SYSFSUSB_H
+#define SYSFSUSB_H
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+
+struct SysfsUsbDevice
+{
+    std::string portPath;       // Kernel device name, e.g. 1-2.3 (bus 1, root port 2, hub port 3)
+    std::string sysfsPath;
+    uint16_t vendorID;
+    uint16_t productID;
+    int busNumber;
+    int deviceNumber;           // Changes each time the device re-enumerates
+    std::string serialNumber;
+    std::string manufacturer;
+    std::string product;
+    std::vector<std::string> interfaceStrings;  // String of the current alternate setting of each interface
+};
+
+/**
+ * Linux USB enumeration from the sysfs attributes (/sys/bus/usb/devices/<port path>/...), a few file
+ * reads instead of running lsusb. The root is "/sys" by default, it can be changed with setRoot()
+ * or with PRG_TOOLBOX_DFU_SYSFS_ROOT to work with a fake tree.
+ */
+class SysfsUsb
+{
+public:
+    static void setRoot(const std::string &root) ;
+    static std::string getRoot() ;
+    static bool isAvailable() ;
+    static int enumerate(uint16_t vendorID, uint16_t productID, std::vector<SysfsUsbDevice> &devices) ;
+    static bool findDevice(uint16_t vendorID, uint16_t productID, const std::string &serialNumber, SysfsUsbDevice &device) ;
+    static std::string findPortPath(int busNumber, int deviceNumber) ;
+    static std::string readSerialNumber(const std::string &devPath) ;
+
+private:
+    static bool readDevice(const std::string &portPath, SysfsUsbDevice &device) ;
+    static std::string readAttribute(const std::string &path) ;
+    static bool readHexAttribute(const std::string &path, uint16_t *value) ;
+};
+
+#endif // SYSFSUSB_H
@@ -0,0 +1,114 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TRANSFERSCHEDULER_H
+#define TRANSFERSCHEDULER_H
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Place of a device in the USB tree, from its port path "<bus>-<root port>.<hub port>...".
+ */
+struct UsbTopology
+{
+    int busNumber;
+    std::string rootPort;       // e.g. 1-2, shared by all the devices behind this root port
+    std::string hub;            // Hub the device is plugged in, e.g. 1-2.3 for 1-2.3.1, empty for 1-2
+};
+
+struct SegmentUtilization
+{
+    std::string name;           // Bus (usbN), root port (N-P) or "unknown" for the devices whose port is unknown
+    uint32_t transferCount;
+    uint64_t bytes;
+    uint64_t busyMs;            // Time with at least one transfer running on the segment
+    uint64_t transferMs;        // Sum of the transfer durations, busyMs when they never overlap
+    uint64_t waitMs;            // Time the transfers waited for a free slot
+    uint32_t maxConcurrent;
+};
+
+/**
+ * Shares the USB bandwidth between the devices served in parallel. Each bulk phase (partition
+ * download or upload) takes a slot of its root port and of its hub for its whole duration and
+ * waits while either is full; a device waiting for its re-enumeration holds no slot. The time
+ * spent transferring is accounted per bus and per root port to show how the cabling is loaded.
+ */
+class TransferScheduler
+{
+public:
+    static TransferScheduler& getInstance() ;
+    void setLimits(uint32_t maxPerRootPort, uint32_t maxPerHub) ;
+    void resetStatistics() ;
+    void acquire(const std::string &portPath) ;
+    void release(const std::string &portPath, uint64_t bytes, uint64_t transferMs) ;
+    std::vector<SegmentUtilization> getUtilization() ;
+    static UsbTopology getTopology(const std::string &portPath) ;
+
+private:
+    TransferScheduler();
+    TransferScheduler(const TransferScheduler&) = delete ;
+    TransferScheduler& operator=(const TransferScheduler&) = delete ;
+
+    struct SegmentState
+    {
+        SegmentUtilization utilization;
+        uint32_t activeCount;
+        std::chrono::steady_clock::time_point busySince;
+    };
+
+    static std::string getBusName(const UsbTopology &topology) ;
+    bool isSlotFree(const UsbTopology &topology) ;
+    void startSegment(const std::string &name, const std::chrono::steady_clock::time_point &now, uint64_t waitMs) ;
+    void stopSegment(const std::string &name, const std::chrono::steady_clock::time_point &now, uint64_t bytes, uint64_t transferMs) ;
+
+    std::mutex mutex ;
+    std::condition_variable slotReleased ;
+    uint32_t maxPerRootPort ;   // 0 for no limit
+    uint32_t maxPerHub ;
+    std::map<std::string, uint32_t> rootPortTransfers ;
+    std::map<std::string, uint32_t> hubTransfers ;
+    std::map<std::string, SegmentState> segments ;
+};
+
+/**
+ * Slot of the TransferScheduler held by a bulk phase for its scope.
+ */
+class TransferSlot
+{
+public:
+    TransferSlot(const std::string &portPath, uint64_t bytes);
+    ~TransferSlot();
+    void setBytes(uint64_t bytes) ;
+
+private:
+    std::string portPath ;
+    uint64_t bytes ;
+    std::chrono::steady_clock::time_point start ;
+};
+
+#endif // TRANSFERSCHEDULER_H
@@ -0,0 +1,67 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef USBDFUTRANSPORT_H
+#define USBDFUTRANSPORT_H
+
+#include "DfuTransport.h"
+#include "DfuDevice.h"
+#include "SysfsUsb.h"
+#include "DisplayManager.h"
+
+/**
+ * Transport using the in-process DFU implementation (DfuDevice). When a fallback
+ * transport is given, it takes over each time the device cannot be opened natively.
+ */
+class UsbDfuTransport : public DfuTransport
+{
+public:
+    UsbDfuTransport(const std::string &serialNumber, std::unique_ptr<DfuTransport> fallbackTransport = nullptr);
+    ~UsbDfuTransport();
+    const char* getName() const override;
+    bool isAvailable() override;
+    int listDevices(const std::string &serialNumber, std::vector<DfuDeviceInfo> &devices) override;
+    bool isFastbootDevicePresent() override;
+    int readDeviceIdString(std::string &deviceIdString) override;
+    int download(uint8_t alternateIndex, const std::string &filePath) override;
+    int downloadFromMemory(uint8_t alternateIndex, const unsigned char *data, size_t size) override;
+    int downloadFromReader(uint8_t alternateIndex, const DownloadReader &reader) override;
+    int upload(uint8_t alternateIndex, const std::string &filePath) override;
+    int uploadToMemory(uint8_t alternateIndex, std::vector<unsigned char> &data) override;
+    int detach() override;
+    bool isSameEnumeration() override;
+    bool isFileDownloadPreferred() override;
+
+private:
+    bool isUsbFsAvailable() ;
+    bool openUsbDevice() ;
+    bool isFallbackUsed(int status) ;
+
+    DisplayManager displayManager = DisplayManager::getInstance() ;
+    DfuDevice usbDevice ;
+    std::unique_ptr<DfuTransport> fallbackTransport ;
+    std::string dfuSerialNumber ;
+    bool isFallbackNotified ;
+    bool isFallbackActive ;
+};
+
+#endif // USBDFUTRANSPORT_H
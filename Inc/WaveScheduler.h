@@ -0,0 +1,94 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef WAVESCHEDULER_H
+#define WAVESCHEDULER_H
+
+#include <iostream>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <cstdint>
+#include "DisplayManager.h"
+#include "FileManager.h"
+#include "FleetManager.h"
+#include "DFU.h"
+#include "DeviceEventLoop.h"
+#include "DeviceLock.h"
+#include "Error.h"
+
+constexpr uint32_t WAVE_BIND_TIMEOUT_MS = 1000 ;    // Time for a board seen by the scan to be fully enumerated
+
+struct WaveStep
+{
+    uint8_t alternateIndex;
+    int partitionIndex;     // Index in the TSV partitions list, -1 for the flashlayout and U-Boot script
+    DEVICE_WAIT waitAfter;  // Boot stage awaited after the detach following the download, none to go on without a detach
+    uint32_t msTimeout;     // Time given to the boot stage to show up
+};
+
+struct WaveBoard
+{
+    FleetJob *job;
+    DFU *dfuInterface;
+    fileTSV *parsedTsvFile;
+    DeviceLock deviceLock;
+    std::ofstream logFile;
+    std::vector<WaveStep> steps;
+    size_t stepIndex;
+};
+
+/**
+ * Runs the install service on a batch of boards from a single thread, step by step: the first boot
+ * step is issued on every board, then each board is served as soon as it re-enumerates, so the reboot
+ * delays of the boards overlap instead of adding up. The steps are chained on a DeviceEventLoop, whose
+ * single device scan per poll finds the boards which are back. The wall time, the boards per hour and
+ * the share of the time spent only waiting for the boards (idle fraction) are reported at the end.
+ */
+class WaveScheduler
+{
+public:
+    WaveScheduler(const std::string &toolboxFolder);
+    ~WaveScheduler();
+    int run(std::vector<FleetJob> &jobs, bool isStartFastboot) ;
+    void displayStatistics() ;
+
+private:
+    int prepareBoard(WaveBoard &board, bool isStartFastboot) ;
+    void postStep(WaveBoard &board) ;
+    void runStep(WaveBoard &board) ;
+    void bindBoard(WaveBoard &board, DEVICE_WAIT waitMode, int status) ;
+    void finishBoard(WaveBoard &board, int status) ;
+    void selectBoardOutput(WaveBoard &board) ;
+    uint64_t getElapsedMs(const std::chrono::steady_clock::time_point &start) ;
+
+    DisplayManager displayManager = DisplayManager::getInstance() ;
+    FileManager fileManager = FileManager::getInstance() ;
+    std::string toolboxFolder ;
+    DeviceEventLoop eventLoop ;
+    std::vector<WaveBoard*> boards ;
+    std::chrono::steady_clock::time_point waveStart ;
+    uint64_t waveMs ;
+    uint32_t succeededCount ;
+};
+
+#endif // WAVESCHEDULER_H
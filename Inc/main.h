@@ -30,7 +30,7 @@
 #include "DisplayManager.h"
 #include "Error.h"
 
-constexpr uint8_t  MAX_COMMANDS_NBR = 16 ;
+constexpr uint8_t  MAX_COMMANDS_NBR = 32 ;
 constexpr uint8_t  MAX_PARAMS_NBR = 5 ;
 
 using namespace std;
@@ -44,10 +44,11 @@ struct command
 
 
 command argumentsList[MAX_COMMANDS_NBR];
-const string supportedCommandList[MAX_COMMANDS_NBR]={"-d", "--download", "?", "-h", "--help", "-v", "-otp", "--otp", "-sn", "--serial", "-f", "--flash", "-l", "--list", "-p", "--phase"} ;
+const string supportedCommandList[MAX_COMMANDS_NBR]={"-d", "--download", "?", "-h", "--help", "-v", "-otp", "--otp", "-sn", "--serial", "-f", "--flash", "-l", "--list", "-p", "--phase", "-b", "--backend", "-j", "--jobs", "-fl", "--fleet", "-tl", "--transfer-limits", "-w", "--wave", "-st", "--station", "-dm", "--daemon", "-sp", "--sparse"} ;
 
 DisplayManager displayManager = DisplayManager::getInstance() ;
 int extractProgramCommands (int numberCommands, char* commands[]);
+int parseFastbootOption(const std::string& option, bool* isStartFastboot) ;
 bool compareStrings(const std::string& str1, const std::string& str2, bool caseInsensitive) ;
 void showHelp();
 
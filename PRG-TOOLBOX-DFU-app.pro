@@ -0,0 +1,20 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+TARGET = PRG-TOOLBOX-DFU
+DESTDIR = $$PWD
+OBJECTS_DIR = build/app
+QMAKE_LFLAGS +=-static -static-libgcc -static-libstdc++ -pthread
+MAKEFILE = qtMakefile.app
+
+include(prgtoolbox.pri)
+
+SOURCES += \
+        Src/main.cpp
+
+HEADERS += \
+    Inc/main.h
+
+DISTFILES += \
+    License.txt \
+    README.txt
@@ -0,0 +1,88 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "AltSettingTable.h"
+
+/**
+ * @brief AltSettingTable::build : Parse the alternate setting names and index them.
+ * @param altSettings: The alternate settings of the device.
+ * @note When a name or an ID is exposed twice, the first alternate setting is kept.
+ */
+void AltSettingTable::build(const std::vector<DfuAltSetting> &altSettings)
+{
+    clear();
+    for(const auto &altSetting : altSettings)
+    {
+        std::string name ;
+        int partID = 0 ;
+        if(DfuDevice::parseAlternateName(altSetting.name, name, partID) == false)
+            continue ;
+
+        entries.emplace_back(altSetting.alt, name, partID);
+        nameIndex.emplace(name, altSetting.alt);
+        partitionIdIndex.emplace(partID, altSetting.alt);
+    }
+}
+
+void AltSettingTable::clear()
+{
+    entries.clear();
+    nameIndex.clear();
+    partitionIdIndex.clear();
+}
+
+/**
+ * @brief AltSettingTable::findByName
+ * @param name: The partition name, without the '@' prefix.
+ * @param altIndex: Output alternate setting index.
+ * @return True if the name is found, otherwise false.
+ */
+bool AltSettingTable::findByName(const std::string &name, uint8_t *altIndex) const
+{
+    auto it = nameIndex.find(name);
+    if(it == nameIndex.end())
+        return false ;
+
+    *altIndex = it->second ;
+    return true ;
+}
+
+/**
+ * @brief AltSettingTable::findByPartitionId
+ * @param partitionId: The partition (phase) ID.
+ * @param altIndex: Output alternate setting index.
+ * @return True if the ID is found, otherwise false.
+ */
+bool AltSettingTable::findByPartitionId(int partitionId, uint8_t *altIndex) const
+{
+    auto it = partitionIdIndex.find(partitionId);
+    if(it == partitionIdIndex.end())
+        return false ;
+
+    *altIndex = it->second ;
+    return true ;
+}
+
+const std::vector<std::tuple<int, std::string, int>>& AltSettingTable::getEntries() const
+{
+    return entries ;
+}
@@ -21,7 +21,9 @@
  */
 
 #include "DFU.h"
-#include <regex>
+#include "TransferScheduler.h"
+#include "StreamDecompressor.h"
+#include <algorithm>
 #include <iostream>
 #include <experimental/filesystem>
 
@@ -30,10 +32,15 @@ DFU::DFU()
     deviceID = 0x0;
     otpPartitionName = "";
     isSTM32PRGFW_UTIL = false ;
+    otpAltIndex = 0 ;
+}
+
+DFU::~DFU()
+{
 }
 
 /**
- * @brief DFU::flashPartition : Get the dfu-util command ready, then flash one partition.
+ * @brief DFU::flashPartition : Flash one partition through the selected transport.
  * @param partitionIndex: ALT index of the dedicated partition.
  * @param inputFirmwarePath: The firmware path to be programmed.
  * @return 0 if the operation is performed successfully, otherwise an error occurred.
@@ -43,65 +50,129 @@ int DFU::flashPartition(uint8_t partitionIndex, const std::string inputFirmwareP
     displayManager.print(MSG_NORMAL, L"Partition index : %d", partitionIndex);
     displayManager.print(MSG_NORMAL, L"Firmware path   : %s", inputFirmwarePath.c_str());
 
-    std::string utilCmd = getDfuUtilProgramPath().append("-d 483:df11") ;
-    utilCmd.append(" -a ").append(std::to_string(partitionIndex)) ;
-    utilCmd.append(" -D ").append(inputFirmwarePath) ;
-    if(this->dfuSerialNumber != "")
-        utilCmd.append(" --serial ").append(this->dfuSerialNumber);
+    if(StreamDecompressor::getFormat(inputFirmwarePath) != COMPRESSION_NONE)
+        return flashCompressedPartition(partitionIndex, inputFirmwarePath) ;
 
-#ifdef _WIN32
-        utilCmd = "\"" + utilCmd + "\"" ;
-#endif
-    displayManager.print(MSG_NORMAL, L"DFU-UTIL command: %s", utilCmd.data()) ;
+    std::string path = inputFirmwarePath ;
+    path.erase(std::remove(path.begin(), path.end(), '\"'), path.end()) ;
+    std::error_code errorCode ;
+    uintmax_t fileSize = std::experimental::filesystem::file_size(path, errorCode) ;
 
-    FILE* pipe = popen(utilCmd.c_str(), "r");
-    if (pipe == nullptr)
+    int ret = TOOLBOX_DFU_ERROR_WRITE ;
     {
-        displayManager.print(MSG_ERROR, L"Failed to open pipe") ;
-        return TOOLBOX_DFU_ERROR_NO_MEM;
+        TransferSlot transferSlot(usbPortPath, errorCode ? 0 : fileSize) ;
+        ret = getTransport()->download(partitionIndex, inputFirmwarePath) ;
     }
+    if (ret == TOOLBOX_DFU_NO_ERROR)
+    {
+        displayManager.print(MSG_GREEN, L"Phase ID %d : Download Done", partitionIndex) ;
+        return TOOLBOX_DFU_NO_ERROR ;
 
-    char buffer[4096];
-    std::string result = "";
-    while (!feof(pipe))
+    }
+    else
     {
-        if (fgets(buffer, 4096, pipe) != nullptr)
-        {
-            result += buffer;
-        }
+        session.invalidate() ; // The device may have been unplugged
+        displayManager.print(MSG_ERROR, L"Phase ID %d : Download Failed", partitionIndex) ;
+        return (ret == TOOLBOX_DFU_ERROR_NO_MEM) ? ret : TOOLBOX_DFU_ERROR_WRITE ;
+    }
+}
+
+/**
+ * @brief DFU::flashCompressedPartition : Flash one partition from a compressed binary, decompressed while it is transferred.
+ * @param partitionIndex: ALT index of the dedicated partition.
+ * @param inputFirmwarePath: The compressed firmware path (.gz, .xz or .zst).
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DFU::flashCompressedPartition(uint8_t partitionIndex, const std::string &inputFirmwarePath)
+{
+    StreamDecompressor decompressor ;
+    int ret = decompressor.open(inputFirmwarePath) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+    {
+        displayManager.print(MSG_ERROR, L"Cannot decompress the file %s", inputFirmwarePath.c_str()) ;
+        return (ret == TOOLBOX_DFU_ERROR_NOT_SUPPORTED) ? ret : TOOLBOX_DFU_ERROR_NO_FILE ;
     }
-    pclose(pipe);
 
-    displayManager.print(MSG_NORMAL, L"OUTPUT: %s", result.data()) ;
+    {
+        TransferSlot transferSlot(usbPortPath, 0) ;
+        ret = getTransport()->downloadFromReader(partitionIndex, [&decompressor](unsigned char *buffer, size_t capacity, size_t *size) {
+            return decompressor.read(buffer, capacity, size) ;
+        }) ;
+        transferSlot.setBytes(decompressor.getOutputSize()) ;
+    }
+    decompressor.close() ;
 
-    std::string searchString = "Download done.";
-    size_t pos = result.find(searchString);
-    if (pos != std::string::npos)
+    if (ret == TOOLBOX_DFU_NO_ERROR)
     {
+        displayManager.print(MSG_NORMAL, L"Decompressed %llu bytes, the transfer waited %llu ms for the decompression and the decompression %llu ms for the transfer",
+                             (unsigned long long)decompressor.getOutputSize(), (unsigned long long)decompressor.getReadWaitMs(), (unsigned long long)decompressor.getWriteWaitMs()) ;
         displayManager.print(MSG_GREEN, L"Phase ID %d : Download Done", partitionIndex) ;
         return TOOLBOX_DFU_NO_ERROR ;
+    }
+    else
+    {
+        if(decompressor.getStatus() == TOOLBOX_DFU_ERROR_NOT_SUPPORTED)
+            displayManager.print(MSG_ERROR, L"The zstd program is needed to decompress %s", inputFirmwarePath.c_str()) ;
+        else if(decompressor.getStatus() != TOOLBOX_DFU_NO_ERROR)
+            displayManager.print(MSG_ERROR, L"Failed to decompress %s after %llu bytes", inputFirmwarePath.c_str(), (unsigned long long)decompressor.getOutputSize()) ;
+
+        session.invalidate() ; // The device may have been unplugged
+        displayManager.print(MSG_ERROR, L"Phase ID %d : Download Failed", partitionIndex) ;
+        return (ret == TOOLBOX_DFU_ERROR_NO_MEM) ? ret : TOOLBOX_DFU_ERROR_WRITE ;
+    }
+}
 
+/**
+ * @brief DFU::flashPartition : Download a buffer built in memory (flashlayout, U-Boot script) to an alternate setting.
+ * @param partitionIndex: The alternate setting index of the target partition.
+ * @param data: The bytes to be programmed, they are not copied.
+ * @param size: Number of bytes.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DFU::flashPartition(uint8_t partitionIndex, const unsigned char *data, size_t size)
+{
+    displayManager.print(MSG_NORMAL, L"Partition index : %d", partitionIndex);
+    displayManager.print(MSG_NORMAL, L"Data size       : %lu bytes", (unsigned long)size);
+
+    if((data == nullptr) || (size == 0))
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+
+    int ret = TOOLBOX_DFU_ERROR_WRITE ;
+    {
+        TransferSlot transferSlot(usbPortPath, size) ;
+        ret = getTransport()->downloadFromMemory(partitionIndex, data, size) ;
+    }
+    if (ret == TOOLBOX_DFU_NO_ERROR)
+    {
+        displayManager.print(MSG_GREEN, L"Phase ID %d : Download Done", partitionIndex) ;
+        return TOOLBOX_DFU_NO_ERROR ;
     }
     else
     {
+        session.invalidate() ; // The device may have been unplugged
         displayManager.print(MSG_ERROR, L"Phase ID %d : Download Failed", partitionIndex) ;
-        return TOOLBOX_DFU_ERROR_WRITE ;
+        return (ret == TOOLBOX_DFU_ERROR_NO_MEM) ? ret : TOOLBOX_DFU_ERROR_WRITE ;
     }
 }
 
+/**
+ * @brief DFU::isFileDownloadPreferred
+ * @return True if the transport reads the binaries itself, they are then flashed by path.
+ */
+bool DFU::isFileDownloadPreferred()
+{
+    return getTransport()->isFileDownloadPreferred() ;
+}
+
 /**
  * @brief DFU::dfuDetach : Request to detach the device.
  * @return 0 if the operation is performed successfully, otherwise an error occurred.
  */
 int DFU::dfuDetach()
 {
-    std::string  utilCmd =  getDfuUtilProgramPath().append("-d 483:df11 -a 0 -e") ;
-    if(this->dfuSerialNumber != "")
-        utilCmd.append(" --serial ").append(this->dfuSerialNumber);
-
-    displayManager.print(MSG_NORMAL, L"DFU-UTIL command: %s", utilCmd.data()) ;
-    int ret = std::system(utilCmd.c_str());
-    if(ret == 0)
+    int ret = getTransport()->detach() ;
+    session.invalidate() ; // The device re-enumerates, or is gone
+    if(ret == TOOLBOX_DFU_NO_ERROR)
     {
         displayManager.print(MSG_GREEN, L"Detach Done") ;
         return TOOLBOX_DFU_NO_ERROR;
@@ -120,65 +191,49 @@ int DFU::dfuDetach()
  */
 bool DFU::isUbootDfuRunning(uint32_t msTimeout)
 {
-    std::string  utilCmd =  getDfuUtilProgramPath().append("-d 483:df11 -l") ; /* ST DFU PID:0483 VID:DF11 */
-    if(this->dfuSerialNumber != "")
-        utilCmd.append(" --serial ").append(this->dfuSerialNumber);
+    bool isDfuRunning = false ;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(msTimeout);
 
-    displayManager.print(MSG_NORMAL, L"DFU-UTIL command: %s", utilCmd.data()) ;
+    /* The running boot stage cannot change without a re-enumeration */
+    if(isSessionValid())
+    {
+        isDfuRunning = findOtpAlternateSetting(session.getDeviceInfo()) ;
+        if (isDfuRunning)
+            displayManager.print(MSG_GREEN, L"U-Boot in DFU mode is running !") ;
+        else
+            displayManager.print(MSG_WARNING, L"U-Boot in DFU mode is not running !") ;
 
-    bool isDfuRunning = false ;
-    const std::chrono::milliseconds timeout_duration(msTimeout);
-    const auto start_time = std::chrono::steady_clock::now();
+        return isDfuRunning ;
+    }
 
+    bool isHotplugUsed = startHotplugMonitor() ;
+    int listError = TOOLBOX_DFU_NO_ERROR ;
     while (true)
     {
-        // Check if the timeout has been reached
-        const auto elapsed_time = std::chrono::steady_clock::now() - start_time;
-        if (elapsed_time >= timeout_duration)
-        {
-            displayManager.print(MSG_WARNING, L"Timeout [%d ms] is reached to discover U-Boot DFU device!", msTimeout) ;
-            break;
-        }
+        /* A device which is re-enumerating may not be listed yet (e.g. its node permissions are not applied), retry until the deadline */
+        std::vector<DfuDeviceInfo> devices ;
+        listError = getTransport()->listDevices(this->dfuSerialNumber, devices) ;
 
-        // Perform some operation
-        FILE* pipe = popen(utilCmd.c_str(), "r");
-        if (pipe == nullptr)
+        bool isSettling = (listError != TOOLBOX_DFU_NO_ERROR) ;
+        if(devices.empty() == false)
         {
-            displayManager.print(MSG_ERROR, L"Failed to open pipe") ;
-            return false;
+            isSettling = (updateSession(devices.front()) == false) ;
+            isDfuRunning = findOtpAlternateSetting(devices.front()) ;
         }
 
-        char buffer[4096];
-        std::string result = "";
-
-        while (!feof(pipe))
-        {
-            if (fgets(buffer, 4096, pipe) != nullptr)
-            {
-                result += buffer;
-            }
-        }
-        pclose(pipe);
+        if(isDfuRunning)
+            break;
 
-        try
+        // Check if the deadline has been reached
+        if (std::chrono::steady_clock::now() >= deadline)
         {
-            std::regex pattern("name=(\"@OTP([^\\\"]*)\")");
-            std::smatch match;
-            if (std::regex_search(result, match, pattern))
-            {
-                isDfuRunning = true ;
-                otpPartitionName = match[1].str();
-                break;
-            }
-        }
-        catch (const std::regex_error& e)
-        {
-            displayManager.print(MSG_ERROR, L"Regex error: %s", e.what());
-            return false ;
+            displayManager.print(MSG_WARNING, L"Timeout [%d ms] is reached to discover U-Boot DFU device!", msTimeout) ;
+            if(listError != TOOLBOX_DFU_NO_ERROR)
+                displayManager.print(MSG_ERROR, L"The last listing of the STM32 DFU devices failed (error %d)", listError) ;
+            break;
         }
 
-        // Sleep for a short time to simulate work being done
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        waitDeviceChange(isHotplugUsed && (isSettling == false), ST_DFU_PRODUCT_ID, deadline, 500) ;
     }
 
     if (isDfuRunning)
@@ -196,60 +251,38 @@ bool DFU::isUbootDfuRunning(uint32_t msTimeout)
  */
 bool DFU::isDfuDeviceExist(uint32_t msTimeout)
 {
-    std::string  utilCmd =  getDfuUtilProgramPath().append("-d 483:df11 -l") ; /* ST DFU PID:0483 VID:0AFB */
-    if(this->dfuSerialNumber != "")
-        utilCmd.append(" --serial ").append(this->dfuSerialNumber);
-
     bool isExist = false ;
-    const std::chrono::milliseconds timeout_duration(msTimeout);
-    const auto start_time = std::chrono::steady_clock::now();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(msTimeout);
+
+    if(isSessionValid())
+        return true ;
 
+    bool isHotplugUsed = startHotplugMonitor() ;
+    int listError = TOOLBOX_DFU_NO_ERROR ;
     while (true)
     {
-        // Check if the timeout has been reached
-        const auto elapsed_time = std::chrono::steady_clock::now() - start_time;
-        if (elapsed_time >= timeout_duration)
-        {
-            displayManager.print(MSG_WARNING, L"Timeout [%d ms] is reached to found the STM32 DFU device!", msTimeout) ;
-            break;
-        }
-
-        FILE* pipe = popen(utilCmd.c_str(), "r");
-        if (pipe == nullptr)
-        {
-            displayManager.print(MSG_ERROR, L"Failed to open pipe") ;
-            return false;
-        }
-
-        char buffer[4096];
-        std::string result = "";
+        /* A listing error is handled as a device not present yet, it is reported only if the deadline is reached */
+        std::vector<DfuDeviceInfo> devices ;
+        listError = getTransport()->listDevices(this->dfuSerialNumber, devices) ;
 
-        while (!feof(pipe))
+        // The DFU name is 'UNKNOWN' while the device is in a transient state, it needs to retry while awaiting it to be fully ready
+        bool isSettling = (devices.empty() == false) || (listError != TOOLBOX_DFU_NO_ERROR) ;
+        if((devices.empty() == false) && updateSession(devices.front()))
         {
-            if (fgets(buffer, 4096, pipe) != nullptr)
-            {
-                result += buffer;
-            }
+            isExist = true;
+            break;
         }
-        pclose(pipe);
 
-        std::string searchString = "Found DFU: [0483:df11]";
-        size_t pos = result.find(searchString);
-        if (pos != std::string::npos)
+        // Check if the deadline has been reached
+        if (std::chrono::steady_clock::now() >= deadline)
         {
-            // Check if the DFU name is not 'UNKNOWN', the device is in a transient state, and it needs to retry while awaiting it to be fully ready
-            std::string nameSearchString = "name=\"UNKNOWN\"";
-            size_t namePos = result.find(nameSearchString, pos);
-            if (namePos == std::string::npos)
-            {
-                isExist = true;
-                break;
-            }
+            displayManager.print(MSG_WARNING, L"Timeout [%d ms] is reached to found the STM32 DFU device!", msTimeout) ;
+            if(listError != TOOLBOX_DFU_NO_ERROR)
+                displayManager.print(MSG_ERROR, L"The last listing of the STM32 DFU devices failed (error %d)", listError) ;
+            break;
         }
 
-        // Sleep for a short time to simulate work being done
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
+        waitDeviceChange(isHotplugUsed && (isSettling == false), ST_DFU_PRODUCT_ID, deadline, 100) ;
     }
 
     if (isExist == false)
@@ -269,32 +302,18 @@ bool DFU::isDfuDeviceExist(uint32_t msTimeout)
  */
 int DFU::getDeviceID()
 {
-    std::string  utilCmd =  getLsUsbProgramPath().append("-d 0483:df11 -v") ;
-    FILE* pipe = popen(utilCmd.c_str(), "r");
-    if (pipe == nullptr)
-    {
-        displayManager.print(MSG_ERROR, L"Failed to open pipe") ;
-        return TOOLBOX_DFU_ERROR_OTHER;
-    }
-
-    char buffer[4096];
-    std::string result = "";
-
-    while (!feof(pipe))
+    if(session.isDeviceIdKnown() && isSessionValid())
     {
-        if (fgets(buffer, 4096, pipe) != nullptr)
-        {
-            result += buffer;
-        }
+        this->deviceID = session.getDeviceID() ;
+        displayManager.print(MSG_GREEN, L"STM32 device ID = 0x%03X", this->deviceID) ;
+        return TOOLBOX_DFU_NO_ERROR ;
     }
-    pclose(pipe);
 
-    std::string searchString = "@Device ID /";
-    size_t pos = result.find(searchString);
-    if (pos != std::string::npos)
+    std::string deviceIdString ;
+    if(getTransport()->readDeviceIdString(deviceIdString) == TOOLBOX_DFU_NO_ERROR)
     {
-        std::string deviceIdString = result.substr(pos + searchString.length(), 5) ;
         this->deviceID = std::stoul(deviceIdString, nullptr, 16);
+        session.setDeviceID(this->deviceID) ;
         displayManager.print(MSG_GREEN, L"STM32 device ID = 0x%03X", this->deviceID) ;
         return TOOLBOX_DFU_NO_ERROR ;
     }
@@ -313,51 +332,26 @@ int DFU::getDeviceID()
  */
 bool DFU::isUbootFastbootRunning(uint32_t msTimeout)
 {
-    std::string  utilCmd =  getLsUsbProgramPath().append("-d 0483:0afb") ; /* ST Fastboot PID:0483 VID:0AFB */
-
     bool isRunning = false ;
-    const std::chrono::milliseconds timeout_duration(msTimeout);
-    const auto start_time = std::chrono::steady_clock::now();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(msTimeout);
 
+    bool isHotplugUsed = startHotplugMonitor() ;
     while (true)
     {
-        // Check if the timeout has been reached
-        const auto elapsed_time = std::chrono::steady_clock::now() - start_time;
-        if (elapsed_time >= timeout_duration)
-        {
-            displayManager.print(MSG_WARNING, L"Timeout [%d ms] is reached to discover Fastboot device!", msTimeout) ;
-            break;
-        }
-
-        FILE* pipe = popen(utilCmd.c_str(), "r");
-        if (pipe == nullptr)
-        {
-            displayManager.print(MSG_ERROR, L"Failed to open pipe") ;
-            return false;
-        }
-
-        char buffer[4096];
-        std::string result = "";
-
-        while (!feof(pipe))
+        if (isFastbootDevicePresent())
         {
-            if (fgets(buffer, 4096, pipe) != nullptr)
-            {
-                result += buffer;
-            }
+            isRunning = true ;
+            break ;
         }
-        pclose(pipe);
 
-        std::string searchString = "ID 0483:0afb";
-        size_t pos = result.find(searchString);
-        if (pos != std::string::npos)
+        // Check if the deadline has been reached
+        if (std::chrono::steady_clock::now() >= deadline)
         {
-            isRunning = true ;
-            break ;
+            displayManager.print(MSG_WARNING, L"Timeout [%d ms] is reached to discover Fastboot device!", msTimeout) ;
+            break;
         }
 
-        // Sleep for a short time to simulate work being done
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        waitDeviceChange(isHotplugUsed, ST_FASTBOOT_PRODUCT_ID, deadline, 500) ;
     }
 
     if (isRunning)
@@ -369,14 +363,35 @@ bool DFU::isUbootFastbootRunning(uint32_t msTimeout)
 }
 
 /**
- * @brief DFU::readOtpPartition : Get the dfu-util command ready, then read the OTP partition and save it into file.
+ * @brief DFU::isFastbootDevicePresent : Search the selected device in Fastboot mode, any device if no serial number is selected.
+ * @return True if the device runs U-Boot in Fastboot mode, otherwise, false.
+ */
+bool DFU::isFastbootDevicePresent()
+{
+    if(this->dfuSerialNumber.empty())
+        return getTransport()->isFastbootDevicePresent() ;
+
+    std::vector<DfuDeviceInfo> devices ;
+    if(getTransport()->listFastbootDevices(devices) != TOOLBOX_DFU_NO_ERROR)
+        return false ;
+
+    for(const auto &device : devices)
+    {
+        /* Without sysfs, the Fastboot devices are only known to be present */
+        if((device.serialNumber == this->dfuSerialNumber) || (device.serialNumber == "UNKNOWN"))
+            return true ;
+    }
+
+    return false ;
+}
+
+/**
+ * @brief DFU::readOtpPartition : Read the OTP partition and save it into file.
  * @param filePath: The output binary file to store OTP data.
  * @return 0 if the operation is performed successfully, otherwise an error occurred.
  */
 int DFU::readOtpPartition(const std::string filePath)
 {
-    std::string  utilCmd =  getDfuUtilProgramPath().append("-d 0483:df11 -a ") ;
-
     if(otpPartitionName.empty()) // Then Check U-Boot and get the OTP partition name
     {
        bool state = isUbootDfuRunning() ;
@@ -386,44 +401,14 @@ int DFU::readOtpPartition(const std::string filePath)
 
     displayManager.print(MSG_NORMAL, L"OTP partition name = %s", otpPartitionName.c_str()) ;
 
-    utilCmd.append(otpPartitionName) ;
-    utilCmd.append(" -U ").append(filePath) ;
-    if(this->dfuSerialNumber != "")
-        utilCmd.append(" --serial ").append(this->dfuSerialNumber);
-
-#ifdef _WIN32
-    utilCmd = "\"" + utilCmd + "\"" ;
-#endif
-    displayManager.print(MSG_NORMAL, L"DFU-UTIL command: %s", utilCmd.data()) ;
-
-    FILE* pipe = popen(utilCmd.c_str(), "r");
-    if (pipe == nullptr)
-    {
-        displayManager.print(MSG_ERROR, L"Failed to open pipe") ;
-        return TOOLBOX_DFU_ERROR_OTHER;
-    }
-
-    char buffer[4096];
-    std::string result = "";
-
-    while (!feof(pipe))
-    {
-        if (fgets(buffer, 4096, pipe) != nullptr)
-        {
-            result += buffer;
-        }
-    }
-    pclose(pipe);
-
-    std::string searchString = "Upload done.";
-    size_t pos = result.find(searchString);
-    if (pos != std::string::npos)
+    if (getTransport()->upload(otpAltIndex, filePath) == TOOLBOX_DFU_NO_ERROR)
     {
         displayManager.print(MSG_GREEN, L"Read OTP partition is done successfully !") ;
         return TOOLBOX_DFU_NO_ERROR ;
     }
     else
     {
+        session.invalidate() ;
         displayManager.print(MSG_ERROR, L"Read OTP partition is failed !") ;
         return TOOLBOX_DFU_ERROR_READ ;
     }
@@ -437,8 +422,6 @@ int DFU::readOtpPartition(const std::string filePath)
  */
 int DFU::writeOtpPartition(const std::string filePath)
 {
-    std::string  utilCmd = getDfuUtilProgramPath().append("-d 0483:df11 -a ");
-
     if(otpPartitionName.empty()) // Then Check U-Boot and get the OTP partition name
     {
        bool state = isUbootDfuRunning() ;
@@ -448,190 +431,51 @@ int DFU::writeOtpPartition(const std::string filePath)
 
     displayManager.print(MSG_NORMAL, L"OTP partition name = %s", otpPartitionName.c_str()) ;
 
-    utilCmd.append(otpPartitionName) ;
-    utilCmd.append(" -D ").append(filePath) ;
-    if(this->dfuSerialNumber != "")
-        utilCmd.append(" --serial ").append(this->dfuSerialNumber);
-
-#ifdef _WIN32
-    utilCmd = "\"" + utilCmd + "\"" ;
-#endif
-
-    displayManager.print(MSG_NORMAL, L"DFU-UTIL command: %s", utilCmd.data()) ;
-
-    FILE* pipe = popen(utilCmd.c_str(), "r");
-    if (pipe == nullptr)
-    {
-        displayManager.print(MSG_ERROR, L"Failed to open pipe") ;
-        return TOOLBOX_DFU_ERROR_OTHER;
-    }
-
-    char buffer[4096];
-    std::string result = "";
-
-    while (!feof(pipe))
-    {
-        if (fgets(buffer, 4096, pipe) != nullptr)
-        {
-            result += buffer;
-        }
-    }
-    pclose(pipe);
-
-    std::string searchString = "Download done.";
-    size_t pos = result.find(searchString);
-    if (pos != std::string::npos)
+    if (getTransport()->download(otpAltIndex, filePath) == TOOLBOX_DFU_NO_ERROR)
     {
         displayManager.print(MSG_GREEN, L"Write OTP partition is done successfully !") ;
         return TOOLBOX_DFU_NO_ERROR ;
     }
     else
     {
+        session.invalidate() ;
         displayManager.print(MSG_ERROR, L"Write OTP partition is failed !") ;
         return TOOLBOX_DFU_ERROR_WRITE ;
     }
 }
 
-/**
- * @brief DFU::getDfuUtilProgramPath : Get the path of dfu-util program from the project directory.
- * @return The dfu-util executable path.
- */
-std::string DFU::getDfuUtilProgramPath()
-{
-    std::string path = "" ;
-#ifdef _WIN32
-    path = this->toolboxFolder;
-    path.append("\\Utilities\\Windows\\dfu-util.exe") ; //from the project tree
-    path = "\"" + path + "\" " ;
-    displayManager.print(MSG_NORMAL, L"dfu-util application path : %s", path.c_str()) ;
-#else
-    path = "dfu-util " ; //use system command
-#endif
-
-    return path;
-}
-
-/**
- * @brief DFU::getLsUsbProgramPath : Get the path of lsusb program from the project directory.
- * @return The fastboot executable path.
- */
-std::string DFU::getLsUsbProgramPath()
-{
-    std::string path = "" ;
-#ifdef _WIN32
-    path = this->toolboxFolder;
-    path.append("\\Utilities\\Windows\\lsusb.exe") ; //from the project tree
-    path = "\"" + path + "\" " ;
-    displayManager.print(MSG_NORMAL, L"lsusb path : %s", path.c_str()) ; // display this just once
-#elif __APPLE__
-    path = this->toolboxFolder;
-    path = "/Utilities/MacOS/dfu-util/lsusb" ; //from the project tree
-    path = "\"" + path + "\" " ;
-    displayManager.print(MSG_NORMAL, L"lsusb application path : %s", path.c_str()) ; // display this just once
-#elif __linux__
-    path = "lsusb " ; // use Linux system command
-#else
-    path = "" ;
-#endif
-
-    return path;
-}
-
 /**
  * @brief DFU::isDfuUtilInstalled
- * @return True if dfu-util is already installed on the machine, otherwise, false.
+ * @return True if the selected transport can be used on this machine (dfu-util installed, USB devices reachable...), otherwise, false.
  * @note PRG-TOOLBOX-DFU includes the dfu-util program within the project for Windows, while it relies on the pre-installed version for Linux and MacOS.
  */
 bool DFU::isDfuUtilInstalled()
 {
-    std::string cmd =  getDfuUtilProgramPath().append("--version ") ;
-    FILE* pipe = popen(cmd.c_str(), "r");
-    if (pipe == nullptr)
-    {
-        displayManager.print(MSG_ERROR, L"Failed to open pipe") ;
-        return false;
-    }
-
-    char buffer[4096];
-    std::string result = "";
-
-    while (!feof(pipe))
-    {
-        if (fgets(buffer, 4096, pipe) != nullptr)
-        {
-            result += buffer;
-        }
-    }
-    pclose(pipe);
-
-    std::string searchString = "not found";
-    size_t pos = result.find(searchString);
-    if ((pos != std::string::npos) || (result.empty()))
-    {
-        displayManager.print(MSG_ERROR, L"dfu-util is not installed or cannot be found. Please install it and try again.") ;
-        displayManager.print(MSG_WARNING, L"refer to: https://dfu-util.sourceforge.net/") ;
-        return false ;
-    }
-    else
-    {
-        return true ;
-    }
+    displayManager.print(MSG_NORMAL, L"DFU backend : %s", getTransport()->getName()) ;
+    return getTransport()->isAvailable() ;
 }
 
 /**
- * @brief DFU::getAlternateSettingList : Get the list of the alternate settings for the current DFU device.
+ * @brief DFU::getAlternateSettingTable : Get the alternate settings of the current DFU device, the descriptors are queried once per enumeration.
+ * @param table: Output table indexed by name and partition ID.
  * @return 0 if the operation is performed successfully, otherwise an error occurred.
  */
-int DFU::getAlternateSettingList()
+int DFU::getAlternateSettingTable(const AltSettingTable **table)
 {
-    std::string  utilCmd =  getDfuUtilProgramPath().append("-d 483:df11 -l") ; /* ST DFU PID:0483 VID:DF11 */
-    if(this->dfuSerialNumber != "")
-        utilCmd.append(" --serial ").append(this->dfuSerialNumber);
-    displayManager.print(MSG_NORMAL, L"DFU-UTIL command: %s", utilCmd.data()) ;
-
-    FILE* pipe = popen(utilCmd.c_str(), "r");
-    if (pipe == nullptr)
-    {
-        displayManager.print(MSG_ERROR, L"Failed to open pipe") ;
-        return TOOLBOX_DFU_ERROR_NO_MEM;
-    }
-
-    char buffer[4096];
-    std::string result = "";
-
-    while (!feof(pipe))
-    {
-        if (fgets(buffer, 4096, pipe) != nullptr)
-        {
-            result += buffer;
-        }
-    }
-    pclose(pipe);
-
-    altSettingList.clear();
-
-    try
+    bool isCached = isSessionValid() ;
+    session.countLookup(isCached) ;
+    if(isCached == false)
     {
-        std::regex altNameRegex(R"(alt=([0-9]+),\s*name=\"@([^\s/]+)\s*/(0x[0-9A-Fa-f]+))");
-        auto begin = std::sregex_iterator(result.begin(), result.end(), altNameRegex);
-        auto end = std::sregex_iterator();
+        std::vector<DfuDeviceInfo> devices ;
+        int ret = getTransport()->listDevices(this->dfuSerialNumber, devices) ;
+        if(ret != TOOLBOX_DFU_NO_ERROR)
+            return ret ;
 
-        for (std::sregex_iterator i = begin; i != end; ++i)
-        {
-            std::smatch match = *i;
-            int alt = std::stoi(match[1].str());
-            std::string name = match[2].str();
-            name.erase(name.find_last_not_of(" ") + 1);// Remove trailing whitespace
-            int partID = std::stoi(match[3].str(), nullptr, 16); // Convert hex string to int
-            this->altSettingList.emplace_back(alt, name, partID);
-        }
-    }
-    catch (const std::regex_error& e)
-    {
-        displayManager.print(MSG_ERROR, L"Regex error: %s", e.what());
-        return TOOLBOX_DFU_ERROR_OTHER ;
+        if(devices.empty() == false)
+            updateSession(devices.front()) ;
     }
 
+    *table = &session.getAltSettingTable() ;
     return TOOLBOX_DFU_NO_ERROR;
 }
 
@@ -643,85 +487,37 @@ int DFU::getAlternateSettingList()
  */
 int DFU::getAlternateSettingIndex(const std::string altName, uint8_t *altIndex)
 {
-    int ret = TOOLBOX_DFU_NO_ERROR;
-    bool isIndexFound = false ;
+    const AltSettingTable *table = nullptr ;
 
     /* Read the DFU device and get the list of the avaialble alternate setting */
-    ret = getAlternateSettingList() ;
+    int ret = getAlternateSettingTable(&table) ;
     if(ret != TOOLBOX_DFU_NO_ERROR)
         return ret ;
 
-    /* The List of alternate setting is already populated */
-    for(uint8_t idx = 0 ; idx < this->altSettingList.size(); idx ++)
-    {
-        if(std::get<1>(altSettingList.at(idx)) == altName)
-        {
-            *altIndex = std::get<0>(altSettingList.at(idx)) ;
-            isIndexFound = true ;
-            displayManager.print(MSG_NORMAL, L"DFU device : Alternate name [%s] is found with alternate index [%d]", altName.c_str(), *altIndex);
-            break ;
-        }
-    }
-
-    if(isIndexFound == false)
+    if(table->findByName(altName, altIndex) == false)
     {
         displayManager.print(MSG_ERROR, L"DFU device : Alternate name [%s] does not exist !", altName.c_str());
-        ret = TOOLBOX_DFU_ERROR_INTERFACE_NOT_SUPPORTED;
+        return TOOLBOX_DFU_ERROR_INTERFACE_NOT_SUPPORTED;
     }
 
-    return ret;
+    displayManager.print(MSG_NORMAL, L"DFU device : Alternate name [%s] is found with alternate index [%d]", altName.c_str(), *altIndex);
+    return TOOLBOX_DFU_NO_ERROR;
 }
 
 /**
- * @brief DFU::displayDevicesList: Print the list of available STM32 DFU devices.
+ * @brief DFU::displayDevicesList: Print the list of available STM32 devices from a single discovery pass.
  * @return : 0 if the operation is performed successfully, otherwise an error occurred.
  */
 int DFU::displayDevicesList()
 {
-    std::string  utilCmd =  getDfuUtilProgramPath().append("-d 483:df11 -l") ; /* ST DFU PID:0483 VID:DF11 */
-    displayManager.print(MSG_NORMAL, L"DFU-UTIL command: %s", utilCmd.data()) ;
-
-    FILE* pipe = popen(utilCmd.c_str(), "r");
-    if (pipe == nullptr)
-    {
-        displayManager.print(MSG_ERROR, L"Failed to open pipe") ;
-        return TOOLBOX_DFU_ERROR_OTHER;
-    }
-
-    char buffer[4096];
-    std::string result = "";
-    while (!feof(pipe))
-    {
-        if (fgets(buffer, 4096, pipe) != nullptr)
-        {
-            result += buffer;
-        }
-    }
-    pclose(pipe);
-
-    std::map<std::string, std::string> deviceMap;
-    try
-    {
-        std::regex regex("devnum=(\\d+).*serial=\"([A-F0-9]+)\"");
-        std::smatch match;
-        std::string::const_iterator searchStart(result.cbegin());
-        while (std::regex_search(searchStart, result.cend(), match, regex))
-        {
-            std::string devnum = match[1];
-            std::string serial = match[2];
-            deviceMap[serial] = std::move(devnum);
-            searchStart = match.suffix().first;
-        }
-    }
-    catch (const std::regex_error& e)
-    {
-        displayManager.print(MSG_ERROR, L"Regex error: %s", e.what());
-        return false ;
-    }
+    int ret = scanDevices() ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
 
+    const std::vector<DiscoveredDevice> &devices = deviceIndex.getDevices() ;
 
     // Check if any devices were found
-    if (deviceMap.empty())
+    if (devices.empty())
     {
         displayManager.print(MSG_NORMAL, L"") ;
         displayManager.print(MSG_WARNING, L"No STM32 DFU devices found.") ;
@@ -729,13 +525,24 @@ int DFU::displayDevicesList()
     else
     {
         displayManager.print(MSG_GREEN, L"\nSTM32 DFU devices List") ;
-        displayManager.print(MSG_NORMAL, L" Number of STM32 DFU devices: %d", deviceMap.size()) ;
+        displayManager.print(MSG_NORMAL, L" Number of STM32 DFU devices: %d", devices.size()) ;
         int deviceCount = 1;
-        for (const auto& device : deviceMap)
+        for (const auto& device : devices)
         {
             displayManager.print(MSG_NORMAL, L" [Device %d] : ", deviceCount) ;
-            displayManager.print(MSG_NORMAL, L"     Dev Num : %s", device.second.c_str()) ;
-            displayManager.print(MSG_NORMAL, L"     Serial number : %s", device.first.c_str()) ;
+            displayManager.print(MSG_NORMAL, L"     Dev Num : %d", device.deviceNumber) ;
+            displayManager.print(MSG_NORMAL, L"     Serial number : %s", device.serialNumber.c_str()) ;
+            displayManager.print(MSG_NORMAL, L"     Mode : %s", DeviceIndex::getModeName(device.mode)) ;
+            if(device.deviceID != 0)
+                displayManager.print(MSG_NORMAL, L"     Device ID : 0x%03X", device.deviceID) ;
+            if(device.portPath.empty() == false)
+                displayManager.print(MSG_NORMAL, L"     USB port : %s", device.portPath.c_str()) ;
+            if(device.otpAltName.empty() == false)
+                displayManager.print(MSG_NORMAL, L"     OTP partition : %s (alternate %d)", device.otpAltName.c_str(), device.otpAltIndex) ;
+            if(device.lockOwnerPid > 0)
+                displayManager.print(MSG_NORMAL, L"     In use by : PID %ld", device.lockOwnerPid) ;
+            else if(device.lockOwnerPid < 0)
+                displayManager.print(MSG_NORMAL, L"     In use by : another process") ;
             deviceCount++;
         }
     }
@@ -744,85 +551,228 @@ int DFU::displayDevicesList()
 }
 
 /**
- * @brief DFU::readPartition: Get the dfu-util command ready, then read the partition and save it into file.
+ * @brief DFU::scanDevices : Build the index of all the attached ST devices (DFU and Fastboot) in one discovery pass.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DFU::scanDevices()
+{
+    return deviceIndex.scan(getTransport()) ;
+}
+
+/**
+ * @brief DFU::getDeviceIndex : Get the snapshot built by the last scanDevices() call.
+ * @return The device index.
+ */
+const DeviceIndex& DFU::getDeviceIndex() const
+{
+    return deviceIndex ;
+}
+
+/**
+ * @brief DFU::readPartition: Read the partition and save it into file.
  * @param filePath: The output binary file to store the  parition data.
  * @param alternateIndex: The alternate setting index of the dedicated partition to read.
  * @return 0 if the operation is performed successfully, otherwise an error occurred.
  */
 int DFU::readPartition(const std::string filePath, uint8_t alternateIndex)
 {
-    std::string  utilCmd =  getDfuUtilProgramPath().append("-d 0483:df11") ;
-    utilCmd.append(" -a ").append(std::to_string(alternateIndex)) ;
-
-    utilCmd.append(" -U ").append(filePath) ;
-    if(this->dfuSerialNumber != "")
-        utilCmd.append(" --serial ").append(this->dfuSerialNumber);
-
-#ifdef _WIN32
-    utilCmd = "\"" + utilCmd + "\"" ;
-#endif
-    displayManager.print(MSG_NORMAL, L"DFU-UTIL command: %s", utilCmd.data()) ;
-
-    FILE* pipe = popen(utilCmd.c_str(), "r");
-    if (pipe == nullptr)
+    if (getTransport()->upload(alternateIndex, filePath) == TOOLBOX_DFU_NO_ERROR)
     {
-        displayManager.print(MSG_ERROR, L"Failed to open pipe") ;
-        return TOOLBOX_DFU_ERROR_OTHER;
+        displayManager.print(MSG_GREEN, L"Read partition is done successfully !") ;
+        return TOOLBOX_DFU_NO_ERROR ;
     }
-
-    char buffer[4096];
-    std::string result = "";
-
-    while (!feof(pipe))
+    else
     {
-        if (fgets(buffer, 4096, pipe) != nullptr)
-        {
-            result += buffer;
-        }
+        session.invalidate() ;
+        displayManager.print(MSG_ERROR, L"Read partition is failed !") ;
+        return TOOLBOX_DFU_ERROR_READ ;
     }
-    pclose(pipe);
+}
 
-    std::string searchString = "Upload done.";
-    size_t pos = result.find(searchString);
-    if (pos != std::string::npos)
+/**
+ * @brief DFU::readPartition: Read the partition into memory.
+ * @param alternateIndex: The alternate setting index of the dedicated partition to read.
+ * @param data: Output buffer receiving the partition data.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DFU::readPartition(uint8_t alternateIndex, std::vector<unsigned char> &data)
+{
+    if (getTransport()->uploadToMemory(alternateIndex, data) != TOOLBOX_DFU_NO_ERROR)
     {
-        displayManager.print(MSG_GREEN, L"Read partition is done successfully !") ;
-        return TOOLBOX_DFU_NO_ERROR ;
+        session.invalidate() ;
+        displayManager.print(MSG_ERROR, L"Read partition is failed !") ;
+        return TOOLBOX_DFU_ERROR_READ ;
     }
-    else
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief DFU::getPhase: Upload the virtual partition and decode the GetPhase answer of the device.
+ * @param phaseInfo: Output GetPhase fields.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DFU::getPhase(GetPhaseStruct *phaseInfo)
+{
+    uint8_t alternateIndexVirtual = 0xFF;
+    int ret = getAlternateSettingIndex("virtual", &alternateIndexVirtual);
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    ret = readPartition(alternateIndexVirtual, phaseBuffer) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    if(phaseBuffer.size() < GET_PHASE_MIN_SIZE)
     {
-        displayManager.print(MSG_ERROR, L"Read partition is failed !") ;
+        displayManager.print(MSG_ERROR, L"Invalid GetPhase answer : %lu bytes received", (unsigned long)phaseBuffer.size());
         return TOOLBOX_DFU_ERROR_READ ;
     }
+
+    /* The answer is packed and little endian */
+    const unsigned char *data = phaseBuffer.data() ;
+    phaseInfo->Phase = data[0] ;
+    phaseInfo->Address = (uint32_t)data[1] | ((uint32_t)data[2] << 8) | ((uint32_t)data[3] << 16) | ((uint32_t)data[4] << 24) ;
+    phaseInfo->Offset = (uint32_t)data[5] | ((uint32_t)data[6] << 8) | ((uint32_t)data[7] << 16) | ((uint32_t)data[8] << 24) ;
+
+    /* Check if Phase is 0 to read the NeedDFUDetach byte */
+    if((phaseInfo->Phase == 0) && (phaseBuffer.size() > GET_PHASE_MIN_SIZE))
+        phaseInfo->NeedDFUDetach = data[GET_PHASE_MIN_SIZE] ;
+    else
+        phaseInfo->NeedDFUDetach = 0 ;
+
+    return TOOLBOX_DFU_NO_ERROR ;
 }
 
 int DFU::getAlternateSettingIndex(const uint8_t phaseId, uint8_t *altIndex)
 {
-    int ret = TOOLBOX_DFU_NO_ERROR;
-    bool isIndexFound = false ;
+    const AltSettingTable *table = nullptr ;
 
     /* Read the DFU device and get the list of the avaialble alternate setting */
-    ret = getAlternateSettingList() ;
+    int ret = getAlternateSettingTable(&table) ;
     if(ret != TOOLBOX_DFU_NO_ERROR)
         return ret ;
 
-    /* The List of alternate setting is already populated */
-    for(uint8_t idx = 0 ; idx < this->altSettingList.size(); idx ++)
+    if(table->findByPartitionId(phaseId, altIndex) == false)
     {
-        if(std::get<2>(altSettingList.at(idx)) == phaseId)
+        displayManager.print(MSG_ERROR, L"DFU device : Partition ID [%d] does not exist !", phaseId);
+        return TOOLBOX_DFU_ERROR_INTERFACE_NOT_SUPPORTED;
+    }
+
+    displayManager.print(MSG_NORMAL, L"DFU device : Partition ID [%d] is found with alternate index [%d]", phaseId, *altIndex);
+    return TOOLBOX_DFU_NO_ERROR;
+}
+
+/**
+ * @brief DFU::getTransport : Get the transport of the selected backend, created on first use.
+ * @return The transport used for all the USB operations.
+ */
+DfuTransport* DFU::getTransport()
+{
+    if(transport == nullptr)
+        transport = DfuTransport::create(DfuTransport::getDefaultBackend(), this->toolboxFolder, this->dfuSerialNumber) ;
+
+    return transport.get() ;
+}
+
+/**
+ * @brief DFU::getSession : Get the session of the selected device (probe and enumeration counters).
+ * @return The device session.
+ */
+const DeviceSession& DFU::getSession() const
+{
+    return session ;
+}
+
+/**
+ * @brief DFU::isSessionValid : Check that the cached device information still matches the device enumeration.
+ * @return True if the cached information can be used, otherwise false and the device has to be probed again.
+ */
+bool DFU::isSessionValid()
+{
+    if(session.isValid() == false)
+        return false ;
+
+    if(getTransport()->isSameEnumeration() == false)
+    {
+        session.invalidate() ;
+        return false ;
+    }
+
+    return true ;
+}
+
+/**
+ * @brief DFU::updateSession : Store the listed device information for the current enumeration.
+ * @param device: The listed device.
+ * @return True if the device is fully enumerated, otherwise false (some names are still 'UNKNOWN').
+ */
+bool DFU::updateSession(const DfuDeviceInfo &device)
+{
+    for(const auto &altSetting : device.altSettings)
+    {
+        if(altSetting.name == "UNKNOWN")
+            return false ;
+    }
+
+    session.update(device) ;
+    if(device.portPath.empty() == false)
+        usbPortPath = device.portPath ;
+    return true ;
+}
+
+/**
+ * @brief DFU::findOtpAlternateSetting : Search the OTP partition exposed by U-Boot, the ROM code does not expose it.
+ * @param device: The listed device.
+ * @return True if the OTP partition is found, otherwise false.
+ */
+bool DFU::findOtpAlternateSetting(const DfuDeviceInfo &device)
+{
+    for(const auto &altSetting : device.altSettings)
+    {
+        if(altSetting.name.compare(0, 4, "@OTP") == 0)
         {
-            *altIndex = std::get<0>(altSettingList.at(idx)) ;
-            isIndexFound = true ;
-            displayManager.print(MSG_NORMAL, L"DFU device : Partition ID [%d] is found with alternate index [%d]", phaseId, *altIndex);
-            break ;
+            otpPartitionName = "\"" + altSetting.name + "\"" ;
+            otpAltIndex = altSetting.alt ;
+            return true ;
         }
     }
 
-    if(isIndexFound == false)
+    return false ;
+}
+
+/**
+ * @brief DFU::startHotplugMonitor : Start listening to the hotplug events before checking the devices, so no event is missed.
+ * @return True if the waits can be driven by the hotplug events, otherwise false and the devices are polled.
+ */
+bool DFU::startHotplugMonitor()
+{
+    if((getTransport()->isHotplugObservable() == false) || (hotplugMonitor.open() == false))
+        return false ;
+
+    hotplugMonitor.flush() ;
+    return true ;
+}
+
+/**
+ * @brief DFU::waitDeviceChange : Wait before checking the devices again.
+ * @param isEventDriven: True to wake up on the hotplug events, false to sleep for the polling period.
+ * @param productID: The USB product ID of the awaited device.
+ * @param deadline: The time point the wait does not exceed.
+ * @param pollMs: The polling period in milliseconds.
+ */
+void DFU::waitDeviceChange(bool isEventDriven, uint16_t productID, const std::chrono::steady_clock::time_point &deadline, uint32_t pollMs)
+{
+    const auto now = std::chrono::steady_clock::now() ;
+    if(isEventDriven)
     {
-        displayManager.print(MSG_ERROR, L"DFU device : Partition ID [%d] does not exist !", phaseId);
-        ret = TOOLBOX_DFU_ERROR_INTERFACE_NOT_SUPPORTED;
+        /* Wake up on the device events, and periodically in case an event is missed */
+        HOTPLUG_WAIT_STATUS status = hotplugMonitor.wait(ST_USB_VENDOR_ID, productID, this->dfuSerialNumber, std::min(deadline, now + std::chrono::milliseconds(HOTPLUG_RECHECK_MS))) ;
+        if(status != HOTPLUG_NOT_SUPPORTED)
+            return ;
+
+        hotplugMonitor.close() ;
     }
 
-    return ret;
+    std::this_thread::sleep_until(std::min(deadline, now + std::chrono::milliseconds(pollMs)));
 }
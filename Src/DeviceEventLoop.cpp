@@ -0,0 +1,167 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "DeviceEventLoop.h"
+#include <thread>
+
+DeviceEventLoop::DeviceEventLoop(const std::string &toolboxFolder)
+{
+    scanInterface.toolboxFolder = toolboxFolder ;
+    busyMs = 0 ;
+    scanCount = 0 ;
+}
+
+/**
+ * @brief DeviceEventLoop::post : Queue a task, the tasks run in their posting order.
+ * @param task: The task.
+ */
+void DeviceEventLoop::post(std::function<void(void)> task)
+{
+    readyTasks.push_back(std::move(task)) ;
+}
+
+/**
+ * @brief DeviceEventLoop::waitForMode : Wait for a device to show up in a boot stage, without blocking the loop.
+ * @param serialNumber: The device serial number.
+ * @param mode: The awaited boot stage.
+ * @param lastDeviceNumber: Device number before the detach, for the waits of a new enumeration.
+ * @param msTimeout: Time given to the device to show up.
+ * @param callback: Called from the loop with TOOLBOX_DFU_NO_ERROR once the device is seen,
+ * or with TOOLBOX_DFU_ERROR_TIMEOUT when the timeout elapsed first.
+ */
+void DeviceEventLoop::waitForMode(const std::string &serialNumber, DEVICE_WAIT mode, int lastDeviceNumber, uint32_t msTimeout, std::function<void(int)> callback)
+{
+    waiters.push_back({serialNumber, mode, lastDeviceNumber, std::chrono::steady_clock::now() + std::chrono::milliseconds(msTimeout), std::move(callback)}) ;
+}
+
+/**
+ * @brief DeviceEventLoop::run : Run the tasks and serve the waits until none is left.
+ */
+void DeviceEventLoop::run()
+{
+    runReadyTasks() ;
+    while(waiters.empty() == false)
+    {
+        pollWaiters() ;
+        if(readyTasks.empty())
+            std::this_thread::sleep_for(std::chrono::milliseconds(EVENT_LOOP_POLL_MS));
+        else
+            runReadyTasks() ;
+    }
+}
+
+/**
+ * @brief DeviceEventLoop::scanDevices : Scan the attached devices, the result is given by getDeviceIndex().
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DeviceEventLoop::scanDevices()
+{
+    scanCount++ ;
+    return scanInterface.scanDevices() ;
+}
+
+/**
+ * @brief DeviceEventLoop::getDeviceIndex
+ * @return The devices found by the last scan.
+ */
+const DeviceIndex& DeviceEventLoop::getDeviceIndex() const
+{
+    return scanInterface.getDeviceIndex() ;
+}
+
+uint64_t DeviceEventLoop::getBusyMs() const
+{
+    return busyMs ;
+}
+
+uint32_t DeviceEventLoop::getScanCount() const
+{
+    return scanCount ;
+}
+
+/**
+ * @brief DeviceEventLoop::runReadyTasks : Run the queued tasks, including the ones they post.
+ */
+void DeviceEventLoop::runReadyTasks()
+{
+    auto start = std::chrono::steady_clock::now() ;
+    while(readyTasks.empty() == false)
+    {
+        std::function<void(void)> task = std::move(readyTasks.front()) ;
+        readyTasks.pop_front() ;
+        task() ;
+    }
+    busyMs += std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() ;
+}
+
+/**
+ * @brief DeviceEventLoop::pollWaiters : Scan the devices once and complete the waits of the devices which are back,
+ * in their registration order, then the waits which reached their deadline. A failed scan sees no device, so the
+ * waits still expire when the devices cannot be listed.
+ */
+void DeviceEventLoop::pollWaiters()
+{
+    bool isScanned = (scanDevices() == TOOLBOX_DFU_NO_ERROR) ;
+
+    /* The callbacks are posted, so they may register new waits */
+    auto now = std::chrono::steady_clock::now() ;
+    for(auto waiter = waiters.begin(); waiter != waiters.end(); )
+    {
+        bool isBack = isScanned && isDeviceBack(*waiter, getDeviceIndex().findBySerialNumber(waiter->serialNumber)) ;
+        if(isBack || (now >= waiter->deadline))
+        {
+            int status = isBack ? TOOLBOX_DFU_NO_ERROR : TOOLBOX_DFU_ERROR_TIMEOUT ;
+            std::function<void(int)> callback = std::move(waiter->callback) ;
+            post([callback, status]() { callback(status) ; }) ;
+            waiter = waiters.erase(waiter) ;
+        }
+        else
+        {
+            ++waiter ;
+        }
+    }
+}
+
+/**
+ * @brief DeviceEventLoop::isDeviceBack
+ * @param waiter: The wait.
+ * @param device: The device as seen by the last scan, nullptr if it is absent.
+ * @return True if the device shows the awaited boot stage.
+ */
+bool DeviceEventLoop::isDeviceBack(const DeviceWaiter &waiter, const DiscoveredDevice *device)
+{
+    if(device == nullptr)
+        return false ;
+
+    bool isNewEnumeration = (device->deviceNumber != waiter.lastDeviceNumber) ;
+    switch(waiter.mode)
+    {
+    case DEVICE_WAIT_DFU:
+        return isNewEnumeration && (device->mode != DEVICE_MODE_FASTBOOT) ;
+    case DEVICE_WAIT_UBOOT_DFU:
+        return isNewEnumeration && (device->mode == DEVICE_MODE_UBOOT_DFU) ;
+    case DEVICE_WAIT_FASTBOOT:
+        return device->mode == DEVICE_MODE_FASTBOOT ;
+    default:
+        return true ;
+    }
+}
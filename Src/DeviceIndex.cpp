@@ -0,0 +1,185 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "DeviceIndex.h"
+
+/**
+ * @brief DeviceIndex::scan : Discover all the attached ST devices in one pass.
+ * @param transport: The transport used to list the DFU devices and their alternate settings.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DeviceIndex::scan(DfuTransport *transport)
+{
+    devices.clear();
+    serialNumberIndex.clear();
+
+    std::vector<DfuDeviceInfo> dfuDevices ;
+    int ret = transport->listDevices("", dfuDevices) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    /* The sysfs entries give the port path, and the product string when the transport does not read it */
+    std::vector<SysfsUsbDevice> sysfsDevices ;
+    SysfsUsb::enumerate(ST_USB_VENDOR_ID, ST_DFU_PRODUCT_ID, sysfsDevices) ;
+
+    for(const auto &dfuDevice : dfuDevices)
+    {
+        const SysfsUsbDevice *sysfsDevice = nullptr ;
+        for(const auto &candidate : sysfsDevices)
+        {
+            bool isSameNode = (candidate.busNumber == dfuDevice.busNumber) && (candidate.deviceNumber == dfuDevice.deviceNumber) ;
+            bool isSamePort = (dfuDevice.portPath.empty() == false) && (candidate.portPath == dfuDevice.portPath) ;
+            if(isSameNode || isSamePort)
+            {
+                sysfsDevice = &candidate ;
+                break ;
+            }
+        }
+
+        devices.push_back(classifyDfuDevice(dfuDevice, sysfsDevice));
+    }
+
+    std::vector<DfuDeviceInfo> fastbootDevices ;
+    transport->listFastbootDevices(fastbootDevices) ;
+    for(const auto &fastbootDevice : fastbootDevices)
+    {
+        DiscoveredDevice device ;
+        device.serialNumber = fastbootDevice.serialNumber ;
+        device.mode = DEVICE_MODE_FASTBOOT ;
+        device.deviceID = 0 ;
+        device.otpAltIndex = 0 ;
+        device.portPath = fastbootDevice.portPath ;
+        device.busNumber = fastbootDevice.busNumber ;
+        device.deviceNumber = fastbootDevice.deviceNumber ;
+        for(const auto &str : fastbootDevice.descriptorStrings)
+        {
+            std::string deviceIdString ;
+            if(DfuDevice::findDeviceIdString(str, deviceIdString))
+                device.deviceID = std::strtoul(deviceIdString.c_str(), nullptr, 16) ;
+        }
+        devices.push_back(std::move(device));
+    }
+
+    for(size_t idx = 0 ; idx < devices.size() ; idx++)
+    {
+        DiscoveredDevice &device = devices.at(idx) ;
+        if(DeviceLock::isLocked(device.serialNumber, device.portPath, &device.lockOwnerPid) && (device.lockOwnerPid == 0))
+            device.lockOwnerPid = -1 ; // Locked by an unknown process
+        serialNumberIndex.emplace(device.serialNumber, idx);
+    }
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+const std::vector<DiscoveredDevice>& DeviceIndex::getDevices() const
+{
+    return devices ;
+}
+
+/**
+ * @brief DeviceIndex::findBySerialNumber
+ * @param serialNumber: The serial number of the device.
+ * @return The device from the last scan, nullptr if it was not attached.
+ */
+const DiscoveredDevice* DeviceIndex::findBySerialNumber(const std::string &serialNumber) const
+{
+    auto it = serialNumberIndex.find(serialNumber);
+    if(it == serialNumberIndex.end())
+        return nullptr ;
+
+    return &devices.at(it->second) ;
+}
+
+const char* DeviceIndex::getModeName(DEVICE_MODE mode)
+{
+    switch(mode)
+    {
+    case DEVICE_MODE_ROM_DFU:
+        return "ROM DFU" ;
+    case DEVICE_MODE_UBOOT_DFU:
+        return "U-Boot DFU" ;
+    case DEVICE_MODE_PRGFW_UTIL:
+        return "STM32PRGFW-UTIL" ;
+    case DEVICE_MODE_FASTBOOT:
+        return "Fastboot" ;
+    default:
+        return "Unknown" ;
+    }
+}
+
+/**
+ * @brief DeviceIndex::classifyDfuDevice : Deduce the running boot stage from the exposed partitions and product string.
+ * The ROM code does not expose the OTP partition. U-Boot (stm32prog) names its product "USB download gadget@Device ID /...",
+ * while STM32PRGFW-UTIL keeps the "DFU in HS Mode @Device ID /..." string of the ROM code.
+ * @param device: The listed DFU device.
+ * @param sysfsDevice: The matching sysfs entry, nullptr if there is none.
+ * @return The discovered device.
+ */
+DiscoveredDevice DeviceIndex::classifyDfuDevice(const DfuDeviceInfo &device, const SysfsUsbDevice *sysfsDevice)
+{
+    DiscoveredDevice discovered ;
+    discovered.serialNumber = device.serialNumber ;
+    discovered.deviceID = 0 ;
+    discovered.otpAltIndex = 0 ;
+    discovered.portPath = device.portPath ;
+    discovered.busNumber = device.busNumber ;
+    discovered.deviceNumber = device.deviceNumber ;
+    discovered.altSettings.build(device.altSettings) ;
+
+    std::vector<std::string> descriptorStrings = device.descriptorStrings ;
+    if(sysfsDevice != nullptr)
+    {
+        if(discovered.portPath.empty())
+            discovered.portPath = sysfsDevice->portPath ;
+        descriptorStrings.push_back(sysfsDevice->product);
+    }
+
+    std::string productString ;
+    for(const auto &str : descriptorStrings)
+    {
+        std::string deviceIdString ;
+        if(DfuDevice::findDeviceIdString(str, deviceIdString))
+        {
+            discovered.deviceID = std::strtoul(deviceIdString.c_str(), nullptr, 16) ;
+            productString = str ;
+        }
+    }
+
+    for(const auto &altSetting : device.altSettings)
+    {
+        if(altSetting.name.compare(0, 4, "@OTP") == 0)
+        {
+            discovered.otpAltName = altSetting.name ;
+            discovered.otpAltIndex = altSetting.alt ;
+            break ;
+        }
+    }
+
+    if(discovered.otpAltName.empty())
+        discovered.mode = DEVICE_MODE_ROM_DFU ;
+    else if((productString.empty() == false) && (productString.find("USB download gadget") == std::string::npos))
+        discovered.mode = DEVICE_MODE_PRGFW_UTIL ;
+    else
+        discovered.mode = DEVICE_MODE_UBOOT_DFU ;
+
+    return discovered ;
+}
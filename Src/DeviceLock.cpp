@@ -0,0 +1,335 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "DeviceLock.h"
+#include "DisplayManager.h"
+#include "Error.h"
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+#include <experimental/filesystem>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#ifndef F_OFD_GETLK
+#define F_OFD_GETLK     36
+#define F_OFD_SETLK     37
+#endif
+#endif
+
+namespace fs = std::experimental::filesystem ;
+
+constexpr uint32_t DEVICE_LOCK_RETRY_MS = 100;
+
+DeviceLock::DeviceLock()
+{
+    serialHandle = -1 ;
+    portHandle = -1 ;
+}
+
+DeviceLock::~DeviceLock()
+{
+    release();
+}
+
+bool DeviceLock::isHeld() const
+{
+    return (serialHandle != -1) || (portHandle != -1) ;
+}
+
+const std::string& DeviceLock::getSerialNumber() const
+{
+    return serialNumber ;
+}
+
+const std::string& DeviceLock::getPortPath() const
+{
+    return portPath ;
+}
+
+/**
+ * @brief DeviceLock::acquire : Lock a device for this instance, both keys must be free.
+ * @param serialNumber: Serial number of the device, empty if unknown.
+ * @param portPath: USB port path of the device ("<bus>-<port>.<port>..."), empty if unknown.
+ * @param msTimeout: Delay to wait for the other holders to release the device, 0 to fail immediately.
+ * @return 0 if the operation is performed successfully, TOOLBOX_DFU_ERROR_DEVICE_BUSY if another instance holds the device,
+ * otherwise an error occurred.
+ */
+int DeviceLock::acquire(const std::string &serialNumber, const std::string &portPath, uint32_t msTimeout)
+{
+    release();
+    if(serialNumber.empty() && portPath.empty())
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+
+    std::error_code errorCode ;
+    fs::path directory(getLockDirectory()) ;
+    if((fs::create_directories(directory, errorCode) == false) && (fs::is_directory(directory, errorCode) == false))
+    {
+        DisplayManager::getInstance().print(MSG_ERROR, L"Could not create the lock directory %s", directory.string().c_str());
+        return TOOLBOX_DFU_ERROR_NO_FILE ;
+    }
+#ifndef _WIN32
+    chmod(directory.string().c_str(), 01777) ; // Shared by all the users, like /tmp
+#endif
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(msTimeout);
+    while(true)
+    {
+        int ret = TOOLBOX_DFU_NO_ERROR ;
+        if(serialNumber.empty() == false)
+            ret = lockFile(getLockFilePath("serial", serialNumber), &serialHandle) ;
+        if((ret == TOOLBOX_DFU_NO_ERROR) && (portPath.empty() == false))
+            ret = lockFile(getLockFilePath("port", portPath), &portHandle) ;
+
+        if(ret == TOOLBOX_DFU_NO_ERROR)
+            break ;
+
+        release();
+        if((ret != TOOLBOX_DFU_ERROR_DEVICE_BUSY) || (std::chrono::steady_clock::now() >= deadline))
+            return ret ;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(DEVICE_LOCK_RETRY_MS));
+    }
+
+    this->serialNumber = serialNumber ;
+    this->portPath = portPath ;
+    writeOwner(serialHandle) ;
+    writeOwner(portHandle) ;
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief DeviceLock::release : Release the device, the lock files are kept for the next holders.
+ */
+void DeviceLock::release()
+{
+    unlockFile(serialHandle) ;
+    unlockFile(portHandle) ;
+    serialHandle = -1 ;
+    portHandle = -1 ;
+    serialNumber.clear();
+    portPath.clear();
+}
+
+/**
+ * @brief DeviceLock::isLocked : Check if a device is held by any instance, including this process.
+ * @param serialNumber: Serial number of the device, empty if unknown.
+ * @param portPath: USB port path of the device, empty if unknown.
+ * @param ownerPid: Optional output process ID of the holder, 0 if unknown.
+ * @return True if one of the keys is locked, otherwise false.
+ */
+bool DeviceLock::isLocked(const std::string &serialNumber, const std::string &portPath, long *ownerPid)
+{
+    if(ownerPid != nullptr)
+        *ownerPid = 0 ;
+
+    if((serialNumber.empty() == false) && isFileLocked(getLockFilePath("serial", serialNumber), ownerPid))
+        return true ;
+
+    return (portPath.empty() == false) && isFileLocked(getLockFilePath("port", portPath), ownerPid) ;
+}
+
+/**
+ * @brief DeviceLock::getLockDirectory : The same directory for all the users and sessions, whatever their environment.
+ * @return The directory holding the lock files.
+ */
+std::string DeviceLock::getLockDirectory()
+{
+    const char *lockDirectory = std::getenv("PRG_TOOLBOX_DFU_LOCK_DIR") ;
+    if((lockDirectory != nullptr) && (lockDirectory[0] != '\0'))
+        return lockDirectory ;
+
+#ifdef _WIN32
+    std::error_code errorCode ;
+    fs::path tempDirectory = fs::temp_directory_path(errorCode) ;
+    if(errorCode)
+        tempDirectory = "C:\\Windows\\Temp" ;
+
+    return (tempDirectory / "PRG-TOOLBOX-DFU-locks").string() ;
+#else
+    /* Neither $XDG_RUNTIME_DIR nor $TMPDIR: they differ between the users, which would lock the same device in different places */
+    if(access("/run/lock/PRG-TOOLBOX-DFU", W_OK | X_OK) == 0)
+        return "/run/lock/PRG-TOOLBOX-DFU" ;
+    if((access("/run/lock/PRG-TOOLBOX-DFU", F_OK) != 0) && (access("/run/lock", W_OK | X_OK) == 0))
+        return "/run/lock/PRG-TOOLBOX-DFU" ;
+
+    return "/tmp/PRG-TOOLBOX-DFU-locks" ;
+#endif
+}
+
+/**
+ * @brief DeviceLock::getLockFilePath : Build the lock file of a key, the characters unsafe in a file name are replaced.
+ */
+std::string DeviceLock::getLockFilePath(const std::string &kind, const std::string &key)
+{
+    std::string name = kind + "-" ;
+    for(char c : key)
+        name.push_back((isalnum((unsigned char)c) || (c == '-') || (c == '.')) ? c : '_') ;
+    name.append(".lock") ;
+
+    return (fs::path(getLockDirectory()) / name).string() ;
+}
+
+/**
+ * @brief DeviceLock::lockFile : Open a lock file and lock it without waiting.
+ * @param path: The lock file.
+ * @param handle: Output handle of the open lock file.
+ * @return 0 if the operation is performed successfully, TOOLBOX_DFU_ERROR_DEVICE_BUSY if the file is locked, otherwise an error occurred.
+ */
+int DeviceLock::lockFile(const std::string &path, intptr_t *handle)
+{
+#ifdef _WIN32
+    /* No sharing: the open fails while another instance holds the file */
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr) ;
+    if(file == INVALID_HANDLE_VALUE)
+        return (GetLastError() == ERROR_SHARING_VIOLATION) ? TOOLBOX_DFU_ERROR_DEVICE_BUSY : TOOLBOX_DFU_ERROR_NO_FILE ;
+
+    *handle = (intptr_t)file ;
+    return TOOLBOX_DFU_NO_ERROR ;
+#else
+    /* The directory is shared by the users: a symbolic or hard link planted there must not make the owner written elsewhere */
+    int descriptor = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | O_NOFOLLOW, 0666) ;
+    if(descriptor < 0)
+    {
+        DisplayManager::getInstance().print(MSG_ERROR, L"Could not open the lock file %s : %s", path.c_str(), strerror(errno));
+        return TOOLBOX_DFU_ERROR_NO_FILE ;
+    }
+
+    struct stat fileStat ;
+    if((fstat(descriptor, &fileStat) != 0) || (S_ISREG(fileStat.st_mode) == false) || (fileStat.st_nlink != 1))
+    {
+        DisplayManager::getInstance().print(MSG_ERROR, L"The lock file %s is not a regular file, it is not used", path.c_str());
+        close(descriptor);
+        return TOOLBOX_DFU_ERROR_NO_FILE ;
+    }
+    fchmod(descriptor, 0666) ; // Whatever the umask, any user may lock the device later
+
+    struct flock lock ;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK ;
+    lock.l_whence = SEEK_SET ;
+    int status = -1 ;
+#ifdef __linux__
+    status = fcntl(descriptor, F_OFD_SETLK, &lock) ;
+    if((status != 0) && (errno == EINVAL)) // Kernel older than 3.15, the lock is per process
+#endif
+        status = fcntl(descriptor, F_SETLK, &lock) ;
+
+    if(status != 0)
+    {
+        int error = errno ;
+        close(descriptor);
+        return ((error == EACCES) || (error == EAGAIN)) ? TOOLBOX_DFU_ERROR_DEVICE_BUSY : TOOLBOX_DFU_ERROR_OTHER ;
+    }
+
+    *handle = descriptor ;
+    return TOOLBOX_DFU_NO_ERROR ;
+#endif
+}
+
+void DeviceLock::unlockFile(intptr_t handle)
+{
+    if(handle == -1)
+        return ;
+
+#ifdef _WIN32
+    CloseHandle((HANDLE)handle) ;
+#else
+    close((int)handle) ; // Closing the open file description releases its lock
+#endif
+}
+
+/**
+ * @brief DeviceLock::isFileLocked : Test a lock file without locking it.
+ * @param path: The lock file.
+ * @param ownerPid: Optional output process ID recorded by the holder.
+ * @return True if the file is locked, otherwise false.
+ */
+bool DeviceLock::isFileLocked(const std::string &path, long *ownerPid)
+{
+    bool isLocked = false ;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) ;
+    if(file == INVALID_HANDLE_VALUE)
+        return (GetLastError() == ERROR_SHARING_VIOLATION) ;
+    CloseHandle(file) ;
+    return false ;
+#else
+    int descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW) ;
+    if(descriptor < 0)
+        return false ; // Never locked
+
+    struct flock lock ;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK ;
+    lock.l_whence = SEEK_SET ;
+    int status = -1 ;
+#ifdef __linux__
+    status = fcntl(descriptor, F_OFD_GETLK, &lock) ;
+    if((status != 0) && (errno == EINVAL))
+#endif
+        status = fcntl(descriptor, F_GETLK, &lock) ;
+    isLocked = (status == 0) && (lock.l_type != F_UNLCK) ;
+
+    if(isLocked && (ownerPid != nullptr))
+    {
+        char buffer[32] = {0} ;
+        if(pread(descriptor, buffer, sizeof(buffer) - 1, 0) > 0)
+            *ownerPid = std::strtol(buffer, nullptr, 10) ;
+    }
+
+    close(descriptor);
+#endif
+    return isLocked ;
+}
+
+/**
+ * @brief DeviceLock::writeOwner : Record the holder process ID in a lock file, for the diagnostics.
+ */
+void DeviceLock::writeOwner(intptr_t handle)
+{
+    if(handle == -1)
+        return ;
+
+#ifdef _WIN32
+    std::string owner = std::to_string((unsigned long)GetCurrentProcessId()) + "\n" ;
+    DWORD written = 0 ;
+    SetFilePointer((HANDLE)handle, 0, nullptr, FILE_BEGIN) ;
+    WriteFile((HANDLE)handle, owner.data(), (DWORD)owner.size(), &written, nullptr) ;
+    SetEndOfFile((HANDLE)handle) ;
+#else
+    std::string owner = std::to_string((long)getpid()) + "\n" ;
+    if(ftruncate((int)handle, 0) == 0)
+    {
+        ssize_t written = pwrite((int)handle, owner.data(), owner.size(), 0) ;
+        (void)written ;
+    }
+#endif
+}
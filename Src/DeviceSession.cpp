@@ -0,0 +1,137 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "DeviceSession.h"
+
+DeviceSession::DeviceSession()
+{
+    deviceID = 0 ;
+    isProbed = false ;
+    isDeviceIdProbed = false ;
+    generation = 0 ;
+    probeCount = 0 ;
+    lookupHits = 0 ;
+    lookupMisses = 0 ;
+}
+
+/**
+ * @brief DeviceSession::isValid
+ * @return True if the descriptors of the current enumeration are known, otherwise false.
+ */
+bool DeviceSession::isValid() const
+{
+    return isProbed ;
+}
+
+/**
+ * @brief DeviceSession::isDeviceIdKnown
+ * @return True if the device ID of the current enumeration is known, otherwise false.
+ */
+bool DeviceSession::isDeviceIdKnown() const
+{
+    return isDeviceIdProbed ;
+}
+
+/**
+ * @brief DeviceSession::update : Store the descriptors probed for the current enumeration.
+ * @param deviceInfo: The device serial number, alternate settings and string descriptors.
+ */
+void DeviceSession::update(const DfuDeviceInfo &deviceInfo)
+{
+    this->deviceInfo = deviceInfo ;
+    altSettingTable.build(deviceInfo.altSettings) ;
+    isProbed = true ;
+    probeCount++ ;
+}
+
+/**
+ * @brief DeviceSession::setDeviceID : Store the device ID read for the current enumeration.
+ * @param deviceID: The STM32 device ID.
+ */
+void DeviceSession::setDeviceID(uint16_t deviceID)
+{
+    this->deviceID = deviceID ;
+    isDeviceIdProbed = true ;
+}
+
+/**
+ * @brief DeviceSession::invalidate : The device is leaving its current enumeration (detach, hotplug, transfer error),
+ * the next access probes it again.
+ */
+void DeviceSession::invalidate()
+{
+    if((isProbed == false) && (isDeviceIdProbed == false))
+        return ;
+
+    isProbed = false ;
+    isDeviceIdProbed = false ;
+    deviceInfo = DfuDeviceInfo() ;
+    altSettingTable.clear() ;
+    generation++ ;
+}
+
+/**
+ * @brief DeviceSession::countLookup : Account an alternate setting lookup.
+ * @param isCached: True if the lookup is answered from the table of the current enumeration.
+ */
+void DeviceSession::countLookup(bool isCached)
+{
+    if(isCached)
+        lookupHits++ ;
+    else
+        lookupMisses++ ;
+}
+
+uint32_t DeviceSession::getGeneration() const
+{
+    return generation ;
+}
+
+uint32_t DeviceSession::getProbeCount() const
+{
+    return probeCount ;
+}
+
+uint16_t DeviceSession::getDeviceID() const
+{
+    return deviceID ;
+}
+
+uint32_t DeviceSession::getLookupHits() const
+{
+    return lookupHits ;
+}
+
+uint32_t DeviceSession::getLookupMisses() const
+{
+    return lookupMisses ;
+}
+
+const DfuDeviceInfo& DeviceSession::getDeviceInfo() const
+{
+    return deviceInfo ;
+}
+
+const AltSettingTable& DeviceSession::getAltSettingTable() const
+{
+    return altSettingTable ;
+}
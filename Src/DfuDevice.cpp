@@ -0,0 +1,934 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "DfuDevice.h"
+#include "SysfsUsb.h"
+#include <thread>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/usbdevice_fs.h>
+#endif
+
+constexpr uint8_t USB_DT_DEVICE = 0x01;
+constexpr uint8_t USB_DT_CONFIG = 0x02;
+constexpr uint8_t USB_DT_STRING = 0x03;
+constexpr uint8_t USB_DT_INTERFACE = 0x04;
+constexpr uint8_t USB_DT_DFU_FUNCTIONAL = 0x21;
+constexpr uint8_t USB_CLASS_APP_SPECIFIC = 0xFE;
+constexpr uint8_t USB_SUBCLASS_DFU = 0x01;
+constexpr uint8_t USB_REQ_GET_DESCRIPTOR = 0x06;
+constexpr uint8_t DFU_ATTR_WILL_DETACH = 0x08;
+
+constexpr uint8_t DFU_REQUEST_TYPE_OUT = 0x21; // Host to device, class, interface
+constexpr uint8_t DFU_REQUEST_TYPE_IN = 0xA1;  // Device to host, class, interface
+
+DfuDevice::DfuDevice()
+{
+    fileDescriptor = -1 ;
+    interfaceNumber = 0 ;
+    currentAlt = -1 ;
+    transferSize = DFU_DEFAULT_TRANSFER_SIZE ;
+    dfuAttributes = 0 ;
+    busNumber = 0 ;
+    deviceNumber = 0 ;
+    isBlockSent = false ;
+    lastStatus = {DFU_STATUS_OK, 0, DFU_STATE_DFU_IDLE, 0} ;
+}
+
+DfuDevice::~DfuDevice()
+{
+    close();
+}
+
+/**
+ * @brief DfuDevice::open : Search the USB bus for a DFU device and claim its DFU interface.
+ * @param vendorId: USB vendor ID to match.
+ * @param productId: USB product ID to match.
+ * @param serialNumber: Optional serial number filter, empty to take the first matching device.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuDevice::open(uint16_t vendorId, uint16_t productId, const std::string serialNumber)
+{
+    close();
+
+    std::vector<std::string> devicePaths ;
+    int ret = getDevicePaths(devicePaths) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    ret = TOOLBOX_DFU_ERROR_NO_DEVICE ;
+    for(const auto &devPath : devicePaths)
+    {
+        int status = openPath(devPath, vendorId, productId) ;
+        if(status != TOOLBOX_DFU_NO_ERROR)
+        {
+            if(status == TOOLBOX_DFU_ERROR_CONNECTION)
+                ret = status ; // Keep the most relevant reason
+            continue ;
+        }
+
+        if((serialNumber.empty() == false) && (this->serialNumber != serialNumber))
+        {
+            close();
+            continue ;
+        }
+
+#ifdef __linux__
+        unsigned int interface = interfaceNumber ;
+        if(ioctl(fileDescriptor, USBDEVFS_CLAIMINTERFACE, &interface) < 0)
+        {
+            /* Another process or a kernel driver owns the interface */
+            close();
+            ret = TOOLBOX_DFU_ERROR_CONNECTION ;
+            continue ;
+        }
+#endif
+
+        return TOOLBOX_DFU_NO_ERROR ;
+    }
+
+    return ret ;
+}
+
+/**
+ * @brief DfuDevice::enumerate : List the DFU devices without claiming them.
+ * @param vendorId: USB vendor ID to match.
+ * @param productId: USB product ID to match.
+ * @param devices: Output list of the discovered devices.
+ * @return 0 if the operation is performed successfully, TOOLBOX_DFU_ERROR_CONNECTION if a matching device is not accessible.
+ */
+int DfuDevice::enumerate(uint16_t vendorId, uint16_t productId, std::vector<DfuDeviceInfo> &devices)
+{
+    devices.clear();
+
+    std::vector<std::string> devicePaths ;
+    int ret = getDevicePaths(devicePaths) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    for(const auto &devPath : devicePaths)
+    {
+        DfuDevice device ;
+        int status = device.openPath(devPath, vendorId, productId) ;
+        if(status == TOOLBOX_DFU_ERROR_CONNECTION)
+            ret = status ;
+        if(status != TOOLBOX_DFU_NO_ERROR)
+            continue ;
+
+        devices.push_back(device.getDeviceInfo());
+    }
+
+    return ret ;
+}
+
+/**
+ * @brief DfuDevice::isDevicePresent : Check the device descriptors only, no write access is needed.
+ * @param vendorId: USB vendor ID to match.
+ * @param productId: USB product ID to match.
+ * @return True if at least one device matches, otherwise false.
+ */
+bool DfuDevice::isDevicePresent(uint16_t vendorId, uint16_t productId)
+{
+    std::vector<std::string> devicePaths ;
+    if(getDevicePaths(devicePaths) != TOOLBOX_DFU_NO_ERROR)
+        return false ;
+
+#ifdef __linux__
+    for(const auto &devPath : devicePaths)
+    {
+        int fd = ::open(devPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0)
+            continue ;
+
+        unsigned char descriptor[18] = {0} ;
+        ssize_t size = read(fd, descriptor, sizeof(descriptor));
+        ::close(fd);
+        if((size == sizeof(descriptor)) && ((descriptor[8] | (descriptor[9] << 8)) == vendorId) && ((descriptor[10] | (descriptor[11] << 8)) == productId))
+            return true ;
+    }
+#else
+    (void)vendorId ;
+    (void)productId ;
+#endif
+
+    return false ;
+}
+
+/**
+ * @brief DfuDevice::getDeviceInfo
+ * @return The identity and the cached descriptors of the opened device.
+ */
+DfuDeviceInfo DfuDevice::getDeviceInfo() const
+{
+    DfuDeviceInfo info ;
+    info.serialNumber = serialNumber ;
+    info.busNumber = busNumber ;
+    info.deviceNumber = deviceNumber ;
+    info.portPath = portPath ;
+    info.altSettings = altSettings ;
+    info.descriptorStrings = descriptorStrings ;
+    return info ;
+}
+
+/**
+ * @brief DfuDevice::getDevicePaths : List the usbfs device nodes (/dev/bus/usb/BBB/DDD).
+ * @param devicePaths: Output list of device node paths.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuDevice::getDevicePaths(std::vector<std::string> &devicePaths)
+{
+    devicePaths.clear();
+
+#ifdef __linux__
+    DIR *busDir = opendir("/dev/bus/usb");
+    if(busDir == nullptr)
+        return TOOLBOX_DFU_ERROR_INTERFACE_NOT_SUPPORTED ;
+
+    struct dirent *busEntry ;
+    while((busEntry = readdir(busDir)) != nullptr)
+    {
+        if(busEntry->d_name[0] == '.')
+            continue ;
+
+        std::string busPath = std::string("/dev/bus/usb/") + busEntry->d_name ;
+        DIR *devDir = opendir(busPath.c_str());
+        if(devDir == nullptr)
+            continue ;
+
+        struct dirent *devEntry ;
+        while((devEntry = readdir(devDir)) != nullptr)
+        {
+            if(devEntry->d_name[0] != '.')
+                devicePaths.push_back(busPath + "/" + devEntry->d_name);
+        }
+        closedir(devDir);
+    }
+    closedir(busDir);
+
+    std::sort(devicePaths.begin(), devicePaths.end());
+    return TOOLBOX_DFU_NO_ERROR ;
+#else
+    return TOOLBOX_DFU_ERROR_INTERFACE_NOT_SUPPORTED ;
+#endif
+}
+
+/**
+ * @brief DfuDevice::openPath : Open one usbfs node and cache its descriptors and strings, the interface is not claimed.
+ * @param devPath: The usbfs node path.
+ * @param vendorId: USB vendor ID to match.
+ * @param productId: USB product ID to match.
+ * @return 0 if a DFU device is opened, TOOLBOX_DFU_ERROR_CONNECTION if it matches but is not writable, otherwise TOOLBOX_DFU_ERROR_NO_DEVICE.
+ */
+int DfuDevice::openPath(const std::string &devPath, uint16_t vendorId, uint16_t productId)
+{
+    close();
+
+#ifdef __linux__
+    bool isReadOnly = false ;
+    int fd = ::open(devPath.c_str(), O_RDWR | O_CLOEXEC);
+    if(fd < 0)
+    {
+        /* Descriptors stay readable without write access, it helps to report a permission issue */
+        isReadOnly = true ;
+        fd = ::open(devPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0)
+            return TOOLBOX_DFU_ERROR_NO_DEVICE ;
+    }
+
+    /* usbfs returns the device descriptor followed by the raw configuration descriptors */
+    std::vector<unsigned char> descriptors(4096) ;
+    ssize_t size = read(fd, descriptors.data(), descriptors.size());
+    if((size < 18) || (descriptors[1] != USB_DT_DEVICE) ||
+       ((descriptors[8] | (descriptors[9] << 8)) != vendorId) || ((descriptors[10] | (descriptors[11] << 8)) != productId))
+    {
+        ::close(fd);
+        return TOOLBOX_DFU_ERROR_NO_DEVICE ;
+    }
+
+    if(isReadOnly)
+    {
+        ::close(fd);
+        return TOOLBOX_DFU_ERROR_CONNECTION ;
+    }
+
+    fileDescriptor = fd ;
+    if(parseDescriptors(descriptors.data(), size) != TOOLBOX_DFU_NO_ERROR)
+    {
+        close();
+        return TOOLBOX_DFU_ERROR_NO_DEVICE ;
+    }
+
+    size_t separator = devPath.find_last_of('/') ;
+    busNumber = std::atoi(devPath.substr(separator - 3, 3).c_str()) ;
+    deviceNumber = std::atoi(devPath.substr(separator + 1).c_str()) ;
+    portPath = SysfsUsb::findPortPath(busNumber, deviceNumber) ;
+
+    if(getStringDescriptor(descriptors[16], serialNumber) != TOOLBOX_DFU_NO_ERROR)
+        serialNumber = "UNKNOWN" ;
+
+    /* Cache the strings once: alternate setting names and the device descriptor strings */
+    for(auto &altSetting : altSettings)
+    {
+        if(getStringDescriptor(interfaceStringIndexes.at(altSetting.alt), altSetting.name) != TOOLBOX_DFU_NO_ERROR)
+            altSetting.name = "UNKNOWN" ;
+        descriptorStrings.push_back(altSetting.name);
+    }
+    for(uint8_t index : {descriptors[14], descriptors[15]})
+    {
+        std::string str ;
+        if(getStringDescriptor(index, str) == TOOLBOX_DFU_NO_ERROR)
+            descriptorStrings.push_back(std::move(str));
+    }
+
+    return TOOLBOX_DFU_NO_ERROR ;
+#else
+    (void)devPath ;
+    (void)vendorId ;
+    (void)productId ;
+    return TOOLBOX_DFU_ERROR_INTERFACE_NOT_SUPPORTED ;
+#endif
+}
+
+/**
+ * @brief DfuDevice::close : Release the DFU interface and close the device handle.
+ */
+void DfuDevice::close()
+{
+#ifdef __linux__
+    if(fileDescriptor >= 0)
+    {
+        unsigned int interface = interfaceNumber ;
+        ioctl(fileDescriptor, USBDEVFS_RELEASEINTERFACE, &interface);
+        ::close(fileDescriptor);
+    }
+#endif
+    fileDescriptor = -1 ;
+    currentAlt = -1 ;
+    serialNumber.clear();
+    portPath.clear();
+    altSettings.clear();
+    descriptorStrings.clear();
+    interfaceStringIndexes.clear();
+}
+
+/**
+ * @brief DfuDevice::isOpen
+ * @return True if a device handle is held, otherwise false.
+ */
+bool DfuDevice::isOpen() const
+{
+    return (fileDescriptor >= 0) ;
+}
+
+/**
+ * @brief DfuDevice::isAlive : Check that the held handle still refers to an enumerated device.
+ * @return True if the device is still connected, otherwise false and the handle is released.
+ */
+bool DfuDevice::isAlive()
+{
+    if(isOpen() == false)
+        return false ;
+
+#ifdef __linux__
+    struct usbdevfs_connectinfo info ;
+    if(ioctl(fileDescriptor, USBDEVFS_CONNECTINFO, &info) < 0)
+    {
+        close();
+        return false ;
+    }
+#endif
+
+    return true ;
+}
+
+/**
+ * @brief DfuDevice::download : Send a firmware to an alternate setting (DFU_DNLOAD sequence).
+ * @param alt: The alternate setting index of the target partition.
+ * @param data: The buffer to download.
+ * @param size: Number of bytes to download.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuDevice::download(uint8_t alt, const unsigned char *data, size_t size)
+{
+    int ret = setAlternateSetting(alt) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    isBlockSent = false ;
+    ret = prepareIdleState() ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    size_t offset = 0 ;
+    uint16_t blockNumber = 0 ;
+    while(offset < size)
+    {
+        uint16_t chunkSize = (size - offset) > transferSize ? transferSize : (uint16_t)(size - offset) ;
+        isBlockSent = true ;
+        if(controlTransfer(DFU_REQUEST_TYPE_OUT, DFU_REQUEST_DNLOAD, blockNumber, interfaceNumber, const_cast<unsigned char*>(data + offset), chunkSize) != chunkSize)
+        {
+            displayManager.print(MSG_ERROR, L"DFU download failed at offset %lu : %s", (unsigned long)offset, strerror(errno)) ;
+            ret = mapTransferError() ;
+            return (ret == TOOLBOX_DFU_ERROR_OTHER) ? TOOLBOX_DFU_ERROR_WRITE : ret ;
+        }
+
+        ret = waitWhileBusy() ;
+        if(ret != TOOLBOX_DFU_NO_ERROR)
+            return ret ;
+
+        offset += chunkSize ;
+        blockNumber++ ;
+        DisplayManager::reportProgress(alt, offset, size) ;
+    }
+
+    return finishDownload(blockNumber) ;
+}
+
+/**
+ * @brief DfuDevice::download : Send a firmware produced while it is transferred to an alternate setting (DFU_DNLOAD sequence).
+ * @param alt: The alternate setting index of the target partition.
+ * @param reader: The producer of the bytes, read by blocks of the transfer size.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred. A producer error after the first
+ * block aborts the download sequence.
+ */
+int DfuDevice::download(uint8_t alt, const DownloadReader &reader)
+{
+    int ret = setAlternateSetting(alt) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    isBlockSent = false ;
+    ret = prepareIdleState() ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    std::vector<unsigned char> chunk(transferSize) ;
+    uint64_t offset = 0 ;
+    uint16_t blockNumber = 0 ;
+    bool isEnd = false ;
+    while(isEnd == false)
+    {
+        /* Full blocks until the end of the data */
+        size_t chunkSize = 0 ;
+        while(chunkSize < chunk.size())
+        {
+            size_t size = 0 ;
+            ret = reader(chunk.data() + chunkSize, chunk.size() - chunkSize, &size) ;
+            if(ret != TOOLBOX_DFU_NO_ERROR)
+            {
+                /* The device waits for the next block, it is brought back to dfuIDLE */
+                if(blockNumber != 0)
+                    abort() ;
+                return ret ;
+            }
+            if(size == 0)
+            {
+                isEnd = true ;
+                break ;
+            }
+            chunkSize += size ;
+        }
+
+        if(chunkSize == 0)
+            break ;
+
+        isBlockSent = true ;
+        if(controlTransfer(DFU_REQUEST_TYPE_OUT, DFU_REQUEST_DNLOAD, blockNumber, interfaceNumber, chunk.data(), (uint16_t)chunkSize) != (int)chunkSize)
+        {
+            displayManager.print(MSG_ERROR, L"DFU download failed at offset %llu : %s", (unsigned long long)offset, strerror(errno)) ;
+            ret = mapTransferError() ;
+            return (ret == TOOLBOX_DFU_ERROR_OTHER) ? TOOLBOX_DFU_ERROR_WRITE : ret ;
+        }
+
+        ret = waitWhileBusy() ;
+        if(ret != TOOLBOX_DFU_NO_ERROR)
+            return ret ;
+
+        offset += chunkSize ;
+        blockNumber++ ;
+        DisplayManager::reportProgress(alt, offset, 0) ;
+    }
+
+    return finishDownload(blockNumber) ;
+}
+
+/**
+ * @brief DfuDevice::finishDownload : End a DFU_DNLOAD sequence and let the device manifest the firmware.
+ * @param blockNumber: The block number following the last data block.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuDevice::finishDownload(uint16_t blockNumber)
+{
+    int ret = TOOLBOX_DFU_NO_ERROR ;
+
+    /* A zero length DFU_DNLOAD marks the end of the transfer */
+    if(controlTransfer(DFU_REQUEST_TYPE_OUT, DFU_REQUEST_DNLOAD, blockNumber, interfaceNumber, nullptr, 0) < 0)
+    {
+        displayManager.print(MSG_ERROR, L"DFU download failed to send the end of transfer : %s", strerror(errno)) ;
+        ret = mapTransferError() ;
+        return (ret == TOOLBOX_DFU_ERROR_OTHER) ? TOOLBOX_DFU_ERROR_WRITE : ret ;
+    }
+
+    /* The device may reset or re-enumerate before answering, but a status it gives is checked */
+    DfuStatus status ;
+    for(uint8_t retry = 0 ; retry < 10 ; retry++)
+    {
+        if(getStatus(&status) != TOOLBOX_DFU_NO_ERROR)
+            break ;
+
+        if((status.bState == DFU_STATE_ERROR) || (status.bStatus != DFU_STATUS_OK))
+        {
+            displayManager.print(MSG_ERROR, L"DFU manifestation failed : state(%u) = %s, status(%u)", status.bState, getStateName(status.bState), status.bStatus) ;
+            clearStatus();
+            return TOOLBOX_DFU_ERROR_WRITE ;
+        }
+
+        if((status.bState != DFU_STATE_MANIFEST_SYNC) && (status.bState != DFU_STATE_MANIFEST))
+            break ;
+        std::this_thread::sleep_for(std::chrono::milliseconds(status.bwPollTimeout));
+    }
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief DfuDevice::upload : Read the content of an alternate setting (DFU_UPLOAD sequence).
+ * @param alt: The alternate setting index of the partition to read.
+ * @param data: Output buffer receiving the uploaded bytes.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuDevice::upload(uint8_t alt, std::vector<unsigned char> &data)
+{
+    int ret = setAlternateSetting(alt) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    ret = prepareIdleState() ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    data.clear();
+    uint16_t blockNumber = 0 ;
+    while(true)
+    {
+        size_t offset = data.size() ;
+        data.resize(offset + transferSize);
+        int received = controlTransfer(DFU_REQUEST_TYPE_IN, DFU_REQUEST_UPLOAD, blockNumber, interfaceNumber, data.data() + offset, transferSize) ;
+        if(received < 0)
+        {
+            displayManager.print(MSG_ERROR, L"DFU upload failed at offset %lu : %s", (unsigned long)offset, strerror(errno)) ;
+            data.resize(offset);
+            ret = mapTransferError() ;
+            return (ret == TOOLBOX_DFU_ERROR_OTHER) ? TOOLBOX_DFU_ERROR_READ : ret ;
+        }
+
+        data.resize(offset + received);
+        DisplayManager::reportProgress(alt, data.size(), 0) ;
+        if(received < transferSize) // A short frame ends the upload
+            break ;
+
+        blockNumber++ ;
+    }
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief DfuDevice::detach : Request the device to leave the DFU mode, then release the handle.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuDevice::detach()
+{
+    if(isOpen() == false)
+        return TOOLBOX_DFU_ERROR_NOT_CONNECTED ;
+
+    /* Like dfu-util, a refused detach is not fatal: the device may already be leaving */
+    if(controlTransfer(DFU_REQUEST_TYPE_OUT, DFU_REQUEST_DETACH, DFU_DETACH_TIMEOUT_MS, interfaceNumber, nullptr, 0) < 0)
+        displayManager.print(MSG_WARNING, L"DFU device can't detach : %s", strerror(errno)) ;
+
+#ifdef __linux__
+    if((dfuAttributes & DFU_ATTR_WILL_DETACH) == 0)
+        ioctl(fileDescriptor, USBDEVFS_RESET, 0);
+#endif
+
+    close();
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief DfuDevice::getStatus : Send a DFU_GETSTATUS request.
+ * @param status: Output structure filled with the device answer.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuDevice::getStatus(DfuStatus *status)
+{
+    unsigned char buffer[6] = {0} ;
+    if(controlTransfer(DFU_REQUEST_TYPE_IN, DFU_REQUEST_GETSTATUS, 0, interfaceNumber, buffer, sizeof(buffer)) != sizeof(buffer))
+        return mapTransferError() ;
+
+    status->bStatus = buffer[0] ;
+    status->bwPollTimeout = buffer[1] | (buffer[2] << 8) | (buffer[3] << 16) ;
+    status->bState = buffer[4] ;
+    status->iString = buffer[5] ;
+    lastStatus = *status ;
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief DfuDevice::clearStatus : Send a DFU_CLRSTATUS request to leave the dfuERROR state.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuDevice::clearStatus()
+{
+    if(controlTransfer(DFU_REQUEST_TYPE_OUT, DFU_REQUEST_CLRSTATUS, 0, interfaceNumber, nullptr, 0) < 0)
+        return mapTransferError() ;
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief DfuDevice::isDownloadStarted
+ * @return True if the last download sent a data block, so it cannot be restarted safely after a failure.
+ */
+bool DfuDevice::isDownloadStarted() const
+{
+    return isBlockSent ;
+}
+
+/**
+ * @brief DfuDevice::abort : Send a DFU_ABORT request to go back to the dfuIDLE state.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuDevice::abort()
+{
+    if(controlTransfer(DFU_REQUEST_TYPE_OUT, DFU_REQUEST_ABORT, 0, interfaceNumber, nullptr, 0) < 0)
+        return mapTransferError() ;
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief DfuDevice::findDeviceIdString : Extract the device ID from a string like "DFU in HS Mode @Device ID /0x505, @Revision ID /0x2000".
+ * @param descriptorString: The product string descriptor.
+ * @param deviceIdString: Output string following the "@Device ID /" pattern.
+ * @return True if the pattern is found, otherwise false.
+ */
+bool DfuDevice::findDeviceIdString(const std::string &descriptorString, std::string &deviceIdString)
+{
+    std::string searchString = "@Device ID /";
+    size_t pos = descriptorString.find(searchString);
+    if(pos == std::string::npos)
+        return false ;
+
+    deviceIdString = descriptorString.substr(pos + searchString.length(), 5) ;
+    return true ;
+}
+
+/**
+ * @brief DfuDevice::parseAlternateName : Split an alternate setting name like "@virtual /0xF1/1*512Ba".
+ * @param rawName: The alternate setting string descriptor.
+ * @param name: Output partition name without the '@' prefix.
+ * @param partID: Output partition ID.
+ * @return True if the name follows the STM32 format, otherwise false.
+ */
+bool DfuDevice::parseAlternateName(const std::string &rawName, std::string &name, int &partID)
+{
+    size_t pos = 0 ;
+    if((rawName.size() < 2) || (rawName.at(pos++) != '@'))
+        return false ;
+
+    size_t nameStart = pos ;
+    while((pos < rawName.size()) && (isspace((unsigned char)rawName.at(pos)) == 0) && (rawName.at(pos) != '/'))
+        pos++ ;
+    if(pos == nameStart)
+        return false ;
+    name = rawName.substr(nameStart, pos - nameStart) ;
+
+    while((pos < rawName.size()) && isspace((unsigned char)rawName.at(pos)))
+        pos++ ;
+    if((rawName.compare(pos, 3, "/0x") != 0) && (rawName.compare(pos, 3, "/0X") != 0))
+        return false ;
+    pos += 3 ;
+
+    size_t idStart = pos ;
+    while((pos < rawName.size()) && isxdigit((unsigned char)rawName.at(pos)))
+        pos++ ;
+    if(pos == idStart)
+        return false ;
+
+    partID = std::stoi(rawName.substr(idStart, pos - idStart), nullptr, 16) ;
+    return true ;
+}
+
+/**
+ * @brief DfuDevice::controlTransfer : Perform a synchronous control transfer on the default endpoint.
+ * @return The number of transferred bytes, otherwise a negative value and errno is set.
+ */
+int DfuDevice::controlTransfer(uint8_t requestType, uint8_t request, uint16_t value, uint16_t index, unsigned char *data, uint16_t length)
+{
+    if(isOpen() == false)
+    {
+        errno = ENODEV ;
+        return -1 ;
+    }
+
+#ifdef __linux__
+    struct usbdevfs_ctrltransfer transfer ;
+    transfer.bRequestType = requestType ;
+    transfer.bRequest = request ;
+    transfer.wValue = value ;
+    transfer.wIndex = index ;
+    transfer.wLength = length ;
+    transfer.timeout = DFU_CONTROL_TIMEOUT_MS ;
+    transfer.data = data ;
+
+    return ioctl(fileDescriptor, USBDEVFS_CONTROL, &transfer) ;
+#else
+    (void)requestType ;
+    (void)request ;
+    (void)value ;
+    (void)index ;
+    (void)data ;
+    (void)length ;
+    errno = ENOSYS ;
+    return -1 ;
+#endif
+}
+
+/**
+ * @brief DfuDevice::getStringDescriptor : Read a string descriptor and convert it to ASCII.
+ * @param index: The string descriptor index, 0 means no string.
+ * @param outString: Output string.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuDevice::getStringDescriptor(uint8_t index, std::string &outString)
+{
+    outString.clear();
+    if(index == 0)
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+
+    /* The first language ID is used, as libusb_get_string_descriptor_ascii does */
+    unsigned char buffer[255] = {0} ;
+    int length = controlTransfer(0x80, USB_REQ_GET_DESCRIPTOR, (USB_DT_STRING << 8), 0, buffer, sizeof(buffer)) ;
+    if((length < 4) || (buffer[1] != USB_DT_STRING))
+        return TOOLBOX_DFU_ERROR_READ ;
+    uint16_t langId = buffer[2] | (buffer[3] << 8) ;
+
+    length = controlTransfer(0x80, USB_REQ_GET_DESCRIPTOR, (USB_DT_STRING << 8) | index, langId, buffer, sizeof(buffer)) ;
+    if((length < 2) || (buffer[1] != USB_DT_STRING))
+        return TOOLBOX_DFU_ERROR_READ ;
+
+    length = (buffer[0] < length) ? buffer[0] : length ;
+    for(int idx = 2 ; idx + 1 < length ; idx += 2)
+        outString.push_back((buffer[idx + 1] == 0) ? (char)buffer[idx] : '?');
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief DfuDevice::parseDescriptors : Locate the DFU interface and its functional descriptor.
+ * @param data: Device descriptor followed by the configuration descriptors.
+ * @param size: Size of the descriptors buffer.
+ * @return 0 if a DFU interface is found, otherwise an error occurred.
+ */
+int DfuDevice::parseDescriptors(const unsigned char *data, size_t size)
+{
+    bool isDfuInterface = false ;
+    bool isFirstConfig = true ;
+    int dfuInterfaceNumber = -1 ;
+
+    for(size_t pos = data[0] ; (pos + 2 <= size) && (data[pos] >= 2) ; pos += data[pos])
+    {
+        const unsigned char *desc = data + pos ;
+        if((pos + desc[0]) > size)
+            break ;
+
+        if(desc[1] == USB_DT_CONFIG)
+        {
+            if(isFirstConfig == false) // Only the first configuration is used
+                break ;
+            isFirstConfig = false ;
+        }
+        else if((desc[1] == USB_DT_INTERFACE) && (desc[0] >= 9))
+        {
+            isDfuInterface = (desc[5] == USB_CLASS_APP_SPECIFIC) && (desc[6] == USB_SUBCLASS_DFU) &&
+                             ((dfuInterfaceNumber < 0) || (dfuInterfaceNumber == desc[2])) ;
+            if(isDfuInterface)
+            {
+                dfuInterfaceNumber = desc[2] ;
+                DfuAltSetting altSetting ;
+                altSetting.alt = desc[3] ;
+                altSettings.push_back(altSetting);
+                if(interfaceStringIndexes.size() <= desc[3])
+                    interfaceStringIndexes.resize(desc[3] + 1, 0);
+                interfaceStringIndexes[desc[3]] = desc[8] ;
+            }
+        }
+        else if((desc[1] == USB_DT_DFU_FUNCTIONAL) && isDfuInterface && (desc[0] >= 7))
+        {
+            dfuAttributes = desc[2] ;
+            transferSize = desc[5] | (desc[6] << 8) ;
+            if(transferSize == 0)
+                transferSize = DFU_DEFAULT_TRANSFER_SIZE ;
+        }
+    }
+
+    if(dfuInterfaceNumber < 0)
+        return TOOLBOX_DFU_ERROR_NOT_SUPPORTED ;
+
+    interfaceNumber = dfuInterfaceNumber ;
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief DfuDevice::setAlternateSetting : Select the alternate setting of the DFU interface.
+ * @param alt: The alternate setting index.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuDevice::setAlternateSetting(uint8_t alt)
+{
+    if(isOpen() == false)
+        return TOOLBOX_DFU_ERROR_NOT_CONNECTED ;
+
+    if(currentAlt == alt)
+        return TOOLBOX_DFU_NO_ERROR ;
+
+#ifdef __linux__
+    struct usbdevfs_setinterface setting ;
+    setting.interface = interfaceNumber ;
+    setting.altsetting = alt ;
+    if(ioctl(fileDescriptor, USBDEVFS_SETINTERFACE, &setting) < 0)
+    {
+        displayManager.print(MSG_ERROR, L"Cannot set alternate setting %d : %s", alt, strerror(errno)) ;
+        return mapTransferError() ;
+    }
+#endif
+
+    currentAlt = alt ;
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief DfuDevice::prepareIdleState : Bring the device back to dfuIDLE before a new transfer.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuDevice::prepareIdleState()
+{
+    DfuStatus status ;
+    int ret = getStatus(&status) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    switch(status.bState)
+    {
+    case DFU_STATE_APP_IDLE:
+    case DFU_STATE_APP_DETACH:
+        displayManager.print(MSG_ERROR, L"DFU device is still in runtime mode !") ;
+        return TOOLBOX_DFU_ERROR_NOT_SUPPORTED ;
+    case DFU_STATE_ERROR:
+        ret = clearStatus() ;
+        break;
+    case DFU_STATE_DNLOAD_IDLE:
+    case DFU_STATE_UPLOAD_IDLE:
+        ret = abort() ;
+        break;
+    default:
+        break;
+    }
+
+    return ret ;
+}
+
+/**
+ * @brief DfuDevice::waitWhileBusy : Poll DFU_GETSTATUS until the last block is processed, at most DFU_BUSY_TIMEOUT_MS.
+ * @return 0 if the device accepted the block, otherwise an error occurred.
+ */
+int DfuDevice::waitWhileBusy()
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(DFU_BUSY_TIMEOUT_MS) ;
+    DfuStatus status ;
+    while(true)
+    {
+        int ret = getStatus(&status) ;
+        if(ret != TOOLBOX_DFU_NO_ERROR)
+            return ret ;
+
+        if((status.bState != DFU_STATE_DNLOAD_SYNC) && (status.bState != DFU_STATE_DNBUSY))
+            break ;
+
+        if(std::chrono::steady_clock::now() >= deadline)
+        {
+            displayManager.print(MSG_ERROR, L"DFU device still busy after %u ms : state(%u) = %s", DFU_BUSY_TIMEOUT_MS, status.bState, getStateName(status.bState)) ;
+            return TOOLBOX_DFU_ERROR_TIMEOUT ;
+        }
+
+        /* A poll timeout of 0 would turn the wait into a busy loop */
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::max<uint32_t>(status.bwPollTimeout, DFU_BUSY_MIN_POLL_MS)));
+    }
+
+    bool isExpectedState = (status.bState == DFU_STATE_DNLOAD_IDLE) || (status.bState == DFU_STATE_MANIFEST) ;
+    if((isExpectedState == false) || (status.bStatus != DFU_STATUS_OK))
+    {
+        displayManager.print(MSG_ERROR, L"DFU device error : state(%u) = %s, status(%u)", status.bState, getStateName(status.bState), status.bStatus) ;
+        if(status.bState == DFU_STATE_ERROR)
+            clearStatus();
+        return TOOLBOX_DFU_ERROR_WRITE ;
+    }
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief DfuDevice::mapTransferError : Translate the errno of a failed transfer into a toolbox error.
+ * @return TOOLBOX_DFU_ERROR_NOT_CONNECTED if the device is gone (the handle is released), otherwise TOOLBOX_DFU_ERROR_OTHER.
+ */
+int DfuDevice::mapTransferError()
+{
+    if((errno == ENODEV) || (errno == ESHUTDOWN))
+    {
+        close();
+        return TOOLBOX_DFU_ERROR_NOT_CONNECTED ;
+    }
+
+    return TOOLBOX_DFU_ERROR_OTHER ;
+}
+
+/**
+ * @brief DfuDevice::getStateName
+ * @return The DFU 1.1 name of a device state.
+ */
+const char* DfuDevice::getStateName(uint8_t state)
+{
+    static const char* names[] = {"appIDLE", "appDETACH", "dfuIDLE", "dfuDNLOAD-SYNC", "dfuDNBUSY", "dfuDNLOAD-IDLE",
+                                  "dfuMANIFEST-SYNC", "dfuMANIFEST", "dfuMANIFEST-WAIT-RESET", "dfuUPLOAD-IDLE", "dfuERROR"} ;
+    return (state <= DFU_STATE_ERROR) ? names[state] : "unknown" ;
+}
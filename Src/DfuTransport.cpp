@@ -0,0 +1,195 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "DfuTransport.h"
+#include "DfuUtilTransport.h"
+#include "UsbDfuTransport.h"
+#include "MockDfuTransport.h"
+#include "DisplayManager.h"
+#include <cstdlib>
+#include <algorithm>
+#include <fstream>
+
+static bool isDefaultBackendSet = false ;
+static DFU_BACKEND defaultBackend = DFU_BACKEND_AUTO ;
+
+/**
+ * @brief DfuTransport::create : Instantiate the transport implementing a backend.
+ * @param backend: The selected backend.
+ * @param toolboxFolder: The toolbox root path, used to locate the embedded utilities.
+ * @param serialNumber: The serial number of the selected device, empty for the first device found.
+ * @return The transport, owned by the caller.
+ */
+std::unique_ptr<DfuTransport> DfuTransport::create(DFU_BACKEND backend, const std::string &toolboxFolder, const std::string &serialNumber)
+{
+    switch(backend)
+    {
+    case DFU_BACKEND_DFU_UTIL:
+        return std::unique_ptr<DfuTransport>(new DfuUtilTransport(toolboxFolder, serialNumber));
+    case DFU_BACKEND_USB:
+        return std::unique_ptr<DfuTransport>(new UsbDfuTransport(serialNumber));
+    case DFU_BACKEND_MOCK:
+        return std::unique_ptr<DfuTransport>(new MockDfuTransport(serialNumber));
+    case DFU_BACKEND_AUTO:
+    default:
+#ifdef __linux__
+        return std::unique_ptr<DfuTransport>(new UsbDfuTransport(serialNumber, std::unique_ptr<DfuTransport>(new DfuUtilTransport(toolboxFolder, serialNumber))));
+#else
+        return std::unique_ptr<DfuTransport>(new DfuUtilTransport(toolboxFolder, serialNumber));
+#endif
+    }
+}
+
+/**
+ * @brief DfuTransport::listFastbootDevices : List the ST Fastboot devices from sysfs, otherwise report a single device of unknown identity.
+ * @param devices: Output list of devices, without alternate settings.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuTransport::listFastbootDevices(std::vector<DfuDeviceInfo> &devices)
+{
+    devices.clear();
+
+    std::vector<SysfsUsbDevice> sysfsDevices ;
+    if(SysfsUsb::enumerate(ST_USB_VENDOR_ID, ST_FASTBOOT_PRODUCT_ID, sysfsDevices) != 0)
+    {
+        if(isFastbootDevicePresent())
+        {
+            DfuDeviceInfo device ;
+            device.serialNumber = "UNKNOWN" ;
+            device.busNumber = 0 ;
+            device.deviceNumber = 0 ;
+            devices.push_back(device);
+        }
+        return TOOLBOX_DFU_NO_ERROR ;
+    }
+
+    for(const auto &sysfsDevice : sysfsDevices)
+    {
+        DfuDeviceInfo device ;
+        device.serialNumber = sysfsDevice.serialNumber ;
+        device.busNumber = sysfsDevice.busNumber ;
+        device.deviceNumber = sysfsDevice.deviceNumber ;
+        device.portPath = sysfsDevice.portPath ;
+        device.descriptorStrings.push_back(sysfsDevice.product);
+        devices.push_back(device);
+    }
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief DfuTransport::downloadFromReader : Download the bytes of a producer, for the transports which cannot stream
+ * them the whole data is first gathered in memory.
+ * @param alternateIndex: The alternate setting index of the target partition.
+ * @param reader: The producer of the bytes.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuTransport::downloadFromReader(uint8_t alternateIndex, const DownloadReader &reader)
+{
+    std::vector<unsigned char> data ;
+    size_t size = 0 ;
+    do
+    {
+        data.resize(data.size() + DOWNLOAD_READ_SIZE) ;
+        int ret = reader(data.data() + data.size() - DOWNLOAD_READ_SIZE, DOWNLOAD_READ_SIZE, &size) ;
+        data.resize(data.size() - DOWNLOAD_READ_SIZE + size) ;
+        if(ret != TOOLBOX_DFU_NO_ERROR)
+            return ret ;
+    } while(size != 0) ;
+
+    return downloadFromMemory(alternateIndex, data.data(), data.size()) ;
+}
+
+/**
+ * @brief DfuTransport::parseBackendName : Convert a backend name (auto, dfu-util, usb, mock) to its value.
+ * @param name: The backend name, case insensitive.
+ * @param backend: Output backend value.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuTransport::parseBackendName(const std::string &name, DFU_BACKEND *backend)
+{
+    std::string lowerName = name ;
+    std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), ::tolower);
+
+    if(lowerName == "auto")
+        *backend = DFU_BACKEND_AUTO ;
+    else if((lowerName == "dfu-util") || (lowerName == "dfuutil"))
+        *backend = DFU_BACKEND_DFU_UTIL ;
+    else if(lowerName == "usb")
+        *backend = DFU_BACKEND_USB ;
+    else if(lowerName == "mock")
+        *backend = DFU_BACKEND_MOCK ;
+    else
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief DfuTransport::setDefaultBackend : Select the backend used by the next DFU instances (--backend option).
+ * @param backend: The selected backend.
+ */
+void DfuTransport::setDefaultBackend(DFU_BACKEND backend)
+{
+    defaultBackend = backend ;
+    isDefaultBackendSet = true ;
+}
+
+/**
+ * @brief DfuTransport::getDefaultBackend : Get the backend selected by the command line, then by the PRG_TOOLBOX_DFU_BACKEND variable.
+ * @return The backend to use.
+ */
+DFU_BACKEND DfuTransport::getDefaultBackend()
+{
+    if(isDefaultBackendSet)
+        return defaultBackend ;
+
+    DFU_BACKEND backend = DFU_BACKEND_AUTO ;
+    const char* envBackend = std::getenv("PRG_TOOLBOX_DFU_BACKEND");
+    if((envBackend != nullptr) && (parseBackendName(envBackend, &backend) != TOOLBOX_DFU_NO_ERROR))
+        backend = DFU_BACKEND_AUTO ;
+
+    return backend ;
+}
+
+/**
+ * @brief DfuTransport::writeFile : Save the uploaded data into the output file of an upload.
+ * @param filePath: The output binary file, it may be surrounded by double quotes.
+ * @param data: The uploaded bytes.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuTransport::writeFile(const std::string &filePath, const std::vector<unsigned char> &data)
+{
+    std::string path = filePath ;
+    path.erase(std::remove(path.begin(), path.end(), '\"'), path.end()) ; //remove the double quotes from the file path
+    std::ofstream file(path, std::ios::binary | std::ios::out | std::ios::trunc);
+    if(file.is_open() == false)
+    {
+        DisplayManager::getInstance().print(MSG_ERROR, L"Could not open the output file : %s", filePath.c_str());
+        return TOOLBOX_DFU_ERROR_NO_FILE ;
+    }
+
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    file.close();
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
@@ -0,0 +1,405 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "DfuUtilOutputParser.h"
+#include <cstring>
+#include <cctype>
+
+DfuUtilOutputParser::DfuUtilOutputParser()
+{
+    reset();
+}
+
+/**
+ * @brief DfuUtilOutputParser::setEventCallback : Receive each event as soon as its line is complete.
+ * @param callback: Function called with the parsed event.
+ */
+void DfuUtilOutputParser::setEventCallback(std::function<void(const DfuOutputEvent&)> callback)
+{
+    eventCallback = callback ;
+}
+
+/**
+ * @brief DfuUtilOutputParser::reset : Forget the pending line and the transfer status before a new command.
+ */
+void DfuUtilOutputParser::reset()
+{
+    pendingLine.clear();
+    isDownloadCompleted = false ;
+    isUploadCompleted = false ;
+    isErrorFound = false ;
+    transferSize = 0 ;
+    transferredBytes = 0 ;
+    lastError.clear();
+}
+
+/**
+ * @brief DfuUtilOutputParser::feed : Parse a chunk of raw output, the incomplete last line is kept for the next chunk.
+ * @param data: The output bytes.
+ * @param size: Number of bytes.
+ */
+void DfuUtilOutputParser::feed(const char *data, size_t size)
+{
+    const char *end = data + size ;
+    const char *lineStart = data ;
+    for(const char *cursor = data; cursor < end; cursor++)
+    {
+        if((*cursor != '\n') && (*cursor != '\r'))
+            continue ;
+
+        if(pendingLine.empty())
+        {
+            feedLine(lineStart, cursor - lineStart) ;
+        }
+        else
+        {
+            pendingLine.append(lineStart, cursor - lineStart) ;
+            feedLine(pendingLine.data(), pendingLine.size()) ;
+            pendingLine.clear();
+        }
+        lineStart = cursor + 1 ;
+    }
+
+    pendingLine.append(lineStart, end - lineStart) ;
+}
+
+/**
+ * @brief DfuUtilOutputParser::finish : Parse the last line when the output does not end with a new line.
+ */
+void DfuUtilOutputParser::finish()
+{
+    if(pendingLine.empty() == false)
+    {
+        std::string line ;
+        line.swap(pendingLine) ;
+        feedLine(line.data(), line.size()) ;
+    }
+}
+
+void DfuUtilOutputParser::feedLine(const std::string &line)
+{
+    feedLine(line.data(), line.size()) ;
+}
+
+/**
+ * @brief DfuUtilOutputParser::feedLine : Identify a complete line from its first characters and report its event.
+ * @param line: The line without its terminator.
+ * @param length: Length of the line.
+ */
+void DfuUtilOutputParser::feedLine(const char *line, size_t length)
+{
+    while((length > 0) && ((*line == ' ') || (*line == '\t')))
+    {
+        line++ ;
+        length-- ;
+    }
+    if(length == 0)
+        return ;
+
+    DfuOutputEvent event = DfuOutputEvent() ;
+    switch(line[0])
+    {
+    case 'F':
+        if(startsWith(line, length, "Found DFU: ["))
+            parseFoundLine(line, length) ;
+        break;
+    case 'D':
+        if(startsWith(line, length, "Download\t[") || startsWith(line, length, "Download ["))
+        {
+            parseProgressLine(line, length, false) ;
+        }
+        else if(startsWith(line, length, "Download done."))
+        {
+            isDownloadCompleted = true ;
+            event.type = DFU_OUTPUT_DOWNLOAD_DONE ;
+            event.value = transferredBytes ;
+            emit(event) ;
+        }
+        else if(startsWith(line, length, "DFU state("))
+        {
+            parseStateLine(line, length) ;
+        }
+        else if(startsWith(line, length, "Device returned transfer size "))
+        {
+            uint64_t value = 0 ;
+            const char *cursor = line + strlen("Device returned transfer size ") ;
+            if(readNumber(cursor, line + length, value))
+            {
+                transferSize = (uint32_t)value ;
+                event.type = DFU_OUTPUT_TRANSFER_SIZE ;
+                event.value = value ;
+                emit(event) ;
+            }
+        }
+        break;
+    case 'U':
+        if(startsWith(line, length, "Upload\t[") || startsWith(line, length, "Upload ["))
+        {
+            parseProgressLine(line, length, true) ;
+        }
+        else if(startsWith(line, length, "Upload done."))
+        {
+            isUploadCompleted = true ;
+            event.type = DFU_OUTPUT_UPLOAD_DONE ;
+            event.value = transferredBytes ;
+            emit(event) ;
+        }
+        break;
+    case 'd':
+        if(startsWith(line, length, "dfu-util: "))
+        {
+            const char *message = line + strlen("dfu-util: ") ;
+            size_t messageLength = length - strlen("dfu-util: ") ;
+            /* Suffix warnings are printed for every raw binary, they are not errors */
+            if(startsWith(message, messageLength, "Warning") || (findKey(message, messageLength, "DFU suffix") != nullptr))
+                break;
+
+            isErrorFound = true ;
+            lastError.assign(message, messageLength) ;
+            event.type = DFU_OUTPUT_ERROR ;
+            event.text = lastError ;
+            emit(event) ;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief DfuUtilOutputParser::parseFoundLine : Read the fields of a "Found DFU" line.
+ * e.g. Found DFU: [0483:df11] ver=0200, devnum=7, cfg=1, intf=0, path="1-2", alt=1, name="@FSBL /0x01/1*1Me", serial="0025003B..."
+ */
+void DfuUtilOutputParser::parseFoundLine(const char *line, size_t length)
+{
+    const char *end = line + length ;
+    const char *cursor = line + strlen("Found DFU: [") ;
+    uint64_t vendorID = 0 ;
+    uint64_t productID = 0 ;
+    uint64_t deviceNumber = 0 ;
+    uint64_t alternateIndex = 0 ;
+
+    /* Hexadecimal "vvvv:pppp" */
+    auto readHex = [&cursor, end](uint64_t &value) {
+        const char *start = cursor ;
+        value = 0 ;
+        while((cursor < end) && isxdigit((unsigned char)*cursor))
+        {
+            char c = *cursor++ ;
+            value = (value << 4) | (uint64_t)((c <= '9') ? (c - '0') : ((c | 0x20) - 'a' + 10)) ;
+        }
+        return (cursor != start) ;
+    };
+    if((readHex(vendorID) == false) || (cursor >= end) || (*cursor++ != ':') || (readHex(productID) == false))
+        return ;
+
+    DfuOutputEvent event = DfuOutputEvent() ;
+    event.type = DFU_OUTPUT_ALT_SETTING ;
+    if((readKeyNumber(cursor, end - cursor, "devnum=", deviceNumber) == false) ||
+            (readKeyNumber(cursor, end - cursor, "alt=", alternateIndex) == false) ||
+            (readQuoted(cursor, end - cursor, "path=\"", event.path) == false) ||
+            (readQuoted(cursor, end - cursor, "name=\"", event.name) == false) ||
+            (readQuoted(cursor, end - cursor, "serial=\"", event.serialNumber) == false))
+        return ;
+
+    event.vendorID = (uint16_t)vendorID ;
+    event.productID = (uint16_t)productID ;
+    event.deviceNumber = (int)deviceNumber ;
+    event.alternateIndex = (int)alternateIndex ;
+    emit(event) ;
+}
+
+/**
+ * @brief DfuUtilOutputParser::parseProgressLine : Read the percentage and the byte count of a progress bar.
+ * e.g. Download	[=========                ]  36%        16384 bytes
+ */
+void DfuUtilOutputParser::parseProgressLine(const char *line, size_t length, bool isUpload)
+{
+    const char *end = line + length ;
+    const char *cursor = static_cast<const char*>(memchr(line, ']', length)) ;
+    if(cursor == nullptr)
+        return ;
+
+    uint64_t percent = 0 ;
+    uint64_t bytes = 0 ;
+    cursor++ ;
+    if(readNumber(cursor, end, percent) == false)
+        return ;
+    if((cursor < end) && (*cursor == '%'))
+        cursor++ ;
+    if(readNumber(cursor, end, bytes) == false)
+        return ;
+
+    transferredBytes = bytes ;
+    DfuOutputEvent event = DfuOutputEvent() ;
+    event.type = DFU_OUTPUT_PROGRESS ;
+    event.isUpload = isUpload ;
+    event.percent = (int)percent ;
+    event.value = bytes ;
+    emit(event) ;
+}
+
+/**
+ * @brief DfuUtilOutputParser::parseStateLine : Read the DFU state and status reported by the device.
+ * e.g. DFU state(10) = dfuERROR, status(14) = Something went wrong, but the device does not know what it was
+ */
+void DfuUtilOutputParser::parseStateLine(const char *line, size_t length)
+{
+    const char *end = line + length ;
+    const char *cursor = line + strlen("DFU state(") ;
+    uint64_t state = 0 ;
+    uint64_t status = 0 ;
+    if(readNumber(cursor, end, state) == false)
+        return ;
+    if(readKeyNumber(cursor, end - cursor, "status(", status) == false)
+        return ;
+
+    DfuOutputEvent event = DfuOutputEvent() ;
+    event.type = DFU_OUTPUT_STATE ;
+    event.value = state ;
+    event.status = (int)status ;
+    const char *text = findKey(cursor, end - cursor, ") = ") ;
+    if(text != nullptr)
+        event.text.assign(text, end - text) ;
+    emit(event) ;
+
+    if(isErrorState((int)state) || (status != 0))
+    {
+        isErrorFound = true ;
+        lastError = event.text ;
+        DfuOutputEvent error = event ;
+        error.type = DFU_OUTPUT_ERROR ;
+        emit(error) ;
+    }
+}
+
+/**
+ * @brief DfuUtilOutputParser::isErrorState
+ * @param state: DFU state as defined by the DFU 1.1 specification.
+ * @return True for dfuERROR, otherwise false.
+ */
+bool DfuUtilOutputParser::isErrorState(int state)
+{
+    return (state == 10) ;
+}
+
+bool DfuUtilOutputParser::isDownloadDone() const
+{
+    return isDownloadCompleted ;
+}
+
+bool DfuUtilOutputParser::isUploadDone() const
+{
+    return isUploadCompleted ;
+}
+
+bool DfuUtilOutputParser::isErrorReported() const
+{
+    return isErrorFound ;
+}
+
+uint32_t DfuUtilOutputParser::getTransferSize() const
+{
+    return transferSize ;
+}
+
+uint64_t DfuUtilOutputParser::getTransferredBytes() const
+{
+    return transferredBytes ;
+}
+
+const std::string& DfuUtilOutputParser::getLastError() const
+{
+    return lastError ;
+}
+
+void DfuUtilOutputParser::emit(const DfuOutputEvent &event)
+{
+    if(eventCallback)
+        eventCallback(event) ;
+}
+
+bool DfuUtilOutputParser::startsWith(const char *line, size_t length, const char *prefix)
+{
+    size_t prefixLength = strlen(prefix) ;
+    return (length >= prefixLength) && (memcmp(line, prefix, prefixLength) == 0) ;
+}
+
+/**
+ * @brief DfuUtilOutputParser::findKey : Search a key within a line.
+ * @return Pointer to the first character following the key, nullptr if the key is not found.
+ */
+const char* DfuUtilOutputParser::findKey(const char *line, size_t length, const char *key)
+{
+    size_t keyLength = strlen(key) ;
+    if(length < keyLength)
+        return nullptr ;
+
+    const char *last = line + length - keyLength ;
+    for(const char *cursor = line; cursor <= last; cursor++)
+    {
+        cursor = static_cast<const char*>(memchr(cursor, key[0], last - cursor + 1)) ;
+        if(cursor == nullptr)
+            return nullptr ;
+        if(memcmp(cursor, key, keyLength) == 0)
+            return cursor + keyLength ;
+    }
+
+    return nullptr ;
+}
+
+/**
+ * @brief DfuUtilOutputParser::readNumber : Read a decimal number, the leading spaces are skipped.
+ * @return True if at least one digit is read, otherwise false.
+ */
+bool DfuUtilOutputParser::readNumber(const char *&cursor, const char *end, uint64_t &value)
+{
+    while((cursor < end) && ((*cursor == ' ') || (*cursor == '\t')))
+        cursor++ ;
+
+    const char *start = cursor ;
+    value = 0 ;
+    while((cursor < end) && (*cursor >= '0') && (*cursor <= '9'))
+        value = (value * 10) + (uint64_t)(*cursor++ - '0') ;
+
+    return (cursor != start) ;
+}
+
+bool DfuUtilOutputParser::readKeyNumber(const char *line, size_t length, const char *key, uint64_t &value)
+{
+    const char *cursor = findKey(line, length, key) ;
+    return (cursor != nullptr) && readNumber(cursor, line + length, value) ;
+}
+
+bool DfuUtilOutputParser::readQuoted(const char *line, size_t length, const char *key, std::string &value)
+{
+    const char *start = findKey(line, length, key) ;
+    if(start == nullptr)
+        return false ;
+
+    const char *quote = static_cast<const char*>(memchr(start, '\"', line + length - start)) ;
+    if(quote == nullptr)
+        return false ;
+
+    value.assign(start, quote - start) ;
+    return true ;
+}
@@ -0,0 +1,592 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "DfuUtilTransport.h"
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <experimental/filesystem>
+
+std::atomic<bool> DfuUtilTransport::isProgramFound(false) ;
+
+DfuUtilTransport::DfuUtilTransport(const std::string &toolboxFolder, const std::string &serialNumber)
+{
+    this->toolboxFolder = toolboxFolder ;
+    this->dfuSerialNumber = serialNumber ;
+    listedDevice.deviceNumber = -1 ;
+    lastExitCode = 0 ;
+}
+
+const char* DfuUtilTransport::getName() const
+{
+    return "dfu-util" ;
+}
+
+/**
+ * @brief DfuUtilTransport::isAvailable
+ * @return True if dfu-util is already installed on the machine, otherwise, false.
+ * @note PRG-TOOLBOX-DFU includes the dfu-util program within the project for Windows, while it relies on the pre-installed version for Linux and MacOS.
+ * dfu-util is run once per process, the sessions of a long run (fleet, station) skip this probe.
+ */
+bool DfuUtilTransport::isAvailable()
+{
+    if(isProgramFound)
+        return true ;
+
+    std::string cmd =  getDfuUtilProgramPath().append("--version ") ;
+    std::string result = "";
+    if(executeCommand(cmd, result) != TOOLBOX_DFU_NO_ERROR)
+        return false;
+
+    std::string searchString = "not found";
+    size_t pos = result.find(searchString);
+    if ((pos != std::string::npos) || (result.empty()))
+    {
+        displayManager.print(MSG_ERROR, L"dfu-util is not installed or cannot be found. Please install it and try again.") ;
+        displayManager.print(MSG_WARNING, L"refer to: https://dfu-util.sourceforge.net/") ;
+        return false ;
+    }
+    else
+    {
+        isProgramFound = true ;
+        return true ;
+    }
+}
+
+/**
+ * @brief DfuUtilTransport::listDevices : Run "dfu-util -l" and parse the list of STM32 DFU devices.
+ * @param serialNumber: Serial number filter, empty to list all devices.
+ * @param devices: Output list of devices with their alternate settings.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuUtilTransport::listDevices(const std::string &serialNumber, std::vector<DfuDeviceInfo> &devices)
+{
+    devices.clear();
+
+    /* No need to run dfu-util while the device is not plugged */
+    SysfsUsbDevice sysfsDevice ;
+    bool isSysfsAvailable = SysfsUsb::isAvailable() ;
+    if(isSysfsAvailable && (SysfsUsb::findDevice(ST_USB_VENDOR_ID, ST_DFU_PRODUCT_ID, serialNumber, sysfsDevice) == false))
+        return TOOLBOX_DFU_NO_ERROR ;
+
+    if(isSysfsAvailable && (serialNumber == this->dfuSerialNumber))
+        listedDevice = sysfsDevice ;
+
+    std::string  utilCmd =  getDfuUtilProgramPath().append("-d 483:df11 -l") ; /* ST DFU PID:0483 VID:DF11 */
+    if(serialNumber != "")
+        utilCmd.append(" --serial ").append(serialNumber);
+
+    std::string result = "";
+    int ret = executeCommand(utilCmd, result) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    return parseDeviceList(result, devices) ;
+}
+
+/**
+ * @brief DfuUtilTransport::isFastbootDevicePresent : Search a 0483:0afb device from sysfs, otherwise run "lsusb -d 0483:0afb" once.
+ * @return True if an U-Boot in Fastboot mode is detected, otherwise, false.
+ */
+bool DfuUtilTransport::isFastbootDevicePresent()
+{
+    std::vector<SysfsUsbDevice> sysfsDevices ;
+    if(SysfsUsb::enumerate(ST_USB_VENDOR_ID, ST_FASTBOOT_PRODUCT_ID, sysfsDevices) == 0)
+        return (sysfsDevices.empty() == false) ;
+
+    std::string  utilCmd =  getLsUsbProgramPath().append("-d 0483:0afb") ; /* ST Fastboot PID:0483 VID:0AFB */
+    std::string result = "";
+    if(executeCommand(utilCmd, result) != TOOLBOX_DFU_NO_ERROR)
+        return false;
+
+    std::string searchString = "ID 0483:0afb";
+    return (result.find(searchString) != std::string::npos) ;
+}
+
+/**
+ * @brief DfuUtilTransport::readDeviceIdString : Search the "@Device ID /" descriptor in the sysfs product string,
+ * otherwise in the "lsusb -v" output.
+ * @param deviceIdString: Output string following the "@Device ID /" pattern.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuUtilTransport::readDeviceIdString(std::string &deviceIdString)
+{
+    if(SysfsUsb::isAvailable())
+    {
+        SysfsUsbDevice sysfsDevice ;
+        if(SysfsUsb::findDevice(ST_USB_VENDOR_ID, ST_DFU_PRODUCT_ID, this->dfuSerialNumber, sysfsDevice) == false)
+            return TOOLBOX_DFU_ERROR_NO_DEVICE ;
+
+        return DfuDevice::findDeviceIdString(sysfsDevice.product, deviceIdString) ? TOOLBOX_DFU_NO_ERROR : TOOLBOX_DFU_ERROR_NOT_SUPPORTED ;
+    }
+
+    std::string  utilCmd =  getLsUsbProgramPath().append("-d 0483:df11 -v") ;
+    std::string result = "";
+    int ret = executeCommand(utilCmd, result) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    return DfuDevice::findDeviceIdString(result, deviceIdString) ? TOOLBOX_DFU_NO_ERROR : TOOLBOX_DFU_ERROR_NOT_SUPPORTED ;
+}
+
+/**
+ * @brief DfuUtilTransport::download : Get the dfu-util command ready, then download a file to an alternate setting.
+ * @param alternateIndex: ALT index of the dedicated partition.
+ * @param filePath: The firmware path to be programmed.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuUtilTransport::download(uint8_t alternateIndex, const std::string &filePath)
+{
+    std::string utilCmd = getDfuUtilProgramPath().append("-d 483:df11") ;
+    utilCmd.append(" -a ").append(std::to_string(alternateIndex)) ;
+    utilCmd.append(" -D ").append(filePath) ;
+    if(this->dfuSerialNumber != "")
+        utilCmd.append(" --serial ").append(this->dfuSerialNumber);
+
+#ifdef _WIN32
+        utilCmd = "\"" + utilCmd + "\"" ;
+#endif
+    displayManager.print(MSG_NORMAL, L"DFU-UTIL command: %s", utilCmd.data()) ;
+
+    std::string path = filePath ;
+    path.erase(std::remove(path.begin(), path.end(), '\"'), path.end()) ; //remove the double quotes from the file path
+    std::error_code errorCode ;
+    uintmax_t fileSize = std::experimental::filesystem::file_size(path, errorCode) ;
+
+    int ret = runTransfer(utilCmd, alternateIndex, false, errorCode ? 0 : (uint64_t)fileSize) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return (ret == TOOLBOX_DFU_ERROR_TIMEOUT) ? ret : TOOLBOX_DFU_ERROR_NO_MEM;
+
+    return outputParser.isDownloadDone() ? TOOLBOX_DFU_NO_ERROR : TOOLBOX_DFU_ERROR_WRITE ;
+}
+
+/**
+ * @brief DfuUtilTransport::downloadFromMemory : Download a buffer to an alternate setting, dfu-util reads it from its standard input.
+ * @param alternateIndex: ALT index of the dedicated partition.
+ * @param data: The bytes to be programmed.
+ * @param size: Number of bytes.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuUtilTransport::downloadFromMemory(uint8_t alternateIndex, const unsigned char *data, size_t size)
+{
+#ifdef _WIN32
+    /* The standard input of the programs cannot be fed on this platform */
+    return downloadFromScratchFile(alternateIndex, data, size) ;
+#else
+    std::string utilCmd = getDfuUtilProgramPath().append("-d 483:df11") ;
+    utilCmd.append(" -a ").append(std::to_string(alternateIndex)) ;
+    utilCmd.append(" -D -") ;
+    if(this->dfuSerialNumber != "")
+        utilCmd.append(" --serial ").append(this->dfuSerialNumber);
+
+    displayManager.print(MSG_NORMAL, L"DFU-UTIL command: %s (%lu bytes from memory)", utilCmd.data(), (unsigned long)size) ;
+
+    int ret = runTransfer(utilCmd, alternateIndex, false, size, data, size) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return (ret == TOOLBOX_DFU_ERROR_TIMEOUT) ? ret : TOOLBOX_DFU_ERROR_NO_MEM;
+
+    return outputParser.isDownloadDone() ? TOOLBOX_DFU_NO_ERROR : TOOLBOX_DFU_ERROR_WRITE ;
+#endif
+}
+
+/**
+ * @brief DfuUtilTransport::downloadFromReader : Download the bytes of a producer to an alternate setting. dfu-util reads its
+ * whole input before the transfer, so the bytes are gathered in memory up to DFU_UTIL_INPUT_MAX_SIZE, a larger stream is
+ * spilled to a scratch file which is downloaded by path.
+ * @param alternateIndex: ALT index of the dedicated partition.
+ * @param reader: The producer of the bytes.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuUtilTransport::downloadFromReader(uint8_t alternateIndex, const DownloadReader &reader)
+{
+    std::vector<unsigned char> data ;
+    size_t size = 0 ;
+    do
+    {
+        if(data.size() >= DFU_UTIL_INPUT_MAX_SIZE)
+        {
+            displayManager.print(MSG_NORMAL, L"Streamed data larger than %lu bytes, it is spilled to a scratch file", (unsigned long)DFU_UTIL_INPUT_MAX_SIZE) ;
+            return downloadFromScratchFile(alternateIndex, data.data(), data.size(), &reader) ;
+        }
+
+        data.resize(data.size() + DOWNLOAD_READ_SIZE) ;
+        int ret = reader(data.data() + data.size() - DOWNLOAD_READ_SIZE, DOWNLOAD_READ_SIZE, &size) ;
+        data.resize(data.size() - DOWNLOAD_READ_SIZE + size) ;
+        if(ret != TOOLBOX_DFU_NO_ERROR)
+            return ret ;
+    } while(size != 0) ;
+
+    return downloadFromMemory(alternateIndex, data.data(), data.size()) ;
+}
+
+/**
+ * @brief DfuUtilTransport::downloadFromScratchFile : Write the bytes to a scratch file, followed by the remaining bytes of
+ * a producer if any, then download this file to an alternate setting.
+ * @param alternateIndex: ALT index of the dedicated partition.
+ * @param data: The first bytes to be programmed.
+ * @param size: Number of bytes of data.
+ * @param reader: The producer of the remaining bytes, nullptr if none.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuUtilTransport::downloadFromScratchFile(uint8_t alternateIndex, const unsigned char *data, size_t size, const DownloadReader *reader)
+{
+    std::string downloadPath ;
+    int ret = scratchSpace.getFilePath("alt" + std::to_string(alternateIndex) + ".bin", downloadPath) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    std::ofstream file(downloadPath, std::ios::binary | std::ios::out | std::ios::trunc);
+    if(file.is_open() == false)
+    {
+        displayManager.print(MSG_ERROR, L"Could not open temporary file!");
+        return TOOLBOX_DFU_ERROR_NO_FILE ;
+    }
+    file.write(reinterpret_cast<const char*>(data), size);
+
+    std::vector<unsigned char> chunk(reader != nullptr ? DOWNLOAD_READ_SIZE : 0) ;
+    size_t readSize = chunk.size() ;
+    while((reader != nullptr) && (readSize != 0) && file.good())
+    {
+        ret = (*reader)(chunk.data(), chunk.size(), &readSize) ;
+        if(ret != TOOLBOX_DFU_NO_ERROR)
+            break ;
+        file.write(reinterpret_cast<const char*>(chunk.data()), readSize);
+    }
+    file.close();
+
+    if((ret == TOOLBOX_DFU_NO_ERROR) && file.fail())
+    {
+        displayManager.print(MSG_ERROR, L"Could not write temporary file!");
+        ret = TOOLBOX_DFU_ERROR_NO_FILE ;
+    }
+    if(ret == TOOLBOX_DFU_NO_ERROR)
+        ret = download(alternateIndex, "\"" + downloadPath + "\"") ;
+
+    std::remove(downloadPath.c_str()) ;
+    return ret ;
+}
+
+/**
+ * @brief DfuUtilTransport::upload : Get the dfu-util command ready, then read an alternate setting and save it into file.
+ * @param alternateIndex: The alternate setting index of the dedicated partition to read.
+ * @param filePath: The output binary file to store the parition data.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuUtilTransport::upload(uint8_t alternateIndex, const std::string &filePath)
+{
+    std::string  utilCmd =  getDfuUtilProgramPath().append("-d 0483:df11") ;
+    utilCmd.append(" -a ").append(std::to_string(alternateIndex)) ;
+
+    utilCmd.append(" -U ").append(filePath) ;
+    if(this->dfuSerialNumber != "")
+        utilCmd.append(" --serial ").append(this->dfuSerialNumber);
+
+#ifdef _WIN32
+    utilCmd = "\"" + utilCmd + "\"" ;
+#endif
+    displayManager.print(MSG_NORMAL, L"DFU-UTIL command: %s", utilCmd.data()) ;
+
+    int ret = runTransfer(utilCmd, alternateIndex, true) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return (ret == TOOLBOX_DFU_ERROR_TIMEOUT) ? ret : TOOLBOX_DFU_ERROR_OTHER;
+
+    return outputParser.isUploadDone() ? TOOLBOX_DFU_NO_ERROR : TOOLBOX_DFU_ERROR_READ ;
+}
+
+/**
+ * @brief DfuUtilTransport::uploadToMemory : dfu-util can only upload into a new file, the data is read back from
+ * a file of the scratch directory of this transport, which is removed right after.
+ * @param alternateIndex: The alternate setting index of the dedicated partition to read.
+ * @param data: Output buffer receiving the uploaded bytes.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuUtilTransport::uploadToMemory(uint8_t alternateIndex, std::vector<unsigned char> &data)
+{
+    data.clear();
+
+    std::string uploadPath ; // Never used before, as dfu-util refuses to overwrite an existing file
+    int ret = scratchSpace.getFilePath("alt" + std::to_string(alternateIndex) + ".bin", uploadPath) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    ret = upload(alternateIndex, "\"" + uploadPath + "\"") ;
+    if(ret == TOOLBOX_DFU_NO_ERROR)
+    {
+        std::ifstream file(uploadPath, std::ios::binary);
+        if(file.is_open())
+            data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        else
+            ret = TOOLBOX_DFU_ERROR_NO_FILE ;
+    }
+
+    std::remove(uploadPath.c_str()) ;
+    return ret ;
+}
+
+/**
+ * @brief DfuUtilTransport::detach : Request to detach the device.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuUtilTransport::detach()
+{
+    std::string  utilCmd =  getDfuUtilProgramPath().append("-d 483:df11 -a 0 -e") ;
+    if(this->dfuSerialNumber != "")
+        utilCmd.append(" --serial ").append(this->dfuSerialNumber);
+
+    displayManager.print(MSG_NORMAL, L"DFU-UTIL command: %s", utilCmd.data()) ;
+    std::string result = "";
+    int ret = executeCommand(utilCmd, result, PROCESS_QUERY_TIMEOUT_MS, true) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    return (lastExitCode == 0) ? TOOLBOX_DFU_NO_ERROR : TOOLBOX_DFU_ERROR_OTHER ;
+}
+
+/**
+ * @brief DfuUtilTransport::isFileDownloadPreferred : dfu-util reads a file itself, the content from memory is either
+ * buffered from its standard input or written to a scratch file first (Windows).
+ * @return True.
+ */
+bool DfuUtilTransport::isFileDownloadPreferred()
+{
+    return true ;
+}
+
+/**
+ * @brief DfuUtilTransport::isSameEnumeration : Compare the sysfs device number, it changes each time the device re-enumerates.
+ * @return True if the listed device did not re-enumerate, otherwise false.
+ */
+bool DfuUtilTransport::isSameEnumeration()
+{
+    if((listedDevice.deviceNumber < 0) || (SysfsUsb::isAvailable() == false))
+        return true ;
+
+    SysfsUsbDevice sysfsDevice ;
+    if(SysfsUsb::findDevice(ST_USB_VENDOR_ID, ST_DFU_PRODUCT_ID, this->dfuSerialNumber, sysfsDevice) == false)
+        return false ;
+
+    return (sysfsDevice.portPath == listedDevice.portPath) && (sysfsDevice.deviceNumber == listedDevice.deviceNumber) ;
+}
+
+/**
+ * @brief DfuUtilTransport::getDfuUtilProgramPath : Get the path of dfu-util program from the project directory.
+ * @return The dfu-util executable path.
+ */
+std::string DfuUtilTransport::getDfuUtilProgramPath()
+{
+    std::string path = "" ;
+#ifdef _WIN32
+    path = this->toolboxFolder;
+    path.append("\\Utilities\\Windows\\dfu-util.exe") ; //from the project tree
+    path = "\"" + path + "\" " ;
+    displayManager.print(MSG_NORMAL, L"dfu-util application path : %s", path.c_str()) ;
+#else
+    path = "dfu-util " ; //use system command
+#endif
+
+    return path;
+}
+
+/**
+ * @brief DfuUtilTransport::getLsUsbProgramPath : Get the path of lsusb program from the project directory.
+ * @return The fastboot executable path.
+ */
+std::string DfuUtilTransport::getLsUsbProgramPath()
+{
+    std::string path = "" ;
+#ifdef _WIN32
+    path = this->toolboxFolder;
+    path.append("\\Utilities\\Windows\\lsusb.exe") ; //from the project tree
+    path = "\"" + path + "\" " ;
+    displayManager.print(MSG_NORMAL, L"lsusb path : %s", path.c_str()) ; // display this just once
+#elif __APPLE__
+    path = this->toolboxFolder;
+    path = "/Utilities/MacOS/dfu-util/lsusb" ; //from the project tree
+    path = "\"" + path + "\" " ;
+    displayManager.print(MSG_NORMAL, L"lsusb application path : %s", path.c_str()) ; // display this just once
+#elif __linux__
+    path = "lsusb " ; // use Linux system command
+#else
+    path = "" ;
+#endif
+
+    return path;
+}
+
+/**
+ * @brief DfuUtilTransport::executeCommand : Run a program and collect its output, the program is killed if it exceeds the timeout.
+ * @param command: The command line.
+ * @param output: Output of the program (stdout and stderr).
+ * @param msTimeout: The deadline of the program in milliseconds.
+ * @param isOutputDisplayed: Print each output line as soon as it is received.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuUtilTransport::executeCommand(const std::string &command, std::string &output, uint32_t msTimeout, bool isOutputDisplayed)
+{
+    ProcessRunner runner ;
+    ProcessResult result ;
+    runner.setTimeout(msTimeout) ;
+    if(isOutputDisplayed)
+    {
+        runner.setLineCallback([this](const std::string &line) {
+            displayManager.print(MSG_NORMAL, L"%s", line.c_str()) ;
+        });
+    }
+
+    int ret = runner.runShellCommand(command, result) ;
+    output = result.output ;
+    lastExitCode = result.exitCode ;
+    if(ret == TOOLBOX_DFU_ERROR_TIMEOUT)
+    {
+        displayManager.print(MSG_ERROR, L"Command timed out after %d ms, it is terminated : %s", msTimeout, command.c_str()) ;
+    }
+    else if(ret != TOOLBOX_DFU_NO_ERROR)
+    {
+        displayManager.print(MSG_ERROR, L"Failed to run the command : %s", command.c_str()) ;
+    }
+
+    return ret ;
+}
+
+/**
+ * @brief DfuUtilTransport::runTransfer : Run a dfu-util transfer and follow its progress while the output is received.
+ * @param command: The dfu-util command line.
+ * @param alternateIndex: The alternate setting of the transfer, given to the progress handler.
+ * @param isUpload: True for an upload, false for a download.
+ * @param totalSize: Number of bytes of the transfer, 0 if it is not known.
+ * @param input: Data written to the standard input of dfu-util, nullptr if none.
+ * @param inputSize: Number of input bytes.
+ * @return 0 if the program ran until its end, otherwise an error occurred. The transfer status is kept by the output parser.
+ */
+int DfuUtilTransport::runTransfer(const std::string &command, uint8_t alternateIndex, bool isUpload, uint64_t totalSize, const unsigned char *input, size_t inputSize)
+{
+    const char *direction = isUpload ? "Upload" : "Download" ;
+    auto start = std::chrono::steady_clock::now();
+    int nextPercentStep = 25 ;
+
+    outputParser.reset();
+    outputParser.setEventCallback([&](const DfuOutputEvent &event) {
+        if(event.type == DFU_OUTPUT_PROGRESS)
+        {
+            DisplayManager::reportProgress(alternateIndex, event.value, totalSize) ;
+            if((event.percent < nextPercentStep) || (event.percent >= 100))
+                return ;
+
+            nextPercentStep = ((event.percent / 25) + 1) * 25 ;
+            long msElapsed = (long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() ;
+            unsigned long kbPerSecond = (msElapsed > 0) ? (unsigned long)(event.value / (uint64_t)msElapsed) : 0 ; // bytes per ms is KB/s
+            displayManager.print(MSG_NORMAL, L"%s %3d%% : %lu bytes, %lu KB/s", direction, event.percent, (unsigned long)event.value, kbPerSecond) ;
+        }
+        else if(event.type == DFU_OUTPUT_ERROR)
+        {
+            displayManager.print(MSG_ERROR, L"dfu-util : %s", event.text.c_str()) ;
+        }
+    });
+
+    ProcessRunner runner ;
+    ProcessResult result ;
+    runner.setTimeout(0) ;  // A large image takes as long as it takes, only a silent dfu-util is stopped
+    runner.setIdleTimeout(PROCESS_TRANSFER_IDLE_TIMEOUT_MS) ;
+    runner.setInputData(input, inputSize) ;
+    runner.setLineCallback([this](const std::string &line) {
+        outputParser.feedLine(line) ;
+    });
+
+    int ret = runner.runShellCommand(command, result) ;
+    outputParser.setEventCallback(nullptr) ;
+    lastExitCode = result.exitCode ;
+    if(ret == TOOLBOX_DFU_ERROR_TIMEOUT)
+    {
+        displayManager.print(MSG_ERROR, L"Command silent for %d ms, it is terminated : %s", PROCESS_TRANSFER_IDLE_TIMEOUT_MS, command.c_str()) ;
+        return ret ;
+    }
+    else if(ret != TOOLBOX_DFU_NO_ERROR)
+    {
+        displayManager.print(MSG_ERROR, L"Failed to run the command : %s", command.c_str()) ;
+        return ret ;
+    }
+
+    bool isDone = isUpload ? outputParser.isUploadDone() : outputParser.isDownloadDone() ;
+    if(isDone)
+    {
+        unsigned long bytes = (unsigned long)outputParser.getTransferredBytes() ;
+        long msElapsed = (long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() ;
+        displayManager.print(MSG_NORMAL, L"%s done : %lu bytes in %ld ms (%lu KB/s, transfer size %u)", direction, bytes, msElapsed,
+                             (msElapsed > 0) ? (bytes / (unsigned long)msElapsed) : 0UL, outputParser.getTransferSize()) ;
+    }
+    else
+    {
+        displayManager.print(MSG_NORMAL, L"OUTPUT: %s", result.output.data()) ;
+    }
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief DfuUtilTransport::parseDeviceList : Group the "Found DFU" lines of "dfu-util -l" by device.
+ * @param output: The dfu-util output.
+ * @param devices: Output list of devices with their alternate settings.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int DfuUtilTransport::parseDeviceList(const std::string &output, std::vector<DfuDeviceInfo> &devices)
+{
+    devices.clear();
+
+    outputParser.reset();
+    outputParser.setEventCallback([&devices](const DfuOutputEvent &event) {
+        if((event.type != DFU_OUTPUT_ALT_SETTING) || (event.vendorID != ST_USB_VENDOR_ID) || (event.productID != ST_DFU_PRODUCT_ID))
+            return ;
+
+        int busNum = std::atoi(event.path.c_str()); // path is "<bus>-<port>.<port>..."
+        DfuDeviceInfo *device = nullptr ;
+        for(auto &knownDevice : devices)
+        {
+            if((knownDevice.deviceNumber == event.deviceNumber) && (knownDevice.busNumber == busNum))
+                device = &knownDevice ;
+        }
+        if(device == nullptr)
+        {
+            DfuDeviceInfo newDevice ;
+            newDevice.serialNumber = event.serialNumber ;
+            newDevice.busNumber = busNum ;
+            newDevice.deviceNumber = event.deviceNumber ;
+            newDevice.portPath = event.path ;
+            devices.push_back(newDevice);
+            device = &devices.back() ;
+        }
+
+        DfuAltSetting altSetting ;
+        altSetting.alt = event.alternateIndex ;
+        altSetting.name = event.name ;
+        device->altSettings.push_back(altSetting);
+        device->descriptorStrings.push_back(altSetting.name);
+    });
+
+    outputParser.feed(output.data(), output.size()) ;
+    outputParser.finish() ;
+    outputParser.setEventCallback(nullptr) ;
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
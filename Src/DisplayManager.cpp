@@ -21,6 +21,7 @@
  */
 
 #include "DisplayManager.h"
+#include <cstdint>
 #ifdef _WIN32
 #include <windows.h>
 HANDLE  console;
@@ -30,6 +31,9 @@ WORD OriginalBgColors;
 #include <cstdlib>
 #endif
 
+std::mutex DisplayManager::outputMutex ;
+thread_local ThreadOutput DisplayManager::threadOutput = {nullptr, "", CONSOLE_ALL, nullptr, nullptr} ;
+
 DisplayManager::DisplayManager()
 {
 
@@ -74,10 +78,98 @@ void DisplayManager::print(messageType messageType, const wchar_t* message, ...)
     std::wstring s(std::move(msgIndicator));
     s += std::wstring(ws);
 
-    displayMessage(messageType, s.c_str()) ;
-
     free(ws);
     va_end(args);
+
+    /* The log stream and the handler belong to the calling thread: a handler which blocks or prints
+       again does not hold the console of the other threads */
+    if((threadOutput.logStream != nullptr) || threadOutput.messageHandler)
+    {
+        std::string line = encodeUtf8(s.c_str()) ;
+        if(threadOutput.logStream != nullptr)
+            *threadOutput.logStream << line << std::endl ;
+        if(threadOutput.messageHandler)
+            threadOutput.messageHandler(messageType, line) ;
+    }
+
+    if((threadOutput.consoleFilter == CONSOLE_NONE) || ((threadOutput.consoleFilter == CONSOLE_MILESTONES) && (messageType != MSG_GREEN) && (messageType != MSG_ERROR)))
+        return ;
+
+    if(threadOutput.consolePrefix.empty() == false)
+    {
+        size_t position = s.find_first_not_of(L'\n') ;
+        s.insert((position == std::wstring::npos) ? s.size() : position, std::wstring(threadOutput.consolePrefix.begin(), threadOutput.consolePrefix.end())) ;
+    }
+
+    std::lock_guard<std::mutex> lock(outputMutex);
+    displayMessage(messageType, s.c_str()) ;
+}
+
+/**
+ * @brief DisplayManager::setThreadOutput : Redirect the messages printed by the calling thread.
+ * @param output: The log stream, console prefix and filtering to apply until resetThreadOutput().
+ */
+void DisplayManager::setThreadOutput(const ThreadOutput &output)
+{
+    threadOutput = output ;
+}
+
+/**
+ * @brief DisplayManager::resetThreadOutput : Print the messages of the calling thread to the console only.
+ */
+void DisplayManager::resetThreadOutput()
+{
+    threadOutput = {nullptr, "", CONSOLE_ALL, nullptr, nullptr} ;
+}
+
+/**
+ * @brief DisplayManager::reportProgress : Give the progress of a transfer of the calling thread to its progress handler.
+ * @param alt: The alternate setting of the transfer.
+ * @param done: Number of bytes transferred so far.
+ * @param total: Number of bytes of the whole transfer, 0 if it is not known.
+ */
+void DisplayManager::reportProgress(int alt, uint64_t done, uint64_t total)
+{
+    if(threadOutput.progressHandler)
+        threadOutput.progressHandler(alt, done, total) ;
+}
+
+/**
+ * @brief DisplayManager::encodeUtf8 : Encode a message for the log files and the message handlers, without colors.
+ * @param str: the string to encode.
+ * @return The message encoded in UTF-8.
+ */
+std::string DisplayManager::encodeUtf8(const wchar_t* str)
+{
+    std::string line ;
+    for(const wchar_t *character = str; *character != L'\0'; character++)
+    {
+        uint32_t code = (uint32_t)*character ;
+        if(code < 0x80)
+        {
+            line += (char)code ;
+        }
+        else if(code < 0x800)
+        {
+            line += (char)(0xC0 | (code >> 6)) ;
+            line += (char)(0x80 | (code & 0x3F)) ;
+        }
+        else if(code < 0x10000)
+        {
+            line += (char)(0xE0 | (code >> 12)) ;
+            line += (char)(0x80 | ((code >> 6) & 0x3F)) ;
+            line += (char)(0x80 | (code & 0x3F)) ;
+        }
+        else
+        {
+            line += (char)(0xF0 | (code >> 18)) ;
+            line += (char)(0x80 | ((code >> 12) & 0x3F)) ;
+            line += (char)(0x80 | ((code >> 6) & 0x3F)) ;
+            line += (char)(0x80 | (code & 0x3F)) ;
+        }
+    }
+
+    return line ;
 }
 
 /**
@@ -121,6 +121,7 @@ int FileManager::parseTsvFile(const std::string tsvFolderPath, std::ifstream *in
         inFile->seekg(0, std::ios::beg) ;
     }
 
+    std::vector<std::pair<FirmwareIdentity, std::string>> uniqueBinaries ;
     while (inFile->eof() == false)
     {
         partitionInfo tempPartition;
@@ -162,22 +163,21 @@ int FileManager::parseTsvFile(const std::string tsvFolderPath, std::ifstream *in
 
         if(tempPartition.binary != "none")
         {
-            std::ifstream binaryFile(tempPartition.binary);
-            if(binaryFile.is_open() == false) // file does not exist
+            FirmwareIdentity identity ;
+            if(FirmwareImage::getIdentity(tempPartition.binary, identity) == false)
             {
                 /* Try to search from the folder that contains the TSV file */
                 std::string tmpPath = "" ;
                 tmpPath.append(tsvFolderPath).append("/").append(tempPartition.binary) ;
                 tempPartition.binary = std::move(tmpPath)  ;
 
-                binaryFile.close();
-                binaryFile.open(tempPartition.binary);
-                if(binaryFile.is_open() == false)
+                if(FirmwareImage::getIdentity(tempPartition.binary, identity) == false)
                 {
                     displayManager.print(MSG_ERROR, L"File %s does not exist !", tempPartition.binary.c_str());
                     return TOOLBOX_DFU_ERROR_WRONG_PARAM;
                 }
             }
+            tempPartition.binary = getUniqueBinary(tempPartition, identity, uniqueBinaries) ;
             tempPartition.binary = "\"" + tempPartition.binary + "\""; //To take into account the paths with white spaces;
         }
 
@@ -193,6 +193,46 @@ int FileManager::parseTsvFile(const std::string tsvFolderPath, std::ifstream *in
     return ret ;
 }
 
+/**
+ * @brief FileManager::getUniqueBinary : Resolve a partition binary to the first binary of the TSV file having the same
+ * identity, so the partitions sharing an image name it with the same path and the image is loaded once. The paths naming
+ * the same file are identical, and so are two files of the same size holding the same bytes: each file is sampled
+ * once, and its content compared only with the binaries having the same samples.
+ * @param partition: The partition, its binary path is without quotes.
+ * @param identity: The identity of the partition binary, its samples are digested if needed.
+ * @param uniqueBinaries: The input/output list of the distinct binaries found so far, with their path.
+ * @return The path of the binary to download for the partition.
+ */
+std::string FileManager::getUniqueBinary(const partitionInfo &partition, FirmwareIdentity &identity, std::vector<std::pair<FirmwareIdentity, std::string>> &uniqueBinaries)
+{
+    const std::pair<FirmwareIdentity, std::string> *sameImage = nullptr ;
+    for(const auto &binary : uniqueBinaries)
+    {
+        if(binary.first.fileKey == identity.fileKey)
+            sameImage = &binary ;
+    }
+
+    for(auto &binary : uniqueBinaries)
+    {
+        if((sameImage != nullptr) || (identity.size > IMAGE_COMPARE_MAX_SIZE))
+            break ;
+
+        bool isCandidate = (binary.first.size == identity.size) && FirmwareImage::getSampleDigest(binary.second, binary.first) && FirmwareImage::getSampleDigest(partition.binary, identity) ;
+        if(isCandidate && (binary.first.sampleDigest == identity.sampleDigest) && FirmwareImage::isSameContent(binary.second, partition.binary))
+            sameImage = &binary ;
+    }
+
+    if(sameImage != nullptr)
+    {
+        if(sameImage->second != partition.binary)
+            displayManager.print(MSG_NORMAL, L"Partition %s : %s holds the same image as %s, it is loaded once", partition.partName.c_str(), partition.binary.c_str(), sameImage->second.c_str());
+        return sameImage->second ;
+    }
+
+    uniqueBinaries.push_back(std::make_pair(identity, partition.binary)) ;
+    return partition.binary ;
+}
+
 /**
  * @brief FileManager::splitStdString : Split an input string basiong on a specifc format and delimiter.
  * @param str: The input string.
@@ -411,76 +451,6 @@ uint32_t FileManager::getChecksumCrc32(unsigned char* data, uint32_t size)
     return ~reg;
 }
 
-/**
- * @brief FileManager::saveTemproryScriptFile : search for a temprory path and save the data.
- * @param parsedTsvFile: The input parsed TSV file containing the script data.
- * @param outTempFile: Output variable to give the temprory path.
- * @return 0 if the operation is performed successfully, otherwise an error occurred.
- */
-int FileManager::saveTemproryScriptFile(const fileTSV parsedTsvFile, std::string &outTempFile)
-{
-    displayManager.print(MSG_NORMAL, L"Preparing U-Boot Script/Flashlayout...");
-
-#ifdef _WIN32
-    char temp_dir[MAX_PATH];
-    DWORD result = GetTempPathA(MAX_PATH, temp_dir);
-    if ((result == 0) || (result > MAX_PATH))
-    {
-        displayManager.print(MSG_ERROR, L"Could not get temporary directory!");
-        return TOOLBOX_DFU_ERROR_NO_FILE;
-    }
-
-    char tempFile[MAX_PATH];
-    result = GetTempFileNameA(temp_dir, "STM32", 0, tempFile);
-    if (result == 0)
-    {
-        displayManager.print(MSG_ERROR, L"Could not get temporary directory!");
-        return TOOLBOX_DFU_ERROR_NO_FILE;
-    }
-#else // Linux & MacOS
-    const char* temp_dir = std::getenv("TMPDIR");
-    if (temp_dir == nullptr)
-    {
-        temp_dir = "/tmp";
-    }
-
-    std::string tempFile = std::string(temp_dir) + "/STM32";
-#endif
-
-#ifdef _WIN32
-    std::ofstream outfile(tempFile, std::ios::binary | std::ios::out | std::ios::trunc);
-#else
-    std::ofstream outfile(tempFile.c_str(), std::ios::binary | std::ios::out | std::ios::trunc);
-#endif
-
-    if (outfile.is_open())
-    {
-        outfile.write((char*)parsedTsvFile.scriptUbootTsvData, parsedTsvFile.scriptUbootTsvDataSize);
-        outfile.close();
-    }
-    else
-    {
-        displayManager.print(MSG_ERROR, L"Could not open temporary file!");
-        return TOOLBOX_DFU_ERROR_NOT_SUPPORTED ;
-    }
-
-    outTempFile.erase();
-    outTempFile +=  tempFile ;
-
-    return TOOLBOX_DFU_NO_ERROR;
-}
-
-/**
- * @brief FileManager::removeTemproryFile
- * @param tempFile: The path of temprory file to be removed.
- * @return 0 if there is no issue, otherwise an error occured.
- */
-int FileManager::removeTemproryFile(const std::string tempFile)
-{
-    displayManager.print(MSG_NORMAL, L"Removing temprory file : %s", tempFile.c_str());
-    return std::remove(tempFile.c_str());
-}
-
 /**
  * @brief FileManager::isValidTsvFile: Check the validity of the given TSV file.
  * @param myTsvFile: The input parsed TSV file containing the list of partitions.
@@ -621,41 +591,3 @@ void FileManager::createSTM32HeadredImage(std::string& data)
     data.insert(0,header);
 }
 
-/**
- * @brief FileManager::getTemproryFile: Prepare and get a temprory file path (expected to be deleted later)
- * @param outTempFile: Output variable to give the temprory path.
- * @return 0 if the operation is performed successfully, otherwise an error occurred.
- */
-int FileManager::getTemproryFile(std::string &outTempFile)
-{
-#ifdef _WIN32
-    char temp_dir[MAX_PATH];
-    DWORD result = GetTempPathA(MAX_PATH, temp_dir);
-    if ((result == 0) || (result > MAX_PATH))
-    {
-        displayManager.print(MSG_ERROR, L"Could not get temporary directory!");
-        return TOOLBOX_DFU_ERROR_NO_FILE;
-    }
-
-    char tempFile[MAX_PATH];
-    result = GetTempFileNameA(temp_dir, "STM32", 0, tempFile);
-    if (result == 0)
-    {
-        displayManager.print(MSG_ERROR, L"Could not get temporary directory!");
-        return TOOLBOX_DFU_ERROR_NO_FILE;
-    }
-#else // Linux
-    const char* temp_dir = std::getenv("TMPDIR");
-    if (temp_dir == nullptr)
-    {
-        temp_dir = "/tmp";
-    }
-
-    std::string tempFile = std::string(temp_dir) + "/STM32";
-#endif
-
-    outTempFile.erase();
-    outTempFile +=  tempFile ;
-
-    return TOOLBOX_DFU_NO_ERROR;
-}
@@ -0,0 +1,244 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "FirmwareImage.h"
+#include "DisplayManager.h"
+#include "Error.h"
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#else
+#include <experimental/filesystem>
+#endif
+
+FirmwareImage::FirmwareImage()
+{
+    data = nullptr ;
+    size = 0 ;
+    mappedAddress = nullptr ;
+}
+
+FirmwareImage::~FirmwareImage()
+{
+    close() ;
+}
+
+/**
+ * @brief FirmwareImage::open : Map a partition binary read-only, the previous one is released.
+ * @param filePath: The binary path, without quotes.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int FirmwareImage::open(const std::string &filePath)
+{
+    DisplayManager displayManager = DisplayManager::getInstance() ;
+    close() ;
+
+#ifdef _WIN32
+    std::ifstream file(filePath, std::ios::binary);
+    if(file.is_open() == false)
+    {
+        displayManager.print(MSG_ERROR, L"The file does not exist :  %s", filePath.c_str());
+        return TOOLBOX_DFU_ERROR_NO_FILE ;
+    }
+
+    buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    data = buffer.data() ;
+    size = buffer.size() ;
+    return TOOLBOX_DFU_NO_ERROR ;
+#else
+    int fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC) ;
+    if(fd < 0)
+    {
+        displayManager.print(MSG_ERROR, L"The file does not exist :  %s", filePath.c_str());
+        return TOOLBOX_DFU_ERROR_NO_FILE ;
+    }
+
+    struct stat fileStat ;
+    if((fstat(fd, &fileStat) != 0) || (S_ISREG(fileStat.st_mode) == false))
+    {
+        displayManager.print(MSG_ERROR, L"The file is not a regular file :  %s", filePath.c_str());
+        ::close(fd) ;
+        return TOOLBOX_DFU_ERROR_NO_FILE ;
+    }
+
+    /* An empty file cannot be mapped, there is nothing to transfer anyway */
+    size = (size_t)fileStat.st_size ;
+    if(size == 0)
+    {
+        ::close(fd) ;
+        return TOOLBOX_DFU_NO_ERROR ;
+    }
+
+    void *address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) ;
+    ::close(fd) ; // The mapping keeps the file referenced
+    if(address == MAP_FAILED)
+    {
+        displayManager.print(MSG_ERROR, L"Cannot map the file %s : %s", filePath.c_str(), strerror(errno));
+        size = 0 ;
+        return TOOLBOX_DFU_ERROR_NO_MEM ;
+    }
+
+    /* Hints only, the transfer works without them */
+    madvise(address, size, MADV_SEQUENTIAL) ;
+    madvise(address, size, MADV_WILLNEED) ;
+
+    mappedAddress = address ;
+    data = static_cast<const unsigned char*>(address) ;
+    return TOOLBOX_DFU_NO_ERROR ;
+#endif
+}
+
+/**
+ * @brief FirmwareImage::close : Release the view of the binary, the spans taken from it become invalid.
+ */
+void FirmwareImage::close()
+{
+#ifndef _WIN32
+    if(mappedAddress != nullptr)
+        munmap(mappedAddress, size) ;
+#endif
+    mappedAddress = nullptr ;
+    std::vector<unsigned char>().swap(buffer) ;
+    data = nullptr ;
+    size = 0 ;
+}
+
+const unsigned char* FirmwareImage::getData() const
+{
+    return data ;
+}
+
+size_t FirmwareImage::getSize() const
+{
+    return size ;
+}
+
+/**
+ * @brief FirmwareImage::isFileExist : Check that a binary exists, without opening it.
+ * @param filePath: The binary path, without quotes.
+ * @return True if the path names a regular file.
+ */
+bool FirmwareImage::isFileExist(const std::string &filePath)
+{
+    struct stat fileStat ;
+    return (stat(filePath.c_str(), &fileStat) == 0) && S_ISREG(fileStat.st_mode) ;
+}
+
+/**
+ * @brief FirmwareImage::getIdentity : Identify the file of a binary, so the paths naming the same file are recognized.
+ * @param filePath: The binary path, without quotes.
+ * @param identity: Output variable to store the identity of the file.
+ * @return True if the path names a regular file.
+ */
+bool FirmwareImage::getIdentity(const std::string &filePath, FirmwareIdentity &identity)
+{
+    struct stat fileStat ;
+    if((stat(filePath.c_str(), &fileStat) != 0) || (S_ISREG(fileStat.st_mode) == false))
+        return false ;
+
+    identity.size = (uint64_t)fileStat.st_size ;
+    identity.isSampled = false ;
+    identity.sampleDigest = 0 ;
+#ifdef _WIN32
+    /* No inode number on Windows, the canonical path names the file */
+    try
+    {
+        identity.fileKey = std::experimental::filesystem::canonical(filePath).string() ;
+    }
+    catch(const std::exception &)
+    {
+        identity.fileKey = filePath ;
+    }
+#else
+    identity.fileKey = std::to_string((unsigned long long)fileStat.st_dev) + ":" + std::to_string((unsigned long long)fileStat.st_ino) ;
+#endif
+    return true ;
+}
+
+/**
+ * @brief FirmwareImage::getSampleDigest : Digest a few samples of a binary, computed once per identity. Two binaries
+ * with different digests differ, equal digests are confirmed with isSameContent.
+ * @param filePath: The binary path, without quotes.
+ * @param identity: The input/output identity of the binary, its digest is filled.
+ * @return True if the digest is available.
+ */
+bool FirmwareImage::getSampleDigest(const std::string &filePath, FirmwareIdentity &identity)
+{
+    if(identity.isSampled)
+        return true ;
+
+    std::ifstream file(filePath, std::ios::binary) ;
+    if(file.is_open() == false)
+        return false ;
+
+    uint64_t offsets[3] = {0, identity.size / 2, (identity.size > IMAGE_SAMPLE_SIZE) ? identity.size - IMAGE_SAMPLE_SIZE : 0} ;
+    std::vector<char> sample(IMAGE_SAMPLE_SIZE) ;
+    uLong digest = crc32(0L, Z_NULL, 0) ;
+    for(uint64_t offset : offsets)
+    {
+        file.seekg((std::streamoff)offset) ;
+        file.read(sample.data(), sample.size()) ;
+        if(file.bad())
+            return false ;
+        digest = crc32(digest, reinterpret_cast<const Bytef*>(sample.data()), (uInt)file.gcount()) ;
+        file.clear() ;
+    }
+
+    identity.sampleDigest = (uint32_t)digest ;
+    identity.isSampled = true ;
+    return true ;
+}
+
+/**
+ * @brief FirmwareImage::isSameContent : Compare two binaries of the same size, the comparison stops at the first difference.
+ * @param filePath: The first binary path, without quotes.
+ * @param otherFilePath: The second binary path, without quotes.
+ * @return True if both files are readable and hold the same bytes.
+ */
+bool FirmwareImage::isSameContent(const std::string &filePath, const std::string &otherFilePath)
+{
+    std::ifstream file(filePath, std::ios::binary) ;
+    std::ifstream otherFile(otherFilePath, std::ios::binary) ;
+    if((file.is_open() == false) || (otherFile.is_open() == false))
+        return false ;
+
+    constexpr size_t COMPARE_CHUNK_SIZE = 1024 * 1024 ;
+    std::vector<char> chunk(COMPARE_CHUNK_SIZE) ;
+    std::vector<char> otherChunk(COMPARE_CHUNK_SIZE) ;
+    while(true)
+    {
+        file.read(chunk.data(), chunk.size()) ;
+        otherFile.read(otherChunk.data(), otherChunk.size()) ;
+        if((file.gcount() != otherFile.gcount()) || (memcmp(chunk.data(), otherChunk.data(), (size_t)file.gcount()) != 0))
+            return false ;
+
+        if(file.gcount() < (std::streamsize)chunk.size())
+            return file.eof() && otherFile.eof() ;
+    }
+}
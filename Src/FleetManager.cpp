@@ -0,0 +1,469 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "FleetManager.h"
+#include "ProgramManager.h"
+#include "DFU.h"
+#include "TransferScheduler.h"
+#include "WaveScheduler.h"
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <experimental/filesystem>
+
+namespace fs = std::experimental::filesystem ;
+
+FleetManager::FleetManager(const std::string &toolboxFolder)
+{
+    this->toolboxFolder = toolboxFolder ;
+    maxRootPortTransfers = FLEET_DEFAULT_ROOT_PORT_TRANSFERS ;
+    maxHubTransfers = FLEET_DEFAULT_HUB_TRANSFERS ;
+    durationMs = 0 ;
+}
+
+/**
+ * @brief FleetManager::loadMapFile : Add one job per line of a map file "serialNumber tsvFilePath".
+ * Empty lines and lines starting with '#' are ignored, a relative TSV path is relative to the map file folder.
+ * @param mapFilePath: The map file path.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int FleetManager::loadMapFile(const std::string &mapFilePath)
+{
+    std::ifstream mapFile(mapFilePath);
+    if(mapFile.is_open() == false)
+    {
+        displayManager.print(MSG_ERROR, L"The file does not exist :  %s", mapFilePath.c_str());
+        return TOOLBOX_DFU_ERROR_NO_FILE ;
+    }
+
+    fs::path mapFolder = fs::path(mapFilePath).parent_path() ;
+    std::string line ;
+    int lineNumber = 0 ;
+    while(std::getline(mapFile, line))
+    {
+        lineNumber++ ;
+        std::istringstream fields(line) ;
+        std::string serialNumber, tsvFilePath, extraField ;
+        if(!(fields >> serialNumber) || (serialNumber[0] == '#'))
+            continue ;
+
+        if(!(fields >> tsvFilePath) || (fields >> extraField))
+        {
+            displayManager.print(MSG_ERROR, L"Map file line %d : expected \"serialNumber tsvFilePath\"", lineNumber);
+            return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+        }
+
+        if(fs::path(tsvFilePath).is_relative() && (mapFolder.empty() == false))
+            tsvFilePath = (mapFolder / tsvFilePath).string() ;
+
+        int ret = addJob(serialNumber, tsvFilePath) ;
+        if(ret != TOOLBOX_DFU_NO_ERROR)
+            return ret ;
+    }
+
+    if(jobs.empty())
+    {
+        displayManager.print(MSG_ERROR, L"No device in the map file : %s", mapFilePath.c_str());
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+    }
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief FleetManager::discoverDevices : Add one job per attached DFU device which is not in use by another instance.
+ * @param tsvFilePath: The TSV file to deploy on every device.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int FleetManager::discoverDevices(const std::string &tsvFilePath)
+{
+    DFU dfuInterface ;
+    dfuInterface.toolboxFolder = toolboxFolder ;
+    int ret = dfuInterface.scanDevices() ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    for(const DiscoveredDevice &device : dfuInterface.getDeviceIndex().getDevices())
+    {
+        if(device.serialNumber.empty())
+        {
+            displayManager.print(MSG_WARNING, L"Device %d skipped : no serial number", device.deviceNumber);
+        }
+        else if(device.mode == DEVICE_MODE_FASTBOOT)
+        {
+            displayManager.print(MSG_WARNING, L"Device %s skipped : it runs in Fastboot mode", device.serialNumber.c_str());
+        }
+        else if(device.lockOwnerPid != 0)
+        {
+            displayManager.print(MSG_WARNING, L"Device %s skipped : it is in use by another process", device.serialNumber.c_str());
+        }
+        else
+        {
+            ret = addJob(device.serialNumber, tsvFilePath) ;
+            if(ret != TOOLBOX_DFU_NO_ERROR)
+                return ret ;
+            jobs.back().portPath = device.portPath ;
+        }
+    }
+
+    if(jobs.empty())
+    {
+        displayManager.print(MSG_ERROR, L"No STM32 DFU device available.");
+        return TOOLBOX_DFU_ERROR_NO_DEVICE ;
+    }
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief FleetManager::setTransferLimits : Set the number of bulk phases allowed at the same time in the USB tree.
+ * @param maxPerRootPort: Limit for the devices behind a same root port, 0 for no limit.
+ * @param maxPerHub: Limit for the devices plugged in a same hub, 0 for no limit.
+ */
+void FleetManager::setTransferLimits(uint32_t maxPerRootPort, uint32_t maxPerHub)
+{
+    maxRootPortTransfers = maxPerRootPort ;
+    maxHubTransfers = maxPerHub ;
+}
+
+/**
+ * @brief FleetManager::run : Run the service on every device, at most jobsNumber devices at a time.
+ * @param service: The service to run.
+ * @param jobsNumber: The number of worker threads, FLEET_DEFAULT_JOBS if 0.
+ * @param isStartFastboot: Ask to launch the fastboot mode or not (install service).
+ * @return 0 if the service succeeded on every device, otherwise an error occurred.
+ */
+int FleetManager::run(FLEET_SERVICE service, uint32_t jobsNumber, bool isStartFastboot)
+{
+    if(jobs.empty())
+        return TOOLBOX_DFU_ERROR_NO_DEVICE ;
+
+    int ret = createLogDirectory() ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    if(jobsNumber == 0)
+        jobsNumber = FLEET_DEFAULT_JOBS ;
+    if(jobsNumber > jobs.size())
+        jobsNumber = jobs.size() ;
+
+    locateDevices() ;
+    TransferScheduler::getInstance().setLimits(maxRootPortTransfers, maxHubTransfers) ;
+    TransferScheduler::getInstance().resetStatistics() ;
+
+    displayManager.print(MSG_NORMAL, L"-----------------------------------------");
+    displayManager.print(MSG_GREEN, L"Fleet %s...", (service == FLEET_SERVICE_INSTALL) ? "installing" : "flashing");
+    displayManager.print(MSG_NORMAL, L"  Devices number     : %d", (int)jobs.size());
+    displayManager.print(MSG_NORMAL, L"  Parallel jobs      : %d", jobsNumber);
+    displayManager.print(MSG_NORMAL, L"  Transfers per port : %d per root port, %d per hub (0 : no limit)", maxRootPortTransfers, maxHubTransfers);
+    displayManager.print(MSG_NORMAL, L"  Logs folder        : %s", logDirectory.c_str());
+    displayManager.print(MSG_NORMAL, L"-----------------------------------------\n");
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers ;
+    for(uint32_t workerIndex = 0; workerIndex < jobsNumber; workerIndex++)
+        workers.emplace_back(&FleetManager::runWorker, this, service, isStartFastboot) ;
+
+    for(std::thread &worker : workers)
+        worker.join() ;
+
+    TransferScheduler::getInstance().setLimits(0, 0) ;
+
+    durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() ;
+
+    for(const FleetJob &job : jobs)
+    {
+        if(job.status != TOOLBOX_DFU_NO_ERROR)
+            return TOOLBOX_DFU_ERROR_OTHER ;
+    }
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief FleetManager::runWave : Run the install service on every device from a single thread with the WaveScheduler,
+ * which overlaps the reboots of the devices.
+ * @param isStartFastboot: Ask to launch the fastboot mode or not.
+ * @return 0 if the service succeeded on every device, otherwise an error occurred.
+ */
+int FleetManager::runWave(bool isStartFastboot)
+{
+    if(jobs.empty())
+        return TOOLBOX_DFU_ERROR_NO_DEVICE ;
+
+    int ret = createLogDirectory() ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    displayManager.print(MSG_NORMAL, L"-----------------------------------------");
+    displayManager.print(MSG_GREEN, L"Fleet installing by waves...");
+    displayManager.print(MSG_NORMAL, L"  Devices number     : %d", (int)jobs.size());
+    displayManager.print(MSG_NORMAL, L"  Logs folder        : %s", logDirectory.c_str());
+    displayManager.print(MSG_NORMAL, L"-----------------------------------------\n");
+
+    auto start = std::chrono::steady_clock::now();
+    TransferScheduler::getInstance().resetStatistics() ;
+    WaveScheduler waveScheduler(toolboxFolder) ;
+    ret = waveScheduler.run(jobs, isStartFastboot) ;
+    durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() ;
+
+    displayManager.print(MSG_NORMAL, L"") ;
+    waveScheduler.displayStatistics() ;
+    return ret ;
+}
+
+/**
+ * @brief FleetManager::displayResults : Display the result of each device and the fleet summary.
+ */
+void FleetManager::displayResults()
+{
+    uint32_t succeededCount = 0 ;
+    displayManager.print(MSG_NORMAL, L"\n  %-24s %-16s %-10s %s", "Serial number", "Status", "Time", "Log");
+    for(const FleetJob &job : jobs)
+    {
+        std::string status = (job.isDone == false) ? "NOT RUN" : (job.status == TOOLBOX_DFU_NO_ERROR) ? "OK" : "FAILED (" + std::to_string(job.status) + ")" ;
+        std::string duration = std::to_string(job.durationMs / 1000) + "." + std::to_string((job.durationMs % 1000) / 100) + " s" ;
+        displayManager.print(MSG_NORMAL, L"  %-24s %-16s %-10s %s", job.serialNumber.c_str(), status.c_str(), duration.c_str(), job.logFilePath.c_str());
+        if(job.status == TOOLBOX_DFU_NO_ERROR)
+            succeededCount++ ;
+    }
+
+    displayManager.print(MSG_NORMAL, L"") ;
+    if(succeededCount == jobs.size())
+        displayManager.print(MSG_GREEN, L"Fleet done : %d devices in %llu ms", succeededCount, (unsigned long long)durationMs);
+    else
+        displayManager.print(MSG_ERROR, L"Fleet failed on %d of %d devices, in %llu ms", (int)(jobs.size() - succeededCount), (int)jobs.size(), (unsigned long long)durationMs);
+}
+
+/**
+ * @brief FleetManager::displayUsbUtilization : Display the load of each bus and root port over the last run.
+ * The busy part is the share of the run with at least one transfer, the overlap is the mean number of transfers
+ * running together while busy, and the wait is the time the transfers were delayed by the limits.
+ */
+void FleetManager::displayUsbUtilization()
+{
+    std::vector<SegmentUtilization> utilization = TransferScheduler::getInstance().getUtilization() ;
+    if(utilization.empty())
+        return ;
+
+    displayManager.print(MSG_NORMAL, L"\n  %-12s %10s %12s %8s %8s %6s %10s", "USB", "Transfers", "Data (KB)", "Busy", "Overlap", "Max", "Wait (ms)");
+    for(const SegmentUtilization &segment : utilization)
+    {
+        bool isBus = (segment.name.compare(0, 3, "usb") == 0) || (segment.name == "unknown") ;
+        std::string name = isBus ? segment.name : "  " + segment.name ;
+        double busyPercent = (durationMs != 0) ? (segment.busyMs * 100.0) / durationMs : 0.0 ;
+        double overlap = (segment.busyMs != 0) ? (double)segment.transferMs / segment.busyMs : 0.0 ;
+        displayManager.print(MSG_NORMAL, L"  %-12s %10d %12llu %7.1f%% %8.2f %6d %10llu", name.c_str(), segment.transferCount, (unsigned long long)(segment.bytes / 1024), busyPercent, overlap, segment.maxConcurrent, (unsigned long long)segment.waitMs);
+    }
+}
+
+/**
+ * @brief FleetManager::getJobs
+ * @return The jobs, with their results once run() returned.
+ */
+const std::vector<FleetJob>& FleetManager::getJobs() const
+{
+    return jobs ;
+}
+
+/**
+ * @brief FleetManager::addJob : Add a device to the fleet, each serial number appears once.
+ * @param serialNumber: The device serial number.
+ * @param tsvFilePath: The TSV file to deploy on the device.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int FleetManager::addJob(const std::string &serialNumber, const std::string &tsvFilePath)
+{
+    if((tsvFilePath.size() < 4) || (tsvFilePath.substr(tsvFilePath.size() - 4) != ".tsv"))
+    {
+        displayManager.print(MSG_ERROR, L"Device %s : wrong file extension %s, expected file extension is .tsv", serialNumber.c_str(), tsvFilePath.c_str());
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+    }
+
+    for(const FleetJob &job : jobs)
+    {
+        if(job.serialNumber == serialNumber)
+        {
+            displayManager.print(MSG_ERROR, L"Device %s is listed twice", serialNumber.c_str());
+            return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+        }
+    }
+
+    FleetJob job = FleetJob() ;
+    job.serialNumber = serialNumber ;
+    job.tsvFilePath = tsvFilePath ;
+    job.status = TOOLBOX_DFU_ERROR_OTHER ;
+    jobs.push_back(job) ;
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief FleetManager::createLogDirectory : Create the folder of the device logs, PRG_TOOLBOX_DFU_LOG_DIR if set,
+ * otherwise PRG-TOOLBOX-DFU-logs in the working directory. Each device log is named after its serial number.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int FleetManager::createLogDirectory()
+{
+    const char *envLogDirectory = std::getenv("PRG_TOOLBOX_DFU_LOG_DIR") ;
+    logDirectory = ((envLogDirectory != nullptr) && (envLogDirectory[0] != '\0')) ? envLogDirectory : "PRG-TOOLBOX-DFU-logs" ;
+
+    std::error_code errorCode ;
+    fs::create_directories(logDirectory, errorCode) ;
+    if(fs::is_directory(logDirectory, errorCode) == false)
+    {
+        displayManager.print(MSG_ERROR, L"Could not create the logs folder %s", logDirectory.c_str());
+        return TOOLBOX_DFU_ERROR_NO_FILE ;
+    }
+
+    for(FleetJob &job : jobs)
+        job.logFilePath = getLogFilePath(job.serialNumber) ;
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief FleetManager::getLogFilePath : Get the log file of a device, in the folder made by createLogDirectory().
+ * @param serialNumber: The device serial number, the characters which do not fit a file name are replaced by '_'.
+ * @return The log file path.
+ */
+std::string FleetManager::getLogFilePath(const std::string &serialNumber) const
+{
+    std::string fileName = serialNumber ;
+    for(char &character : fileName)
+    {
+        if((isalnum((unsigned char)character) == 0) && (character != '-') && (character != '_'))
+            character = '_' ;
+    }
+
+    return (fs::path(logDirectory) / (fileName + ".log")).string() ;
+}
+
+/**
+ * @brief FleetManager::locateDevices : Find the USB port of the devices given by serial number only, best effort.
+ */
+void FleetManager::locateDevices()
+{
+    DFU dfuInterface ;
+    dfuInterface.toolboxFolder = toolboxFolder ;
+    if(dfuInterface.scanDevices() != TOOLBOX_DFU_NO_ERROR)
+        return ;
+
+    for(FleetJob &job : jobs)
+    {
+        const DiscoveredDevice *device = dfuInterface.getDeviceIndex().findBySerialNumber(job.serialNumber) ;
+        if(job.portPath.empty() && (device != nullptr))
+            job.portPath = device->portPath ;
+    }
+}
+
+/**
+ * @brief FleetManager::takeNextJob : Pick the pending job whose root port runs the fewest jobs, in the list order on a tie.
+ * @return The job, marked as started, nullptr if no job is pending.
+ */
+FleetJob* FleetManager::takeNextJob()
+{
+    std::lock_guard<std::mutex> lock(jobsMutex);
+    FleetJob *nextJob = nullptr ;
+    uint32_t nextJobLoad = 0 ;
+    for(FleetJob &job : jobs)
+    {
+        if(job.isStarted)
+            continue ;
+
+        uint32_t load = rootPortJobs[TransferScheduler::getTopology(job.portPath).rootPort] ;
+        if((nextJob == nullptr) || (load < nextJobLoad))
+        {
+            nextJob = &job ;
+            nextJobLoad = load ;
+        }
+    }
+
+    if(nextJob != nullptr)
+    {
+        nextJob->isStarted = true ;
+        rootPortJobs[TransferScheduler::getTopology(nextJob->portPath).rootPort]++ ;
+    }
+
+    return nextJob ;
+}
+
+/**
+ * @brief FleetManager::finishJob : Release the root port of a job taken by takeNextJob().
+ * @param job: The finished job.
+ */
+void FleetManager::finishJob(FleetJob &job)
+{
+    std::lock_guard<std::mutex> lock(jobsMutex);
+    rootPortJobs[TransferScheduler::getTopology(job.portPath).rootPort]-- ;
+}
+
+/**
+ * @brief FleetManager::runWorker : Run the pending jobs one after the other until none is left.
+ * @param service: The service to run.
+ * @param isStartFastboot: Ask to launch the fastboot mode or not (install service).
+ */
+void FleetManager::runWorker(FLEET_SERVICE service, bool isStartFastboot)
+{
+    for(FleetJob *job = takeNextJob(); job != nullptr; job = takeNextJob())
+    {
+        runJob(*job, service, isStartFastboot) ;
+        finishJob(*job) ;
+    }
+}
+
+/**
+ * @brief FleetManager::runJob : Run the service on one device, with the messages of the thread sent to the device log.
+ * @param job: The job to run, updated with its result.
+ * @param service: The service to run.
+ * @param isStartFastboot: Ask to launch the fastboot mode or not (install service).
+ * @param parsedTsvFile: The job TSV file already parsed for the service and shared between the jobs, nullptr to parse it.
+ */
+void FleetManager::runJob(FleetJob &job, FLEET_SERVICE service, bool isStartFastboot, fileTSV *parsedTsvFile)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::ofstream logFile(job.logFilePath, std::ios::out | std::ios::trunc) ;
+    if(logFile.is_open() == false)
+        displayManager.print(MSG_WARNING, L"Device %s : could not open the log file %s, messages are printed on the console", job.serialNumber.c_str(), job.logFilePath.c_str());
+
+    DisplayManager::setThreadOutput({logFile.is_open() ? &logFile : nullptr, "[" + job.serialNumber + "] ", logFile.is_open() ? CONSOLE_MILESTONES : CONSOLE_ALL, nullptr, nullptr}) ;
+    displayManager.print(MSG_GREEN, L"Started : %s", job.tsvFilePath.c_str());
+
+    ProgramManager *programMng = new ProgramManager(toolboxFolder, job.serialNumber);
+    if(parsedTsvFile != nullptr)
+        programMng->useParsedTsvFile(parsedTsvFile);
+    if(service == FLEET_SERVICE_INSTALL)
+        job.status = programMng->startInstallService(job.tsvFilePath, isStartFastboot);
+    else
+        job.status = programMng->startFlashingService(job.tsvFilePath);
+    delete programMng;
+
+    job.durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() ;
+    job.isDone = true ;
+    if(job.status == TOOLBOX_DFU_NO_ERROR)
+        displayManager.print(MSG_GREEN, L"Done in %llu ms", (unsigned long long)job.durationMs);
+    else
+        displayManager.print(MSG_ERROR, L"Failed with error %d after %llu ms, see %s", job.status, (unsigned long long)job.durationMs, job.logFilePath.c_str());
+
+    DisplayManager::resetThreadOutput() ;
+}
@@ -0,0 +1,259 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "HotplugMonitor.h"
+#include "SysfsUsb.h"
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#ifdef __linux__
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#endif
+
+constexpr size_t HOTPLUG_BUFFER_SIZE = 8192;
+constexpr uint32_t UDEV_MONITOR_MAGIC = 0xfeedcafe;
+constexpr uint32_t NETLINK_GROUP_KERNEL = 1;   // Raw kernel uevents
+constexpr uint32_t NETLINK_GROUP_UDEV = 2;     // Events re-sent by udev once the rules (permissions) are applied
+constexpr const char* UDEV_CONTROL_PATH = "/run/udev/control";   // Socket of a running udevd
+
+HotplugMonitor::HotplugMonitor()
+{
+    socketDescriptor = -1 ;
+}
+
+HotplugMonitor::~HotplugMonitor()
+{
+    close();
+}
+
+/**
+ * @brief HotplugMonitor::open : Subscribe to the udev uevents, or to the kernel uevents when udevd is not running.
+ * @return True if the events can be received, otherwise false and the caller has to poll.
+ * @note The kernel uevent comes before udev applies the node permissions, a device opened on it is not accessible yet.
+ */
+bool HotplugMonitor::open()
+{
+#ifdef __linux__
+    if(isOpen())
+        return true ;
+
+    socketDescriptor = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+    if(socketDescriptor < 0)
+        return false ;
+
+    struct sockaddr_nl address ;
+    memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK ;
+    address.nl_groups = (access(UDEV_CONTROL_PATH, F_OK) == 0) ? NETLINK_GROUP_UDEV : NETLINK_GROUP_KERNEL ;
+    if(bind(socketDescriptor, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0)
+    {
+        close();
+        return false ;
+    }
+
+    return true ;
+#else
+    return false ;
+#endif
+}
+
+void HotplugMonitor::close()
+{
+#ifdef __linux__
+    if(socketDescriptor >= 0)
+        ::close(socketDescriptor);
+#endif
+    socketDescriptor = -1 ;
+}
+
+bool HotplugMonitor::isOpen() const
+{
+    return (socketDescriptor >= 0) ;
+}
+
+/**
+ * @brief HotplugMonitor::flush : Drop the pending events, the caller checks the current device state right after.
+ */
+void HotplugMonitor::flush()
+{
+#ifdef __linux__
+    if(isOpen() == false)
+        return ;
+
+    std::vector<char> buffer(HOTPLUG_BUFFER_SIZE);
+    while((recv(socketDescriptor, buffer.data(), buffer.size(), 0) >= 0) || (errno == ENOBUFS) || (errno == EINTR))
+    {
+    }
+#endif
+}
+
+/**
+ * @brief HotplugMonitor::waitEvent : Wait for the next USB device event.
+ * @param deadline: The time point after which the wait is given up.
+ * @param event: Output event, valid when HOTPLUG_EVENT_RECEIVED is returned.
+ * @return The wait status.
+ */
+HOTPLUG_WAIT_STATUS HotplugMonitor::waitEvent(const std::chrono::steady_clock::time_point &deadline, HotplugEvent &event)
+{
+#ifdef __linux__
+    if(isOpen() == false)
+        return HOTPLUG_NOT_SUPPORTED ;
+
+    std::vector<char> buffer(HOTPLUG_BUFFER_SIZE);
+    while(true)
+    {
+        ssize_t size = recv(socketDescriptor, buffer.data(), buffer.size() - 1, 0);
+        if(size > 0)
+        {
+            buffer[size] = '\0' ;
+            if(parseEvent(buffer.data(), size, event))
+                return HOTPLUG_EVENT_RECEIVED ;
+            continue ;
+        }
+
+        if((size < 0) && (errno == ENOBUFS))
+            return HOTPLUG_EVENTS_LOST ;
+        if((size < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+            return HOTPLUG_NOT_SUPPORTED ;
+
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if(remaining <= 0)
+            return HOTPLUG_DEADLINE_REACHED ;
+
+        struct pollfd descriptor ;
+        descriptor.fd = socketDescriptor ;
+        descriptor.events = POLLIN ;
+        descriptor.revents = 0 ;
+        if((poll(&descriptor, 1, static_cast<int>(remaining)) < 0) && (errno != EINTR))
+            return HOTPLUG_NOT_SUPPORTED ;
+    }
+#else
+    (void)deadline;
+    (void)event;
+    return HOTPLUG_NOT_SUPPORTED ;
+#endif
+}
+
+/**
+ * @brief HotplugMonitor::wait : Wait until a device with the given IDs (and serial number) appears or disappears.
+ * @param vendorID: USB vendor ID.
+ * @param productID: USB product ID.
+ * @param serialNumber: Serial number filter, empty to accept any device.
+ * @param deadline: The time point after which the wait is given up.
+ * @return The wait status.
+ */
+HOTPLUG_WAIT_STATUS HotplugMonitor::wait(uint16_t vendorID, uint16_t productID, const std::string &serialNumber, const std::chrono::steady_clock::time_point &deadline)
+{
+    while(true)
+    {
+        HotplugEvent event ;
+        HOTPLUG_WAIT_STATUS status = waitEvent(deadline, event) ;
+        if(status != HOTPLUG_EVENT_RECEIVED)
+            return status ;
+
+        if((event.vendorID != vendorID) || (event.productID != productID))
+            continue ;
+
+        /* The serial number of a removed device cannot be read anymore, the waiter checks it again anyway */
+        if((serialNumber.empty() == false) && (event.serialNumber.empty() == false) && (event.serialNumber != serialNumber))
+            continue ;
+
+        return HOTPLUG_EVENT_RECEIVED ;
+    }
+}
+
+/**
+ * @brief HotplugMonitor::parseEvent : Decode a kernel ("action@devpath" header) or a udev ("libudev" header) uevent.
+ * @param buffer: The received message, properties are "KEY=VALUE" strings separated by '\0'.
+ * @param size: The message size.
+ * @param event: Output event.
+ * @return True if the message is an event of a USB device, otherwise false.
+ */
+bool HotplugMonitor::parseEvent(const char *buffer, size_t size, HotplugEvent &event)
+{
+    size_t offset = 0 ;
+    if((size >= 8) && (memcmp(buffer, "libudev", 8) == 0))
+    {
+        uint32_t magic = 0 ;
+        uint32_t propertiesOffset = 0 ;
+        if(size < 24)
+            return false ;
+        memcpy(&magic, buffer + 8, sizeof(magic));
+        memcpy(&propertiesOffset, buffer + 16, sizeof(propertiesOffset));
+        if(ntohl(magic) != UDEV_MONITOR_MAGIC)
+            return false ;
+        offset = propertiesOffset ;
+    }
+    else
+    {
+        offset = strnlen(buffer, size) + 1 ;
+    }
+
+    std::string subsystem ;
+    std::string devType ;
+    std::string product ;
+    event = HotplugEvent() ;
+    while(offset < size)
+    {
+        const char *entry = buffer + offset ;
+        size_t length = strnlen(entry, size - offset) ;
+        const char *separator = static_cast<const char*>(memchr(entry, '=', length)) ;
+        if(separator != nullptr)
+        {
+            std::string key(entry, separator - entry) ;
+            std::string value(separator + 1, entry + length) ;
+            if(key == "ACTION")
+                event.action = value ;
+            else if(key == "DEVPATH")
+                event.devPath = value ;
+            else if(key == "SUBSYSTEM")
+                subsystem = value ;
+            else if(key == "DEVTYPE")
+                devType = value ;
+            else if(key == "PRODUCT")
+                product = value ;
+            else if(key == "ID_SERIAL_SHORT")
+                event.serialNumber = value ;
+        }
+        offset += length + 1 ;
+    }
+
+    if((subsystem != "usb") || (devType != "usb_device") || product.empty())
+        return false ;
+
+    /* PRODUCT=<idVendor>/<idProduct>/<bcdDevice> in hexadecimal without leading zeros */
+    char *end = nullptr ;
+    event.vendorID = static_cast<uint16_t>(strtoul(product.c_str(), &end, 16)) ;
+    if((end == nullptr) || (*end != '/'))
+        return false ;
+    event.productID = static_cast<uint16_t>(strtoul(end + 1, nullptr, 16)) ;
+
+    if(event.serialNumber.empty() && (event.action != "remove"))
+        event.serialNumber = SysfsUsb::readSerialNumber(event.devPath) ;
+
+    return true ;
+}
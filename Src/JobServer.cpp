@@ -0,0 +1,532 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "JobServer.h"
+#include "ProgramManager.h"
+#include "DFU.h"
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <experimental/filesystem>
+#ifndef _WIN32
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#endif
+
+namespace fs = std::experimental::filesystem ;
+
+volatile std::sig_atomic_t JobServer::isStopRequested = 0 ;
+
+JobServer::JobServer(const std::string &toolboxFolder)
+{
+    this->toolboxFolder = toolboxFolder ;
+    listenDescriptor = -1 ;
+    jobCount = 0 ;
+}
+
+JobServer::~JobServer()
+{
+    joinClients(true) ;
+    closeSocket() ;
+}
+
+/**
+ * @brief JobServer::run : Serve the clients until the SIGINT (Ctrl+C) or SIGTERM signal, the running jobs are completed.
+ * @param socketPath: The path of the Unix domain socket, a socket left by a daemon which is not running is replaced.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int JobServer::run(const std::string &socketPath)
+{
+#ifdef _WIN32
+    (void)socketPath ;
+    displayManager.print(MSG_ERROR, L"The daemon mode is not supported on this platform") ;
+    return TOOLBOX_DFU_ERROR_NOT_SUPPORTED ;
+#else
+    this->socketPath = socketPath ;
+    int ret = openSocket() ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    isStopRequested = 0 ;
+    void (*previousIntHandler)(int) = std::signal(SIGINT, &JobServer::handleStopSignal) ;
+    void (*previousTermHandler)(int) = std::signal(SIGTERM, &JobServer::handleStopSignal) ;
+
+    displayManager.print(MSG_GREEN, L"Daemon listening on %s, press Ctrl+C to stop", socketPath.c_str()) ;
+    while(isStopRequested == 0)
+    {
+        struct pollfd pollDescriptor = {listenDescriptor, POLLIN, 0} ;
+        if(poll(&pollDescriptor, 1, JOB_POLL_MS) > 0)
+        {
+            int socketDescriptor = accept(listenDescriptor, nullptr, nullptr) ;
+            if(socketDescriptor >= 0)
+                startClient(socketDescriptor) ;
+        }
+
+        joinClients(false) ;
+    }
+
+    displayManager.print(MSG_NORMAL, L"\nDaemon stopping, waiting for the running jobs") ;
+    closeSocket() ;
+    joinClients(true) ;
+
+    std::signal(SIGINT, previousIntHandler) ;
+    std::signal(SIGTERM, previousTermHandler) ;
+    displayManager.print(MSG_GREEN, L"Daemon stopped after %d jobs", (int)jobCount) ;
+    return TOOLBOX_DFU_NO_ERROR ;
+#endif
+}
+
+/**
+ * @brief JobServer::handleStopSignal : Stop accepting the clients and the jobs.
+ * @param signalNumber: The received signal.
+ */
+void JobServer::handleStopSignal(int signalNumber)
+{
+    (void)signalNumber ;
+    isStopRequested = 1 ;
+}
+
+/**
+ * @brief JobServer::openSocket : Create the listening socket at socketPath.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int JobServer::openSocket()
+{
+#ifdef _WIN32
+    return TOOLBOX_DFU_ERROR_NOT_SUPPORTED ;
+#else
+    struct sockaddr_un address ;
+    memset(&address, 0, sizeof(address)) ;
+    address.sun_family = AF_UNIX ;
+    if(socketPath.empty() || (socketPath.size() >= sizeof(address.sun_path)))
+    {
+        displayManager.print(MSG_ERROR, L"Wrong socket path, at most %d characters : %s", (int)sizeof(address.sun_path) - 1, socketPath.c_str()) ;
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+    }
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1) ;
+
+    /* A socket file nobody answers on is left by a daemon which stopped abruptly, any other file is kept */
+    struct stat fileStat ;
+    if(lstat(socketPath.c_str(), &fileStat) == 0)
+    {
+        if(S_ISSOCK(fileStat.st_mode) == false)
+        {
+            displayManager.print(MSG_ERROR, L"%s already exists and is not a socket, it is kept", socketPath.c_str()) ;
+            return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+        }
+
+        int probeDescriptor = socket(AF_UNIX, SOCK_STREAM, 0) ;
+        if(probeDescriptor < 0)
+        {
+            displayManager.print(MSG_ERROR, L"Could not create the daemon socket : %s", strerror(errno)) ;
+            return TOOLBOX_DFU_ERROR_OTHER ;
+        }
+        int status = connect(probeDescriptor, (struct sockaddr*)&address, sizeof(address)) ;
+        int error = errno ;
+        ::close(probeDescriptor) ;
+        if(status == 0)
+        {
+            displayManager.print(MSG_ERROR, L"Another daemon is already listening on %s", socketPath.c_str()) ;
+            return TOOLBOX_DFU_ERROR_DEVICE_BUSY ;
+        }
+        if(error != ECONNREFUSED)
+        {
+            displayManager.print(MSG_ERROR, L"Could not check the socket %s : %s", socketPath.c_str(), strerror(error)) ;
+            return TOOLBOX_DFU_ERROR_OTHER ;
+        }
+        unlink(socketPath.c_str()) ;
+    }
+
+    listenDescriptor = socket(AF_UNIX, SOCK_STREAM, 0) ;
+    if((listenDescriptor < 0) || (bind(listenDescriptor, (struct sockaddr*)&address, sizeof(address)) != 0) || (listen(listenDescriptor, SOMAXCONN) != 0))
+    {
+        displayManager.print(MSG_ERROR, L"Could not listen on %s : %s", socketPath.c_str(), strerror(errno)) ;
+        if(listenDescriptor >= 0)
+            ::close(listenDescriptor) ;
+        listenDescriptor = -1 ;
+        return TOOLBOX_DFU_ERROR_OTHER ;
+    }
+
+    return TOOLBOX_DFU_NO_ERROR ;
+#endif
+}
+
+/**
+ * @brief JobServer::closeSocket : Stop listening and remove the socket file.
+ */
+void JobServer::closeSocket()
+{
+#ifndef _WIN32
+    if(listenDescriptor < 0)
+        return ;
+
+    ::close(listenDescriptor) ;
+    listenDescriptor = -1 ;
+    unlink(socketPath.c_str()) ;
+#endif
+}
+
+/**
+ * @brief JobServer::startClient : Start the worker serving a new client connection.
+ * @param socketDescriptor: The client socket, closed by the worker.
+ */
+void JobServer::startClient(int socketDescriptor)
+{
+    clients.emplace_back() ;
+    JobClient &client = clients.back() ;
+    client.socketDescriptor = socketDescriptor ;
+    client.isFinished = false ;
+    client.worker = std::thread(&JobServer::serveClient, this, &client) ;
+}
+
+/**
+ * @brief JobServer::joinClients : Join the workers of the clients.
+ * @param isAllJoined: True to wait for every worker, false to only join the workers which are done.
+ */
+void JobServer::joinClients(bool isAllJoined)
+{
+    for(auto client = clients.begin(); client != clients.end(); )
+    {
+        if(isAllJoined || client->isFinished)
+        {
+            client->worker.join() ;
+            client = clients.erase(client) ;
+        }
+        else
+        {
+            ++client ;
+        }
+    }
+}
+
+/**
+ * @brief JobServer::serveClient : Worker of a client, run its requests in order until it disconnects or the daemon stops.
+ * @param client: The client.
+ */
+void JobServer::serveClient(JobClient *client)
+{
+#ifndef _WIN32
+    std::string pending ;
+    char buffer[4096] ;
+    while(isStopRequested == 0)
+    {
+        struct pollfd pollDescriptor = {client->socketDescriptor, POLLIN, 0} ;
+        int ret = poll(&pollDescriptor, 1, JOB_POLL_MS) ;
+        if(ret == 0)
+            continue ;
+        if((ret < 0) && (errno == EINTR))
+            continue ;
+
+        ssize_t size = (ret > 0) ? recv(client->socketDescriptor, buffer, sizeof(buffer), 0) : -1 ;
+        if(size <= 0)
+            break ;
+
+        pending.append(buffer, size) ;
+        size_t lineEnd = pending.find('\n') ;
+        while((lineEnd != std::string::npos) && (isStopRequested == 0))
+        {
+            std::string line = pending.substr(0, lineEnd) ;
+            pending.erase(0, lineEnd + 1) ;
+            if(line.find_first_not_of(" \t\r") != std::string::npos)
+            {
+                JsonMessage request ;
+                if(request.parse(line))
+                {
+                    runJob(client->socketDescriptor, request) ;
+                }
+                else
+                {
+                    JsonMessage result ;
+                    result.setString("event", "done") ;
+                    result.setNumber("status", TOOLBOX_DFU_ERROR_WRONG_PARAM) ;
+                    result.setString("error", "the request is not a flat JSON object") ;
+                    sendMessage(client->socketDescriptor, result) ;
+                }
+            }
+            lineEnd = pending.find('\n') ;
+        }
+
+        if(pending.size() > JOB_MAX_REQUEST_SIZE)
+        {
+            displayManager.print(MSG_WARNING, L"Daemon client dropped : request longer than %d bytes", (int)JOB_MAX_REQUEST_SIZE) ;
+            break ;
+        }
+    }
+
+    ::close(client->socketDescriptor) ;
+#endif
+    client->isFinished = true ;
+}
+
+/**
+ * @brief JobServer::runJob : Run one request, its messages are streamed to the client as they are printed.
+ * @param socketDescriptor: The client socket.
+ * @param request: The request.
+ */
+void JobServer::runJob(int socketDescriptor, const JsonMessage &request)
+{
+    uint32_t jobNumber = ++jobCount ;
+    std::string jobId = request.getString("id", std::to_string(jobNumber)) ;
+    std::string type = request.getString("type") ;
+
+    JsonMessage event ;
+    event.setString("id", jobId) ;
+    event.setString("event", "accepted") ;
+    event.setString("type", type) ;
+    sendMessage(socketDescriptor, event) ;
+
+    DisplayManager::setThreadOutput({nullptr, "[job " + jobId + "] ", CONSOLE_MILESTONES, [socketDescriptor, jobId](messageType type, const std::string &text) {
+        JsonMessage message ;
+        message.setString("id", jobId) ;
+        message.setString("event", "message") ;
+        message.setString("level", getLevelName(type)) ;
+        message.setString("text", text) ;
+        sendMessage(socketDescriptor, message) ;
+    }, nullptr}) ;
+
+    auto start = std::chrono::steady_clock::now() ;
+    JsonMessage result ;
+    result.setString("id", jobId) ;
+    result.setString("event", "done") ;
+    result.setNumber("status", TOOLBOX_DFU_NO_ERROR) ;
+
+    int ret = TOOLBOX_DFU_NO_ERROR ;
+    if((type == "install") || (type == "flash"))
+        ret = runServiceJob(request, type == "flash") ;
+    else if((type == "otp-read") || (type == "otp-write"))
+        ret = runOtpJob(request, type == "otp-write") ;
+    else if(type == "phase")
+        ret = runPhaseJob(request, result) ;
+    else if(type == "list")
+        ret = runListJob(socketDescriptor, jobId, result) ;
+    else
+    {
+        ret = TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+        result.setString("error", "unknown job type, expected install, flash, otp-read, otp-write, phase or list") ;
+    }
+
+    DisplayManager::resetThreadOutput() ;
+    uint64_t durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() ;
+    result.setNumber("status", ret) ;
+    result.setNumber("durationMs", (long long)durationMs) ;
+    sendMessage(socketDescriptor, result) ;
+
+    if(ret == TOOLBOX_DFU_NO_ERROR)
+        displayManager.print(MSG_NORMAL, L"Job %s : %s done in %llu ms", jobId.c_str(), type.c_str(), (unsigned long long)durationMs) ;
+    else
+        displayManager.print(MSG_ERROR, L"Job %s : %s failed with error %d", jobId.c_str(), type.c_str(), ret) ;
+}
+
+/**
+ * @brief JobServer::runServiceJob : Run the install ("tsv", optional "serial" and "fastboot") or the flashing ("tsv", optional "serial") service.
+ * @param request: The request.
+ * @param isFlashService: True for the flashing service, false for the install service.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int JobServer::runServiceJob(const JsonMessage &request, bool isFlashService)
+{
+    std::string tsvFilePath = request.getString("tsv") ;
+    bool isStartFastboot = isFlashService ? false : request.getBool("fastboot", true) ;
+    if((tsvFilePath.size() < 4) || (tsvFilePath.substr(tsvFilePath.size() - 4) != ".tsv"))
+    {
+        displayManager.print(MSG_ERROR, L"Wrong \"tsv\" field, expected file extension is .tsv") ;
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+    }
+
+    std::shared_ptr<fileTSV> parsedTsvFile ;
+    int ret = getParsedTsvFile(tsvFilePath, isStartFastboot, parsedTsvFile) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    ProgramManager programMng(toolboxFolder, request.getString("serial")) ;
+    programMng.useParsedTsvFile(parsedTsvFile.get()) ;
+    if(isFlashService)
+        return programMng.startFlashingService(tsvFilePath) ;
+
+    return programMng.startInstallService(tsvFilePath, isStartFastboot) ;
+}
+
+/**
+ * @brief JobServer::runOtpJob : Read the OTP partition into the "file" field path, or write it from this file.
+ * @param request: The request, with an optional "serial" field.
+ * @param isWrite: True to write the OTP partition, false to read it.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int JobServer::runOtpJob(const JsonMessage &request, bool isWrite)
+{
+    std::string filePath = request.getString("file") ;
+    if(filePath.empty())
+    {
+        displayManager.print(MSG_ERROR, L"Missing \"file\" field") ;
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+    }
+
+    ProgramManager programMng(toolboxFolder, request.getString("serial")) ;
+    return isWrite ? programMng.writeOtpPartition(filePath) : programMng.readOtpPartition(filePath) ;
+}
+
+/**
+ * @brief JobServer::runPhaseJob : Get the phase expected by the device, given in the "phase" and "detach" fields of the result.
+ * @param request: The request, with an optional "serial" field.
+ * @param result: The "done" event to complete.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int JobServer::runPhaseJob(const JsonMessage &request, JsonMessage &result)
+{
+    uint8_t phase = 0xFF ;
+    bool isNeedDetach = false ;
+    ProgramManager programMng(toolboxFolder, request.getString("serial")) ;
+    int ret = programMng.getPhase(&phase, &isNeedDetach) ;
+    if(ret == TOOLBOX_DFU_NO_ERROR)
+    {
+        result.setNumber("phase", phase) ;
+        result.setBool("detach", isNeedDetach) ;
+    }
+
+    return ret ;
+}
+
+/**
+ * @brief JobServer::runListJob : Send one "device" event per attached ST device, the count is given in the result.
+ * @param socketDescriptor: The client socket.
+ * @param jobId: The request id.
+ * @param result: The "done" event to complete.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int JobServer::runListJob(int socketDescriptor, const std::string &jobId, JsonMessage &result)
+{
+    DFU dfuInterface ;
+    dfuInterface.toolboxFolder = toolboxFolder ;
+    int ret = dfuInterface.scanDevices() ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    const std::vector<DiscoveredDevice> &devices = dfuInterface.getDeviceIndex().getDevices() ;
+    for(const DiscoveredDevice &device : devices)
+    {
+        JsonMessage event ;
+        event.setString("id", jobId) ;
+        event.setString("event", "device") ;
+        event.setString("serial", device.serialNumber) ;
+        event.setString("mode", DeviceIndex::getModeName(device.mode)) ;
+        event.setNumber("deviceId", device.deviceID) ;
+        event.setString("port", device.portPath) ;
+        event.setNumber("lockOwnerPid", device.lockOwnerPid) ;
+        sendMessage(socketDescriptor, event) ;
+    }
+
+    result.setNumber("count", (long long)devices.size()) ;
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief JobServer::getParsedTsvFile : Get a TSV file from the cache, it is parsed on its first use and each time it changed.
+ * @param tsvFilePath: The TSV file path.
+ * @param isStartFastboot: The fastboot option the file is parsed with.
+ * @param parsedTsvFile: Output parsed file, kept alive by the job even if the cache replaces it.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int JobServer::getParsedTsvFile(const std::string &tsvFilePath, bool isStartFastboot, std::shared_ptr<fileTSV> &parsedTsvFile)
+{
+    std::error_code errorCode ;
+    fs::path absolutePath = fs::absolute(tsvFilePath) ;
+    long long modificationTime = (long long)fs::last_write_time(absolutePath, errorCode).time_since_epoch().count() ;
+    unsigned long long fileSize = (unsigned long long)fs::file_size(absolutePath, errorCode) ;
+    if(errorCode)
+    {
+        displayManager.print(MSG_ERROR, L"The file does not exist :  %s", tsvFilePath.c_str()) ;
+        return TOOLBOX_DFU_ERROR_NO_FILE ;
+    }
+
+    std::string key = (isStartFastboot ? "1:" : "0:") + absolutePath.string() ;
+    std::lock_guard<std::mutex> lock(tsvCacheMutex) ;
+    auto cachedFile = tsvCache.find(key) ;
+    if((cachedFile != tsvCache.end()) && (cachedFile->second.modificationTime == modificationTime) && (cachedFile->second.fileSize == fileSize))
+    {
+        displayManager.print(MSG_NORMAL, L"TSV file already parsed : %s", tsvFilePath.c_str()) ;
+        parsedTsvFile = cachedFile->second.parsedTsvFile ;
+        return TOOLBOX_DFU_NO_ERROR ;
+    }
+
+    fileTSV *newTsvFile = nullptr ;
+    if(fileManager.openTsvFile(tsvFilePath, &newTsvFile, isStartFastboot) != 0)
+    {
+        displayManager.print(MSG_ERROR, L"Failed to download TSV partitions: %s", tsvFilePath.c_str()) ;
+        return TOOLBOX_DFU_ERROR_NO_FILE ;
+    }
+
+    parsedTsvFile.reset(newTsvFile) ;
+    tsvCache[key] = {parsedTsvFile, modificationTime, fileSize} ;
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief JobServer::getLevelName
+ * @param type: The message type.
+ * @return The level given in the "message" events.
+ */
+const char* JobServer::getLevelName(messageType type)
+{
+    switch(type)
+    {
+    case MSG_GREEN:
+        return "success" ;
+    case MSG_WARNING:
+        return "warning" ;
+    case MSG_ERROR:
+        return "error" ;
+    default:
+        return "info" ;
+    }
+}
+
+/**
+ * @brief JobServer::sendMessage : Send a message to a client as one JSON line.
+ * @param socketDescriptor: The client socket.
+ * @param message: The message.
+ * @return True if the message was sent, false if the client is gone.
+ */
+bool JobServer::sendMessage(int socketDescriptor, const JsonMessage &message)
+{
+#ifdef _WIN32
+    (void)socketDescriptor ;
+    (void)message ;
+    return false ;
+#else
+    std::string line = message.toString() + "\n" ;
+    size_t offset = 0 ;
+    while(offset < line.size())
+    {
+        ssize_t size = send(socketDescriptor, line.data() + offset, line.size() - offset, MSG_NOSIGNAL) ;
+        if((size < 0) && (errno == EINTR))
+            continue ;
+        if(size <= 0)
+            return false ;
+        offset += size ;
+    }
+
+    return true ;
+#endif
+}
@@ -0,0 +1,348 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "JsonMessage.h"
+#include <cstdio>
+#include <cstdlib>
+
+/**
+ * @brief JsonMessage::parse : Decode a flat JSON object, the previous fields are dropped.
+ * @param text: The JSON text, e.g. {"type":"install","serial":"0025003C3338510A","fastboot":true}.
+ * @return True if the text is a flat JSON object, otherwise false.
+ */
+bool JsonMessage::parse(const std::string &text)
+{
+    fields.clear() ;
+    size_t position = 0 ;
+    skipSpaces(text, position) ;
+    if((position >= text.size()) || (text[position] != '{'))
+        return false ;
+
+    position++ ;
+    skipSpaces(text, position) ;
+    if((position < text.size()) && (text[position] == '}'))
+        return true ;
+
+    while(position < text.size())
+    {
+        JsonField field ;
+        if(parseString(text, position, field.key) == false)
+            return false ;
+
+        skipSpaces(text, position) ;
+        if((position >= text.size()) || (text[position] != ':'))
+            return false ;
+
+        position++ ;
+        skipSpaces(text, position) ;
+        if(position >= text.size())
+            return false ;
+
+        field.isString = (text[position] == '"') ;
+        if(field.isString)
+        {
+            if(parseString(text, position, field.value) == false)
+                return false ;
+        }
+        else
+        {
+            size_t end = text.find_first_of(",} \t\r\n", position) ;
+            if(end == std::string::npos)
+                return false ;
+
+            field.value = text.substr(position, end - position) ;
+            char *numberEnd = nullptr ;
+            strtod(field.value.c_str(), &numberEnd) ;
+            bool isNumber = (field.value.empty() == false) && (*numberEnd == '\0') ;
+            if((isNumber == false) && (field.value != "true") && (field.value != "false") && (field.value != "null"))
+                return false ;
+            position = end ;
+        }
+        fields.push_back(field) ;
+
+        skipSpaces(text, position) ;
+        if(position >= text.size())
+            return false ;
+
+        if(text[position] == '}')
+        {
+            position++ ;
+            skipSpaces(text, position) ;
+            return position == text.size() ;
+        }
+
+        if(text[position] != ',')
+            return false ;
+
+        position++ ;
+        skipSpaces(text, position) ;
+    }
+
+    return false ;
+}
+
+/**
+ * @brief JsonMessage::toString : Encode the object on a single line.
+ * @return The JSON text, without line feed.
+ */
+std::string JsonMessage::toString() const
+{
+    std::string text = "{" ;
+    for(const JsonField &field : fields)
+    {
+        if(text.size() > 1)
+            text += "," ;
+
+        appendQuoted(text, field.key) ;
+        text += ":" ;
+        if(field.isString)
+            appendQuoted(text, field.value) ;
+        else
+            text += field.value ;
+    }
+
+    return text + "}" ;
+}
+
+/**
+ * @brief JsonMessage::hasField
+ * @param key: The field name.
+ * @return True if the object has the field, otherwise false.
+ */
+bool JsonMessage::hasField(const std::string &key) const
+{
+    return findField(key) != nullptr ;
+}
+
+/**
+ * @brief JsonMessage::getString : Get a field as a string, numbers and booleans are given as their JSON text.
+ * @param key: The field name.
+ * @param defaultValue: The value of a missing or null field.
+ * @return The field value.
+ */
+std::string JsonMessage::getString(const std::string &key, const std::string &defaultValue) const
+{
+    const JsonField *field = findField(key) ;
+    if((field == nullptr) || ((field->isString == false) && (field->value == "null")))
+        return defaultValue ;
+
+    return field->value ;
+}
+
+/**
+ * @brief JsonMessage::getBool : Get a boolean field, the numbers 0 and 1 are accepted as well.
+ * @param key: The field name.
+ * @param defaultValue: The value of a missing field, or of a field which is not a boolean.
+ * @return The field value.
+ */
+bool JsonMessage::getBool(const std::string &key, bool defaultValue) const
+{
+    const JsonField *field = findField(key) ;
+    if((field == nullptr) || field->isString)
+        return defaultValue ;
+
+    if((field->value == "true") || (field->value == "1"))
+        return true ;
+    if((field->value == "false") || (field->value == "0"))
+        return false ;
+
+    return defaultValue ;
+}
+
+void JsonMessage::setString(const std::string &key, const std::string &value)
+{
+    setField(key, value, true) ;
+}
+
+void JsonMessage::setNumber(const std::string &key, long long value)
+{
+    setField(key, std::to_string(value), false) ;
+}
+
+void JsonMessage::setBool(const std::string &key, bool value)
+{
+    setField(key, value ? "true" : "false", false) ;
+}
+
+/**
+ * @brief JsonMessage::findField
+ * @param key: The field name.
+ * @return The field, nullptr if the object has no such field.
+ */
+const JsonField* JsonMessage::findField(const std::string &key) const
+{
+    for(const JsonField &field : fields)
+    {
+        if(field.key == key)
+            return &field ;
+    }
+
+    return nullptr ;
+}
+
+/**
+ * @brief JsonMessage::setField : Replace the value of a field, or add the field at the end of the object.
+ * @param key: The field name.
+ * @param value: The decoded string or the JSON text of the value.
+ * @param isString: True if the value is a string.
+ */
+void JsonMessage::setField(const std::string &key, const std::string &value, bool isString)
+{
+    for(JsonField &field : fields)
+    {
+        if(field.key == key)
+        {
+            field.value = value ;
+            field.isString = isString ;
+            return ;
+        }
+    }
+
+    fields.push_back({key, value, isString}) ;
+}
+
+/**
+ * @brief JsonMessage::parseString : Decode a JSON string and its escape sequences.
+ * @param text: The JSON text.
+ * @param position: Position of the opening quote, moved after the closing quote.
+ * @param value: Output decoded string, in UTF-8.
+ * @return True if the string is well formed, otherwise false.
+ */
+bool JsonMessage::parseString(const std::string &text, size_t &position, std::string &value)
+{
+    if((position >= text.size()) || (text[position] != '"'))
+        return false ;
+
+    value.clear() ;
+    for(position++; position < text.size(); position++)
+    {
+        char character = text[position] ;
+        if(character == '"')
+        {
+            position++ ;
+            return true ;
+        }
+
+        if(character != '\\')
+        {
+            value += character ;
+            continue ;
+        }
+
+        if(++position >= text.size())
+            return false ;
+
+        switch(text[position])
+        {
+        case '"':  value += '"' ;  break ;
+        case '\\': value += '\\' ; break ;
+        case '/':  value += '/' ;  break ;
+        case 'b':  value += '\b' ; break ;
+        case 'f':  value += '\f' ; break ;
+        case 'n':  value += '\n' ; break ;
+        case 'r':  value += '\r' ; break ;
+        case 't':  value += '\t' ; break ;
+        case 'u':
+        {
+            if(position + 4 >= text.size())
+                return false ;
+
+            std::string digits = text.substr(position + 1, 4) ;
+            char *end = nullptr ;
+            uint32_t code = (uint32_t)strtoul(digits.c_str(), &end, 16) ;
+            if(*end != '\0')
+                return false ;
+
+            appendUtf8(value, code) ;
+            position += 4 ;
+            break ;
+        }
+        default:
+            return false ;
+        }
+    }
+
+    return false ;
+}
+
+/**
+ * @brief JsonMessage::appendUtf8 : Append a character of the Basic Multilingual Plane encoded in UTF-8.
+ * @param text: The string to complete.
+ * @param code: The character code.
+ */
+void JsonMessage::appendUtf8(std::string &text, uint32_t code)
+{
+    if(code < 0x80)
+    {
+        text += (char)code ;
+    }
+    else if(code < 0x800)
+    {
+        text += (char)(0xC0 | (code >> 6)) ;
+        text += (char)(0x80 | (code & 0x3F)) ;
+    }
+    else
+    {
+        text += (char)(0xE0 | (code >> 12)) ;
+        text += (char)(0x80 | ((code >> 6) & 0x3F)) ;
+        text += (char)(0x80 | (code & 0x3F)) ;
+    }
+}
+
+/**
+ * @brief JsonMessage::appendQuoted : Append a string as a JSON string, the control characters being escaped.
+ * @param text: The JSON text to complete.
+ * @param value: The string, in UTF-8.
+ */
+void JsonMessage::appendQuoted(std::string &text, const std::string &value)
+{
+    text += '"' ;
+    for(char character : value)
+    {
+        switch(character)
+        {
+        case '"':  text += "\\\"" ; break ;
+        case '\\': text += "\\\\" ; break ;
+        case '\n': text += "\\n" ;  break ;
+        case '\r': text += "\\r" ;  break ;
+        case '\t': text += "\\t" ;  break ;
+        default:
+            if((unsigned char)character < 0x20)
+            {
+                char escape[8] ;
+                snprintf(escape, sizeof(escape), "\\u%04x", (unsigned char)character) ;
+                text += escape ;
+            }
+            else
+            {
+                text += character ;
+            }
+        }
+    }
+    text += '"' ;
+}
+
+void JsonMessage::skipSpaces(const std::string &text, size_t &position)
+{
+    while((position < text.size()) && ((text[position] == ' ') || (text[position] == '\t') || (text[position] == '\r') || (text[position] == '\n')))
+        position++ ;
+}
@@ -0,0 +1,569 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "MockDfuTransport.h"
+#include "FirmwareImage.h"
+#include "DFU.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <chrono>
+
+constexpr uint32_t MOCK_FILE_PREFIX_SIZE = 1024 * 1024; // Only the beginning of the downloaded files is inspected
+constexpr uint16_t MOCK_OTP_SIZE = 544;
+constexpr uint16_t MOCK_LAYOUT_HEADER_SIZE = 256;
+constexpr uint16_t MOCK_DEFAULT_DEVICE_ID = 0x505;
+
+std::mutex MockDfuTransport::boardsMutex ;
+int MockDfuTransport::nextDeviceNumber = 2 ;
+
+MockDfuTransport::MockDfuTransport(const std::string &serialNumber)
+{
+    this->dfuSerialNumber = serialNumber ;
+    listedEnumeration = 0 ;
+}
+
+const char* MockDfuTransport::getName() const
+{
+    return "mock" ;
+}
+
+bool MockDfuTransport::isAvailable()
+{
+    return true ;
+}
+
+/**
+ * @brief MockDfuTransport::listDevices : List the simulated boards currently in DFU mode.
+ * @param serialNumber: Serial number filter, empty to list all boards.
+ * @param devices: Output list of devices with their alternate settings.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int MockDfuTransport::listDevices(const std::string &serialNumber, std::vector<DfuDeviceInfo> &devices)
+{
+    std::lock_guard<std::mutex> lock(boardsMutex);
+    devices.clear();
+
+    MockBoard *selectedBoard = getSelectedBoard() ;
+    if(selectedBoard != nullptr)
+        listedEnumeration = selectedBoard->enumerationCount ;
+
+    for(const auto &entry : getBoards())
+    {
+        const MockBoard &board = entry.second ;
+        if((board.mode == MOCK_MODE_FASTBOOT) || isRebooting(board) || ((serialNumber.empty() == false) && (serialNumber != board.serialNumber)))
+            continue ;
+
+        DfuDeviceInfo device ;
+        device.serialNumber = board.serialNumber ;
+        device.deviceNumber = board.deviceNumber ;
+        device.portPath = board.portPath ;
+        device.busNumber = std::atoi(device.portPath.c_str()) ;
+        device.altSettings = getAltSettings(board) ;
+        for(const auto &altSetting : device.altSettings)
+            device.descriptorStrings.push_back(altSetting.name);
+
+        char product[80] ;
+        if(board.mode == MOCK_MODE_ROM)
+            snprintf(product, sizeof(product), "DFU in HS Mode @Device ID /0x%03X, @Revision ID /0x2000", board.deviceID);
+        else
+            snprintf(product, sizeof(product), "USB download gadget@Device ID /0x%03X, @Revision ID /0x2000", board.deviceID);
+        device.descriptorStrings.push_back(product);
+        devices.push_back(std::move(device));
+    }
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief MockDfuTransport::isFastbootDevicePresent
+ * @return True if a simulated board runs U-Boot in Fastboot mode, otherwise, false.
+ */
+bool MockDfuTransport::isFastbootDevicePresent()
+{
+    std::lock_guard<std::mutex> lock(boardsMutex);
+    for(const auto &entry : getBoards())
+    {
+        if((entry.second.mode == MOCK_MODE_FASTBOOT) && (isRebooting(entry.second) == false))
+            return true ;
+    }
+
+    return false ;
+}
+
+/**
+ * @brief MockDfuTransport::listFastbootDevices
+ * @param devices: Output list of the simulated boards running U-Boot in Fastboot mode.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int MockDfuTransport::listFastbootDevices(std::vector<DfuDeviceInfo> &devices)
+{
+    std::lock_guard<std::mutex> lock(boardsMutex);
+    devices.clear();
+
+    for(const auto &entry : getBoards())
+    {
+        if((entry.second.mode != MOCK_MODE_FASTBOOT) || isRebooting(entry.second))
+            continue ;
+
+        DfuDeviceInfo device ;
+        device.serialNumber = entry.second.serialNumber ;
+        device.deviceNumber = entry.second.deviceNumber ;
+        device.portPath = entry.second.portPath ;
+        device.busNumber = std::atoi(device.portPath.c_str()) ;
+        devices.push_back(device);
+    }
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief MockDfuTransport::readDeviceIdString
+ * @param deviceIdString: Output string following the "@Device ID /" pattern.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int MockDfuTransport::readDeviceIdString(std::string &deviceIdString)
+{
+    std::lock_guard<std::mutex> lock(boardsMutex);
+    MockBoard *board = getSelectedBoard() ;
+    if(board == nullptr)
+        return TOOLBOX_DFU_ERROR_NO_DEVICE ;
+
+    char deviceId[8] ;
+    snprintf(deviceId, sizeof(deviceId), "0x%03X", board->deviceID);
+    deviceIdString = deviceId ;
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief MockDfuTransport::download : Simulate a download from file, the boot sequence progresses as on a real board.
+ * @param alternateIndex: The alternate setting index of the target partition.
+ * @param filePath: The firmware path to be programmed.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int MockDfuTransport::download(uint8_t alternateIndex, const std::string &filePath)
+{
+    std::string path = filePath ;
+    path.erase(std::remove(path.begin(), path.end(), '\"'), path.end()) ; //remove the double quotes from the file path
+    FirmwareImage firmware ;
+    int ret = firmware.open(path) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    return downloadFromMemory(alternateIndex, firmware.getData(), firmware.getSize()) ;
+}
+
+/**
+ * @brief MockDfuTransport::downloadFromMemory : Simulate a download from memory.
+ * @param alternateIndex: The alternate setting index of the target partition.
+ * @param firmware: The bytes to be programmed.
+ * @param size: Number of bytes.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int MockDfuTransport::downloadFromMemory(uint8_t alternateIndex, const unsigned char *firmware, size_t size)
+{
+    std::vector<unsigned char> data(firmware, firmware + std::min(size, (size_t)MOCK_FILE_PREFIX_SIZE)) ;
+
+    simulateTransfer(size) ;
+    DisplayManager::reportProgress(alternateIndex, size, size) ;
+    return receiveData(alternateIndex, data, size) ;
+}
+
+/**
+ * @brief MockDfuTransport::downloadFromReader : Simulate a download of the bytes of a producer, only the first bytes are kept.
+ * @param alternateIndex: The alternate setting index of the target partition.
+ * @param reader: The producer of the bytes.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int MockDfuTransport::downloadFromReader(uint8_t alternateIndex, const DownloadReader &reader)
+{
+    std::vector<unsigned char> data ;
+    std::vector<unsigned char> chunk(DOWNLOAD_READ_SIZE) ;
+    size_t totalSize = 0 ;
+    size_t size = 0 ;
+    do
+    {
+        int ret = reader(chunk.data(), chunk.size(), &size) ;
+        if(ret != TOOLBOX_DFU_NO_ERROR)
+            return ret ;
+
+        size_t prefixSize = std::min(size, (size_t)MOCK_FILE_PREFIX_SIZE - data.size()) ;
+        data.insert(data.end(), chunk.begin(), chunk.begin() + prefixSize) ;
+        simulateTransfer(size) ;
+        totalSize += size ;
+        DisplayManager::reportProgress(alternateIndex, totalSize, 0) ;
+    } while(size != 0) ;
+
+    return receiveData(alternateIndex, data, totalSize) ;
+}
+
+/**
+ * @brief MockDfuTransport::receiveData : Apply a download to the board, the beginning of the data decides what the board does.
+ * @param alternateIndex: The alternate setting index of the target partition.
+ * @param data: The first bytes of the download, up to MOCK_FILE_PREFIX_SIZE.
+ * @param size: Number of bytes of the whole download.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int MockDfuTransport::receiveData(uint8_t alternateIndex, const std::vector<unsigned char> &data, size_t size)
+{
+    std::lock_guard<std::mutex> lock(boardsMutex);
+    MockBoard *board = getSelectedBoard() ;
+    if(board == nullptr)
+        return TOOLBOX_DFU_ERROR_NO_DEVICE ;
+
+    int partID = getPartitionId(*board, alternateIndex) ;
+    if(partID < 0)
+        return TOOLBOX_DFU_ERROR_WRITE ;
+
+    if(partID == 0xF2)
+    {
+        board->otpData = data ;
+    }
+    else if((partID == 0x00) && (data.size() >= 4) && (memcmp(data.data(), "STM2", 4) == 0))
+    {
+        loadFlashlayout(*board, data) ;
+    }
+    else if((partID == 0x00) && (board->mode == MOCK_MODE_UBOOT_DFU) && (data.size() >= 4) &&
+            (data[0] == 0x27) && (data[1] == 0x05) && (data[2] == 0x19) && (data[3] == 0x56)) /* U-Boot script image */
+    {
+        board->isFastbootScriptLoaded = true ;
+    }
+    else
+    {
+        if(board->mode == MOCK_MODE_ROM)
+            board->bootDownloads++ ;
+
+        if((board->phases.size() > 1) && (board->phases.front() == partID))
+            board->phases.erase(board->phases.begin());
+    }
+
+    displayManager.print(MSG_NORMAL, L"Mock board %s : %lu bytes received on alternate %d", board->serialNumber.c_str(), (unsigned long)size, alternateIndex);
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief MockDfuTransport::upload : Simulate an upload and save it into file.
+ * @param alternateIndex: The alternate setting index of the partition to read.
+ * @param filePath: The output binary file.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int MockDfuTransport::upload(uint8_t alternateIndex, const std::string &filePath)
+{
+    std::vector<unsigned char> data ;
+    int ret = uploadToMemory(alternateIndex, data) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    return writeFile(filePath, data) ;
+}
+
+/**
+ * @brief MockDfuTransport::uploadToMemory : Simulate an upload of the virtual (GetPhase) or the OTP partition.
+ * @param alternateIndex: The alternate setting index of the partition to read.
+ * @param data: Output buffer receiving the uploaded bytes.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int MockDfuTransport::uploadToMemory(uint8_t alternateIndex, std::vector<unsigned char> &data)
+{
+    data.clear();
+    std::lock_guard<std::mutex> lock(boardsMutex);
+    MockBoard *board = getSelectedBoard() ;
+    if(board == nullptr)
+        return TOOLBOX_DFU_ERROR_NO_DEVICE ;
+
+    int partID = getPartitionId(*board, alternateIndex) ;
+    if(partID == 0xF1) /* GetPhase : Phase, Address, Offset, NeedDFUDetach */
+    {
+        uint8_t phase = board->phases.front() ;
+        data = {phase, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00} ;
+        if((phase == 0) && (board->mode == MOCK_MODE_ROM))
+            data[9] = 1 ;
+    }
+    else if(partID == 0xF2)
+    {
+        data = board->otpData ;
+    }
+    else if(partID < 0)
+    {
+        return TOOLBOX_DFU_ERROR_READ ;
+    }
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief MockDfuTransport::detach : Simulate the reboot of the board into its next boot stage.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int MockDfuTransport::detach()
+{
+    std::lock_guard<std::mutex> lock(boardsMutex);
+    MockBoard *board = getSelectedBoard() ;
+    if(board == nullptr)
+        return TOOLBOX_DFU_ERROR_NO_DEVICE ;
+
+    if((board->mode == MOCK_MODE_ROM) && isBootCompleted(*board))
+    {
+        board->mode = MOCK_MODE_UBOOT_DFU ;
+        while((board->phases.size() > 1) && (board->phases.front() != 0x00)) // U-Boot does not request the boot partitions
+            board->phases.erase(board->phases.begin());
+    }
+    else if((board->mode == MOCK_MODE_UBOOT_DFU) && board->isFastbootScriptLoaded)
+    {
+        board->mode = MOCK_MODE_FASTBOOT ;
+    }
+
+    /* The board comes back with a new device number, after PRG_TOOLBOX_DFU_MOCK_REBOOT_MS if set */
+    const char* envRebootTime = std::getenv("PRG_TOOLBOX_DFU_MOCK_REBOOT_MS");
+    unsigned long rebootTime = (envRebootTime != nullptr) ? std::strtoul(envRebootTime, nullptr, 10) : 0 ;
+    board->rebootEnd = std::chrono::steady_clock::now() + std::chrono::milliseconds(rebootTime) ;
+    board->deviceNumber = nextDeviceNumber++ ;
+    board->enumerationCount++ ;
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief MockDfuTransport::simulateTransfer : Take the time of a real transfer when PRG_TOOLBOX_DFU_MOCK_KBPS gives a throughput.
+ * @param size: Number of bytes transferred.
+ */
+void MockDfuTransport::simulateTransfer(size_t size)
+{
+    const char* envRate = std::getenv("PRG_TOOLBOX_DFU_MOCK_KBPS");
+    unsigned long rate = (envRate != nullptr) ? std::strtoul(envRate, nullptr, 10) : 0 ;
+    if(rate != 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds((uint64_t)size / rate));
+}
+
+/**
+ * @brief MockDfuTransport::isRebooting
+ * @param board: The simulated board.
+ * @return True if the board is still rebooting after a detach, it is not attached meanwhile.
+ */
+bool MockDfuTransport::isRebooting(const MockBoard &board)
+{
+    return std::chrono::steady_clock::now() < board.rebootEnd ;
+}
+
+/**
+ * @brief MockDfuTransport::isHotplugObservable
+ * @return False, the simulated boards do not raise USB events.
+ */
+bool MockDfuTransport::isHotplugObservable()
+{
+    return false ;
+}
+
+/**
+ * @brief MockDfuTransport::isSameEnumeration
+ * @return True if the selected board did not re-enumerate since it was last listed, otherwise false.
+ */
+bool MockDfuTransport::isSameEnumeration()
+{
+    std::lock_guard<std::mutex> lock(boardsMutex);
+    MockBoard *board = getSelectedBoard() ;
+    return (board != nullptr) && (board->enumerationCount == listedEnumeration) ;
+}
+
+/**
+ * @brief MockDfuTransport::getBoards : Get the simulated boards, created once from PRG_TOOLBOX_DFU_MOCK_BOARDS.
+ * @return The boards indexed by serial number.
+ * @note The caller holds boardsMutex.
+ */
+std::map<std::string, MockBoard>& MockDfuTransport::getBoards()
+{
+    static std::map<std::string, MockBoard> boards ;
+    static bool isInitialized = false ;
+    if(isInitialized)
+        return boards ;
+
+    const char* envBoards = std::getenv("PRG_TOOLBOX_DFU_MOCK_BOARDS");
+    std::stringstream boardsList((envBoards != nullptr) ? envBoards : "MOCK0001");
+    std::string entry ;
+    while(std::getline(boardsList, entry, ','))
+    {
+        if(entry.empty())
+            continue ;
+
+        MockBoard board ;
+        size_t portSeparator = entry.find('@') ;
+        if(portSeparator != std::string::npos)
+        {
+            board.portPath = entry.substr(portSeparator + 1) ;
+            entry.erase(portSeparator) ;
+        }
+
+        size_t separator = entry.find(':') ;
+        board.serialNumber = entry.substr(0, separator) ;
+        board.deviceID = (separator != std::string::npos) ? std::strtoul(entry.substr(separator + 1).c_str(), nullptr, 16) : MOCK_DEFAULT_DEVICE_ID ;
+        board.mode = MOCK_MODE_ROM ;
+        board.bootDownloads = 0 ;
+        board.isFastbootScriptLoaded = false ;
+        board.enumerationCount = 0 ;
+        board.phases = {0x01, 0x03, 0x00} ;
+        board.otpData.assign(MOCK_OTP_SIZE, 0) ;
+        boards[board.serialNumber] = board ;
+    }
+
+    int portNumber = 2 ;
+    for(auto &boardEntry : boards)
+    {
+        MockBoard &board = boardEntry.second ;
+        if(board.portPath.empty())
+            board.portPath = "1-" + std::to_string(portNumber) ;
+        board.deviceNumber = nextDeviceNumber++ ;
+        portNumber++ ;
+    }
+
+    isInitialized = true ;
+    return boards ;
+}
+
+/**
+ * @brief MockDfuTransport::getSelectedBoard : Get the board matching the serial number, or the first board in DFU mode.
+ * @return The board, nullptr if there is none.
+ * @note The caller holds boardsMutex.
+ */
+MockBoard* MockDfuTransport::getSelectedBoard()
+{
+    for(auto &entry : getBoards())
+    {
+        MockBoard &board = entry.second ;
+        if((board.mode == MOCK_MODE_FASTBOOT) || isRebooting(board))
+            continue ;
+        if(dfuSerialNumber.empty() || (dfuSerialNumber == board.serialNumber))
+            return &board ;
+    }
+
+    return nullptr ;
+}
+
+/**
+ * @brief MockDfuTransport::getAltSettings : Build the alternate settings exposed in the current boot stage.
+ * @param board: The simulated board.
+ * @return The list of alternate settings.
+ */
+std::vector<DfuAltSetting> MockDfuTransport::getAltSettings(const MockBoard &board)
+{
+    std::vector<std::string> names ;
+    names.push_back("@Partition0 /0x00/1*256Ke");
+    if(board.mode == MOCK_MODE_ROM)
+    {
+        names.push_back("@FSBL /0x01/1*1Me");
+        names.push_back("@Partition2 /0x02/1*1Me");
+        names.push_back("@Partition3 /0x03/1*16Me");
+        names.push_back("@virtual /0xF1/1*512Ba");
+    }
+    else
+    {
+        for(const auto &partition : board.layout)
+        {
+            char name[64] ;
+            snprintf(name, sizeof(name), "@%s /0x%02X/1*1Me", partition.name.c_str(), partition.phaseID);
+            names.push_back(name);
+        }
+        names.push_back("@virtual /0xF1/1*512Ba");
+        names.push_back("@OTP /0xF2/1*544Be");
+        names.push_back("@PMIC /0xF4/1*8Be");
+    }
+
+    std::vector<DfuAltSetting> altSettings ;
+    for(size_t idx = 0 ; idx < names.size() ; idx++)
+    {
+        DfuAltSetting altSetting ;
+        altSetting.alt = idx ;
+        altSetting.name = names.at(idx) ;
+        altSettings.push_back(altSetting);
+    }
+
+    return altSettings ;
+}
+
+/**
+ * @brief MockDfuTransport::getPartitionId
+ * @return The partition ID exposed by an alternate setting, -1 if the alternate setting does not exist.
+ */
+int MockDfuTransport::getPartitionId(const MockBoard &board, uint8_t alternateIndex)
+{
+    std::vector<DfuAltSetting> altSettings = getAltSettings(board) ;
+    if(alternateIndex >= altSettings.size())
+        return -1 ;
+
+    std::string name ;
+    int partID = -1 ;
+    if(DfuDevice::parseAlternateName(altSettings.at(alternateIndex).name, name, partID) == false)
+        return -1 ;
+
+    return partID ;
+}
+
+/**
+ * @brief MockDfuTransport::loadFlashlayout : Decode a flashlayout (STM32 header + TSV lines) and plan the next phases.
+ * @param board: The simulated board.
+ * @param data: The downloaded flashlayout.
+ */
+void MockDfuTransport::loadFlashlayout(MockBoard &board, const std::vector<unsigned char> &data)
+{
+    if(data.size() <= MOCK_LAYOUT_HEADER_SIZE)
+        return ;
+
+    board.layout.clear();
+    board.phases.clear();
+
+    std::stringstream content(std::string(data.begin() + MOCK_LAYOUT_HEADER_SIZE, data.end()));
+    std::string line ;
+    while(std::getline(content, line))
+    {
+        std::stringstream fields(line);
+        std::string opt, phaseId, name ;
+        if(!(fields >> opt >> phaseId >> name))
+            continue ;
+
+        MockPartition partition ;
+        partition.name = name ;
+        partition.phaseID = std::strtoul(phaseId.c_str(), nullptr, 16) ;
+        if((partition.phaseID <= 0x03) || (partition.phaseID >= 0xF0))
+            continue ;
+
+        board.layout.push_back(partition);
+        if(opt.find('P') != std::string::npos)
+            board.phases.push_back(partition.phaseID);
+    }
+
+    board.phases.push_back(0xFE); // Flashing is completed
+}
+
+/**
+ * @brief MockDfuTransport::isBootCompleted : Check if the board received enough boot partitions to start U-Boot.
+ * @param board: The simulated board.
+ * @return True if U-Boot starts on the next detach, otherwise false.
+ */
+bool MockDfuTransport::isBootCompleted(const MockBoard &board)
+{
+    if(board.phases.front() == 0x00) // GetPhase already requests the flashlayout
+        return true ;
+
+    uint8_t requiredDownloads = ((board.deviceID == STM32MP25) || (board.deviceID == STM32MP21)) ? 3 : 2 ;
+    return (board.bootDownloads >= requiredDownloads) ;
+}
@@ -0,0 +1,140 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "PartitionPrefetcher.h"
+#include "Error.h"
+#include <algorithm>
+#include <chrono>
+#include <experimental/filesystem>
+
+PartitionPrefetcher::PartitionPrefetcher()
+{
+    pendingStatus = TOOLBOX_DFU_NO_ERROR ;
+    totalStallMs = 0 ;
+}
+
+PartitionPrefetcher::~PartitionPrefetcher()
+{
+    cancel() ;
+}
+
+/**
+ * @brief PartitionPrefetcher::prefetch : Start mapping the binary of the next partition in the background.
+ * A binary prefetched before is dropped.
+ * @param filePath: The binary path, as written in the parsed TSV file.
+ */
+void PartitionPrefetcher::prefetch(const std::string &filePath)
+{
+    if((filePath == pendingPath) || filePath.empty())
+        return ;
+
+    cancel() ;
+    pendingPath = filePath ;
+    pendingImage = std::make_shared<FirmwareImage>() ;
+    pendingStatus = TOOLBOX_DFU_ERROR_OTHER ;
+    loader = std::thread([this]() {
+        pendingStatus = load(pendingPath, *pendingImage) ;
+    }) ;
+}
+
+/**
+ * @brief PartitionPrefetcher::take : Get the image of a binary, waiting for its mapping to end if it is prefetched,
+ * or mapping it now otherwise.
+ * @param filePath: The binary path, as written in the parsed TSV file.
+ * @param image: Output image, nullptr if the binary cannot be mapped.
+ * @param stallMs: Output time spent waiting for the binary.
+ * @param isPrefetched: Output flag, true if the binary was mapped in the background.
+ * @return 0 if the operation is performed successfully, TOOLBOX_DFU_ERROR_NOT_SUPPORTED if the binary
+ * is too large to be read into memory, otherwise an error occurred.
+ */
+int PartitionPrefetcher::take(const std::string &filePath, std::shared_ptr<FirmwareImage> &image, uint64_t &stallMs, bool &isPrefetched)
+{
+    auto start = std::chrono::steady_clock::now() ;
+    int ret = TOOLBOX_DFU_ERROR_OTHER ;
+    isPrefetched = (filePath == pendingPath) ;
+    if(isPrefetched)
+    {
+        if(loader.joinable())
+            loader.join() ;
+        ret = pendingStatus ;
+        image = std::move(pendingImage) ;
+        pendingPath.clear() ;
+    }
+    else
+    {
+        image = std::make_shared<FirmwareImage>() ;
+        ret = load(filePath, *image) ;
+    }
+
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        image = nullptr ;
+
+    stallMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() ;
+    totalStallMs += stallMs ;
+    return ret ;
+}
+
+/**
+ * @brief PartitionPrefetcher::getStallMs
+ * @return The time the downloads waited for their binary since the creation of the instance.
+ */
+uint64_t PartitionPrefetcher::getStallMs() const
+{
+    return totalStallMs ;
+}
+
+/**
+ * @brief PartitionPrefetcher::cancel : Wait for the running mapping and drop it, the pages already read stay cached.
+ */
+void PartitionPrefetcher::cancel()
+{
+    if(loader.joinable())
+        loader.join() ;
+    pendingPath.clear() ;
+    pendingImage = nullptr ;
+}
+
+/**
+ * @brief PartitionPrefetcher::load : Map a whole binary, its pages are read ahead by the kernel.
+ * @param filePath: The binary path, as written in the parsed TSV file.
+ * @param image: Output image.
+ * @return 0 if the operation is performed successfully, TOOLBOX_DFU_ERROR_NOT_SUPPORTED if the binary
+ * is too large to be read into memory, otherwise an error occurred.
+ */
+int PartitionPrefetcher::load(const std::string &filePath, FirmwareImage &image)
+{
+    std::string path = filePath ;
+    path.erase(std::remove(path.begin(), path.end(), '\"'), path.end()) ; //remove the double quotes from the file path
+
+    /* Checked first, FirmwareImage reports its errors to the output of the loader thread */
+    if(FirmwareImage::isFileExist(path) == false)
+        return TOOLBOX_DFU_ERROR_NO_FILE ;
+
+#ifdef _WIN32
+    std::error_code errorCode ;
+    uintmax_t fileSize = std::experimental::filesystem::file_size(path, errorCode) ;
+    if(errorCode || (fileSize > PREFETCH_MAX_SIZE))
+        return TOOLBOX_DFU_ERROR_NOT_SUPPORTED ;
+#endif
+
+    return image.open(path) ;
+}
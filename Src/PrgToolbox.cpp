@@ -0,0 +1,324 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "PrgToolbox.h"
+#include "ProgramManager.h"
+#include "DfuTransport.h"
+#include "DFU.h"
+#include <mutex>
+#include <algorithm>
+#include <cstring>
+
+struct prgtoolbox_session
+{
+    std::string toolboxFolder;
+    std::string serialNumber;
+    prgtoolbox_message_callback messageCallback;
+    void *callbackContext;
+    prgtoolbox_progress_callback progressCallback;
+    void *progressContext;
+    std::mutex callMutex;       // The calls on a session are run one at a time
+};
+
+/**
+ * @brief runSessionCall : Run a call with the messages of the calling thread sent to the session callback.
+ * The C++ exceptions do not cross the C interface.
+ * @param session: The session.
+ * @param call: The operation.
+ * @return The result of the operation, TOOLBOX_DFU_ERROR_OTHER if it threw.
+ */
+static int runSessionCall(prgtoolbox_session *session, const std::function<int(void)> &call)
+{
+    if(session == nullptr)
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+
+    std::lock_guard<std::mutex> lock(session->callMutex) ;
+    ThreadOutput output = {nullptr, "", CONSOLE_ALL, nullptr, nullptr} ;
+    if(session->messageCallback != nullptr)
+    {
+        prgtoolbox_message_callback callback = session->messageCallback ;
+        void *context = session->callbackContext ;
+        output.consoleFilter = CONSOLE_NONE ;
+        output.messageHandler = [callback, context](messageType type, const std::string &text) {
+            callback(context, (int)type, text.c_str()) ;
+        } ;
+    }
+    if(session->progressCallback != nullptr)
+    {
+        prgtoolbox_progress_callback callback = session->progressCallback ;
+        void *context = session->progressContext ;
+        output.progressHandler = [callback, context](int alt, uint64_t done, uint64_t total) {
+            callback(context, alt, done, total) ;
+        } ;
+    }
+    DisplayManager::setThreadOutput(output) ;
+
+    int ret = TOOLBOX_DFU_ERROR_OTHER ;
+    try
+    {
+        ret = call() ;
+    }
+    catch(const std::bad_alloc&)
+    {
+        ret = TOOLBOX_DFU_ERROR_NO_MEM ;
+    }
+    catch(...)
+    {
+        ret = TOOLBOX_DFU_ERROR_OTHER ;
+    }
+
+    DisplayManager::resetThreadOutput() ;
+    return ret ;
+}
+
+/**
+ * @brief copyString : Copy a string into a fixed size field, truncated if needed.
+ */
+static void copyString(char *destination, size_t destinationSize, const std::string &source)
+{
+    size_t size = std::min(source.size(), destinationSize - 1) ;
+    memcpy(destination, source.data(), size) ;
+    destination[size] = '\0' ;
+}
+
+/**
+ * @brief prgtoolbox_get_version
+ * @return The library version.
+ */
+const char* prgtoolbox_get_version(void)
+{
+    return PRGTOOLBOX_VERSION ;
+}
+
+/**
+ * @brief prgtoolbox_set_backend : Select the DFU backend of the sessions opened afterwards.
+ * @param backend_name: auto, dfu-util, usb or mock.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int prgtoolbox_set_backend(const char *backend_name)
+{
+    DFU_BACKEND backend = DFU_BACKEND_AUTO ;
+    if((backend_name == nullptr) || (DfuTransport::parseBackendName(backend_name, &backend) != TOOLBOX_DFU_NO_ERROR))
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+
+    DfuTransport::setDefaultBackend(backend) ;
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief prgtoolbox_open_session : Open a session on a device.
+ * @param toolbox_folder: The folder of the bundled tools (dfu-util on Windows), "." if null.
+ * @param serial_number: The device serial number, null or empty to use the only attached device.
+ * @param session: Output session, to close with prgtoolbox_close_session().
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int prgtoolbox_open_session(const char *toolbox_folder, const char *serial_number, prgtoolbox_session **session)
+{
+    if(session == nullptr)
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+
+    try
+    {
+        prgtoolbox_session *newSession = new prgtoolbox_session ;
+        newSession->toolboxFolder = (toolbox_folder != nullptr) ? toolbox_folder : "." ;
+        newSession->serialNumber = (serial_number != nullptr) ? serial_number : "" ;
+        newSession->messageCallback = nullptr ;
+        newSession->callbackContext = nullptr ;
+        newSession->progressCallback = nullptr ;
+        newSession->progressContext = nullptr ;
+        *session = newSession ;
+    }
+    catch(...)
+    {
+        *session = nullptr ;
+        return TOOLBOX_DFU_ERROR_NO_MEM ;
+    }
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief prgtoolbox_close_session : Release a session, no call may be running on it.
+ * @param session: The session, null is ignored.
+ */
+void prgtoolbox_close_session(prgtoolbox_session *session)
+{
+    delete session ;
+}
+
+/**
+ * @brief prgtoolbox_set_message_callback : Send the messages of the next calls of a session to a callback instead of the console.
+ * @param session: The session.
+ * @param callback: The callback, null to print the messages on the console.
+ * @param context: Given back to the callback.
+ */
+void prgtoolbox_set_message_callback(prgtoolbox_session *session, prgtoolbox_message_callback callback, void *context)
+{
+    if(session == nullptr)
+        return ;
+
+    std::lock_guard<std::mutex> lock(session->callMutex) ;
+    session->messageCallback = callback ;
+    session->callbackContext = context ;
+}
+
+/**
+ * @brief prgtoolbox_set_progress_callback : Report the byte counts of the transfers of the next calls of a session.
+ * @param session: The session.
+ * @param callback: The callback, null to stop reporting.
+ * @param context: Given back to the callback.
+ */
+void prgtoolbox_set_progress_callback(prgtoolbox_session *session, prgtoolbox_progress_callback callback, void *context)
+{
+    if(session == nullptr)
+        return ;
+
+    std::lock_guard<std::mutex> lock(session->callMutex) ;
+    session->progressCallback = callback ;
+    session->progressContext = context ;
+}
+
+/**
+ * @brief prgtoolbox_install : Install U-Boot on the device, as the -d/--download command.
+ * @param session: The session.
+ * @param tsv_file_path: The TSV file to deploy.
+ * @param is_start_fastboot: Non zero to launch the fastboot mode.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int prgtoolbox_install(prgtoolbox_session *session, const char *tsv_file_path, int is_start_fastboot)
+{
+    if(tsv_file_path == nullptr)
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+
+    return runSessionCall(session, [&]() {
+        ProgramManager programMng(session->toolboxFolder, session->serialNumber) ;
+        return programMng.startInstallService(tsv_file_path, is_start_fastboot != 0) ;
+    }) ;
+}
+
+/**
+ * @brief prgtoolbox_flash : Flash the partitions of the TSV file, as the -f/--flash command.
+ * @param session: The session.
+ * @param tsv_file_path: The TSV file to deploy.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int prgtoolbox_flash(prgtoolbox_session *session, const char *tsv_file_path)
+{
+    if(tsv_file_path == nullptr)
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+
+    return runSessionCall(session, [&]() {
+        ProgramManager programMng(session->toolboxFolder, session->serialNumber) ;
+        return programMng.startFlashingService(tsv_file_path) ;
+    }) ;
+}
+
+/**
+ * @brief prgtoolbox_read_otp : Read the OTP partition into a file.
+ * @param session: The session.
+ * @param file_path: The output file.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int prgtoolbox_read_otp(prgtoolbox_session *session, const char *file_path)
+{
+    if(file_path == nullptr)
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+
+    return runSessionCall(session, [&]() {
+        ProgramManager programMng(session->toolboxFolder, session->serialNumber) ;
+        return programMng.readOtpPartition(file_path) ;
+    }) ;
+}
+
+/**
+ * @brief prgtoolbox_write_otp : Write the OTP partition from a file.
+ * @param session: The session.
+ * @param file_path: The input binary.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int prgtoolbox_write_otp(prgtoolbox_session *session, const char *file_path)
+{
+    if(file_path == nullptr)
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+
+    return runSessionCall(session, [&]() {
+        ProgramManager programMng(session->toolboxFolder, session->serialNumber) ;
+        return programMng.writeOtpPartition(file_path) ;
+    }) ;
+}
+
+/**
+ * @brief prgtoolbox_get_phase : Get the phase expected by the device.
+ * @param session: The session.
+ * @param phase: Output phase ID.
+ * @param is_need_detach: Output flag, non zero if the device asks for a detach, may be null.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int prgtoolbox_get_phase(prgtoolbox_session *session, uint8_t *phase, int *is_need_detach)
+{
+    if(phase == nullptr)
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+
+    return runSessionCall(session, [&]() {
+        bool isNeedDetach = false ;
+        ProgramManager programMng(session->toolboxFolder, session->serialNumber) ;
+        int ret = programMng.getPhase(phase, &isNeedDetach) ;
+        if(is_need_detach != nullptr)
+            *is_need_detach = isNeedDetach ? 1 : 0 ;
+        return ret ;
+    }) ;
+}
+
+/**
+ * @brief prgtoolbox_list_devices : List the attached ST devices (DFU and Fastboot), whatever the session serial number.
+ * @param session: The session.
+ * @param devices: Output array, may be null when capacity is 0.
+ * @param capacity: Number of entries of the array.
+ * @param count: Output number of attached devices, it may exceed the capacity.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int prgtoolbox_list_devices(prgtoolbox_session *session, prgtoolbox_device *devices, size_t capacity, size_t *count)
+{
+    if((count == nullptr) || ((devices == nullptr) && (capacity != 0)))
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+
+    return runSessionCall(session, [&]() {
+        DFU dfuInterface ;
+        dfuInterface.toolboxFolder = session->toolboxFolder ;
+        int ret = dfuInterface.scanDevices() ;
+        if(ret != TOOLBOX_DFU_NO_ERROR)
+            return ret ;
+
+        const std::vector<DiscoveredDevice> &discoveredDevices = dfuInterface.getDeviceIndex().getDevices() ;
+        *count = discoveredDevices.size() ;
+        for(size_t index = 0; (index < discoveredDevices.size()) && (index < capacity); index++)
+        {
+            const DiscoveredDevice &device = discoveredDevices[index] ;
+            copyString(devices[index].serial_number, sizeof(devices[index].serial_number), device.serialNumber) ;
+            copyString(devices[index].mode, sizeof(devices[index].mode), DeviceIndex::getModeName(device.mode)) ;
+            devices[index].device_id = device.deviceID ;
+            copyString(devices[index].port_path, sizeof(devices[index].port_path), device.portPath) ;
+            devices[index].lock_owner_pid = device.lockOwnerPid ;
+        }
+        return (int)TOOLBOX_DFU_NO_ERROR ;
+    }) ;
+}
@@ -0,0 +1,507 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ProcessRunner.h"
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#ifndef _WIN32
+#include <spawn.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+extern char **environ;
+#endif
+#include "Error.h"
+
+constexpr size_t PROCESS_READ_BUFFER_SIZE = 4096;
+constexpr size_t PROCESS_INPUT_CHUNK_SIZE = 64 * 1024;   // Bytes asked to the input producer at once
+constexpr int PROCESS_POLL_PERIOD_MS = 50;      // Upper bound of each wait, to observe the cancel requests
+
+std::mutex ProcessRunner::statisticsMutex ;
+ProcessStatistics ProcessRunner::statistics = {0, 0, 0, 0} ;
+
+ProcessRunner::ProcessRunner()
+{
+    msTimeout = PROCESS_QUERY_TIMEOUT_MS ;
+    msIdleTimeout = 0 ;
+    isOutputCaptured = true ;
+    inputData = nullptr ;
+    inputSize = 0 ;
+    isCancelRequested = false ;
+}
+
+/**
+ * @brief ProcessRunner::setTimeout : Set the deadline of the next runs, counted from the process start.
+ * @param msTimeout: The timeout in milliseconds, 0 to wait without limit.
+ */
+void ProcessRunner::setTimeout(uint32_t msTimeout)
+{
+    this->msTimeout = msTimeout ;
+}
+
+/**
+ * @brief ProcessRunner::setIdleTimeout : Set the longest time the next runs may go without output, so a long
+ * transfer reporting its progress is not interrupted whatever its duration.
+ * @param msIdleTimeout: The timeout in milliseconds, 0 to wait without limit.
+ */
+void ProcessRunner::setIdleTimeout(uint32_t msIdleTimeout)
+{
+    this->msIdleTimeout = msIdleTimeout ;
+}
+
+/**
+ * @brief ProcessRunner::setLineCallback : Receive each output line as soon as it is read ('\n' or '\r' terminated).
+ * @param callback: The function called with the line, without its terminator.
+ */
+void ProcessRunner::setLineCallback(std::function<void(const std::string&)> callback)
+{
+    lineCallback = callback ;
+}
+
+/**
+ * @brief ProcessRunner::setDataCallback : Receive the standard output as raw bytes as soon as they are read, for the
+ * programs writing binary data. The standard error is then discarded.
+ * @param callback: The function called with each block of bytes, the process is not read while it runs.
+ * @note Not supported on Windows, where the output is read in text mode.
+ */
+void ProcessRunner::setDataCallback(std::function<void(const char*, size_t)> callback)
+{
+    dataCallback = callback ;
+}
+
+/**
+ * @brief ProcessRunner::setOutputCaptured : Keep the whole output of the next runs in ProcessResult::output.
+ * @param isCaptured: False when the output is only consumed by the callbacks, so a long run does not grow in memory.
+ */
+void ProcessRunner::setOutputCaptured(bool isCaptured)
+{
+    isOutputCaptured = isCaptured ;
+}
+
+/**
+ * @brief ProcessRunner::setInputData : Feed the standard input of the next runs from memory instead of /dev/null.
+ * @param data: The input bytes, the buffer must stay valid until the end of the runs.
+ * @param size: Number of bytes.
+ * @note Not supported on Windows, where the standard input is inherited.
+ */
+void ProcessRunner::setInputData(const unsigned char *data, size_t size)
+{
+    inputData = data ;
+    inputSize = size ;
+}
+
+/**
+ * @brief ProcessRunner::setInputReader : Feed the standard input of the next runs from a producer, as its bytes are produced.
+ * A producer error terminates the process.
+ * @param reader: Fills up to capacity bytes of its buffer and sets the number of bytes written, 0 at the end of
+ * the input. It returns 0 or an error.
+ * @note Not supported on Windows, where the standard input is inherited.
+ */
+void ProcessRunner::setInputReader(std::function<int(unsigned char*, size_t, size_t*)> reader)
+{
+    inputReader = reader ;
+    inputData = nullptr ;
+    inputSize = 0 ;
+}
+
+/**
+ * @brief ProcessRunner::cancel : Request the running process to be terminated, can be called from any thread.
+ */
+void ProcessRunner::cancel()
+{
+    isCancelRequested = true ;
+}
+
+/**
+ * @brief ProcessRunner::runShellCommand : Run a command line through the shell, the quoting rules of the command line are kept.
+ * @param command: The command line.
+ * @param result: Output result of the run.
+ * @return 0 if the process ran to completion, otherwise an error occurred (spawn failure, timeout, cancel).
+ */
+int ProcessRunner::runShellCommand(const std::string &command, ProcessResult &result)
+{
+#ifdef _WIN32
+    /* No non-blocking pipes on this platform, the command runs to completion */
+    result = ProcessResult() ;
+    auto start = std::chrono::steady_clock::now();
+    FILE* pipe = _popen(command.c_str(), "r");
+    if (pipe == nullptr)
+    {
+        account(result, false) ;
+        return TOOLBOX_DFU_ERROR_NO_MEM;
+    }
+
+    char buffer[PROCESS_READ_BUFFER_SIZE];
+    std::string pendingLine ;
+    size_t size = 0 ;
+    while ((size = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+        processOutput(buffer, size, pendingLine, result) ;
+    if((pendingLine.empty() == false) && lineCallback)
+        lineCallback(pendingLine) ;
+
+    result.exitCode = _pclose(pipe);
+    result.wallTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    account(result, true) ;
+    return TOOLBOX_DFU_NO_ERROR ;
+#else
+    /* The shell and the program share the process group signaled on timeout */
+    return run({"/bin/sh", "-c", command}, result) ;
+#endif
+}
+
+/**
+ * @brief ProcessRunner::run : Spawn a program and stream its output until it exits or the deadline is reached.
+ * @param arguments: The program path followed by its arguments, the path is searched in PATH.
+ * @param result: Output result of the run.
+ * @return 0 if the process ran to completion, otherwise an error occurred (spawn failure, timeout, cancel).
+ */
+int ProcessRunner::run(const std::vector<std::string> &arguments, ProcessResult &result)
+{
+    result.exitCode = -1 ;
+    result.isTimedOut = false ;
+    result.isCanceled = false ;
+    result.signalNumber = 0 ;
+    result.wallTimeMs = 0 ;
+    result.output.clear();
+    isCancelRequested = false ;
+
+#ifdef _WIN32
+    std::string command ;
+    for(const auto &argument : arguments)
+        command.append(argument).append(" ") ;
+    return runShellCommand(command, result) ;
+#else
+    if(arguments.empty())
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+
+    int pipeDescriptors[2] ;
+    if(pipe(pipeDescriptors) != 0)
+    {
+        account(result, false) ;
+        return TOOLBOX_DFU_ERROR_NO_MEM ;
+    }
+    fcntl(pipeDescriptors[0], F_SETFD, FD_CLOEXEC);
+    fcntl(pipeDescriptors[1], F_SETFD, FD_CLOEXEC);
+    fcntl(pipeDescriptors[0], F_SETFL, fcntl(pipeDescriptors[0], F_GETFL) | O_NONBLOCK);
+
+    if(inputReader)
+    {
+        inputChunk.resize(PROCESS_INPUT_CHUNK_SIZE) ;
+        inputData = inputChunk.data() ;
+        inputSize = 0 ;
+    }
+
+    int inputDescriptors[2] = {-1, -1} ;
+    if(((inputData != nullptr) || inputReader) && (pipe(inputDescriptors) != 0))
+    {
+        close(pipeDescriptors[0]);
+        close(pipeDescriptors[1]);
+        account(result, false) ;
+        return TOOLBOX_DFU_ERROR_NO_MEM ;
+    }
+    if(inputDescriptors[1] >= 0)
+    {
+        fcntl(inputDescriptors[0], F_SETFD, FD_CLOEXEC);
+        fcntl(inputDescriptors[1], F_SETFD, FD_CLOEXEC);
+        fcntl(inputDescriptors[1], F_SETFL, fcntl(inputDescriptors[1], F_GETFL) | O_NONBLOCK);
+    }
+
+    posix_spawn_file_actions_t fileActions ;
+    posix_spawn_file_actions_init(&fileActions);
+    if(inputDescriptors[0] >= 0)
+        posix_spawn_file_actions_adddup2(&fileActions, inputDescriptors[0], STDIN_FILENO);
+    else
+        posix_spawn_file_actions_addopen(&fileActions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&fileActions, pipeDescriptors[1], STDOUT_FILENO);
+    if(dataCallback)
+        posix_spawn_file_actions_addopen(&fileActions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    else
+        posix_spawn_file_actions_adddup2(&fileActions, pipeDescriptors[1], STDERR_FILENO);
+
+    /* Own process group, so the whole tree is signaled on timeout */
+    posix_spawnattr_t attributes ;
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attributes, 0);
+
+    std::vector<char*> argv ;
+    for(const auto &argument : arguments)
+        argv.push_back(const_cast<char*>(argument.c_str()));
+    argv.push_back(nullptr);
+
+    const auto start = std::chrono::steady_clock::now();
+    pid_t pid = -1 ;
+    int spawnStatus = posix_spawnp(&pid, argv[0], &fileActions, &attributes, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&fileActions);
+    posix_spawnattr_destroy(&attributes);
+    close(pipeDescriptors[1]);
+    if(inputDescriptors[0] >= 0)
+        close(inputDescriptors[0]);
+
+    int inputDescriptor = inputDescriptors[1] ;
+    size_t inputOffset = 0 ;
+    if(spawnStatus != 0)
+    {
+        close(pipeDescriptors[0]);
+        if(inputDescriptor >= 0)
+            close(inputDescriptor);
+        account(result, false) ;
+        return TOOLBOX_DFU_ERROR_NOT_SUPPORTED ;
+    }
+
+    const auto deadline = start + std::chrono::milliseconds(msTimeout);
+    auto killDeadline = deadline ;
+    auto lastOutput = start ;
+    bool isTerminating = false ;
+    bool isPipeOpen = true ;
+    int status = 0 ;
+    std::string pendingLine ;
+    char buffer[PROCESS_READ_BUFFER_SIZE] ;
+
+    while(true)
+    {
+        struct pollfd descriptors[2] ;
+        nfds_t descriptorCount = 0 ;
+        if(isPipeOpen)
+        {
+            descriptors[descriptorCount].fd = pipeDescriptors[0] ;
+            descriptors[descriptorCount].events = POLLIN ;
+            descriptors[descriptorCount].revents = 0 ;
+            descriptorCount++ ;
+        }
+        if(inputDescriptor >= 0)
+        {
+            descriptors[descriptorCount].fd = inputDescriptor ;
+            descriptors[descriptorCount].events = POLLOUT ;
+            descriptors[descriptorCount].revents = 0 ;
+            descriptorCount++ ;
+        }
+
+        if(descriptorCount > 0)
+            poll(descriptors, descriptorCount, PROCESS_POLL_PERIOD_MS);
+        else
+            std::this_thread::sleep_for(std::chrono::milliseconds(PROCESS_POLL_PERIOD_MS / 5));
+
+        /* End of the input once it is all written, or once the program stops reading it */
+        if((inputDescriptor >= 0) && (writeInput(inputDescriptor, inputOffset) == false))
+        {
+            close(inputDescriptor);
+            inputDescriptor = -1 ;
+        }
+
+        if(isPipeOpen)
+        {
+            while(true)
+            {
+                ssize_t size = read(pipeDescriptors[0], buffer, sizeof(buffer));
+                if(size > 0)
+                {
+                    processOutput(buffer, size, pendingLine, result) ;
+                    lastOutput = std::chrono::steady_clock::now();
+                }
+                else if((size < 0) && (errno == EINTR))
+                    continue ;
+                else
+                {
+                    if(size == 0)
+                        isPipeOpen = false ;
+                    break ;
+                }
+            }
+        }
+
+        /* Read what is left once the program exits, a background child may keep the pipe open */
+        if(waitpid(pid, &status, WNOHANG) == pid)
+        {
+            ssize_t size = 0 ;
+            while(isPipeOpen && ((size = read(pipeDescriptors[0], buffer, sizeof(buffer))) > 0))
+                processOutput(buffer, size, pendingLine, result) ;
+            break ;
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if(isTerminating == false)
+        {
+            if(isCancelRequested)
+                result.isCanceled = true ;
+            else if((msTimeout != 0) && (now >= deadline))
+                result.isTimedOut = true ;
+            else if((msIdleTimeout != 0) && (now >= lastOutput + std::chrono::milliseconds(msIdleTimeout)))
+                result.isTimedOut = true ;
+
+            if(result.isCanceled || result.isTimedOut)
+            {
+                kill(-pid, SIGTERM);
+                isTerminating = true ;
+                killDeadline = now + std::chrono::milliseconds(PROCESS_KILL_GRACE_MS) ;
+            }
+        }
+        else if(now >= killDeadline)
+        {
+            kill(-pid, SIGKILL);
+            waitpid(pid, &status, 0);
+            break ;
+        }
+    }
+    close(pipeDescriptors[0]);
+    if(inputDescriptor >= 0)
+        close(inputDescriptor);
+
+    if((pendingLine.empty() == false) && lineCallback)
+        lineCallback(pendingLine) ;
+
+    if(WIFEXITED(status))
+        result.exitCode = WEXITSTATUS(status) ;
+    else if(WIFSIGNALED(status))
+        result.signalNumber = WTERMSIG(status) ;
+
+    result.wallTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    account(result, true) ;
+
+    if(result.isTimedOut)
+        return TOOLBOX_DFU_ERROR_TIMEOUT ;
+    if(result.isCanceled)
+        return TOOLBOX_DFU_ERROR_OTHER ;
+
+    return TOOLBOX_DFU_NO_ERROR ;
+#endif
+}
+
+/**
+ * @brief ProcessRunner::getStatistics : Get the accounting of all the runs of the process.
+ * @return The number of runs, failures, timeouts and the cumulated wall time.
+ */
+ProcessStatistics ProcessRunner::getStatistics()
+{
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    return statistics ;
+}
+
+/**
+ * @brief ProcessRunner::processOutput : Capture the output and split it into lines.
+ */
+void ProcessRunner::processOutput(const char *data, size_t size, std::string &pendingLine, ProcessResult &result)
+{
+    if(isOutputCaptured)
+        result.output.append(data, size);
+
+    if(dataCallback)
+        dataCallback(data, size) ;
+
+    if(!lineCallback)
+        return ;
+
+    for(size_t idx = 0 ; idx < size ; idx++)
+    {
+        if((data[idx] == '\n') || (data[idx] == '\r'))
+        {
+            if(pendingLine.empty() == false)
+                lineCallback(pendingLine) ;
+            pendingLine.clear();
+        }
+        else
+        {
+            pendingLine.push_back(data[idx]);
+        }
+    }
+}
+
+#ifndef _WIN32
+/**
+ * @brief ProcessRunner::writeInput : Write as much input as the pipe accepts without blocking on the pipe,
+ * the input of a producer is refilled as it is written.
+ * @param descriptor: The write end of the standard input pipe.
+ * @param offset: Input and output offset of the next byte to write.
+ * @return True while some input remains to be written, otherwise false.
+ */
+bool ProcessRunner::writeInput(int descriptor, size_t &offset)
+{
+    /* A program exiting without reading its input must not raise SIGPIPE in this process */
+    sigset_t pipeSignal ;
+    sigset_t previousMask ;
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSignal, &previousMask);
+
+    bool isPending = true ;
+    while(true)
+    {
+        if((offset == inputSize) && inputReader)
+        {
+            size_t readSize = 0 ;
+            if(inputReader(inputChunk.data(), inputChunk.size(), &readSize) != TOOLBOX_DFU_NO_ERROR)
+                isCancelRequested = true ; // A truncated input must not be taken for the whole input
+
+            offset = 0 ;
+            inputSize = isCancelRequested ? 0 : readSize ;
+        }
+        if(offset == inputSize)
+        {
+            isPending = false ;
+            break ;
+        }
+
+        ssize_t size = write(descriptor, inputData + offset, inputSize - offset);
+        if(size > 0)
+        {
+            offset += size ;
+        }
+        else if((size < 0) && (errno == EINTR))
+        {
+            continue ;
+        }
+        else
+        {
+            if((size < 0) && (errno == EPIPE))
+            {
+                struct timespec noWait = {0, 0} ;
+                sigtimedwait(&pipeSignal, nullptr, &noWait);
+                isPending = false ;
+            }
+            else if((size < 0) && (errno != EAGAIN))
+            {
+                isPending = false ;
+            }
+            break ;
+        }
+    }
+
+    pthread_sigmask(SIG_SETMASK, &previousMask, nullptr);
+    return isPending ;
+}
+#endif
+
+void ProcessRunner::account(const ProcessResult &result, bool isSpawned)
+{
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    statistics.processCount++ ;
+    statistics.totalWallTimeMs += result.wallTimeMs ;
+    if((isSpawned == false) || (result.exitCode != 0))
+        statistics.failedCount++ ;
+    if(result.isTimedOut)
+        statistics.timedOutCount++ ;
+}
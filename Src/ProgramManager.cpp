@@ -23,6 +23,7 @@
 #include "ProgramManager.h"
 #include <thread>
 #include <chrono>
+#include <algorithm>
 
 using namespace std ;
 
@@ -37,7 +38,22 @@ ProgramManager::ProgramManager(const std::string toolboxFolder, const std::strin
 ProgramManager::~ProgramManager()
 {
     delete dfuInterface ;
-    delete parsedTsvFile ;
+    if(isTsvFileShared == false)
+        delete parsedTsvFile ;
+}
+
+/**
+ * @brief ProgramManager::useParsedTsvFile : Run the next services with a TSV file already parsed, the TSV path is then only displayed.
+ * @param tsvFile: The parsed TSV file, parsed with the fastboot option of the service. It stays owned by the caller
+ * and is only read, so several services can share it.
+ */
+void ProgramManager::useParsedTsvFile(fileTSV *tsvFile)
+{
+    if(isTsvFileShared == false)
+        delete parsedTsvFile ;
+
+    parsedTsvFile = tsvFile ;
+    isTsvFileShared = true ;
 }
 
 /**
@@ -51,7 +67,7 @@ int ProgramManager::startInstallService(const std::string inputTsvPath, bool isS
 {
     auto start = std::chrono::high_resolution_clock::now(); // get start time
 
-    if(fileManager.openTsvFile(inputTsvPath, &parsedTsvFile, isStartFastboot) != 0)
+    if((isTsvFileShared == false) && (fileManager.openTsvFile(inputTsvPath, &parsedTsvFile, isStartFastboot) != 0))
     {
         displayManager.print(MSG_ERROR, L"Failed to download TSV partitions: %s", inputTsvPath.c_str());
         return TOOLBOX_DFU_ERROR_NO_FILE ;
@@ -107,6 +123,9 @@ int ProgramManager::startInstallService(const std::string inputTsvPath, bool isS
     if(dfuInterface->isDfuDeviceExist() == false)
         return TOOLBOX_DFU_ERROR_CONNECTION;
 
+    if(lockDevice() != TOOLBOX_DFU_NO_ERROR)
+        return TOOLBOX_DFU_ERROR_DEVICE_BUSY ;
+
     if(dfuInterface->getDeviceID() != 0)
         return TOOLBOX_DFU_ERROR_NO_DEVICE ;
 
@@ -234,37 +253,18 @@ int ProgramManager::startInstallService(const std::string inputTsvPath, bool isS
     /* Flash the flash memory layout in partition 0 and start fastboot/DFU mode */
     if((isDfuFlashingCommand == true) || (isStartFastboot == true))
     {
-        std::string tempFile ;
-        ret = fileManager.saveTemproryScriptFile(*parsedTsvFile, tempFile) ;
-        if(ret != 0)
-        {
-            displayManager.print(MSG_ERROR, L"Failed to prepare script flashlayout !");
-            return ret ;
-        }
-
         if(dfuInterface->isUbootDfuRunning(30000) == false) //waiting the device to detach
         {
             return TOOLBOX_DFU_ERROR_CONNECTION ;
         }
 
-        ret = dfuInterface->flashPartition(0, tempFile) ;
+        ret = dfuInterface->flashPartition(0, parsedTsvFile->scriptUbootTsvData, parsedTsvFile->scriptUbootTsvDataSize) ;
         if(ret != 0)
         {
             displayManager.print(MSG_ERROR, L"Failed to program flashlayout at partition 0 !");
-            if(fileManager.removeTemproryFile(tempFile.c_str()) != TOOLBOX_DFU_NO_ERROR)
-            {
-                displayManager.print(MSG_ERROR, L"Failed to remove the temprory file !");
-                return TOOLBOX_DFU_ERROR_NO_MEM ;
-            }
             return ret ;
         }
 
-        if(fileManager.removeTemproryFile(tempFile.c_str()) != TOOLBOX_DFU_NO_ERROR)
-        {
-            displayManager.print(MSG_ERROR, L"Failed to remove the temprory file !");
-            return TOOLBOX_DFU_ERROR_NO_MEM ;
-        }
-
         ret = dfuInterface->dfuDetach() ;
         if(ret != 0)
             return ret ;
@@ -315,6 +315,43 @@ void ProgramManager::sleep(uint32_t ms)
     std::this_thread::sleep_for(std::chrono::milliseconds(ms));
 }
 
+/**
+ * @brief ProgramManager::lockDevice : Lock the selected device against the other toolbox instances, by serial number and USB port.
+ * @return 0 if the operation is performed successfully, TOOLBOX_DFU_ERROR_DEVICE_BUSY if the device is used by another instance
+ * or if it has no lock key.
+ * @note The device must have been found, the lock is kept across its re-enumerations until the end of the service.
+ */
+int ProgramManager::lockDevice()
+{
+    if(deviceLock.isHeld())
+        return TOOLBOX_DFU_NO_ERROR ;
+
+    const DfuDeviceInfo &device = dfuInterface->getSession().getDeviceInfo() ;
+    std::string serialNumber = (device.serialNumber == "UNKNOWN") ? std::string("") : device.serialNumber ; // Would be shared by all the unreadable serial numbers
+    if(serialNumber.empty() && device.portPath.empty())
+    {
+        /* No key to lock: refuse rather than let another instance write the same device */
+        displayManager.print(MSG_ERROR, L"The STM32 DFU device cannot be locked, its serial number and its USB port are unknown !") ;
+        return TOOLBOX_DFU_ERROR_DEVICE_BUSY ;
+    }
+
+    int ret = deviceLock.acquire(serialNumber, device.portPath) ;
+    if(ret == TOOLBOX_DFU_ERROR_DEVICE_BUSY)
+    {
+        long ownerPid = 0 ;
+        DeviceLock::isLocked(serialNumber, device.portPath, &ownerPid) ;
+        displayManager.print(MSG_ERROR, L"STM32 DFU device %s on USB port %s is used by another process (PID %ld) !", device.serialNumber.c_str(), device.portPath.c_str(), ownerPid) ;
+    }
+    else if(ret != TOOLBOX_DFU_NO_ERROR)
+    {
+        /* The lock directory cannot be used, the device is accessed as before the locks */
+        displayManager.print(MSG_WARNING, L"The STM32 DFU device %s could not be locked in %s", device.serialNumber.c_str(), DeviceLock::getLockDirectory().c_str()) ;
+        ret = TOOLBOX_DFU_NO_ERROR ;
+    }
+
+    return ret ;
+}
+
 /**
  * @brief ProgramManager::readOtpPartition : Read the OTP partition and request to save data in file.
  * @param filePath: The output binary file to store OTP data.
@@ -331,6 +368,9 @@ int ProgramManager::readOtpPartition(const std::string filePath)
     if(dfuInterface->isDfuDeviceExist() == false)
         return TOOLBOX_DFU_ERROR_CONNECTION;
 
+    if(lockDevice() != TOOLBOX_DFU_NO_ERROR)
+        return TOOLBOX_DFU_ERROR_DEVICE_BUSY ;
+
     if(dfuInterface->getDeviceID() != 0)
         return TOOLBOX_DFU_ERROR_NO_DEVICE ;
 
@@ -371,6 +411,9 @@ int ProgramManager::writeOtpPartition(const std::string filePath)
     if(dfuInterface->isDfuDeviceExist() == false)
         return TOOLBOX_DFU_ERROR_CONNECTION;
 
+    if(lockDevice() != TOOLBOX_DFU_NO_ERROR)
+        return TOOLBOX_DFU_ERROR_DEVICE_BUSY ;
+
     if(dfuInterface->getDeviceID() != 0)
         return TOOLBOX_DFU_ERROR_NO_DEVICE ;
 
@@ -390,7 +433,7 @@ int ProgramManager::startFlashingService(const std::string inputTsvPath)
     displayManager.print(MSG_NORMAL, L"\nStart DFU flashing service...\n\n");
 
     auto start = std::chrono::high_resolution_clock::now(); // get start time
-    if(fileManager.openTsvFile(inputTsvPath, &parsedTsvFile, false) != 0)
+    if((isTsvFileShared == false) && (fileManager.openTsvFile(inputTsvPath, &parsedTsvFile, false) != 0))
     {
         displayManager.print(MSG_ERROR, L"Failed to download TSV partitions: %s", inputTsvPath.c_str());
         return TOOLBOX_DFU_ERROR_NO_FILE ;
@@ -413,6 +456,9 @@ int ProgramManager::startFlashingService(const std::string inputTsvPath)
     if(dfuInterface->isDfuDeviceExist() == false)
         return TOOLBOX_DFU_ERROR_CONNECTION;
 
+    if(lockDevice() != TOOLBOX_DFU_NO_ERROR)
+        return TOOLBOX_DFU_ERROR_DEVICE_BUSY ;
+
     if(dfuInterface->getDeviceID() != 0)
         return TOOLBOX_DFU_ERROR_NO_DEVICE ;
 
@@ -420,6 +466,11 @@ int ProgramManager::startFlashingService(const std::string inputTsvPath)
     bool isNeedDetach = false ;
     bool isFlashlayoutSent = false;
 
+    /* The device asks for the partitions in the TSV order, the first binary is read while the device is queried */
+    PartitionPrefetcher prefetcher ;
+    std::map<std::string, std::shared_ptr<FirmwareImage>> sharedImages ;
+    prefetcher.prefetch(getNextBinary(-1)) ;
+
     while(1)
     {
         ret = getPhase(&phaseID, &isNeedDetach) ;
@@ -432,28 +483,12 @@ int ProgramManager::startFlashingService(const std::string inputTsvPath)
                 continue;
 
             displayManager.print(MSG_NORMAL, L"\nFlashlayout Programming ...");
-            std::string tempFile ;
-            ret = fileManager.saveTemproryScriptFile(*parsedTsvFile, tempFile) ;
-            if(ret != 0)
-            {
-                displayManager.print(MSG_ERROR, L"Failed to prepare flashlayout !");
-                break ;
-            }
-
-            ret = dfuInterface->flashPartition(0, tempFile) ;
+            ret = dfuInterface->flashPartition(0, parsedTsvFile->scriptUbootTsvData, parsedTsvFile->scriptUbootTsvDataSize) ;
             if(ret != 0)
             {
                 displayManager.print(MSG_ERROR, L"Failed to program flashlayout at partition 0 !");
-            }
-
-            if(fileManager.removeTemproryFile(tempFile.c_str()) != TOOLBOX_DFU_NO_ERROR)
-            {
-                displayManager.print(MSG_ERROR, L"Failed to remove the temprory flashlayout file !");
-                break;
-            }
-
-            if(ret != TOOLBOX_DFU_NO_ERROR)
                 break ;
+            }
 
             ret = dfuInterface->dfuDetach() ;
             if(ret != 0)
@@ -479,10 +514,10 @@ int ProgramManager::startFlashingService(const std::string inputTsvPath)
         }
         else
         {
-            for(auto &part: parsedTsvFile->partitionsList)
+            for(size_t partitionIndex = 0 ; partitionIndex < parsedTsvFile->partitionsList.size() ; partitionIndex++)
             {
-                std::string patternNone = "none\"";
-                if((part.binary == "none") || (part.binary.size() >= patternNone.size() && part.binary.substr(part.binary.size() - patternNone.size()) == patternNone)) //ignore the field containing none keyword
+                const partitionInfo &part = parsedTsvFile->partitionsList.at(partitionIndex) ;
+                if(isPartitionBinary(part) == false) //ignore the field containing none keyword
                     continue ;
 
                 if(part.phaseID == phaseID)
@@ -492,7 +527,7 @@ int ProgramManager::startFlashingService(const std::string inputTsvPath)
                     if(ret != TOOLBOX_DFU_NO_ERROR)
                         break;
 
-                    ret = dfuInterface->flashPartition(alternateIndex, part.binary) ;
+                    ret = flashPartitionBinary(alternateIndex, partitionIndex, prefetcher, sharedImages) ;
                     if(ret != 0)
                         break;
 
@@ -532,6 +567,13 @@ int ProgramManager::startFlashingService(const std::string inputTsvPath)
         auto duration = std::chrono::duration_cast< std::chrono::milliseconds>(end - start);
         displayManager.print(MSG_NORMAL, L"DFU Flashing service finished."),
         displayManager.print(MSG_GREEN, L"Time elapsed to flash all partitions: %ld min, %02ld s, %03ld ms", (duration.count() / (1000 * 60)), ((duration.count() / 1000) % 60), (duration.count() % 1000));
+        displayManager.print(MSG_NORMAL, L"Device descriptors probed %d times over %d enumerations", dfuInterface->getSession().getProbeCount(), dfuInterface->getSession().getGeneration() + 1);
+        displayManager.print(MSG_NORMAL, L"Alternate setting lookups : %d cached, %d queried", dfuInterface->getSession().getLookupHits(), dfuInterface->getSession().getLookupMisses());
+        displayManager.print(MSG_NORMAL, L"Host I/O stall : %llu ms", (unsigned long long)prefetcher.getStallMs());
+
+        ProcessStatistics processStatistics = ProcessRunner::getStatistics() ;
+        if(processStatistics.processCount != 0)
+            displayManager.print(MSG_NORMAL, L"External programs : %d runs, %d failed, %d timed out, %llu ms", processStatistics.processCount, processStatistics.failedCount, processStatistics.timedOutCount, (unsigned long long)processStatistics.totalWallTimeMs);
     }
     else
     {
@@ -542,6 +584,149 @@ int ProgramManager::startFlashingService(const std::string inputTsvPath)
 
 }
 
+/**
+ * @brief ProgramManager::isPartitionBinary
+ * @param part: The partition.
+ * @return True if the partition has a binary to be downloaded, false if its binary field is none.
+ */
+bool ProgramManager::isPartitionBinary(const partitionInfo &part)
+{
+    std::string patternNone = "none\"";
+    return (part.binary != "none") && ((part.binary.size() < patternNone.size()) || (part.binary.substr(part.binary.size() - patternNone.size()) != patternNone)) ;
+}
+
+/**
+ * @brief ProgramManager::isServedPartition : A phase is served by its first partition in the TSV list, the partitions
+ * sharing the phase of a previous one are never asked for.
+ * @param partitionIndex: Index of the partition in the TSV partitions list.
+ * @return True if the binary of the partition is downloaded when the device asks for its phase.
+ */
+bool ProgramManager::isServedPartition(size_t partitionIndex)
+{
+    const std::vector<partitionInfo> &partitions = parsedTsvFile->partitionsList ;
+    if(isPartitionBinary(partitions.at(partitionIndex)) == false)
+        return false ;
+
+    for(size_t previous = 0 ; previous < partitionIndex ; previous++)
+    {
+        if(isPartitionBinary(partitions.at(previous)) && (partitions.at(previous).phaseID == partitions.at(partitionIndex).phaseID))
+            return false ;
+    }
+    return true ;
+}
+
+/**
+ * @brief ProgramManager::isBinaryUsedAgain : Check if the image of a partition is downloaded again for a later partition.
+ * The binaries holding the same image are named with the same path by the TSV parser.
+ * @param partitionIndex: Index of the current partition in the TSV partitions list.
+ * @return True if a partition served after this one has the same binary.
+ */
+bool ProgramManager::isBinaryUsedAgain(size_t partitionIndex)
+{
+    const std::vector<partitionInfo> &partitions = parsedTsvFile->partitionsList ;
+    for(size_t index = partitionIndex + 1 ; index < partitions.size() ; index++)
+    {
+        if(isServedPartition(index) && (partitions.at(index).binary == partitions.at(partitionIndex).binary))
+            return true ;
+    }
+    return false ;
+}
+
+/**
+ * @brief ProgramManager::getNextBinary : Predict the binary the device asks for after a partition, from the TSV order.
+ * The binaries already downloaded for a previous partition are skipped, they are kept in memory until their last use.
+ * @param partitionIndex: Index of the current partition in the TSV partitions list, -1 before the first one.
+ * @return The binary of the next partition having one, empty if there is none or if it is compressed: the compressed
+ * binaries are decompressed during their transfer.
+ */
+std::string ProgramManager::getNextBinary(int partitionIndex)
+{
+    const std::vector<partitionInfo> &partitions = parsedTsvFile->partitionsList ;
+    for(size_t index = partitionIndex + 1 ; index < partitions.size() ; index++)
+    {
+        if(isServedPartition(index) == false)
+            continue ;
+
+        bool isLoaded = false ;
+        for(size_t previous = 0 ; previous < index ; previous++)
+            isLoaded = isLoaded || (isServedPartition(previous) && (partitions.at(previous).binary == partitions.at(index).binary)) ;
+
+        if(isLoaded == false)
+            return (StreamDecompressor::getFormat(partitions.at(index).binary) == COMPRESSION_NONE) ? partitions.at(index).binary : "" ;
+    }
+    return "" ;
+}
+
+/**
+ * @brief ProgramManager::flashPartitionBinary : Download a partition binary from its prefetched mapping, or from its file
+ * when it could not be mapped or when the transport reads the file itself, and report the time the download waited for
+ * the binary. The next binary is mapped and read ahead during the download. An image downloaded again for a later
+ * partition is kept mapped until its last use. With the sparse download, the trailing fill blocks of the partitions
+ * written to a memory are dropped.
+ * @param alternateIndex: The alternate setting index of the target partition.
+ * @param partitionIndex: Index of the partition in the TSV partitions list.
+ * @param prefetcher: The prefetcher of the service.
+ * @param sharedImages: The images of the service kept for a later partition, by binary.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int ProgramManager::flashPartitionBinary(uint8_t alternateIndex, size_t partitionIndex, PartitionPrefetcher &prefetcher, std::map<std::string, std::shared_ptr<FirmwareImage>> &sharedImages)
+{
+    const partitionInfo &part = parsedTsvFile->partitionsList.at(partitionIndex) ;
+    const std::string &binary = part.binary ;
+    std::string nextBinary = getNextBinary(partitionIndex) ;
+    if(StreamDecompressor::getFormat(binary) != COMPRESSION_NONE)
+    {
+        prefetcher.prefetch(nextBinary) ;
+        return dfuInterface->flashPartition(alternateIndex, binary) ;
+    }
+
+    std::string path = binary ;
+    path.erase(std::remove(path.begin(), path.end(), '\"'), path.end()) ; //remove the double quotes from the file path
+    bool isSparse = SparseScanner::isEnabled() && (part.partIp != "none") ;
+    bool isUsedAgain = isBinaryUsedAgain(partitionIndex) ;
+    std::shared_ptr<FirmwareImage> firmware ;
+    uint64_t stallMs = 0 ;
+    const char *source = "shared with a previous partition" ;
+
+    auto sharedImage = sharedImages.find(binary) ;
+    if(sharedImage != sharedImages.end())
+    {
+        firmware = sharedImage->second ;
+        if(isUsedAgain == false)
+            sharedImages.erase(sharedImage) ;
+        prefetcher.prefetch(nextBinary) ;
+    }
+    else
+    {
+        bool isPrefetched = false ;
+        int ret = prefetcher.take(binary, firmware, stallMs, isPrefetched) ;
+        prefetcher.prefetch(nextBinary) ;
+
+        /* A transport reading the file itself gets its path, the mapping only kept its pages in the page cache */
+        if((ret != TOOLBOX_DFU_NO_ERROR) || (firmware->getSize() == 0) || ((isSparse == false) && dfuInterface->isFileDownloadPreferred()))
+        {
+            displayManager.print(MSG_NORMAL, L"I/O stall       : %llu ms, the binary is downloaded from its file", (unsigned long long)stallMs);
+            return dfuInterface->flashPartition(alternateIndex, binary) ;
+        }
+
+        source = isPrefetched ? "mapped in advance" : "mapped on demand" ;
+        if(isUsedAgain)
+            sharedImages[binary] = firmware ;
+    }
+
+    size_t imageSize = firmware->getSize() ;
+    displayManager.print(MSG_NORMAL, L"Firmware path   : %s", binary.c_str());
+    displayManager.print(MSG_NORMAL, L"I/O stall       : %llu ms, %s", (unsigned long long)stallMs, source);
+    if(isSparse)
+    {
+        SparseLayout layout ;
+        bool isCached = SparseScanner::getLayout(path, firmware->getData(), imageSize, layout) ;
+        displayManager.print(MSG_NORMAL, L"Sparse download : %llu of %llu bytes, %llu bytes of data (%s)", (unsigned long long)layout.trimmedSize, (unsigned long long)layout.fileSize, (unsigned long long)layout.dataSize, isCached ? "cached layout" : "scanned");
+        imageSize = (size_t)layout.trimmedSize ;
+    }
+    return dfuInterface->flashPartition(alternateIndex, firmware->getData(), imageSize) ;
+}
+
 /**
  * @brief ProgramManager::getPhase : Get the acutal running phase.
  * @param phase: Output parameter indicating the phase value.
@@ -560,53 +745,17 @@ int ProgramManager::getPhase(uint8_t* phase, bool* isNeedDetach)
     if(status != TOOLBOX_DFU_NO_ERROR)
         return status ;
 
+    if(lockDevice() != TOOLBOX_DFU_NO_ERROR)
+        return TOOLBOX_DFU_ERROR_DEVICE_BUSY ;
+
     if(dfuInterface->getDeviceID() != 0)
         status =  TOOLBOX_DFU_ERROR_NO_DEVICE ;
 
-    if(status != TOOLBOX_DFU_NO_ERROR)
-        return status ;
-
-    std::string tmpPhaseFile = "" ;
-    status = fileManager.getTemproryFile(tmpPhaseFile) ;
-    if(status != TOOLBOX_DFU_NO_ERROR)
-        return status ;
-
-    status = fileManager.removeTemproryFile(tmpPhaseFile) ; // Remove the temporary file to allow dfu-util to create it again
-    if(status != TOOLBOX_DFU_NO_ERROR)
-        return status ;
-
-    uint8_t alternateIndexVirtual = 0xFF;
-    status = this->dfuInterface->getAlternateSettingIndex("virtual", &alternateIndexVirtual);
-    if(status != TOOLBOX_DFU_NO_ERROR)
-        return status ;
-
-    status = dfuInterface->readPartition(tmpPhaseFile, alternateIndexVirtual) ;
-    if(status != TOOLBOX_DFU_NO_ERROR)
-        return status ;
-
-    /* The GetPhase information is now avialable inside the tmpPhaseFile */
-    std::ifstream file(tmpPhaseFile, std::ios::binary);
-    if (!file)
-    {
-        displayManager.print(MSG_ERROR, L"The file does not exist :  %s",  tmpPhaseFile.data());
-        status = TOOLBOX_DFU_ERROR_NO_FILE;
-    }
-
     if(status != TOOLBOX_DFU_NO_ERROR)
         return status ;
 
     GetPhaseStruct data;
-    file.read(reinterpret_cast<char*>(&data), sizeof(data) - 1);
-
-    /* Check if Phase is 0 to read the NeedDFUDetach byte */
-    if (data.Phase == 0)
-        file.read(reinterpret_cast<char*>(&data.NeedDFUDetach), sizeof(data.NeedDFUDetach));
-    else
-        data.NeedDFUDetach = 0;
-
-    file.close();
-
-    status = fileManager.removeTemproryFile(std::move(tmpPhaseFile) ) ; // Remove the temprory file created by dfu-util.
+    status = dfuInterface->getPhase(&data) ;
     if(status != TOOLBOX_DFU_NO_ERROR)
         return status ;
 
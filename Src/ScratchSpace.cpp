@@ -0,0 +1,271 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ScratchSpace.h"
+#include "DisplayManager.h"
+#include "Error.h"
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <vector>
+#include <experimental/filesystem>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#endif
+
+namespace fs = std::experimental::filesystem ;
+
+static const char SCRATCH_PREFIX[] = "PRG-TOOLBOX-DFU." ;
+static const char SCRATCH_LOCK_FILE[] = ".lock" ;
+constexpr long SCRATCH_UNLOCKED_MAX_AGE_S = 3600;     // Directories without lock file, being created or left by a former version
+
+std::mutex ScratchSpace::registryMutex ;
+std::set<std::string> ScratchSpace::registry ;
+
+ScratchSpace::ScratchSpace()
+{
+    fileCount = 0 ;
+    lockDescriptor = -1 ;
+}
+
+ScratchSpace::~ScratchSpace()
+{
+    remove();
+}
+
+const std::string& ScratchSpace::getDirectory() const
+{
+    return directory ;
+}
+
+/**
+ * @brief ScratchSpace::getFilePath : Get a new file path in the scratch directory, the file itself is not created.
+ * @param name: Suffix of the file name, to recognize the file in the messages.
+ * @param filePath: Output path, never returned twice by the same instance.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int ScratchSpace::getFilePath(const std::string &name, std::string &filePath)
+{
+    if(directory.empty())
+    {
+        int ret = create() ;
+        if(ret != TOOLBOX_DFU_NO_ERROR)
+            return ret ;
+    }
+
+    fs::path path(directory) ;
+    path /= std::to_string(fileCount++) + "-" + name ;
+    filePath = path.string() ;
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief ScratchSpace::remove : Remove the scratch directory with its content.
+ */
+void ScratchSpace::remove()
+{
+    if(directory.empty())
+        return ;
+
+    std::error_code errorCode ;
+    fs::remove_all(directory, errorCode) ;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.erase(directory) ;
+    }
+    directory.clear();
+
+#ifndef _WIN32
+    if(lockDescriptor >= 0)
+        close(lockDescriptor) ;
+#endif
+    lockDescriptor = -1 ;
+}
+
+/**
+ * @brief ScratchSpace::create : Create the unique directory of this instance.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int ScratchSpace::create()
+{
+    std::string baseDirectory = getBaseDirectory() ;
+    removeStaleDirectories(baseDirectory) ;
+
+#ifdef _WIN32
+    static uint32_t instanceCount = 0 ;
+    std::error_code errorCode ;
+    for(int attempt = 0; (attempt < 100) && directory.empty(); attempt++)
+    {
+        fs::path path(baseDirectory) ;
+        path /= std::string(SCRATCH_PREFIX) + std::to_string((unsigned long)GetCurrentProcessId()) + "." + std::to_string(instanceCount++) ;
+        if(fs::create_directory(path, errorCode))
+            directory = path.string() ;
+    }
+    if(directory.empty())
+#else
+    fs::path path(baseDirectory) ;
+    path /= std::string(SCRATCH_PREFIX) + std::to_string((long)getpid()) + ".XXXXXX" ;
+    std::string pathString = path.string() ;
+    std::vector<char> pathTemplate(pathString.begin(), pathString.end()) ;
+    pathTemplate.push_back('\0');
+    if(mkdtemp(pathTemplate.data()) != nullptr) // Unique name, mode 0700
+    {
+        directory = pathTemplate.data() ;
+
+        /* The PID of the name cannot tell if the owner is alive from another PID namespace, the lock can */
+        lockDescriptor = open((fs::path(directory) / SCRATCH_LOCK_FILE).string().c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC | O_NOFOLLOW, 0600) ;
+        if((lockDescriptor >= 0) && (flock(lockDescriptor, LOCK_EX | LOCK_NB) != 0))
+        {
+            close(lockDescriptor) ;
+            lockDescriptor = -1 ;
+        }
+        if(lockDescriptor < 0)
+        {
+            std::error_code errorCode ;
+            fs::remove_all(directory, errorCode) ;
+            directory.clear();
+        }
+    }
+    if(directory.empty())
+#endif
+    {
+        DisplayManager::getInstance().print(MSG_ERROR, L"Could not create a scratch directory in %s", baseDirectory.c_str());
+        return TOOLBOX_DFU_ERROR_NO_FILE ;
+    }
+
+    static bool isExitHandlerSet = false ;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if(isExitHandlerSet == false)
+        isExitHandlerSet = (atexit(ScratchSpace::removeAll) == 0) ;
+    registry.insert(directory) ;
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief ScratchSpace::getBaseDirectory : Prefer the per-user runtime directory, usually a tmpfs.
+ * @return The directory in which the scratch directories are created.
+ */
+std::string ScratchSpace::getBaseDirectory()
+{
+#ifndef _WIN32
+    const char *runtimeDirectory = std::getenv("XDG_RUNTIME_DIR") ;
+    if((runtimeDirectory != nullptr) && (runtimeDirectory[0] != '\0') && (access(runtimeDirectory, W_OK | X_OK) == 0))
+        return runtimeDirectory ;
+#endif
+
+    std::error_code errorCode ;
+    fs::path tempDirectory = fs::temp_directory_path(errorCode) ;
+    if(errorCode)
+        return "/tmp" ;
+
+    return tempDirectory.string() ;
+}
+
+/**
+ * @brief ScratchSpace::removeStaleDirectories : Remove the scratch directories of the processes which no longer exist.
+ * @param baseDirectory: The directory holding the scratch directories.
+ */
+void ScratchSpace::removeStaleDirectories(const std::string &baseDirectory)
+{
+#ifndef _WIN32
+    std::error_code errorCode ;
+    fs::directory_iterator entry(baseDirectory, errorCode) ;
+    if(errorCode)
+        return ;
+
+    std::vector<fs::path> staleDirectories ;
+    for(; entry != fs::directory_iterator(); entry.increment(errorCode))
+    {
+        if(errorCode)
+            break ;
+
+        std::string name = entry->path().filename().string() ;
+        if(name.compare(0, strlen(SCRATCH_PREFIX), SCRATCH_PREFIX) != 0)
+            continue ;
+
+        long pid = std::strtol(name.c_str() + strlen(SCRATCH_PREFIX), nullptr, 10) ;
+        if((pid > 0) && (kill((pid_t)pid, 0) != 0) && (errno == ESRCH))
+            staleDirectories.push_back(entry->path()) ;
+    }
+
+    for(const auto &path : staleDirectories)
+        removeUnlockedDirectory(path.string()) ;
+#else
+    (void)baseDirectory ;
+#endif
+}
+
+/**
+ * @brief ScratchSpace::removeUnlockedDirectory : Remove a scratch directory unless a session still holds its lock.
+ * @param path: The scratch directory.
+ * @return True if the directory is removed, otherwise false.
+ */
+bool ScratchSpace::removeUnlockedDirectory(const std::string &path)
+{
+#ifndef _WIN32
+    std::error_code errorCode ;
+    int fd = open((fs::path(path) / SCRATCH_LOCK_FILE).string().c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW) ;
+    if(fd < 0)
+    {
+        /* No lock file: the directory may be in creation, only an old one is removed */
+        struct stat status ;
+        if((errno != ENOENT) || (stat(path.c_str(), &status) != 0) || ((time(nullptr) - status.st_mtime) < SCRATCH_UNLOCKED_MAX_AGE_S))
+            return false ;
+
+        fs::remove_all(path, errorCode) ;
+        return true ;
+    }
+
+    /* The lock is kept while removing, a live session holds it until it removes its directory itself */
+    bool isRemoved = false ;
+    if(flock(fd, LOCK_EX | LOCK_NB) == 0)
+    {
+        fs::remove_all(path, errorCode) ;
+        isRemoved = true ;
+    }
+    close(fd) ;
+    return isRemoved ;
+#else
+    (void)path ;
+    return false ;
+#endif
+}
+
+/**
+ * @brief ScratchSpace::removeAll : Remove the directories of the instances still alive when the process exits.
+ */
+void ScratchSpace::removeAll()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::error_code errorCode ;
+    for(const auto &path : registry)
+        fs::remove_all(path, errorCode) ;
+    registry.clear();
+}
@@ -0,0 +1,279 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "SparseScanner.h"
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <set>
+#include <vector>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <experimental/filesystem>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace fs = std::experimental::filesystem ;
+
+bool SparseScanner::isSparseEnabled = false ;
+std::mutex SparseScanner::cacheMutex ;
+bool SparseScanner::isCacheLoaded = false ;
+std::map<std::string, SparseLayout> SparseScanner::cache ;
+
+void SparseScanner::setEnabled(bool isEnabled)
+{
+    isSparseEnabled = isEnabled ;
+}
+
+bool SparseScanner::isEnabled()
+{
+    return isSparseEnabled ;
+}
+
+/**
+ * @brief SparseScanner::getLayout : Get the sparse layout of a binary, from the cache or by scanning its content.
+ * @param filePath: The binary path, without quotes, used as cache key with the file identity.
+ * @param data: The content of the binary.
+ * @param size: Number of bytes.
+ * @param layout: Output layout.
+ * @return True if the layout comes from the cache, false if the binary was scanned.
+ */
+bool SparseScanner::getLayout(const std::string &filePath, const unsigned char *data, size_t size, SparseLayout &layout)
+{
+    std::string key = getFileKey(filePath) ;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex) ;
+        loadCache() ;
+        auto entry = cache.find(key) ;
+        if((key.empty() == false) && (entry != cache.end()) && (entry->second.fileSize == size))
+        {
+            layout = entry->second ;
+            return true ;
+        }
+    }
+
+    scan(data, size, layout) ;
+    if(key.empty() == false)
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex) ;
+        cache[key] = layout ;
+        storeCache(key, layout) ;
+    }
+    return false ;
+}
+
+/**
+ * @brief SparseScanner::scan : Find the fill blocks of an image and the size left once its trailing fill blocks are dropped.
+ * @param data: The content of the image.
+ * @param size: Number of bytes.
+ * @param layout: Output layout. At least one block is kept, so an image only made of fill is still downloaded.
+ */
+void SparseScanner::scan(const unsigned char *data, size_t size, SparseLayout &layout)
+{
+    layout.fileSize = size ;
+    layout.dataSize = 0 ;
+    uint64_t dataEnd = 0 ;
+    for(size_t offset = 0 ; offset < size ; offset += SPARSE_BLOCK_SIZE)
+    {
+        size_t blockSize = std::min(SPARSE_BLOCK_SIZE, size - offset) ;
+        if(isFillBlock(data + offset, blockSize) == false)
+        {
+            layout.dataSize += blockSize ;
+            dataEnd = offset + blockSize ;
+        }
+    }
+
+    layout.trimmedSize = std::max(dataEnd, (uint64_t)std::min(SPARSE_BLOCK_SIZE, size)) ;
+}
+
+/**
+ * @brief SparseScanner::isFillBlock
+ * @param block: The bytes of the block.
+ * @param size: Number of bytes.
+ * @return True if the block only contains 0x00 or only contains 0xFF.
+ */
+bool SparseScanner::isFillBlock(const unsigned char *block, size_t size)
+{
+    size_t offset = 0 ;
+    bool isZero = true ;
+    bool isErased = true ;
+#if defined(__SSE2__)
+    /* 16 bytes per step: OR of the block is zero for 0x00, AND of the block is all ones for 0xFF */
+    __m128i orBytes = _mm_setzero_si128() ;
+    __m128i andBytes = _mm_set1_epi8((char)0xFF) ;
+    for( ; offset + 16 <= size ; offset += 16)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + offset)) ;
+        orBytes = _mm_or_si128(orBytes, bytes) ;
+        andBytes = _mm_and_si128(andBytes, bytes) ;
+    }
+    isZero = (_mm_movemask_epi8(_mm_cmpeq_epi8(orBytes, _mm_setzero_si128())) == 0xFFFF) ;
+    isErased = (_mm_movemask_epi8(_mm_cmpeq_epi8(andBytes, _mm_set1_epi8((char)0xFF))) == 0xFFFF) ;
+#else
+    uint64_t orWords = 0 ;
+    uint64_t andWords = UINT64_MAX ;
+    for( ; offset + sizeof(uint64_t) <= size ; offset += sizeof(uint64_t))
+    {
+        uint64_t word ;
+        memcpy(&word, block + offset, sizeof(word)) ;
+        orWords |= word ;
+        andWords &= word ;
+    }
+    isZero = (orWords == 0) ;
+    isErased = (andWords == UINT64_MAX) ;
+#endif
+    for( ; offset < size ; offset++)
+    {
+        isZero = isZero && (block[offset] == 0x00) ;
+        isErased = isErased && (block[offset] == 0xFF) ;
+    }
+    return isZero || isErased ;
+}
+
+/**
+ * @brief SparseScanner::getFileKey : Build the cache key of a binary from its identity, a modified file gets a new key.
+ * @param filePath: The binary path, without quotes.
+ * @return The key, empty if the file cannot be found.
+ */
+std::string SparseScanner::getFileKey(const std::string &filePath)
+{
+    struct stat fileStat ;
+    if(stat(filePath.c_str(), &fileStat) != 0)
+        return "" ;
+
+    std::ostringstream key ;
+    key << (uint64_t)fileStat.st_dev << ":" << (uint64_t)fileStat.st_ino << ":" << (uint64_t)fileStat.st_size << ":" << (uint64_t)fileStat.st_mtime ;
+#ifndef _WIN32
+    key << "." << (uint64_t)fileStat.st_mtim.tv_nsec ;
+#endif
+    return key.str() ;
+}
+
+/**
+ * @brief SparseScanner::getCacheFilePath
+ * @return The file keeping the layouts between the runs, empty if no cache directory is known.
+ */
+std::string SparseScanner::getCacheFilePath()
+{
+    fs::path cacheDirectory ;
+    const char *envCacheDirectory = std::getenv("PRG_TOOLBOX_DFU_CACHE_DIR") ;
+    const char *xdgCacheDirectory = std::getenv("XDG_CACHE_HOME") ;
+    const char *homeDirectory = std::getenv("HOME") ;
+    if((envCacheDirectory != nullptr) && (envCacheDirectory[0] != '\0'))
+        cacheDirectory = envCacheDirectory ;
+    else if((xdgCacheDirectory != nullptr) && (xdgCacheDirectory[0] != '\0'))
+        cacheDirectory = fs::path(xdgCacheDirectory) / "PRG-TOOLBOX-DFU" ;
+    else if((homeDirectory != nullptr) && (homeDirectory[0] != '\0'))
+        cacheDirectory = fs::path(homeDirectory) / ".cache" / "PRG-TOOLBOX-DFU" ;
+    else
+        return "" ;
+
+    return (cacheDirectory / "sparse-cache.txt").string() ;
+}
+
+/**
+ * @brief SparseScanner::loadCache : Read the layouts kept by the previous runs, once per process. The cache mutex must be held.
+ */
+void SparseScanner::loadCache()
+{
+    if(isCacheLoaded)
+        return ;
+    isCacheLoaded = true ;
+
+    std::ifstream cacheFile(getCacheFilePath()) ;
+    std::string key ;
+    SparseLayout layout ;
+    while(cacheFile >> key >> layout.fileSize >> layout.trimmedSize >> layout.dataSize)
+        cache[key] = layout ;
+}
+
+/**
+ * @brief SparseScanner::storeCache : Add a layout to the cache file, best effort. The cache mutex must be held.
+ * The file is read again, for the layouts stored by the other runs, and replaced by its compacted content.
+ * @param key: The file identity.
+ * @param layout: The layout found by the scan.
+ */
+void SparseScanner::storeCache(const std::string &key, const SparseLayout &layout)
+{
+    std::string cacheFilePath = getCacheFilePath() ;
+    if(cacheFilePath.empty())
+        return ;
+
+    std::vector<std::pair<std::string, SparseLayout>> entries ;
+    {
+        std::ifstream cacheFile(cacheFilePath) ;
+        std::string storedKey ;
+        SparseLayout storedLayout ;
+        while(cacheFile >> storedKey >> storedLayout.fileSize >> storedLayout.trimmedSize >> storedLayout.dataSize)
+            entries.push_back(std::make_pair(storedKey, storedLayout)) ;
+    }
+    entries.push_back(std::make_pair(key, layout)) ;
+
+    /* From the newest: the first entry of a key is its latest one */
+    std::vector<std::pair<std::string, SparseLayout>> compacted ;
+    std::set<std::string> keptKeys ;
+    for(auto entry = entries.rbegin(); (entry != entries.rend()) && (compacted.size() < SPARSE_CACHE_MAX_ENTRIES); ++entry)
+    {
+        if(keptKeys.insert(entry->first).second)
+            compacted.push_back(*entry) ;
+    }
+
+    std::error_code errorCode ;
+    fs::create_directories(fs::path(cacheFilePath).parent_path(), errorCode) ;
+#ifdef _WIN32
+    std::string temporaryPath = cacheFilePath + "." + std::to_string((unsigned long)GetCurrentProcessId()) ;
+#else
+    std::string temporaryPath = cacheFilePath + "." + std::to_string((long)getpid()) ;
+#endif
+    {
+        std::ofstream cacheFile(temporaryPath, std::ios::out | std::ios::trunc) ;
+        if(cacheFile.is_open() == false)
+            return ;
+
+        for(auto entry = compacted.rbegin(); entry != compacted.rend(); ++entry)
+            cacheFile << entry->first << " " << entry->second.fileSize << " " << entry->second.trimmedSize << " " << entry->second.dataSize << "\n" ;
+        if(cacheFile.flush().good() == false)
+        {
+            cacheFile.close() ;
+            fs::remove(temporaryPath, errorCode) ;
+            return ;
+        }
+    }
+
+    /* Replaced at once, a concurrent reader sees the former or the new content */
+    fs::rename(temporaryPath, cacheFilePath, errorCode) ;
+    if(errorCode)
+    {
+        fs::remove(cacheFilePath, errorCode) ; // Windows does not replace an existing file
+        fs::rename(temporaryPath, cacheFilePath, errorCode) ;
+        if(errorCode)
+            fs::remove(temporaryPath, errorCode) ;
+    }
+}
@@ -0,0 +1,279 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "StationManager.h"
+
+volatile std::sig_atomic_t StationManager::isStopRequested = 0 ;
+
+StationManager::StationManager(const std::string &toolboxFolder) : fleetManager(toolboxFolder)
+{
+    scanInterface.toolboxFolder = toolboxFolder ;
+    parsedTsvFile = nullptr ;
+    service = FLEET_SERVICE_INSTALL ;
+    isStartFastboot = true ;
+    jobsNumber = FLEET_DEFAULT_JOBS ;
+    passedCount = 0 ;
+    failedCount = 0 ;
+}
+
+StationManager::~StationManager()
+{
+    for(StationBoard &board : boards)
+    {
+        if(board.worker.joinable())
+            board.worker.join() ;
+    }
+
+    delete parsedTsvFile ;
+}
+
+/**
+ * @brief StationManager::run : Serve the boards as they are plugged, until the SIGINT (Ctrl+C) or SIGTERM signal.
+ * The boards being served when the signal is received are completed.
+ * @param service: The service to run on each board.
+ * @param tsvFilePath: The TSV file to deploy on every board.
+ * @param jobsNumber: The maximum number of boards served at the same time, FLEET_DEFAULT_JOBS if 0.
+ * @param isStartFastboot: Ask to launch the fastboot mode or not (install service).
+ * @return 0 if the service succeeded on every board, otherwise an error occurred.
+ */
+int StationManager::run(FLEET_SERVICE service, const std::string &tsvFilePath, uint32_t jobsNumber, bool isStartFastboot)
+{
+    this->service = service ;
+    this->isStartFastboot = (service == FLEET_SERVICE_INSTALL) ? isStartFastboot : false ;
+    this->jobsNumber = (jobsNumber != 0) ? jobsNumber : FLEET_DEFAULT_JOBS ;
+
+    int ret = loadTsvFile(tsvFilePath) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    ret = fleetManager.createLogDirectory() ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    if(scanInterface.isDfuUtilInstalled() == false)
+        return TOOLBOX_DFU_ERROR_OTHER ;
+
+    bool isHotplugUsed = hotplugMonitor.open() ;
+    displayManager.print(MSG_NORMAL, L"-----------------------------------------");
+    displayManager.print(MSG_GREEN, L"Station %s...", (service == FLEET_SERVICE_INSTALL) ? "installing" : "flashing");
+    displayManager.print(MSG_NORMAL, L"  TSV path           : %s", tsvFilePath.c_str());
+    displayManager.print(MSG_NORMAL, L"  Partitions number  : %d", (int)parsedTsvFile->partitionsList.size());
+    displayManager.print(MSG_NORMAL, L"  Parallel jobs      : %d", this->jobsNumber);
+    displayManager.print(MSG_NORMAL, L"  Device detection   : %s", isHotplugUsed ? "hotplug events" : "polling");
+    displayManager.print(MSG_NORMAL, L"-----------------------------------------\n");
+    displayManager.print(MSG_NORMAL, L"Waiting for the boards, press Ctrl+C to stop");
+
+    isStopRequested = 0 ;
+    void (*previousIntHandler)(int) = std::signal(SIGINT, &StationManager::handleStopSignal) ;
+    void (*previousTermHandler)(int) = std::signal(SIGTERM, &StationManager::handleStopSignal) ;
+
+    auto start = std::chrono::steady_clock::now();
+    while(isStopRequested == 0)
+    {
+        reportFinishedBoards() ;
+        updateBoards() ;
+        waitDevicesChange() ;
+    }
+
+    displayManager.print(MSG_NORMAL, L"\nStation stopping, %d boards still running", getRunningCount());
+    for(StationBoard &board : boards)
+    {
+        if(board.worker.joinable())
+            board.worker.join() ;
+    }
+    reportFinishedBoards() ;
+
+    std::signal(SIGINT, previousIntHandler) ;
+    std::signal(SIGTERM, previousTermHandler) ;
+    hotplugMonitor.close() ;
+
+    uint64_t durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() ;
+    if(failedCount == 0)
+        displayManager.print(MSG_GREEN, L"Station done : %d boards passed in %llu s", passedCount, (unsigned long long)(durationMs / 1000));
+    else
+        displayManager.print(MSG_ERROR, L"Station done : %d boards passed, %d boards failed in %llu s", passedCount, failedCount, (unsigned long long)(durationMs / 1000));
+
+    return (failedCount == 0) ? TOOLBOX_DFU_NO_ERROR : TOOLBOX_DFU_ERROR_OTHER ;
+}
+
+/**
+ * @brief StationManager::handleStopSignal : Stop waiting for new boards.
+ * @param signalNumber: The received signal.
+ */
+void StationManager::handleStopSignal(int signalNumber)
+{
+    (void)signalNumber ;
+    isStopRequested = 1 ;
+}
+
+/**
+ * @brief StationManager::loadTsvFile : Parse and check the TSV file once for all the boards.
+ * @param tsvFilePath: The TSV file to deploy.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int StationManager::loadTsvFile(const std::string &tsvFilePath)
+{
+    this->tsvFilePath = tsvFilePath ;
+    if(fileManager.openTsvFile(tsvFilePath, &parsedTsvFile, isStartFastboot) != 0)
+    {
+        displayManager.print(MSG_ERROR, L"Failed to download TSV partitions: %s", tsvFilePath.c_str());
+        return TOOLBOX_DFU_ERROR_NO_FILE ;
+    }
+
+    bool isPrgfwUtil = (parsedTsvFile->partitionsList.size() == 1) && (parsedTsvFile->partitionsList.at(0).partIp == "none") ;
+    if(fileManager.isValidTsvFile(parsedTsvFile, isPrgfwUtil) == false)
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief StationManager::updateBoards : Scan the devices, forget the served boards unplugged for STATION_UNPLUG_MS
+ * and start the new boards while a job is free.
+ */
+void StationManager::updateBoards()
+{
+    if(scanInterface.scanDevices() != TOOLBOX_DFU_NO_ERROR)
+        return ;
+
+    auto now = std::chrono::steady_clock::now() ;
+    const DeviceIndex &deviceIndex = scanInterface.getDeviceIndex() ;
+    for(auto board = boards.begin(); board != boards.end(); )
+    {
+        if(deviceIndex.findBySerialNumber(board->job.serialNumber) != nullptr)
+            board->lastSeen = now ;
+
+        bool isUnplugged = (now - board->lastSeen) >= std::chrono::milliseconds(STATION_UNPLUG_MS) ;
+        if(board->isReported && isUnplugged)
+            board = boards.erase(board) ;
+        else
+            ++board ;
+    }
+
+    for(const DiscoveredDevice &device : deviceIndex.getDevices())
+    {
+        if(getRunningCount() >= jobsNumber)
+            break ;
+
+        if(device.serialNumber.empty() || (device.mode == DEVICE_MODE_FASTBOOT) || (device.lockOwnerPid != 0))
+            continue ;
+
+        bool isKnown = false ;
+        for(const StationBoard &board : boards)
+            isKnown = isKnown || (board.job.serialNumber == device.serialNumber) ;
+
+        if(isKnown == false)
+            startBoard(device) ;
+    }
+}
+
+/**
+ * @brief StationManager::startBoard : Start the worker serving a new board.
+ * @param device: The board, as found by the last scan.
+ */
+void StationManager::startBoard(const DiscoveredDevice &device)
+{
+    boards.emplace_back() ;
+    StationBoard &board = boards.back() ;
+    board.job.serialNumber = device.serialNumber ;
+    board.job.tsvFilePath = tsvFilePath ;
+    board.job.logFilePath = fleetManager.getLogFilePath(device.serialNumber) ;
+    board.job.portPath = device.portPath ;
+    board.job.status = TOOLBOX_DFU_ERROR_OTHER ;
+    board.job.isStarted = true ;
+    board.job.isDone = false ;
+    board.job.durationMs = 0 ;
+    board.isFinished = false ;
+    board.isReported = false ;
+    board.lastSeen = std::chrono::steady_clock::now() ;
+
+    displayManager.print(MSG_NORMAL, L"Port %s : board %s plugged, %s started", device.portPath.empty() ? "unknown" : device.portPath.c_str(), device.serialNumber.c_str(), (service == FLEET_SERVICE_INSTALL) ? "install" : "flashing");
+    board.worker = std::thread(&StationManager::runBoard, this, &board) ;
+}
+
+/**
+ * @brief StationManager::runBoard : Worker of a board, run the service with the shared TSV file.
+ * @param board: The board, updated with its result.
+ */
+void StationManager::runBoard(StationBoard *board)
+{
+    fleetManager.runJob(board->job, service, isStartFastboot, parsedTsvFile) ;
+    board->isFinished = true ;
+}
+
+/**
+ * @brief StationManager::reportFinishedBoards : Join the workers which are done and display the result of their port.
+ */
+void StationManager::reportFinishedBoards()
+{
+    for(StationBoard &board : boards)
+    {
+        if(board.isReported || (board.isFinished == false))
+            continue ;
+
+        board.worker.join() ;
+        board.isReported = true ;
+        const char *portPath = board.job.portPath.empty() ? "unknown" : board.job.portPath.c_str() ;
+        if(board.job.status == TOOLBOX_DFU_NO_ERROR)
+        {
+            passedCount++ ;
+            displayManager.print(MSG_GREEN, L"Port %s : PASS  %s in %llu ms", portPath, board.job.serialNumber.c_str(), (unsigned long long)board.job.durationMs);
+        }
+        else
+        {
+            failedCount++ ;
+            displayManager.print(MSG_ERROR, L"Port %s : FAIL  %s with error %d, see %s", portPath, board.job.serialNumber.c_str(), board.job.status, board.job.logFilePath.c_str());
+        }
+    }
+}
+
+/**
+ * @brief StationManager::getRunningCount
+ * @return The number of boards being served.
+ */
+uint32_t StationManager::getRunningCount() const
+{
+    uint32_t runningCount = 0 ;
+    for(const StationBoard &board : boards)
+    {
+        if(board.isReported == false)
+            runningCount++ ;
+    }
+
+    return runningCount ;
+}
+
+/**
+ * @brief StationManager::waitDevicesChange : Wait for the next USB event, at most HOTPLUG_RECHECK_MS so the finished
+ * boards are reported, or sleep for STATION_POLL_MS without the hotplug events.
+ */
+void StationManager::waitDevicesChange()
+{
+    if(hotplugMonitor.isOpen())
+    {
+        HotplugEvent event ;
+        if(hotplugMonitor.waitEvent(std::chrono::steady_clock::now() + std::chrono::milliseconds(HOTPLUG_RECHECK_MS), event) != HOTPLUG_NOT_SUPPORTED)
+            return ;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(STATION_POLL_MS));
+}
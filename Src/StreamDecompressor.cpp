@@ -0,0 +1,357 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "StreamDecompressor.h"
+#include "ProcessRunner.h"
+#include "Error.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <zlib.h>
+#include <lzma.h>
+
+StreamDecompressor::StreamDecompressor()
+{
+    format = COMPRESSION_NONE ;
+    readOffset = 0 ;
+    fillSize = 0 ;
+    isEnd = false ;
+    isClosed = false ;
+    status = TOOLBOX_DFU_NO_ERROR ;
+    outputSize = 0 ;
+    readWaitMs = 0 ;
+    writeWaitMs = 0 ;
+}
+
+StreamDecompressor::~StreamDecompressor()
+{
+    close() ;
+}
+
+/**
+ * @brief StreamDecompressor::getFormat : Get the compression of a binary from its extension.
+ * @param filePath: The binary path, the double quotes of the parsed TSV file are allowed.
+ * @return The compression format, COMPRESSION_NONE for a binary to be downloaded as is.
+ */
+COMPRESSION_FORMAT StreamDecompressor::getFormat(const std::string &filePath)
+{
+    std::string path = filePath ;
+    path.erase(std::remove(path.begin(), path.end(), '\"'), path.end()) ;
+    std::transform(path.begin(), path.end(), path.begin(), ::tolower) ;
+
+    auto isSuffix = [&path](const std::string &suffix) {
+        return (path.size() > suffix.size()) && (path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0) ;
+    } ;
+
+    if(isSuffix(".gz"))
+        return COMPRESSION_GZIP ;
+    if(isSuffix(".xz"))
+        return COMPRESSION_XZ ;
+    if(isSuffix(".zst"))
+        return COMPRESSION_ZSTD ;
+    return COMPRESSION_NONE ;
+}
+
+/**
+ * @brief StreamDecompressor::open : Start the decompression of a binary, the decompressed bytes are then given by read().
+ * @param filePath: The compressed binary path, the double quotes of the parsed TSV file are allowed.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int StreamDecompressor::open(const std::string &filePath)
+{
+    close() ;
+    this->filePath = filePath ;
+    this->filePath.erase(std::remove(this->filePath.begin(), this->filePath.end(), '\"'), this->filePath.end()) ;
+    format = getFormat(this->filePath) ;
+    if(format == COMPRESSION_NONE)
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+
+#ifdef _WIN32
+    if(format == COMPRESSION_ZSTD)
+        return TOOLBOX_DFU_ERROR_NOT_SUPPORTED ;
+#endif
+
+    ring.resize(DECOMPRESS_RING_SIZE) ;
+    readOffset = 0 ;
+    fillSize = 0 ;
+    isEnd = false ;
+    isClosed = false ;
+    status = TOOLBOX_DFU_NO_ERROR ;
+    outputSize = 0 ;
+    readWaitMs = 0 ;
+    writeWaitMs = 0 ;
+    decompressor = std::thread(&StreamDecompressor::decompress, this) ;
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief StreamDecompressor::read : Get the next decompressed bytes, waiting for the decompression when none is ready.
+ * Compatible with DownloadReader.
+ * @param buffer: Output buffer.
+ * @param capacity: Size of the buffer.
+ * @param size: Output number of bytes written to the buffer, 0 at the end of the image.
+ * @return 0 if the operation is performed successfully, otherwise the decompression failed.
+ */
+int StreamDecompressor::read(unsigned char *buffer, size_t capacity, size_t *size)
+{
+    *size = 0 ;
+    std::unique_lock<std::mutex> lock(ringMutex) ;
+    if((fillSize == 0) && (isEnd == false))
+    {
+        auto start = std::chrono::steady_clock::now() ;
+        dataReady.wait(lock, [this]() { return (fillSize != 0) || isEnd ; }) ;
+        readWaitMs += std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() ;
+    }
+
+    if(fillSize == 0)
+        return status ;
+
+    /* Up to the end of the ring buffer, the next call gets the bytes at its beginning */
+    size_t readSize = std::min(std::min(capacity, fillSize), ring.size() - readOffset) ;
+    std::copy(ring.begin() + readOffset, ring.begin() + readOffset + readSize, buffer) ;
+    readOffset = (readOffset + readSize) % ring.size() ;
+    fillSize -= readSize ;
+    *size = readSize ;
+    spaceReady.notify_one() ;
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief StreamDecompressor::close : Stop the decompression and release the ring buffer.
+ */
+void StreamDecompressor::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(ringMutex) ;
+        isClosed = true ;
+    }
+    spaceReady.notify_all() ;
+    if(decompressor.joinable())
+        decompressor.join() ;
+    std::vector<unsigned char>().swap(ring) ;
+}
+
+/**
+ * @brief StreamDecompressor::getStatus
+ * @return 0 while the decompression succeeds, otherwise the error which stopped it.
+ */
+int StreamDecompressor::getStatus()
+{
+    std::lock_guard<std::mutex> lock(ringMutex) ;
+    return status ;
+}
+
+uint64_t StreamDecompressor::getOutputSize() const
+{
+    return outputSize ;
+}
+
+uint64_t StreamDecompressor::getReadWaitMs() const
+{
+    return readWaitMs ;
+}
+
+uint64_t StreamDecompressor::getWriteWaitMs() const
+{
+    return writeWaitMs ;
+}
+
+/**
+ * @brief StreamDecompressor::decompress : Body of the decompression thread.
+ */
+void StreamDecompressor::decompress()
+{
+    int ret = TOOLBOX_DFU_ERROR_NOT_SUPPORTED ;
+    if(format == COMPRESSION_GZIP)
+        ret = decompressGzip() ;
+    else if(format == COMPRESSION_XZ)
+        ret = decompressXz() ;
+    else if(format == COMPRESSION_ZSTD)
+        ret = decompressZstd() ;
+
+    {
+        std::lock_guard<std::mutex> lock(ringMutex) ;
+        status = ret ;
+        isEnd = true ;
+    }
+    dataReady.notify_all() ;
+}
+
+/**
+ * @brief StreamDecompressor::write : Append decompressed bytes to the ring buffer, waiting while it is full.
+ * @param data: The decompressed bytes.
+ * @param size: Number of bytes.
+ * @return True if the bytes are queued, false if the transfer stopped reading.
+ */
+bool StreamDecompressor::write(const unsigned char *data, size_t size)
+{
+    std::unique_lock<std::mutex> lock(ringMutex) ;
+    while(size != 0)
+    {
+        if((fillSize == ring.size()) && (isClosed == false))
+        {
+            auto start = std::chrono::steady_clock::now() ;
+            spaceReady.wait(lock, [this]() { return (fillSize != ring.size()) || isClosed ; }) ;
+            writeWaitMs += std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() ;
+        }
+        if(isClosed)
+            return false ;
+
+        size_t writeOffset = (readOffset + fillSize) % ring.size() ;
+        size_t writeSize = std::min(std::min(size, ring.size() - fillSize), ring.size() - writeOffset) ;
+        std::copy(data, data + writeSize, ring.begin() + writeOffset) ;
+        fillSize += writeSize ;
+        outputSize += writeSize ;
+        data += writeSize ;
+        size -= writeSize ;
+        dataReady.notify_one() ;
+    }
+    return true ;
+}
+
+/**
+ * @brief StreamDecompressor::decompressGzip : Decompress a gzip file, its concatenated members included.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int StreamDecompressor::decompressGzip()
+{
+    gzFile file = gzopen(filePath.c_str(), "rb") ;
+    if(file == nullptr)
+        return TOOLBOX_DFU_ERROR_NO_FILE ;
+
+    gzbuffer(file, DECOMPRESS_READ_SIZE) ;
+
+    /* zlib reads a file without the gzip header as is, it would be flashed as the decompressed image */
+    if(gzdirect(file) != 0)
+    {
+        gzclose(file) ;
+        return TOOLBOX_DFU_ERROR_READ ;
+    }
+
+    std::vector<unsigned char> buffer(DECOMPRESS_READ_SIZE) ;
+    int ret = TOOLBOX_DFU_NO_ERROR ;
+    while(true)
+    {
+        int size = gzread(file, buffer.data(), (unsigned int)buffer.size()) ;
+        if(size < 0)
+        {
+            ret = TOOLBOX_DFU_ERROR_READ ;
+            break ;
+        }
+        if(size == 0)
+        {
+            /* A truncated member also ends the reads, with Z_BUF_ERROR */
+            int error = Z_OK ;
+            gzerror(file, &error) ;
+            if(error != Z_OK)
+                ret = TOOLBOX_DFU_ERROR_READ ;
+            break ;
+        }
+        if(write(buffer.data(), size) == false)
+            break ;
+    }
+
+    gzclose(file) ;
+    return ret ;
+}
+
+/**
+ * @brief StreamDecompressor::decompressXz : Decompress an xz file, its concatenated streams included.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int StreamDecompressor::decompressXz()
+{
+    FILE *file = fopen(filePath.c_str(), "rb") ;
+    if(file == nullptr)
+        return TOOLBOX_DFU_ERROR_NO_FILE ;
+
+    lzma_stream stream = LZMA_STREAM_INIT ;
+    if(lzma_stream_decoder(&stream, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK)
+    {
+        fclose(file) ;
+        return TOOLBOX_DFU_ERROR_NO_MEM ;
+    }
+
+    std::vector<unsigned char> input(DECOMPRESS_READ_SIZE) ;
+    std::vector<unsigned char> output(DECOMPRESS_READ_SIZE) ;
+    lzma_action action = LZMA_RUN ;
+    int ret = TOOLBOX_DFU_NO_ERROR ;
+    while(true)
+    {
+        if((stream.avail_in == 0) && (action == LZMA_RUN))
+        {
+            stream.next_in = input.data() ;
+            stream.avail_in = fread(input.data(), 1, input.size(), file) ;
+            if(ferror(file))
+            {
+                ret = TOOLBOX_DFU_ERROR_READ ;
+                break ;
+            }
+            if(feof(file))
+                action = LZMA_FINISH ;
+        }
+
+        stream.next_out = output.data() ;
+        stream.avail_out = output.size() ;
+        lzma_ret lzmaStatus = lzma_code(&stream, action) ;
+        size_t size = output.size() - stream.avail_out ;
+        if((size != 0) && (write(output.data(), size) == false))
+            break ;
+
+        if(lzmaStatus == LZMA_STREAM_END)
+            break ;
+        if(lzmaStatus != LZMA_OK)
+        {
+            ret = TOOLBOX_DFU_ERROR_READ ;
+            break ;
+        }
+    }
+
+    lzma_end(&stream) ;
+    fclose(file) ;
+    return ret ;
+}
+
+/**
+ * @brief StreamDecompressor::decompressZstd : Decompress a zstd file with the zstd program, whose output is streamed.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int StreamDecompressor::decompressZstd()
+{
+    ProcessRunner runner ;
+    ProcessResult result ;
+    runner.setTimeout(0) ;
+    runner.setOutputCaptured(false) ;
+    runner.setDataCallback([this, &runner](const char *data, size_t size) {
+        if(write(reinterpret_cast<const unsigned char*>(data), size) == false)
+            runner.cancel() ;
+    }) ;
+
+    int ret = runner.run({"zstd", "-d", "-c", "-q", "--", filePath}, result) ;
+    if(ret == TOOLBOX_DFU_ERROR_NOT_SUPPORTED)
+        return ret ; // No zstd program
+
+    if(result.isCanceled)
+        return TOOLBOX_DFU_NO_ERROR ; // The transfer stopped reading, its own status is reported
+    return ((ret == TOOLBOX_DFU_NO_ERROR) && (result.exitCode == 0)) ? TOOLBOX_DFU_NO_ERROR : TOOLBOX_DFU_ERROR_READ ;
+}
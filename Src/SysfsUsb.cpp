@@ -0,0 +1,267 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "SysfsUsb.h"
+#include <fstream>
+#include <algorithm>
+#include <cstdlib>
+#ifdef __linux__
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+static std::string sysfsRoot = "" ;
+
+/**
+ * @brief SysfsUsb::setRoot : Select the sysfs mount point, "/sys" on a real system.
+ * @param root: The sysfs root directory.
+ */
+void SysfsUsb::setRoot(const std::string &root)
+{
+    sysfsRoot = root ;
+}
+
+/**
+ * @brief SysfsUsb::getRoot
+ * @return The root selected by setRoot(), then by PRG_TOOLBOX_DFU_SYSFS_ROOT, otherwise "/sys".
+ */
+std::string SysfsUsb::getRoot()
+{
+    if(sysfsRoot.empty() == false)
+        return sysfsRoot ;
+
+    const char* envRoot = std::getenv("PRG_TOOLBOX_DFU_SYSFS_ROOT");
+    return ((envRoot != nullptr) && (envRoot[0] != '\0')) ? std::string(envRoot) : std::string("/sys") ;
+}
+
+/**
+ * @brief SysfsUsb::isAvailable
+ * @return True if the USB devices can be enumerated from sysfs, otherwise false.
+ */
+bool SysfsUsb::isAvailable()
+{
+#ifdef __linux__
+    return (access((getRoot() + "/bus/usb/devices").c_str(), R_OK | X_OK) == 0) ;
+#else
+    return false ;
+#endif
+}
+
+/**
+ * @brief SysfsUsb::enumerate : List the USB devices matching the vendor and product IDs.
+ * @param vendorID: USB vendor ID.
+ * @param productID: USB product ID.
+ * @param devices: Output list of devices sorted by port path.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred (-1 if sysfs cannot be read).
+ */
+int SysfsUsb::enumerate(uint16_t vendorID, uint16_t productID, std::vector<SysfsUsbDevice> &devices)
+{
+    devices.clear();
+#ifdef __linux__
+    DIR *directory = opendir((getRoot() + "/bus/usb/devices").c_str());
+    if(directory == nullptr)
+        return -1 ;
+
+    std::vector<std::string> portPaths ;
+    struct dirent *entry = nullptr ;
+    while((entry = readdir(directory)) != nullptr)
+    {
+        std::string name = entry->d_name ;
+        if((name.empty()) || (name.at(0) == '.') || (name.find(':') != std::string::npos)) // skip the interfaces
+            continue ;
+        portPaths.push_back(name);
+    }
+    closedir(directory);
+    std::sort(portPaths.begin(), portPaths.end());
+
+    for(const auto &portPath : portPaths)
+    {
+        SysfsUsbDevice device ;
+        if(readDevice(portPath, device) && (device.vendorID == vendorID) && (device.productID == productID))
+            devices.push_back(std::move(device));
+    }
+
+    return 0 ;
+#else
+    (void)vendorID;
+    (void)productID;
+    return -1 ;
+#endif
+}
+
+/**
+ * @brief SysfsUsb::findDevice : Search a device by its IDs and serial number.
+ * @param vendorID: USB vendor ID.
+ * @param productID: USB product ID.
+ * @param serialNumber: Serial number filter, empty to select the first device.
+ * @param device: Output device.
+ * @return True if the device is found, otherwise false.
+ */
+bool SysfsUsb::findDevice(uint16_t vendorID, uint16_t productID, const std::string &serialNumber, SysfsUsbDevice &device)
+{
+    std::vector<SysfsUsbDevice> devices ;
+    if(enumerate(vendorID, productID, devices) != 0)
+        return false ;
+
+    for(auto &candidate : devices)
+    {
+        if(serialNumber.empty() || (candidate.serialNumber == serialNumber))
+        {
+            device = std::move(candidate) ;
+            return true ;
+        }
+    }
+
+    return false ;
+}
+
+/**
+ * @brief SysfsUsb::findPortPath : Resolve the usbfs address of a device to its port path.
+ * @param busNumber: USB bus number (busnum).
+ * @param deviceNumber: USB device address on the bus (devnum).
+ * @return The port path, e.g. 1-2.3, empty if the device is not found.
+ */
+std::string SysfsUsb::findPortPath(int busNumber, int deviceNumber)
+{
+#ifdef __linux__
+    std::string devicesPath = getRoot() + "/bus/usb/devices/" ;
+    DIR *directory = opendir(devicesPath.c_str());
+    if(directory == nullptr)
+        return "" ;
+
+    /* Only the devices of this bus are named <bus>-<port>... */
+    std::string busPrefix = std::to_string(busNumber) + "-" ;
+    std::string portPath ;
+    struct dirent *entry = nullptr ;
+    while((entry = readdir(directory)) != nullptr)
+    {
+        std::string name = entry->d_name ;
+        if((name.compare(0, busPrefix.size(), busPrefix) != 0) || (name.find(':') != std::string::npos))
+            continue ;
+
+        if(std::atoi(readAttribute(devicesPath + name + "/devnum").c_str()) == deviceNumber)
+        {
+            portPath = name ;
+            break ;
+        }
+    }
+    closedir(directory);
+
+    return portPath ;
+#else
+    (void)busNumber;
+    (void)deviceNumber;
+    return "" ;
+#endif
+}
+
+/**
+ * @brief SysfsUsb::readSerialNumber
+ * @param devPath: Kernel device path, as given by the uevents (e.g. /devices/pci0000:00/0000:00:14.0/usb1/1-2).
+ * @return The serial number, empty if it cannot be read.
+ */
+std::string SysfsUsb::readSerialNumber(const std::string &devPath)
+{
+    return readAttribute(getRoot() + devPath + "/serial") ;
+}
+
+/**
+ * @brief SysfsUsb::readDevice : Read the attributes of one device directory.
+ * @param portPath: The device directory name.
+ * @param device: Output device.
+ * @return True if the directory describes a USB device, otherwise false.
+ */
+bool SysfsUsb::readDevice(const std::string &portPath, SysfsUsbDevice &device)
+{
+    std::string path = getRoot() + "/bus/usb/devices/" + portPath ;
+    if((readHexAttribute(path + "/idVendor", &device.vendorID) == false) || (readHexAttribute(path + "/idProduct", &device.productID) == false))
+        return false ;
+
+    device.portPath = portPath ;
+    device.sysfsPath = path ;
+    device.busNumber = std::atoi(readAttribute(path + "/busnum").c_str()) ;
+    device.deviceNumber = std::atoi(readAttribute(path + "/devnum").c_str()) ;
+    device.serialNumber = readAttribute(path + "/serial") ;
+    device.manufacturer = readAttribute(path + "/manufacturer") ;
+    device.product = readAttribute(path + "/product") ;
+
+    /* Interfaces are named <port path>:<configuration>.<interface> */
+    device.interfaceStrings.clear();
+#ifdef __linux__
+    DIR *directory = opendir(path.c_str());
+    if(directory != nullptr)
+    {
+        std::vector<std::string> interfaces ;
+        struct dirent *entry = nullptr ;
+        while((entry = readdir(directory)) != nullptr)
+        {
+            std::string name = entry->d_name ;
+            if(name.compare(0, portPath.size() + 1, portPath + ":") == 0)
+                interfaces.push_back(name);
+        }
+        closedir(directory);
+        std::sort(interfaces.begin(), interfaces.end());
+
+        for(const auto &name : interfaces)
+        {
+            std::string interfaceString = readAttribute(path + "/" + name + "/interface") ;
+            if(interfaceString.empty() == false)
+                device.interfaceStrings.push_back(interfaceString);
+        }
+    }
+#endif
+
+    return true ;
+}
+
+/**
+ * @brief SysfsUsb::readAttribute
+ * @param path: The attribute file.
+ * @return The first line of the attribute, empty if it cannot be read.
+ */
+std::string SysfsUsb::readAttribute(const std::string &path)
+{
+    std::string value ;
+    std::ifstream file(path);
+    if(file.is_open())
+        std::getline(file, value);
+
+    while((value.empty() == false) && ((value.back() == '\r') || (value.back() == ' ')))
+        value.pop_back();
+
+    return value ;
+}
+
+bool SysfsUsb::readHexAttribute(const std::string &path, uint16_t *value)
+{
+    std::string attribute = readAttribute(path) ;
+    if(attribute.empty())
+        return false ;
+
+    char *end = nullptr ;
+    unsigned long number = std::strtoul(attribute.c_str(), &end, 16) ;
+    if((end == attribute.c_str()) || (number > 0xFFFF))
+        return false ;
+
+    *value = static_cast<uint16_t>(number) ;
+    return true ;
+}
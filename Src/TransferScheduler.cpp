@@ -0,0 +1,248 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "TransferScheduler.h"
+#include <cstdlib>
+
+TransferScheduler::TransferScheduler()
+{
+    maxPerRootPort = 0 ;
+    maxPerHub = 0 ;
+}
+
+TransferScheduler & TransferScheduler::getInstance()
+{
+    static TransferScheduler instance;
+    return instance;
+}
+
+/**
+ * @brief TransferScheduler::setLimits : Set the number of bulk phases allowed at the same time.
+ * @param maxPerRootPort: Limit for the devices behind a same root port, 0 for no limit.
+ * @param maxPerHub: Limit for the devices plugged in a same hub, 0 for no limit.
+ */
+void TransferScheduler::setLimits(uint32_t maxPerRootPort, uint32_t maxPerHub)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->maxPerRootPort = maxPerRootPort ;
+    this->maxPerHub = maxPerHub ;
+    slotReleased.notify_all() ;
+}
+
+/**
+ * @brief TransferScheduler::resetStatistics : Restart the utilization accounting, the running transfers are kept.
+ */
+void TransferScheduler::resetStatistics()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = std::chrono::steady_clock::now() ;
+    for(auto &entry : segments)
+    {
+        SegmentState &segment = entry.second ;
+        segment.utilization = SegmentUtilization() ;
+        segment.utilization.name = entry.first ;
+        segment.utilization.maxConcurrent = segment.activeCount ;
+        segment.busySince = now ;
+    }
+}
+
+/**
+ * @brief TransferScheduler::acquire : Wait until the root port and the hub of the device have a free slot, then take it.
+ * @param portPath: USB port path of the device, the transfers of a device whose port is unknown are never delayed.
+ */
+void TransferScheduler::acquire(const std::string &portPath)
+{
+    UsbTopology topology = getTopology(portPath) ;
+    auto start = std::chrono::steady_clock::now() ;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while(isSlotFree(topology) == false)
+        slotReleased.wait(lock) ;
+
+    rootPortTransfers[topology.rootPort]++ ;
+    hubTransfers[topology.hub]++ ;
+
+    auto now = std::chrono::steady_clock::now() ;
+    uint64_t waitMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count() ;
+    startSegment(getBusName(topology), now, waitMs) ;
+    if(topology.rootPort.empty() == false)
+        startSegment(topology.rootPort, now, waitMs) ;
+}
+
+/**
+ * @brief TransferScheduler::release : Give back the slot taken by acquire() and account the transfer.
+ * @param portPath: USB port path of the device.
+ * @param bytes: Number of bytes transferred.
+ * @param transferMs: Duration of the transfer.
+ */
+void TransferScheduler::release(const std::string &portPath, uint64_t bytes, uint64_t transferMs)
+{
+    UsbTopology topology = getTopology(portPath) ;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    rootPortTransfers[topology.rootPort]-- ;
+    hubTransfers[topology.hub]-- ;
+
+    auto now = std::chrono::steady_clock::now() ;
+    stopSegment(getBusName(topology), now, bytes, transferMs) ;
+    if(topology.rootPort.empty() == false)
+        stopSegment(topology.rootPort, now, bytes, transferMs) ;
+
+    slotReleased.notify_all() ;
+}
+
+/**
+ * @brief TransferScheduler::getUtilization : Get the accounting of each bus and root port since the last resetStatistics().
+ * @return One entry per bus followed by the root ports of the bus, the devices whose port is unknown come last.
+ * The busy time includes the transfers still running.
+ */
+std::vector<SegmentUtilization> TransferScheduler::getUtilization()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = std::chrono::steady_clock::now() ;
+    std::vector<SegmentUtilization> utilization ;
+    for(const auto &entry : segments) // "usbN" sorts after the "N-P" root ports
+    {
+        SegmentUtilization segment = entry.second.utilization ;
+        if(entry.second.activeCount != 0)
+            segment.busyMs += std::chrono::duration_cast<std::chrono::milliseconds>(now - entry.second.busySince).count() ;
+
+        if(entry.first.compare(0, 3, "usb") == 0)
+        {
+            std::string busPrefix = entry.first.substr(3) + "-" ;
+            auto position = utilization.begin() ;
+            while((position != utilization.end()) && (position->name.compare(0, busPrefix.size(), busPrefix) != 0))
+                position++ ;
+            utilization.insert(position, segment) ;
+        }
+        else
+        {
+            utilization.push_back(segment) ;
+        }
+    }
+
+    return utilization ;
+}
+
+/**
+ * @brief TransferScheduler::getTopology : Split a port path "<bus>-<root port>[.<hub port>...]".
+ * @param portPath: USB port path of the device, empty if unknown.
+ * @return The bus, the root port and the hub of the device. The root port is empty if the path is unknown, the hub
+ * is empty if the path is unknown or if the device is plugged in the root port.
+ */
+UsbTopology TransferScheduler::getTopology(const std::string &portPath)
+{
+    UsbTopology topology = UsbTopology() ;
+    size_t busSeparator = portPath.find('-') ;
+    if((busSeparator == std::string::npos) || (busSeparator == 0))
+        return topology ;
+
+    topology.busNumber = std::atoi(portPath.c_str()) ;
+    topology.rootPort = portPath.substr(0, portPath.find('.')) ;
+    size_t hubSeparator = portPath.rfind('.') ;
+    if(hubSeparator != std::string::npos)
+        topology.hub = portPath.substr(0, hubSeparator) ;
+    return topology ;
+}
+
+/**
+ * @brief TransferScheduler::getBusName
+ * @param topology: Place of the device in the USB tree.
+ * @return The name of the bus segment, "usbN" as the root hub, "unknown" if the port path is unknown.
+ */
+std::string TransferScheduler::getBusName(const UsbTopology &topology)
+{
+    return topology.rootPort.empty() ? "unknown" : "usb" + std::to_string(topology.busNumber) ;
+}
+
+/**
+ * @brief TransferScheduler::isSlotFree
+ * @param topology: Place of the device in the USB tree.
+ * @return True if a transfer of the device can start now, otherwise false.
+ * @note The caller holds mutex.
+ */
+bool TransferScheduler::isSlotFree(const UsbTopology &topology)
+{
+    if(topology.rootPort.empty())
+        return true ;
+
+    if((maxPerRootPort != 0) && (rootPortTransfers[topology.rootPort] >= maxPerRootPort))
+        return false ;
+
+    return (maxPerHub == 0) || topology.hub.empty() || (hubTransfers[topology.hub] < maxPerHub) ;
+}
+
+/**
+ * @brief TransferScheduler::startSegment : Account the start of a transfer on a bus or a root port.
+ * @note The caller holds mutex.
+ */
+void TransferScheduler::startSegment(const std::string &name, const std::chrono::steady_clock::time_point &now, uint64_t waitMs)
+{
+    SegmentState &segment = segments[name] ;
+    segment.utilization.name = name ;
+    if(segment.activeCount == 0)
+        segment.busySince = now ;
+
+    segment.activeCount++ ;
+    segment.utilization.waitMs += waitMs ;
+    if(segment.activeCount > segment.utilization.maxConcurrent)
+        segment.utilization.maxConcurrent = segment.activeCount ;
+}
+
+/**
+ * @brief TransferScheduler::stopSegment : Account the end of a transfer on a bus or a root port.
+ * @note The caller holds mutex.
+ */
+void TransferScheduler::stopSegment(const std::string &name, const std::chrono::steady_clock::time_point &now, uint64_t bytes, uint64_t transferMs)
+{
+    SegmentState &segment = segments[name] ;
+    segment.activeCount-- ;
+    if(segment.activeCount == 0)
+        segment.utilization.busyMs += std::chrono::duration_cast<std::chrono::milliseconds>(now - segment.busySince).count() ;
+
+    segment.utilization.transferCount++ ;
+    segment.utilization.bytes += bytes ;
+    segment.utilization.transferMs += transferMs ;
+}
+
+TransferSlot::TransferSlot(const std::string &portPath, uint64_t bytes)
+{
+    this->portPath = portPath ;
+    this->bytes = bytes ;
+    TransferScheduler::getInstance().acquire(portPath) ;
+    start = std::chrono::steady_clock::now() ;
+}
+
+/**
+ * @brief TransferSlot::setBytes : Account another size, for the transfers whose size is only known at their end.
+ * @param bytes: Number of bytes transferred.
+ */
+void TransferSlot::setBytes(uint64_t bytes)
+{
+    this->bytes = bytes ;
+}
+
+TransferSlot::~TransferSlot()
+{
+    uint64_t transferMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() ;
+    TransferScheduler::getInstance().release(portPath, bytes, transferMs) ;
+}
@@ -0,0 +1,348 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "UsbDfuTransport.h"
+#include "FirmwareImage.h"
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <chrono>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+UsbDfuTransport::UsbDfuTransport(const std::string &serialNumber, std::unique_ptr<DfuTransport> fallbackTransport)
+{
+    this->dfuSerialNumber = serialNumber ;
+    this->fallbackTransport = std::move(fallbackTransport) ;
+    isFallbackNotified = false ;
+    isFallbackActive = false ;
+}
+
+UsbDfuTransport::~UsbDfuTransport()
+{
+    usbDevice.close();
+}
+
+const char* UsbDfuTransport::getName() const
+{
+    return (fallbackTransport != nullptr) ? "auto" : "usb" ;
+}
+
+/**
+ * @brief UsbDfuTransport::isAvailable
+ * @return True if the USB devices can be reached in-process (or through the fallback), otherwise false.
+ */
+bool UsbDfuTransport::isAvailable()
+{
+    if(isUsbFsAvailable())
+        return true ;
+
+    if(fallbackTransport != nullptr)
+        return fallbackTransport->isAvailable() ;
+
+    displayManager.print(MSG_ERROR, L"The USB device file system (/dev/bus/usb) is not accessible, the usb backend cannot be used.") ;
+    return false ;
+}
+
+/**
+ * @brief UsbDfuTransport::listDevices : Enumerate the STM32 DFU devices from their descriptors.
+ * @param serialNumber: Serial number filter, empty to list all devices.
+ * @param devices: Output list of devices with their alternate settings.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int UsbDfuTransport::listDevices(const std::string &serialNumber, std::vector<DfuDeviceInfo> &devices)
+{
+    devices.clear();
+
+    /* The opened device already holds its descriptors */
+    if((serialNumber.empty() == false) && (serialNumber == usbDevice.serialNumber) && usbDevice.isAlive())
+    {
+        devices.push_back(usbDevice.getDeviceInfo());
+        return TOOLBOX_DFU_NO_ERROR ;
+    }
+
+    /* Avoid opening every usbfs node while the device is not plugged */
+    SysfsUsbDevice sysfsDevice ;
+    if(SysfsUsb::isAvailable() && (SysfsUsb::findDevice(ST_USB_VENDOR_ID, ST_DFU_PRODUCT_ID, serialNumber, sysfsDevice) == false))
+        return TOOLBOX_DFU_NO_ERROR ;
+
+    std::vector<DfuDeviceInfo> allDevices ;
+    int ret = DfuDevice::enumerate(ST_USB_VENDOR_ID, ST_DFU_PRODUCT_ID, allDevices) ;
+    if(isFallbackUsed(ret))
+        return fallbackTransport->listDevices(serialNumber, devices) ;
+
+    for(auto &device : allDevices)
+    {
+        if(serialNumber.empty() || (device.serialNumber == serialNumber))
+            devices.push_back(std::move(device));
+    }
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief UsbDfuTransport::isFastbootDevicePresent : Search a 0483:0afb device from sysfs, otherwise from the descriptors.
+ * @return True if an U-Boot in Fastboot mode is detected, otherwise, false.
+ */
+bool UsbDfuTransport::isFastbootDevicePresent()
+{
+    std::vector<SysfsUsbDevice> sysfsDevices ;
+    if(SysfsUsb::enumerate(ST_USB_VENDOR_ID, ST_FASTBOOT_PRODUCT_ID, sysfsDevices) == 0)
+        return (sysfsDevices.empty() == false) ;
+
+    if((isUsbFsAvailable() == false) && (fallbackTransport != nullptr))
+        return fallbackTransport->isFastbootDevicePresent() ;
+
+    return DfuDevice::isDevicePresent(ST_USB_VENDOR_ID, ST_FASTBOOT_PRODUCT_ID) ;
+}
+
+/**
+ * @brief UsbDfuTransport::readDeviceIdString : Search the "@Device ID /" string in the cached descriptors.
+ * @param deviceIdString: Output string following the "@Device ID /" pattern.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int UsbDfuTransport::readDeviceIdString(std::string &deviceIdString)
+{
+    if(openUsbDevice() == false)
+        return (fallbackTransport != nullptr) ? fallbackTransport->readDeviceIdString(deviceIdString) : TOOLBOX_DFU_ERROR_NO_DEVICE ;
+
+    for(const auto &str : usbDevice.descriptorStrings)
+    {
+        if(DfuDevice::findDeviceIdString(str, deviceIdString))
+            return TOOLBOX_DFU_NO_ERROR ;
+    }
+
+    return TOOLBOX_DFU_ERROR_NOT_SUPPORTED ;
+}
+
+/**
+ * @brief UsbDfuTransport::download : Download a file to an alternate setting through the native USB handle.
+ * @param alternateIndex: The alternate setting index of the target partition.
+ * @param filePath: The firmware path to be programmed.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int UsbDfuTransport::download(uint8_t alternateIndex, const std::string &filePath)
+{
+    if(openUsbDevice() == false)
+        return (fallbackTransport != nullptr) ? fallbackTransport->download(alternateIndex, filePath) : TOOLBOX_DFU_ERROR_NO_DEVICE ;
+
+    std::string path = filePath ;
+    path.erase(std::remove(path.begin(), path.end(), '\"'), path.end()) ; //remove the double quotes from the file path
+    FirmwareImage firmware ;
+    int ret = firmware.open(path) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    return downloadFromMemory(alternateIndex, firmware.getData(), firmware.getSize()) ;
+}
+
+/**
+ * @brief UsbDfuTransport::downloadFromMemory : Download a buffer to an alternate setting through the native USB handle.
+ * @param alternateIndex: The alternate setting index of the target partition.
+ * @param data: The bytes to be programmed.
+ * @param size: Number of bytes.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int UsbDfuTransport::downloadFromMemory(uint8_t alternateIndex, const unsigned char *data, size_t size)
+{
+    if(openUsbDevice() == false)
+        return (fallbackTransport != nullptr) ? fallbackTransport->downloadFromMemory(alternateIndex, data, size) : TOOLBOX_DFU_ERROR_NO_DEVICE ;
+
+    auto start = std::chrono::steady_clock::now();
+    int ret = usbDevice.download(alternateIndex, data, size) ;
+    /* The device re-enumerated since the last operation. Once a block is sent, a lost device has rebooted into another stage */
+    if((ret == TOOLBOX_DFU_ERROR_NOT_CONNECTED) && (usbDevice.isDownloadStarted() == false) && openUsbDevice())
+        ret = usbDevice.download(alternateIndex, data, size) ;
+
+    if(ret == TOOLBOX_DFU_NO_ERROR)
+    {
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        displayManager.print(MSG_NORMAL, L"Downloaded %lu bytes in %ld ms", (unsigned long)size, (long)duration.count());
+    }
+
+    return ret ;
+}
+
+/**
+ * @brief UsbDfuTransport::downloadFromReader : Download the bytes of a producer through the native USB handle, as they are produced.
+ * @param alternateIndex: The alternate setting index of the target partition.
+ * @param reader: The producer of the bytes.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int UsbDfuTransport::downloadFromReader(uint8_t alternateIndex, const DownloadReader &reader)
+{
+    if(openUsbDevice() == false)
+        return (fallbackTransport != nullptr) ? fallbackTransport->downloadFromReader(alternateIndex, reader) : TOOLBOX_DFU_ERROR_NO_DEVICE ;
+
+    uint64_t size = 0 ;
+    bool isReaderUsed = false ;
+    DownloadReader countingReader = [&](unsigned char *buffer, size_t capacity, size_t *readSize) {
+        isReaderUsed = true ;
+        int ret = reader(buffer, capacity, readSize) ;
+        size += *readSize ;
+        return ret ;
+    } ;
+
+    auto start = std::chrono::steady_clock::now();
+    int ret = usbDevice.download(alternateIndex, countingReader) ;
+    if((ret == TOOLBOX_DFU_ERROR_NOT_CONNECTED) && (isReaderUsed == false) && openUsbDevice()) // The device re-enumerated since the last operation
+        ret = usbDevice.download(alternateIndex, countingReader) ;
+
+    if(ret == TOOLBOX_DFU_NO_ERROR)
+    {
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        displayManager.print(MSG_NORMAL, L"Downloaded %llu bytes in %ld ms", (unsigned long long)size, (long)duration.count());
+    }
+
+    return ret ;
+}
+
+/**
+ * @brief UsbDfuTransport::upload : Upload an alternate setting through the native USB handle and save it into file.
+ * @param alternateIndex: The alternate setting index of the partition to read.
+ * @param filePath: The output binary file.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int UsbDfuTransport::upload(uint8_t alternateIndex, const std::string &filePath)
+{
+    if(openUsbDevice() == false)
+        return (fallbackTransport != nullptr) ? fallbackTransport->upload(alternateIndex, filePath) : TOOLBOX_DFU_ERROR_NO_DEVICE ;
+
+    std::vector<unsigned char> data ;
+    int ret = uploadToMemory(alternateIndex, data) ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+        return ret ;
+
+    return writeFile(filePath, data) ;
+}
+
+/**
+ * @brief UsbDfuTransport::uploadToMemory : Upload an alternate setting through the native USB handle.
+ * @param alternateIndex: The alternate setting index of the partition to read.
+ * @param data: Output buffer receiving the uploaded bytes.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int UsbDfuTransport::uploadToMemory(uint8_t alternateIndex, std::vector<unsigned char> &data)
+{
+    if(openUsbDevice() == false)
+        return (fallbackTransport != nullptr) ? fallbackTransport->uploadToMemory(alternateIndex, data) : TOOLBOX_DFU_ERROR_NO_DEVICE ;
+
+    int ret = usbDevice.upload(alternateIndex, data) ;
+    if((ret == TOOLBOX_DFU_ERROR_NOT_CONNECTED) && openUsbDevice()) // The device re-enumerated since the last operation
+        ret = usbDevice.upload(alternateIndex, data) ;
+
+    return ret ;
+}
+
+/**
+ * @brief UsbDfuTransport::detach : Send DFU_DETACH, the handle is released as the device re-enumerates.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int UsbDfuTransport::detach()
+{
+    if(openUsbDevice() == false)
+        return (fallbackTransport != nullptr) ? fallbackTransport->detach() : TOOLBOX_DFU_ERROR_NO_DEVICE ;
+
+    return usbDevice.detach() ;
+}
+
+/**
+ * @brief UsbDfuTransport::isSameEnumeration : The opened usbfs node disappears as soon as the device re-enumerates.
+ * @return True if the opened device is still connected, otherwise false.
+ */
+bool UsbDfuTransport::isSameEnumeration()
+{
+    if(isFallbackActive)
+        return fallbackTransport->isSameEnumeration() ;
+
+    return usbDevice.isAlive() ;
+}
+
+/**
+ * @brief UsbDfuTransport::isFileDownloadPreferred
+ * @return True if the fallback transport is active and prefers the files, otherwise false.
+ */
+bool UsbDfuTransport::isFileDownloadPreferred()
+{
+    return isFallbackActive && fallbackTransport->isFileDownloadPreferred() ;
+}
+
+/**
+ * @brief UsbDfuTransport::isUsbFsAvailable
+ * @return True if the usbfs device nodes can be listed, otherwise false.
+ */
+bool UsbDfuTransport::isUsbFsAvailable()
+{
+#ifdef __linux__
+    return (access("/dev/bus/usb", R_OK | X_OK) == 0) ;
+#else
+    return false ;
+#endif
+}
+
+/**
+ * @brief UsbDfuTransport::openUsbDevice : Get the native USB handle ready, the handle is kept open between operations.
+ * @return True if the in-process DFU implementation can be used, otherwise false.
+ */
+bool UsbDfuTransport::openUsbDevice()
+{
+    if(usbDevice.isAlive())
+        return true ;
+
+    int ret = usbDevice.open(ST_USB_VENDOR_ID, ST_DFU_PRODUCT_ID, this->dfuSerialNumber) ;
+    if(ret == TOOLBOX_DFU_NO_ERROR)
+    {
+        isFallbackActive = false ;
+        return true ;
+    }
+
+    isFallbackUsed(ret) ;
+    return false ;
+}
+
+/**
+ * @brief UsbDfuTransport::isFallbackUsed : Decide if a failed native access is handed over to the fallback transport.
+ * @param status: The status of the native access.
+ * @return True if the fallback transport has to be used, otherwise false.
+ */
+bool UsbDfuTransport::isFallbackUsed(int status)
+{
+    if((status != TOOLBOX_DFU_ERROR_CONNECTION) && (status != TOOLBOX_DFU_ERROR_INTERFACE_NOT_SUPPORTED))
+        return false ;
+
+    if(fallbackTransport == nullptr)
+    {
+        if(status == TOOLBOX_DFU_ERROR_CONNECTION)
+            displayManager.print(MSG_ERROR, L"STM32 DFU device is not accessible, please check the udev rules.") ;
+        return false ;
+    }
+
+    isFallbackActive = true ;
+    if(isFallbackNotified == false)
+    {
+        displayManager.print(MSG_WARNING, L"STM32 DFU device is not accessible in-process, using %s instead.", fallbackTransport->getName()) ;
+        isFallbackNotified = true ;
+    }
+
+    return true ;
+}
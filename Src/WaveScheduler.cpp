@@ -0,0 +1,327 @@
+/*
+ * PRG-TOOLBOX-DFU
+ *
+ * (C) 2024 by STMicroelectronics.
+ *
+ * Integrates dfu-util v0.11 for Windows platform.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "WaveScheduler.h"
+#include <algorithm>
+
+WaveScheduler::WaveScheduler(const std::string &toolboxFolder) : eventLoop(toolboxFolder)
+{
+    this->toolboxFolder = toolboxFolder ;
+    waveMs = 0 ;
+    succeededCount = 0 ;
+}
+
+WaveScheduler::~WaveScheduler()
+{
+    for(WaveBoard *board : boards)
+    {
+        delete board->dfuInterface ;
+        delete board->parsedTsvFile ;
+        delete board ;
+    }
+}
+
+/**
+ * @brief WaveScheduler::run : Install U-Boot on every board of the jobs, the boot steps of the boards being interleaved.
+ * @param jobs: One job per board, updated with the result of each board. The log file paths must be set.
+ * @param isStartFastboot: Ask to launch the fastboot mode or not.
+ * @return 0 if the service succeeded on every board, otherwise an error occurred.
+ */
+int WaveScheduler::run(std::vector<FleetJob> &jobs, bool isStartFastboot)
+{
+    waveStart = std::chrono::steady_clock::now() ;
+    eventLoop.scanDevices() ;
+    for(FleetJob &job : jobs)
+    {
+        WaveBoard *board = new WaveBoard() ;
+        board->job = &job ;
+        board->dfuInterface = new DFU() ;
+        board->dfuInterface->toolboxFolder = toolboxFolder ;
+        board->dfuInterface->dfuSerialNumber = job.serialNumber ;
+        board->parsedTsvFile = nullptr ;
+        board->stepIndex = 0 ;
+        board->logFile.open(job.logFilePath, std::ios::out | std::ios::trunc) ;
+        job.isStarted = true ;
+        boards.push_back(board) ;
+
+        eventLoop.post([this, board, isStartFastboot]() {
+            selectBoardOutput(*board) ;
+            int ret = prepareBoard(*board, isStartFastboot) ;
+            if(ret != TOOLBOX_DFU_NO_ERROR)
+                finishBoard(*board, ret) ;
+            else if(board->stepIndex == board->steps.size())
+                finishBoard(*board, TOOLBOX_DFU_NO_ERROR) ;
+            else
+                postStep(*board) ;
+            DisplayManager::resetThreadOutput() ;
+        }) ;
+    }
+
+    /* Each board goes through its steps at its own pace, the first wave is issued on all the boards at once */
+    eventLoop.run() ;
+
+    waveMs = getElapsedMs(waveStart) ;
+    return (succeededCount == boards.size()) ? TOOLBOX_DFU_NO_ERROR : TOOLBOX_DFU_ERROR_OTHER ;
+}
+
+/**
+ * @brief WaveScheduler::displayStatistics : Display the throughput of the last run and the share of the time spent waiting for the boards.
+ */
+void WaveScheduler::displayStatistics()
+{
+    uint64_t busyMs = eventLoop.getBusyMs() ;
+    uint64_t boardsPerHour = (waveMs != 0) ? ((uint64_t)succeededCount * 3600000) / waveMs : 0 ;
+    double idlePercent = (waveMs != 0) ? ((waveMs - std::min(busyMs, waveMs)) * 100.0) / waveMs : 0.0 ;
+    displayManager.print(MSG_NORMAL, L"Wave : %d boards in %llu ms, %llu boards/hour", succeededCount, (unsigned long long)waveMs, (unsigned long long)boardsPerHour);
+    displayManager.print(MSG_NORMAL, L"Wave : busy %llu ms, idle %.1f %% of the time, %d device scans", (unsigned long long)busyMs, idlePercent, eventLoop.getScanCount());
+}
+
+/**
+ * @brief WaveScheduler::prepareBoard : Parse the TSV file, find and lock the board and build its list of boot steps.
+ * A board already running the awaited U-Boot mode gets no step.
+ * @param board: The board.
+ * @param isStartFastboot: Ask to launch the fastboot mode or not.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int WaveScheduler::prepareBoard(WaveBoard &board, bool isStartFastboot)
+{
+    displayManager.print(MSG_GREEN, L"Started : %s", board.job->tsvFilePath.c_str());
+    if(fileManager.openTsvFile(board.job->tsvFilePath, &board.parsedTsvFile, isStartFastboot) != 0)
+    {
+        displayManager.print(MSG_ERROR, L"Failed to download TSV partitions: %s", board.job->tsvFilePath.c_str());
+        return TOOLBOX_DFU_ERROR_NO_FILE ;
+    }
+
+    if((board.parsedTsvFile->partitionsList.size() == 1) && (board.parsedTsvFile->partitionsList.at(0).partIp == "none"))
+    {
+        displayManager.print(MSG_ERROR, L"STM32PRGFW-UTIL is not supported by the wave scheduler.");
+        return TOOLBOX_DFU_ERROR_NOT_SUPPORTED ;
+    }
+
+    if(fileManager.isValidTsvFile(board.parsedTsvFile, false) == false)
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM ;
+
+    const DiscoveredDevice *scannedDevice = eventLoop.getDeviceIndex().findBySerialNumber(board.job->serialNumber) ;
+    if((scannedDevice != nullptr) && (scannedDevice->mode == DEVICE_MODE_FASTBOOT))
+    {
+        if(isStartFastboot)
+        {
+            displayManager.print(MSG_NORMAL, L"No installing service will be performed !");
+            return TOOLBOX_DFU_NO_ERROR ;
+        }
+
+        displayManager.print(MSG_ERROR, L"U-Boot in fastboot mode is already running, it is not possible to prepare and launch U-Boot in DFU mode.");
+        return TOOLBOX_DFU_ERROR_NOT_CONNECTED ;
+    }
+
+    DFU *dfuInterface = board.dfuInterface ;
+    if(dfuInterface->isDfuDeviceExist() == false)
+        return TOOLBOX_DFU_ERROR_CONNECTION ;
+
+    const DfuDeviceInfo &device = dfuInterface->getSession().getDeviceInfo() ;
+    if(board.deviceLock.acquire(device.serialNumber, device.portPath) == TOOLBOX_DFU_ERROR_DEVICE_BUSY)
+    {
+        displayManager.print(MSG_ERROR, L"STM32 DFU device %s on USB port %s is used by another process !", device.serialNumber.c_str(), device.portPath.c_str()) ;
+        return TOOLBOX_DFU_ERROR_DEVICE_BUSY ;
+    }
+
+    if(dfuInterface->getDeviceID() != 0)
+        return TOOLBOX_DFU_ERROR_NO_DEVICE ;
+
+    if(dfuInterface->isUbootDfuRunning() == false)
+    {
+        /* Same boot sequences as ProgramManager::startInstallService */
+        switch(dfuInterface->deviceID)
+        {
+        case STM32MP15:
+            board.steps = {{1, 0, DEVICE_WAIT_NONE, 0}, {3, 1, DEVICE_WAIT_UBOOT_DFU, 30000}} ;
+            break ;
+        case STM32MP13:
+            board.steps = {{0, 0, DEVICE_WAIT_DFU, 3000}, {0, 1, DEVICE_WAIT_UBOOT_DFU, 30000}} ;
+            break ;
+        case STM32MP25:
+        case STM32MP21:
+            board.steps = {{0, 0, DEVICE_WAIT_DFU, 3000}, {0, 1, DEVICE_WAIT_DFU, 3000}, {1, 2, DEVICE_WAIT_UBOOT_DFU, 30000}} ;
+            break ;
+        default:
+            displayManager.print(MSG_ERROR, L"Unsupported device !");
+            return TOOLBOX_DFU_ERROR_NOT_SUPPORTED ;
+        }
+    }
+
+    if(isStartFastboot)
+        board.steps.push_back({0, -1, DEVICE_WAIT_FASTBOOT, 30000}) ;
+    else if(board.steps.empty())
+        displayManager.print(MSG_NORMAL, L"No installing service will be performed !");
+
+    return TOOLBOX_DFU_NO_ERROR ;
+}
+
+/**
+ * @brief WaveScheduler::postStep : Queue the next step of a board on the event loop.
+ * @param board: The board.
+ */
+void WaveScheduler::postStep(WaveBoard &board)
+{
+    WaveBoard *readyBoard = &board ;
+    eventLoop.post([this, readyBoard]() {
+        selectBoardOutput(*readyBoard) ;
+        runStep(*readyBoard) ;
+        DisplayManager::resetThreadOutput() ;
+    }) ;
+}
+
+/**
+ * @brief WaveScheduler::runStep : Download the partition of the next step, then detach the board and wait for
+ * its next boot stage when the step needs it.
+ * @param board: The ready board.
+ */
+void WaveScheduler::runStep(WaveBoard &board)
+{
+    DFU *dfuInterface = board.dfuInterface ;
+    const WaveStep &step = board.steps.at(board.stepIndex) ;
+
+    int ret = TOOLBOX_DFU_NO_ERROR ;
+    if(step.partitionIndex < 0)
+    {
+        ret = dfuInterface->flashPartition(step.alternateIndex, board.parsedTsvFile->scriptUbootTsvData, board.parsedTsvFile->scriptUbootTsvDataSize) ;
+        if(ret != TOOLBOX_DFU_NO_ERROR)
+            displayManager.print(MSG_ERROR, L"Failed to program flashlayout at partition 0 !");
+    }
+    else
+    {
+        const std::string &binary = board.parsedTsvFile->partitionsList.at(step.partitionIndex).binary ;
+        ret = dfuInterface->flashPartition(step.alternateIndex, binary) ;
+        if(ret != TOOLBOX_DFU_NO_ERROR)
+            displayManager.print(MSG_ERROR, L"Failed to flash partition: %s", binary.c_str());
+    }
+
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+    {
+        finishBoard(board, ret) ;
+        return ;
+    }
+
+    board.stepIndex++ ;
+    if(step.waitAfter == DEVICE_WAIT_NONE)
+    {
+        runStep(board) ;
+        return ;
+    }
+
+    int lastDeviceNumber = dfuInterface->getSession().getDeviceInfo().deviceNumber ;
+    ret = dfuInterface->dfuDetach() ;
+    if(ret != TOOLBOX_DFU_NO_ERROR)
+    {
+        finishBoard(board, ret) ;
+        return ;
+    }
+
+    WaveBoard *waitingBoard = &board ;
+    DEVICE_WAIT waitMode = step.waitAfter ;
+    eventLoop.waitForMode(board.job->serialNumber, waitMode, lastDeviceNumber, step.msTimeout, [this, waitingBoard, waitMode](int status) {
+        selectBoardOutput(*waitingBoard) ;
+        bindBoard(*waitingBoard, waitMode, status) ;
+        DisplayManager::resetThreadOutput() ;
+    }) ;
+}
+
+/**
+ * @brief WaveScheduler::bindBoard : Open the new enumeration of a board which came back, and queue its next step.
+ * @param board: The board.
+ * @param waitMode: The awaited boot stage.
+ * @param status: Result of the wait, TOOLBOX_DFU_ERROR_TIMEOUT if the board did not show up in time.
+ */
+void WaveScheduler::bindBoard(WaveBoard &board, DEVICE_WAIT waitMode, int status)
+{
+    if(status != TOOLBOX_DFU_NO_ERROR)
+    {
+        displayManager.print(MSG_ERROR, (waitMode == DEVICE_WAIT_FASTBOOT) ? L"Failed to start Fastboot !" : L"The STM32 DFU device did not come back after the detach !");
+        finishBoard(board, TOOLBOX_DFU_ERROR_CONNECTION) ;
+        return ;
+    }
+
+    DFU *dfuInterface = board.dfuInterface ;
+    if(waitMode == DEVICE_WAIT_FASTBOOT)
+    {
+        displayManager.print(MSG_GREEN, L"U-Boot in Fastboot mode is running !") ;
+        finishBoard(board, TOOLBOX_DFU_NO_ERROR) ;
+        return ;
+    }
+
+    bool isBound = (waitMode == DEVICE_WAIT_DFU) ? dfuInterface->isDfuDeviceExist(WAVE_BIND_TIMEOUT_MS) : dfuInterface->isUbootDfuRunning(WAVE_BIND_TIMEOUT_MS) ;
+    if(isBound == false)
+    {
+        finishBoard(board, TOOLBOX_DFU_ERROR_CONNECTION) ;
+        return ;
+    }
+
+    if(board.stepIndex == board.steps.size())
+    {
+        finishBoard(board, TOOLBOX_DFU_NO_ERROR) ;
+        return ;
+    }
+
+    postStep(board) ;
+}
+
+/**
+ * @brief WaveScheduler::finishBoard : Record the result of a board and release it.
+ * @param board: The board.
+ * @param status: The result of the service.
+ */
+void WaveScheduler::finishBoard(WaveBoard &board, int status)
+{
+    board.job->status = status ;
+    board.job->isDone = true ;
+    board.job->durationMs = getElapsedMs(waveStart) ;
+    board.deviceLock.release() ;
+
+    if(status == TOOLBOX_DFU_NO_ERROR)
+    {
+        succeededCount++ ;
+        displayManager.print(MSG_GREEN, L"Done in %llu ms", (unsigned long long)board.job->durationMs);
+    }
+    else
+    {
+        displayManager.print(MSG_ERROR, L"Failed with error %d after %llu ms, see %s", status, (unsigned long long)board.job->durationMs, board.job->logFilePath.c_str());
+    }
+}
+
+/**
+ * @brief WaveScheduler::selectBoardOutput : Send the following messages to the log of the board.
+ * @param board: The board.
+ */
+void WaveScheduler::selectBoardOutput(WaveBoard &board)
+{
+    DisplayManager::setThreadOutput({board.logFile.is_open() ? &board.logFile : nullptr, "[" + board.job->serialNumber + "] ", board.logFile.is_open() ? CONSOLE_MILESTONES : CONSOLE_ALL, nullptr, nullptr}) ;
+}
+
+/**
+ * @brief WaveScheduler::getElapsedMs
+ * @param start: The start time point.
+ * @return The milliseconds elapsed since start.
+ */
+uint64_t WaveScheduler::getElapsedMs(const std::chrono::steady_clock::time_point &start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() ;
+}
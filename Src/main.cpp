@@ -22,15 +22,23 @@
 
 #include "main.h"
 #include "ProgramManager.h"
+#include "FleetManager.h"
+#include "StationManager.h"
+#include "JobServer.h"
+#include "PrgToolbox.h"
 #include <experimental/filesystem>
 namespace fs = std::experimental::filesystem;
 
-std::string PRG_TOOLBOX_DFU_VERSION = "2.1.0";
+std::string PRG_TOOLBOX_DFU_VERSION = PRGTOOLBOX_VERSION;
 std::string toolboxRootPath = "" ;
 
 int main(int argc, char* argv[])
 {
     std::string dfuSerialNumber = "";
+    uint32_t fleetJobsNumber = FLEET_DEFAULT_JOBS ;
+    uint32_t maxRootPortTransfers = FLEET_DEFAULT_ROOT_PORT_TRANSFERS ;
+    uint32_t maxHubTransfers = FLEET_DEFAULT_HUB_TRANSFERS ;
+    bool isFleetWave = false ;
 
     displayManager.print(MSG_NORMAL, L"      -------------------------------------------------------------------") ;
     displayManager.print(MSG_NORMAL, L"                      PRG-TOOLBOX-DFU v%s                      ", PRG_TOOLBOX_DFU_VERSION.c_str()) ;
@@ -69,6 +77,75 @@ int main(int argc, char* argv[])
             dfuSerialNumber = argumentsList[cmdIdx].Params[0];
             displayManager.print(MSG_NORMAL, L"Selected serial number : %s", dfuSerialNumber.data()) ;
         }
+        else if(compareStrings(argumentsList[cmdIdx].cmd , "-b", true) || compareStrings(argumentsList[cmdIdx].cmd , "--backend", true))
+        {
+            DFU_BACKEND backend = DFU_BACKEND_AUTO ;
+            if((argumentsList[cmdIdx].nParams != 1) || (DfuTransport::parseBackendName(argumentsList[cmdIdx].Params[0], &backend) != TOOLBOX_DFU_NO_ERROR))
+            {
+                displayManager.print(MSG_ERROR, L"Wrong parameters for -b/--backend command") ;
+                showHelp();
+                return EXIT_FAILURE;
+            }
+
+            DfuTransport::setDefaultBackend(backend);
+            displayManager.print(MSG_NORMAL, L"Selected DFU backend : %s", argumentsList[cmdIdx].Params[0].data()) ;
+        }
+        else if(compareStrings(argumentsList[cmdIdx].cmd , "-j", true) || compareStrings(argumentsList[cmdIdx].cmd , "--jobs", true))
+        {
+            char *end = nullptr ;
+            unsigned long value = (argumentsList[cmdIdx].nParams == 1) ? strtoul(argumentsList[cmdIdx].Params[0].c_str(), &end, 10) : 0 ;
+            if((end == nullptr) || (*end != '\0') || (value == 0) || (value > FLEET_MAX_JOBS))
+            {
+                displayManager.print(MSG_ERROR, L"Wrong parameters for -j/--jobs command, possible values [1, %d]", FLEET_MAX_JOBS) ;
+                showHelp();
+                return EXIT_FAILURE;
+            }
+
+            fleetJobsNumber = (uint32_t)value ;
+        }
+        else if(compareStrings(argumentsList[cmdIdx].cmd , "-tl", true) || compareStrings(argumentsList[cmdIdx].cmd , "--transfer-limits", true))
+        {
+            bool isValid = (argumentsList[cmdIdx].nParams == 2) ;
+            unsigned long limits[2] = {0, 0} ;
+            for(int paramIdx = 0; isValid && (paramIdx < 2); paramIdx++)
+            {
+                char *end = nullptr ;
+                limits[paramIdx] = strtoul(argumentsList[cmdIdx].Params[paramIdx].c_str(), &end, 10) ;
+                isValid = (*end == '\0') && (end != argumentsList[cmdIdx].Params[paramIdx].c_str()) && (limits[paramIdx] <= FLEET_MAX_JOBS) ;
+            }
+
+            if(isValid == false)
+            {
+                displayManager.print(MSG_ERROR, L"Wrong parameters for -tl/--transfer-limits command, possible values [0, %d]", FLEET_MAX_JOBS) ;
+                showHelp();
+                return EXIT_FAILURE;
+            }
+
+            maxRootPortTransfers = (uint32_t)limits[0] ;
+            maxHubTransfers = (uint32_t)limits[1] ;
+        }
+        else if(compareStrings(argumentsList[cmdIdx].cmd , "-w", true) || compareStrings(argumentsList[cmdIdx].cmd , "--wave", true))
+        {
+            if(argumentsList[cmdIdx].nParams != 0)
+            {
+                displayManager.print(MSG_ERROR, L"Wrong parameters for -w/--wave command") ;
+                showHelp();
+                return EXIT_FAILURE;
+            }
+
+            isFleetWave = true ;
+        }
+        else if(compareStrings(argumentsList[cmdIdx].cmd , "-sp", true) || compareStrings(argumentsList[cmdIdx].cmd , "--sparse", true))
+        {
+            if(argumentsList[cmdIdx].nParams != 0)
+            {
+                displayManager.print(MSG_ERROR, L"Wrong parameters for -sp/--sparse command") ;
+                showHelp();
+                return EXIT_FAILURE;
+            }
+
+            SparseScanner::setEnabled(true) ;
+        }
     }
 
     /* Search and execute commands */
@@ -110,6 +187,14 @@ int main(int argc, char* argv[])
 
             dfuSerialNumber = argumentsList[cmdIdx].Params[0];
         }
+        else if(compareStrings(argumentsList[cmdIdx].cmd , "-b", true) || compareStrings(argumentsList[cmdIdx].cmd , "--backend", true) ||
+                compareStrings(argumentsList[cmdIdx].cmd , "-j", true) || compareStrings(argumentsList[cmdIdx].cmd , "--jobs", true) ||
+                compareStrings(argumentsList[cmdIdx].cmd , "-tl", true) || compareStrings(argumentsList[cmdIdx].cmd , "--transfer-limits", true) ||
+                compareStrings(argumentsList[cmdIdx].cmd , "-w", true) || compareStrings(argumentsList[cmdIdx].cmd , "--wave", true) ||
+                compareStrings(argumentsList[cmdIdx].cmd , "-sp", true) || compareStrings(argumentsList[cmdIdx].cmd , "--sparse", true))
+        {
+            /* Already applied before executing the commands */
+        }
         else if(compareStrings(argumentsList[cmdIdx].cmd , "-d", true) || compareStrings(argumentsList[cmdIdx].cmd , "--download", true))
         {
             if((argumentsList[cmdIdx].nParams > 2) || (argumentsList[cmdIdx].nParams < 1))
@@ -131,38 +216,8 @@ int main(int argc, char* argv[])
 
             if(argumentsList[cmdIdx].nParams == 2) /* If there is an option "fastboot=0/1" */
             {
-                std::string sFastboot = argumentsList[cmdIdx].Params[1];
-                uint8_t enableFastboot = 0 ;
-
-                try
-                {
-                    std::regex fastbootOption("fastboot=(\\d+)", std::regex_constants::icase);
-                    std::smatch match;
-                    if (std::regex_search(sFastboot, match, fastbootOption))
-                    {
-                        enableFastboot = std::stoul(match[1]);
-                    }
-                    else
-                    {
-                        displayManager.print(MSG_ERROR, L"-d/--download command, wrong option : %s", sFastboot.c_str()) ;
-                        showHelp();
-                        return EXIT_FAILURE;
-                    }
-                }
-                catch (const std::regex_error& e)
-                {
-                    displayManager.print(MSG_ERROR, L"Regex error: %s", e.what());
-                    showHelp();
-                    return EXIT_FAILURE;
-                }
-
-                if(enableFastboot == 0)
-                    isStartFastboot = false ;
-                else if(enableFastboot == 1)
-                    isStartFastboot = true ;
-                else
+                if(parseFastbootOption(argumentsList[cmdIdx].Params[1], &isStartFastboot) != TOOLBOX_DFU_NO_ERROR)
                 {
-                    displayManager.print(MSG_ERROR, L"-d/--download command, wrong fastboot option value: %s | possible values [0 , 1]", sFastboot.c_str()) ;
                     showHelp();
                     return EXIT_FAILURE;
                 }
@@ -201,6 +256,123 @@ int main(int argc, char* argv[])
                 return EXIT_FAILURE;
 
         }
+        else if(compareStrings(argumentsList[cmdIdx].cmd , "-fl", true) || compareStrings(argumentsList[cmdIdx].cmd , "--fleet", true))
+        {
+            if((argumentsList[cmdIdx].nParams > 3) || (argumentsList[cmdIdx].nParams < 2))
+            {
+                displayManager.print(MSG_ERROR, L"Wrong parameters for -fl/--fleet command") ;
+                showHelp();
+                return EXIT_FAILURE;
+            }
+
+            std::string serviceName = argumentsList[cmdIdx].Params[0];
+            FLEET_SERVICE service = FLEET_SERVICE_INSTALL ;
+            if(compareStrings(serviceName, "flash", true))
+                service = FLEET_SERVICE_FLASH ;
+            else if(compareStrings(serviceName, "download", true) == false)
+            {
+                displayManager.print(MSG_ERROR, L"Fleet command, service is not defined : %s", serviceName.c_str()) ;
+                showHelp();
+                return EXIT_FAILURE;
+            }
+
+            if(isFleetWave && (service != FLEET_SERVICE_INSTALL))
+            {
+                displayManager.print(MSG_ERROR, L"Fleet command, -w/--wave applies to the download service only") ;
+                showHelp();
+                return EXIT_FAILURE;
+            }
+
+            bool isStartFastboot = true ;
+            if(argumentsList[cmdIdx].nParams == 3)
+            {
+                if((service != FLEET_SERVICE_INSTALL) || (parseFastbootOption(argumentsList[cmdIdx].Params[2], &isStartFastboot) != TOOLBOX_DFU_NO_ERROR))
+                {
+                    displayManager.print(MSG_ERROR, L"Fleet command, wrong option : %s", argumentsList[cmdIdx].Params[2].c_str()) ;
+                    showHelp();
+                    return EXIT_FAILURE;
+                }
+            }
+
+            /* A TSV file is deployed on every attached board, any other file maps each serial number to its TSV file */
+            std::string filePath = argumentsList[cmdIdx].Params[1];
+            FleetManager fleetManager(toolboxRootPath);
+            int ret = ((filePath.size() >= 4) && (filePath.substr(filePath.size() - 4) == ".tsv")) ? fleetManager.discoverDevices(filePath) : fleetManager.loadMapFile(filePath);
+            if(ret)
+                return EXIT_FAILURE;
+
+            if(isFleetWave)
+            {
+                ret = fleetManager.runWave(isStartFastboot);
+                fleetManager.displayResults();
+            }
+            else
+            {
+                fleetManager.setTransferLimits(maxRootPortTransfers, maxHubTransfers);
+                ret = fleetManager.run(service, fleetJobsNumber, isStartFastboot);
+                fleetManager.displayResults();
+                fleetManager.displayUsbUtilization();
+            }
+            if(ret)
+                return EXIT_FAILURE;
+        }
+        else if(compareStrings(argumentsList[cmdIdx].cmd , "-st", true) || compareStrings(argumentsList[cmdIdx].cmd , "--station", true))
+        {
+            if((argumentsList[cmdIdx].nParams > 3) || (argumentsList[cmdIdx].nParams < 2))
+            {
+                displayManager.print(MSG_ERROR, L"Wrong parameters for -st/--station command") ;
+                showHelp();
+                return EXIT_FAILURE;
+            }
+
+            std::string serviceName = argumentsList[cmdIdx].Params[0];
+            FLEET_SERVICE service = FLEET_SERVICE_INSTALL ;
+            if(compareStrings(serviceName, "flash", true))
+                service = FLEET_SERVICE_FLASH ;
+            else if(compareStrings(serviceName, "download", true) == false)
+            {
+                displayManager.print(MSG_ERROR, L"Station command, service is not defined : %s", serviceName.c_str()) ;
+                showHelp();
+                return EXIT_FAILURE;
+            }
+
+            std::string filePath = argumentsList[cmdIdx].Params[1];
+            if((filePath.size() < 4) || (filePath.substr(filePath.size() - 4) != ".tsv"))
+            {
+                displayManager.print(MSG_ERROR, L"Wrong file extension, expected file extension is .tsv") ;
+                return EXIT_FAILURE;
+            }
+
+            bool isStartFastboot = true ;
+            if(argumentsList[cmdIdx].nParams == 3)
+            {
+                if((service != FLEET_SERVICE_INSTALL) || (parseFastbootOption(argumentsList[cmdIdx].Params[2], &isStartFastboot) != TOOLBOX_DFU_NO_ERROR))
+                {
+                    displayManager.print(MSG_ERROR, L"Station command, wrong option : %s", argumentsList[cmdIdx].Params[2].c_str()) ;
+                    showHelp();
+                    return EXIT_FAILURE;
+                }
+            }
+
+            StationManager stationManager(toolboxRootPath);
+            int ret = stationManager.run(service, filePath, fleetJobsNumber, isStartFastboot);
+            if(ret)
+                return EXIT_FAILURE;
+        }
+        else if(compareStrings(argumentsList[cmdIdx].cmd , "-dm", true) || compareStrings(argumentsList[cmdIdx].cmd , "--daemon", true))
+        {
+            if(argumentsList[cmdIdx].nParams != 1)
+            {
+                displayManager.print(MSG_ERROR, L"Wrong parameters for -dm/--daemon command") ;
+                showHelp();
+                return EXIT_FAILURE;
+            }
+
+            JobServer jobServer(toolboxRootPath);
+            int ret = jobServer.run(argumentsList[cmdIdx].Params[0]);
+            if(ret)
+                return EXIT_FAILURE;
+        }
         else if(compareStrings(argumentsList[cmdIdx].cmd , "-otp", true) || compareStrings(argumentsList[cmdIdx].cmd , "--otp", true))
         {
             if(argumentsList[cmdIdx].nParams != 2 )
@@ -293,6 +465,49 @@ bool compareStrings(const std::string& str1, const std::string& str2, bool caseI
     }
 }
 
+/**
+ * @brief parseFastbootOption: Parse the optional "fastboot=0/1" parameter of the install commands.
+ * @param option: The parameter to parse.
+ * @param isStartFastboot: Output flag, true to launch the fastboot mode after the boot partitions.
+ * @return 0 if the operation is performed successfully, otherwise an error occurred.
+ */
+int parseFastbootOption(const std::string& option, bool* isStartFastboot)
+{
+    uint8_t enableFastboot = 0 ;
+
+    try
+    {
+        std::regex fastbootOption("fastboot=(\\d+)", std::regex_constants::icase);
+        std::smatch match;
+        if (std::regex_search(option, match, fastbootOption))
+        {
+            enableFastboot = std::stoul(match[1]);
+        }
+        else
+        {
+            displayManager.print(MSG_ERROR, L"Wrong fastboot option : %s", option.c_str()) ;
+            return TOOLBOX_DFU_ERROR_WRONG_PARAM;
+        }
+    }
+    catch (const std::regex_error& e)
+    {
+        displayManager.print(MSG_ERROR, L"Regex error: %s", e.what());
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM;
+    }
+
+    if(enableFastboot == 0)
+        *isStartFastboot = false ;
+    else if(enableFastboot == 1)
+        *isStartFastboot = true ;
+    else
+    {
+        displayManager.print(MSG_ERROR, L"Wrong fastboot option value: %s | possible values [0 , 1]", option.c_str()) ;
+        return TOOLBOX_DFU_ERROR_WRONG_PARAM;
+    }
+
+    return TOOLBOX_DFU_NO_ERROR;
+}
+
 /**
  * @brief extractProgramCommands: check and extract the total of commands which are passed to the program.
  * @param numberCommands: Initial number of commands passed to the program.
@@ -375,6 +590,10 @@ void showHelp()
     displayManager.print(MSG_NORMAL, L"--version          -v       : Display the program version.") ;
     displayManager.print(MSG_NORMAL, L"--list             -l       : Display the list of available STM32 DFU devices.") ;
     displayManager.print(MSG_NORMAL, L"--serial           -sn      : Select the USB device by serial number.") ;
+    displayManager.print(MSG_NORMAL, L"                              Note: the device is locked against the other instances, in PRG_TOOLBOX_DFU_LOCK_DIR if set") ;
+    displayManager.print(MSG_NORMAL, L"--backend          -b       : Select the DFU backend, possible value [auto, dfu-util, usb, mock]") ;
+    displayManager.print(MSG_NORMAL, L"                              Note: if it is not specified, PRG_TOOLBOX_DFU_BACKEND is used, otherwise auto") ;
+    displayManager.print(MSG_NORMAL, L"                              The mock boards are declared with PRG_TOOLBOX_DFU_MOCK_BOARDS=serial[:deviceID][@portPath],...") ;
     displayManager.print(MSG_NORMAL, L"--download         -d       : Prepare the device, install U-Boot and enable/disable fastboot mode.") ;
     displayManager.print(MSG_NORMAL, L"       <filePath.tsv>       : TSV file path") ;
     displayManager.print(MSG_NORMAL, L"       <fastboot=0/1>       : Optional flag to configure the fastboot, possible value [0, 1]") ;
@@ -384,6 +603,32 @@ void showHelp()
 
     displayManager.print(MSG_NORMAL, L"--flash            -f       : Prepare the device and flash the list of partitions through DFU interface") ;
     displayManager.print(MSG_NORMAL, L"       <filePath.tsv>       : TSV file path") ;
+    displayManager.print(MSG_NORMAL, L"                              Note: with dfu-util, a compressed binary larger than 64 MB once decompressed is") ;
+    displayManager.print(MSG_NORMAL, L"                              written to a temporary file before its download") ;
+
+    displayManager.print(MSG_NORMAL, L"--fleet            -fl      : Run the download or flash service on several devices in parallel") ;
+    displayManager.print(MSG_NORMAL, L"       <service>            : download/flash") ;
+    displayManager.print(MSG_NORMAL, L"       <filePath>           : TSV file deployed on all the attached devices which are not in use,") ;
+    displayManager.print(MSG_NORMAL, L"                              or map file with one \"serialNumber tsvFilePath\" line per device") ;
+    displayManager.print(MSG_NORMAL, L"       <fastboot=0/1>       : Optional flag of the download service, see --download") ;
+    displayManager.print(MSG_NORMAL, L"                              Note: each device log is written in PRG_TOOLBOX_DFU_LOG_DIR if set, otherwise PRG-TOOLBOX-DFU-logs") ;
+    displayManager.print(MSG_NORMAL, L"--station          -st      : Wait for the boards and run the download or flash service on each new board, until Ctrl+C") ;
+    displayManager.print(MSG_NORMAL, L"       <service>            : download/flash") ;
+    displayManager.print(MSG_NORMAL, L"       <filePath.tsv>       : TSV file deployed on every plugged board") ;
+    displayManager.print(MSG_NORMAL, L"       <fastboot=0/1>       : Optional flag of the download service, see --download") ;
+    displayManager.print(MSG_NORMAL, L"                              Note: a served board is served again once unplugged for 5 s") ;
+    displayManager.print(MSG_NORMAL, L"--daemon           -dm      : Serve the install, flash, otp-read, otp-write, phase and list jobs on a local socket, until Ctrl+C") ;
+    displayManager.print(MSG_NORMAL, L"       <socketPath>         : Unix domain socket path, one JSON request per line, e.g.") ;
+    displayManager.print(MSG_NORMAL, L"                              {\"id\":\"1\",\"type\":\"install\",\"serial\":\"<serial>\",\"tsv\":\"<filePath.tsv>\",\"fastboot\":true}") ;
+    displayManager.print(MSG_NORMAL, L"                              Note: the progress is streamed back as JSON lines, ending with a \"done\" event") ;
+    displayManager.print(MSG_NORMAL, L"--jobs             -j       : Maximum number of devices served at the same time by --fleet and --station, default 4") ;
+    displayManager.print(MSG_NORMAL, L"--transfer-limits  -tl      : Maximum number of partition downloads at the same time in the USB tree, for --fleet") ;
+    displayManager.print(MSG_NORMAL, L"       <perRootPort>        : Limit behind a same root port, default 4, 0 for no limit") ;
+    displayManager.print(MSG_NORMAL, L"       <perHub>             : Limit in a same hub, default 2, 0 for no limit") ;
+    displayManager.print(MSG_NORMAL, L"--wave             -w       : Run --fleet download from a single thread, each boot step is issued on every device") ;
+    displayManager.print(MSG_NORMAL, L"                              and the devices are served as they re-enumerate, so their reboots overlap") ;
+    displayManager.print(MSG_NORMAL, L"--sparse           -sp      : Do not download the trailing 0x00/0xFF blocks of the --flash binaries written to a memory") ;
+    displayManager.print(MSG_NORMAL, L"                              Note: the end of these partitions keeps its previous content") ;
 
     displayManager.print(MSG_NORMAL, L"--otp         -otp          : Read and write the OTP partition") ;
     displayManager.print(MSG_NORMAL, L"       <operationType>      : read/write") ;
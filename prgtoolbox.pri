@@ -0,0 +1,79 @@
+# Settings and sources shared by the executable and the library projects
+CONFIG += c++11
+CONFIG -= qt
+QMAKE_CXXFLAGS += -pthread
+unix: QMAKE_CXXFLAGS += -fvisibility=hidden
+DEFINES += PRGTOOLBOX_BUILD
+LIBS += -lstdc++fs -lz -llzma
+
+VERSION = 2.1.0
+QMAKE_TARGET_COMPANY = "STMicroelectronics"
+QMAKE_TARGET_PRODUCT = "PRG-TOOLBOX-DFU"
+QMAKE_TARGET_COPYRIGHT = "Copyrights 2024 STMicroelectronics"
+
+INCLUDEPATH += $$PWD/Inc
+
+SOURCES += \
+        $$PWD/Src/DisplayManager.cpp \
+        $$PWD/Src/FileManager.cpp \
+        $$PWD/Src/FirmwareImage.cpp \
+        $$PWD/Src/ProgramManager.cpp \
+        $$PWD/Src/PartitionPrefetcher.cpp \
+        $$PWD/Src/SparseScanner.cpp \
+        $$PWD/Src/StreamDecompressor.cpp \
+        $$PWD/Src/DFU.cpp \
+        $$PWD/Src/DfuDevice.cpp \
+        $$PWD/Src/AltSettingTable.cpp \
+        $$PWD/Src/DeviceSession.cpp \
+        $$PWD/Src/DeviceIndex.cpp \
+        $$PWD/Src/ProcessRunner.cpp \
+        $$PWD/Src/ScratchSpace.cpp \
+        $$PWD/Src/DeviceLock.cpp \
+        $$PWD/Src/SysfsUsb.cpp \
+        $$PWD/Src/HotplugMonitor.cpp \
+        $$PWD/Src/DfuTransport.cpp \
+        $$PWD/Src/DfuUtilOutputParser.cpp \
+        $$PWD/Src/DfuUtilTransport.cpp \
+        $$PWD/Src/UsbDfuTransport.cpp \
+        $$PWD/Src/MockDfuTransport.cpp \
+        $$PWD/Src/TransferScheduler.cpp \
+        $$PWD/Src/FleetManager.cpp \
+        $$PWD/Src/DeviceEventLoop.cpp \
+        $$PWD/Src/WaveScheduler.cpp \
+        $$PWD/Src/StationManager.cpp \
+        $$PWD/Src/JsonMessage.cpp \
+        $$PWD/Src/JobServer.cpp \
+        $$PWD/Src/PrgToolbox.cpp
+
+HEADERS += \
+    $$PWD/Inc/DisplayManager.h \
+    $$PWD/Inc/Error.h \
+    $$PWD/Inc/FileManager.h \
+    $$PWD/Inc/FirmwareImage.h \
+    $$PWD/Inc/ProgramManager.h \
+    $$PWD/Inc/PartitionPrefetcher.h \
+    $$PWD/Inc/SparseScanner.h \
+    $$PWD/Inc/StreamDecompressor.h \
+    $$PWD/Inc/DFU.h \
+    $$PWD/Inc/DfuDevice.h \
+    $$PWD/Inc/AltSettingTable.h \
+    $$PWD/Inc/DeviceSession.h \
+    $$PWD/Inc/DeviceIndex.h \
+    $$PWD/Inc/ProcessRunner.h \
+    $$PWD/Inc/ScratchSpace.h \
+    $$PWD/Inc/DeviceLock.h \
+    $$PWD/Inc/SysfsUsb.h \
+    $$PWD/Inc/HotplugMonitor.h \
+    $$PWD/Inc/DfuTransport.h \
+    $$PWD/Inc/DfuUtilOutputParser.h \
+    $$PWD/Inc/DfuUtilTransport.h \
+    $$PWD/Inc/UsbDfuTransport.h \
+    $$PWD/Inc/MockDfuTransport.h \
+    $$PWD/Inc/TransferScheduler.h \
+    $$PWD/Inc/FleetManager.h \
+    $$PWD/Inc/DeviceEventLoop.h \
+    $$PWD/Inc/WaveScheduler.h \
+    $$PWD/Inc/StationManager.h \
+    $$PWD/Inc/JsonMessage.h \
+    $$PWD/Inc/JobServer.h \
+    $$PWD/Inc/PrgToolbox.h
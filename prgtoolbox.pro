@@ -0,0 +1,11 @@
+# libprgtoolbox, the shared library with the C interface of PrgToolbox.h
+TEMPLATE = lib
+CONFIG += shared skip_target_version_ext
+TARGET = prgtoolbox
+DESTDIR = $$PWD
+OBJECTS_DIR = build/lib
+QMAKE_LFLAGS += -static-libgcc -static-libstdc++ -pthread
+unix: QMAKE_LFLAGS += -Wl,--exclude-libs,ALL
+MAKEFILE = qtMakefile.lib
+
+include(prgtoolbox.pri)